@@ -124,6 +124,21 @@ class DLLEXPORT DeskLamp : public HippoDevice {
   uint64_t subscribe(void(*callback)(const DeskLampNotificationParam &param,
                                      void *data),
                      void *data, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are decoded and delivered
+  uint64_t subscribe(void(*callback)(const DeskLampNotificationParam &param,
+                                     void *data),
+                     void *data, uint64_t mask, uint32_t *get);
+
+  // subscribe to notifications in polling mode: up to |queue_depth|
+  // notifications are queued until they are retrieved with poll()
+  uint64_t subscribe(uint32_t queue_depth, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are queued
+  uint64_t subscribe(uint32_t queue_depth, uint64_t mask, uint32_t *get);
+  // copies up to |max_params| queued notifications, oldest first
+  uint64_t poll(DeskLampNotificationParam *params, uint32_t max_params,
+                uint32_t *num_params);
 
   // unsubscribe from notifications
   uint64_t unsubscribe();
@@ -0,0 +1,106 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_FRAME_SYNCHRONIZER_H_
+#define INCLUDE_FRAME_SYNCHRONIZER_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/hippo_camera.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+const uint32_t kMaxSyncSources = 8;
+
+typedef struct SyncedFrame {
+  // keeps the frame referenced as long as the FrameSet
+  FrameHandle frame;
+  // the stream of the source in the frame
+  const StreamHeader *header;
+  const uint8_t *data;
+} SyncedFrame;
+
+typedef struct FrameSet {
+  // one frame for each source, in the order the sources were added
+  SyncedFrame frames[kMaxSyncSources];
+  uint32_t num_frames;
+  // the timestamp of the earliest frame of the set
+  uint64_t timestamp;
+  // microseconds between the earliest and the latest frames of the set
+  int64_t skew_us;
+} FrameSet;
+
+typedef struct SyncStats {
+  // frame sets matched
+  uint64_t framesets;
+  // frames of each source dropped without a match
+  uint64_t dropped[kMaxSyncSources];
+  // frame sets matched but dropped before a Pop()
+  uint64_t dropped_sets;
+  // largest and average skew of the frame sets matched
+  int64_t max_skew_us;
+  int64_t avg_skew_us;
+} SyncStats;
+
+// FrameSynchronizer matches the frames of several sources by their capture
+// timestamps and returns them in aligned frame sets. A source is a stream of
+// the frames pushed for it: i.e. the color and the depth streams of a
+// DepthCamera frame, or the depth stream of a DepthCamera and the color
+// stream of a HiResCamera connected to the same SoHal (the timestamps must
+// come from the same clock).
+//
+// A frame set is matched when the frames at the head of every source are
+// within |tolerance_us| of each other. A frame that can no longer be matched,
+// because another source is already past it, is dropped, and so is the
+// oldest frame of a source that has |queue_depth| frames waiting for the
+// other sources. Likewise, the oldest frame set is dropped when
+// |queue_depth| sets are waiting for Pop(). Push() and Pop() can be called
+// from different threads.
+//
+// e.g.
+//    hippo::FrameSynchronizer sync(5000);
+//    sync.AddSource(color, &color_src);
+//    sync.AddSource(depth, &depth_src);
+//    ...
+//    depthcamera.grab_frame(streams, &frame);
+//    sync.Push(color_src, frame);
+//    sync.Push(depth_src, frame);
+//    if (!sync.Pop(&set, 0)) {
+//      process(set.frames[0].data, set.frames[1].data);
+//    }
+class DLLEXPORT FrameSynchronizer {
+ public:
+  explicit FrameSynchronizer(int64_t tolerance_us);
+  FrameSynchronizer(int64_t tolerance_us, uint32_t queue_depth);
+  ~FrameSynchronizer(void);
+
+  // adds a source for the (single) stream in |stream|, to be used with Push()
+  uint64_t AddSource(const CameraStreams &stream, uint32_t *source);
+  // queues the stream of |source| in |frame|
+  uint64_t Push(uint32_t source, const FrameHandle &frame);
+  // waits up to |timeout_ms| milliseconds for the next frame set
+  // (HIPPO_TIMEOUT if none was matched in time)
+  uint64_t Pop(FrameSet *set, uint32_t timeout_ms);
+  uint64_t GetStats(SyncStats *get);
+  // drops the frames waiting to be matched and clears the stats
+  void Reset();
+
+  FrameSynchronizer(FrameSynchronizer const &);    // Don't implement
+  void operator=(FrameSynchronizer const &);       // Don't implement
+
+ private:
+  class Queues;
+  Queues *queues_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_FRAME_SYNCHRONIZER_H_
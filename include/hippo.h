@@ -119,12 +119,135 @@ typedef enum HippoFacility {
 } HippoFacility;
 
 
+namespace internal {
+
+// The functions below are evaluated at compile time by MAKE_HIPPO_ERROR, so
+// that making an error costs no string work at runtime. They are C++11
+// constexpr functions (single return statement, recursion instead of loops).
+
+typedef struct FileIdEntry {
+  const char *name;
+  uint16_t id;
+} FileIdEntry;
+
+// ids of the hiPPo source files (and of the headers whose templates make
+// errors), to be reported in the error codes
+constexpr FileIdEntry kFileIds[] = {
+  { "base64.cc", 0xbb64 },
+  { "capturestage.cc", 0xbbc5 },
+  { "depthcamera.cc", 0xbbdc },
+  { "desklamp.cc", 0xbbd1 },
+  { "frame_synchronizer.cc", 0xbbf5 },
+  { "hippo.cc", 0xbb00 },
+  { "hippo_arena.cc", 0xbba0 },
+  { "hippo_camera.cc", 0xbb01 },
+  { "hippo_device.cc", 0xbb0d },
+  { "hippo_device.h", 0xbb0e },
+  { "hippo_dispatcher.cc", 0xbbd5 },
+  { "hippo_reactor.cc", 0xbbe0 },
+  { "hippo_swdevice.cc", 0xbb5d },
+  { "hippo_ws.cc", 0xbb55 },
+  { "hirescamera.cc", 0xbbea },
+  { "keystone_warp.cc", 0xbbe5 },
+  { "lens_model.cc", 0xbb1e },
+  { "notification_recorder.cc", 0xbbec },
+  { "pixel_convert.cc", 0xbbcf },
+  { "point_cloud.cc", 0xbbd3 },
+  { "projector.cc", 0xbb08 },
+  { "projector_types.cc", 0xbb09 },
+  { "pyramid.cc", 0xbbd9 },
+  { "registration.cc", 0xbbe9 },
+  { "remap.cc", 0xbbaa },
+  { "sbuttons.cc", 0xbbb0 },
+  { "sohal.cc", 0xbb0a },
+  { "system.cc", 0xbb5e },
+  { "system_types.cc", 0xbb5f },
+  { "touchmat.cc", 0xbba1 },
+  { "undistort.cc", 0xbbd7 },
+  { "uvccamera.cc", 0xbbcc },
+};
+constexpr uint32_t kNumFileIds = sizeof(kFileIds) / sizeof(kFileIds[0]);
+constexpr uint16_t kFileIdNotFound = 0xffff;
+
+// SoHal reports the line number using its decimal digits as hex digits
+// (i.e. line 123 is reported as 0x123)
+constexpr uint32_t LineToHex(uint32_t line) {
+  return (line < 10) ? line : ((LineToHex(line / 10) << 4) | (line % 10));
+}
+
+// returns the file name part of |path| (call it with base == path)
+constexpr const char *FileBasename(const char *path, const char *base) {
+  return ('\0' == *path) ? base :
+         FileBasename(path + 1,
+                      ('\\' == *path || '/' == *path) ? path + 1 : base);
+}
+
+constexpr bool StrEqual(const char *a, const char *b) {
+  return (*a == *b) && ('\0' == *a || StrEqual(a + 1, b + 1));
+}
+
+// returns the id of a hiPPo source file, or kFileIdNotFound
+constexpr uint16_t KnownFileId(const char *name, uint32_t i) {
+  return (i == kNumFileIds) ? kFileIdNotFound :
+         StrEqual(name, kFileIds[i].name) ? kFileIds[i].id :
+         KnownFileId(name, i + 1);
+}
+
+// 32 bit FNV-1a hash
+constexpr uint32_t Fnv1a(const char *str, uint32_t hash) {
+  return ('\0' == *str) ? hash :
+         Fnv1a(str + 1, static_cast<uint32_t>(
+             ((hash ^ static_cast<uint8_t>(*str)) * 16777619ull) &
+             0xffffffff));
+}
+
+// folds the hash into a 16 bit id, staying away from the ids reserved for
+// the hiPPo files (0xbbxx) and from kFileIdNotFound
+constexpr uint16_t HashToFileId(uint32_t hash) {
+  return (0xbb00 == ((hash ^ (hash >> 16)) & 0xff00)) ?
+             static_cast<uint16_t>((hash ^ (hash >> 16) ^ 0x0100) & 0xffff) :
+         (kFileIdNotFound == ((hash ^ (hash >> 16)) & 0xffff)) ?
+             static_cast<uint16_t>(kFileIdNotFound - 1) :
+             static_cast<uint16_t>((hash ^ (hash >> 16)) & 0xffff);
+}
+
+// the hiPPo source files use their fixed id, other files (i.e. client files
+// registered with ADD_FILE_TO_MAP()) use an id derived from their name.
+constexpr uint16_t FileIdFromName(const char *name) {
+  return (kFileIdNotFound != KnownFileId(name, 0)) ? KnownFileId(name, 0) :
+         HashToFileId(Fnv1a(name, 2166136261u));
+}
+
+constexpr uint16_t FileIdFromPath(const char *path) {
+  return FileIdFromName(FileBasename(path, path));
+}
+
+// builds the error code out of an already encoded line and file id
+constexpr uint64_t ComposeHippoError(uint32_t facility, uint32_t code,
+                                     uint32_t line_hex, uint16_t file_id) {
+  return (static_cast<uint64_t>((static_cast<uint32_t>(file_id) << 16) |
+                                (line_hex & 0xffff)) << 32) |
+         0x20000000 | (facility << 16) | code;
+}
+
+// used to force the compile time evaluation of the constexpr functions
+template <typename T, T value>
+struct Constant {
+  static const T kValue = value;
+};
+
+}  // namespace internal
+
 DLLEXPORT uint16_t GetFileId(const char *fileName);
 
 // we use macros to ensure the line corresponds to the caller
+// both the line and file encodings are computed at compile time
 #define MAKE_HIPPO_ERROR(facility, code)       \
-  MakeHippoError((facility), (code), (uint16_t)__LINE__, \
-                 hippo::GetFileId(__FILE__))
+  hippo::internal::ComposeHippoError((facility), (code), \
+      hippo::internal::Constant<uint32_t,                \
+          hippo::internal::LineToHex(__LINE__)>::kValue, \
+      hippo::internal::Constant<uint16_t,                \
+          hippo::internal::FileIdFromPath(__FILE__)>::kValue)
 
 #define ADD_FILE_TO_MAP()       \
   hippo::AddFileToFileMap(__FILE__)
@@ -149,6 +272,12 @@ DLLEXPORT void strerror(uint64_t err, size_t bufsz, char *str);
 // will not print hiPPo error messages
 DLLEXPORT const char* strerror();
 
+// fills |msgs| with up to |max_msgs| of the last SoHal error messages
+// received by the calling thread, most recent first, and returns the number
+// of messages filled. The pointers are owned by hiPPo and remain valid until
+// the calling thread receives 8 more errors.
+DLLEXPORT uint32_t strerror_history(const char **msgs, uint32_t max_msgs);
+
 // will add the given filename to the hiPPo file map in order to report
 // the right file in error messages if the error is generated using
 // hiPPo's APIs
@@ -0,0 +1,104 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_HIPPO_ARENA_H_
+#define INCLUDE_HIPPO_ARENA_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hippo.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+
+namespace hippo {
+
+// ResultArena is an optional, caller-owned block of memory that can be passed
+// to the functions returning multi-field results (DeviceInfo, CalibrationData,
+// ProjectorSpecificInfo, HardwareIDs, CameraKeystoneTableEntries, ...).
+//
+// When an arena is passed in, every string and array of the result is carved
+// out of the arena instead of being malloc'd one by one, and the whole result
+// is released in a single operation by calling Reset() (or by destroying the
+// arena). The matching free_* function must NOT be called on a result that
+// was allocated in an arena.
+//
+// Reset() keeps the memory around, so a caller polling e.g. system.devices
+// every second will not allocate anything once the arena has grown to the
+// size of the result. A ResultArena is not thread safe: use one arena per
+// thread.
+//
+// e.g.
+//    hippo::ResultArena arena;
+//    hippo::DeviceInfo *devs;
+//    uint64_t num_devs;
+//    while (running) {
+//      if (!system.devices(&devs, &num_devs, &arena)) {
+//        ...
+//      }
+//      arena.Reset();   // frees all the strings and the array at once
+//    }
+class DLLEXPORT ResultArena {
+ public:
+  ResultArena();
+  // |block_size| is the size in bytes of the first block of the arena
+  explicit ResultArena(size_t block_size);
+  ~ResultArena(void);
+
+  // Returns |size| bytes of uninitialized memory (aligned to 8 bytes),
+  // or NULL if the memory could not be allocated.
+  void *Alloc(size_t size);
+  // Same as Alloc() for |num| items of |size| bytes, zero initialized.
+  void *Calloc(size_t num, size_t size);
+  // Copies the null-terminated string |str| into the arena.
+  char *StrDup(const char *str);
+
+  // Releases all the results allocated in the arena at once. The memory is
+  // kept to be reused by the next results: if the previous results did not
+  // fit in a single block, the blocks are merged into one that does.
+  void Reset();
+  // Releases all the results and gives the memory back to the system.
+  void Release();
+
+  // number of bytes currently handed out by the arena
+  size_t Used() const;
+  // number of bytes currently reserved by the arena
+  size_t Capacity() const;
+
+ private:
+  typedef struct Block {
+    Block *next;
+    size_t size;
+    size_t used;
+  } Block;
+
+  Block *NewBlock(size_t size);
+
+  Block *head_;
+  Block *current_;
+  size_t block_size_;
+
+  ResultArena(ResultArena const &);       // Don't implement
+  void operator=(ResultArena const &);    // Don't implement
+};
+
+// These are used internally by the json2c functions: they allocate from the
+// arena when one is passed, and fall back to malloc otherwise (in which case
+// the result must be released with the corresponding free_* function).
+inline char *ArenaStrDup(ResultArena *arena, const char *str) {
+  return (NULL == arena) ? strdup(str) : arena->StrDup(str);
+}
+
+inline void *ArenaCalloc(ResultArena *arena, size_t num, size_t size) {
+  return (NULL == arena) ? calloc(num, size) : arena->Calloc(num, size);
+}
+
+}  // namespace hippo
+
+#endif  // INCLUDE_HIPPO_ARENA_H_
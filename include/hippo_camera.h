@@ -163,6 +163,99 @@ typedef struct CameraFrame {
   size_t raw_length_;
 } CameraFrame;
 
+typedef enum class StreamingPolicy {
+  // when every frame of the ring is waiting to be acquired, the oldest one
+  // is overwritten by the next frame received
+  drop_oldest,
+  // the streaming thread waits for the application to release a frame
+  // before requesting the next one
+  block,
+} StreamingPolicy;
+
+typedef struct StreamingStats {
+  // frames received from SoHal
+  uint64_t received;
+  // frames returned by acquire_frame()
+  uint64_t acquired;
+  // frames overwritten before they were acquired
+  uint64_t dropped;
+  // frame requests that failed or returned an error frame (neither goes in
+  // the ring)
+  uint64_t errors;
+} StreamingStats;
+
+class FrameRing;
+
+typedef struct FramePoolStats {
+  // frame buffers allocated by the pool
+  uint64_t allocated;
+  // frames referenced by FrameHandles
+  uint64_t in_use;
+  // frames grabbed into a recycled buffer
+  uint64_t recycled;
+  // size in bytes of the frames of the streams grabbed
+  size_t frame_size;
+} FramePoolStats;
+
+class FramePool;
+struct PooledFrame;
+
+// FrameHandle is a reference counted CameraFrame from the frame pool of a
+// camera. The copies of a handle share the same frame, whose buffer goes
+// back to the pool when the last of them is reset or destroyed, to be
+// reused by the next grab_frame(). Handles can outlive their camera.
+class DLLEXPORT FrameHandle {
+ public:
+  FrameHandle();
+  FrameHandle(const FrameHandle &other);
+  FrameHandle &operator=(const FrameHandle &other);
+  ~FrameHandle(void);
+
+  // drops this reference to the frame, leaving the handle empty
+  void Reset();
+  // returns the frame, or NULL if the handle is empty
+  const CameraFrame *get() const;
+  const CameraFrame *operator->() const;
+  // returns the number of handles sharing the frame
+  uint32_t use_count() const;
+
+ private:
+  friend class HippoCamera;
+  // takes over a reference to |frame|
+  explicit FrameHandle(PooledFrame *frame);
+
+  PooledFrame *frame_;
+};
+
+class AsyncGrabber;
+struct AsyncGrab;
+
+// FrameFuture is the completion handle of grab_frame_async(): it completes
+// with the frame, or the error, of its request. The copies of a future share
+// the same request.
+class DLLEXPORT FrameFuture {
+ public:
+  FrameFuture();
+  FrameFuture(const FrameFuture &other);
+  FrameFuture &operator=(const FrameFuture &other);
+  ~FrameFuture(void);
+
+  // returns true once the request completed
+  bool ready() const;
+  // waits up to |timeout_ms| milliseconds for the request to complete and
+  // returns its error, or its frame in |frame| (HIPPO_TIMEOUT if it did not
+  // complete in time)
+  uint64_t wait(uint32_t timeout_ms, FrameHandle *frame);
+  // drops this reference to the request, leaving the future empty
+  void Reset();
+
+ private:
+  friend class AsyncGrabber;
+  // takes over a reference to |grab|
+  explicit FrameFuture(AsyncGrab *grab);
+
+  AsyncGrab *grab_;
+};
 
 // Implements functionality that is available for all cameras
 // (UVC) cameras.
@@ -268,13 +361,75 @@ class DLLEXPORT HippoCamera : public HippoDevice {
                       const FilterParameters *param,
                       CameraFrame *frame);
 
+  // Same as grab_frame(), but SoHal returns the latest frame available
+  // instead of waiting for the next one.
   uint64_t grab_frame_async(const CameraStreams &streams, CameraFrame *frame);
 
+  // Requests a frame and returns without waiting for it: the frame is
+  // grabbed into the frame pool in the background, and |future| completes
+  // with it. The requests alternate between two connections to the frame
+  // server, so the next frame is already requested while the application
+  // processes the current one, and two frames can be in flight at once.
+  // A request never completes with the same frame as the request before it.
+  //
+  // e.g.
+  //    hippo::FrameFuture next;
+  //    camera.grab_frame_async(streams, &next);
+  //    while (running) {
+  //      hippo::FrameFuture current = next;
+  //      camera.grab_frame_async(streams, &next);
+  //      if (!current.wait(1000, &frame)) {
+  //        ...
+  //      }
+  //    }
+  uint64_t grab_frame_async(const CameraStreams &streams, FrameFuture *future);
+
+  // Grabs a frame into a buffer of the camera's frame pool, which is sized
+  // from the stream headers of the frames grabbed (see GetDataLen()) and
+  // recycled when the last FrameHandle to it goes away: once the pool has
+  // as many buffers as frames held by the application, grabbing frames does
+  // not allocate any memory.
+  uint64_t grab_frame(const CameraStreams &streams, FrameHandle *frame);
+  uint64_t frame_pool_stats(FramePoolStats *get);
+
+  // Starts streaming frames of the (already enabled) streams: a streaming
+  // thread requests the frames from SoHal back to back and stores them in a
+  // ring of |ring_depth| preallocated frames, so the next frame is already
+  // being captured while the application processes the current one. The
+  // failed requests and the frames with an error are left out of the ring
+  // (see StreamingStats::errors), and the requests are retried with an
+  // increasing delay while they fail. grab_frame() returns
+  // HIPPO_WRONG_STATE_ERROR until stop_streaming() is called. The default
+  // policy is StreamingPolicy::drop_oldest.
+  uint64_t start_streaming(const CameraStreams &streams, uint32_t ring_depth);
+  uint64_t start_streaming(const CameraStreams &streams, uint32_t ring_depth,
+                           StreamingPolicy policy);
+
+  // Waits up to |timeout_ms| milliseconds for the oldest frame of the ring
+  // that was not acquired yet. The frame (and its data) stays valid, and its
+  // slot of the ring is not reused, until it is passed to release_frame().
+  uint64_t acquire_frame(CameraFrame **frame, uint32_t timeout_ms);
+  uint64_t release_frame(CameraFrame *frame);
+
+  // Stops the streaming thread and frees the ring, including the frames
+  // acquired and not released. It must not be called while another thread
+  // is in acquire_frame(). disable_streams() and the destructor call it too.
+  uint64_t stop_streaming();
+
+  // returns the frame counters of the current (or last) streaming session
+  uint64_t streaming_stats(StreamingStats *get);
+
   // returns the bytes per pixel for the passed in pixel format
   uint32_t BitsPerPixel(PixelFormat format);
 
  protected:
   HippoWS *wsFrames_;
+  FrameRing *ring_;
+  FramePool *pool_;
+  AsyncGrabber *async_;
+  // the port of the frame streaming server
+  uint32_t frames_port_;
+  StreamingStats last_streaming_stats_;
 
   bool IsConnectedFrames();
   uint64_t EnsureConnectedFrames(uint32_t port);
@@ -287,6 +442,21 @@ class DLLEXPORT HippoCamera : public HippoDevice {
   uint64_t EnableStream_json2c(const void *obj, EnableStream *get);
 
   size_t GetDataLen(const StreamHeader *header);
+  // points the headers and the data of |frame| to the |len| bytes received
+  // in its raw_data_
+  uint64_t ParseFrame(CameraFrame *frame, size_t len);
+  // the size of a frame with the same streams and stream headers
+  size_t GetFrameLen(const CameraFrame &frame);
+  // grabs a frame into the frame pool, requesting it on |ws|
+  uint64_t GrabPooledFrame(HippoWS *ws, const CameraStreams &streams,
+                           FrameHandle *frame);
+  void StopAsyncGrabs();
+
+ private:
+  // the streaming thread requests and parses the frames
+  friend class FrameRing;
+  // and so do the grab_frame_async() connections
+  friend class AsyncGrabber;
 };
 
 }  // namespace hippo
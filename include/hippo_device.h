@@ -5,7 +5,11 @@
 #ifndef INCLUDE_HIPPO_DEVICE_H_
 #define INCLUDE_HIPPO_DEVICE_H_
 
+#include <atomic>
+
 #include "../include/hippo.h"
+#include "../include/hippo_arena.h"
+#include "../include/notification_queue.h"
 #include "../include/common_types.h"
 #include "../include/system_types.h"  // for TemperatureInfo
 
@@ -22,9 +26,14 @@ class thread;
 namespace hippo {
 
 class HippoWS;
+class NotificationReactor;
+class ReadCoalescer;
+class SignalQueue;
+class StateCache;
 
 const uint32_t MAX_DEV_LEN = 64;
 const uint32_t MAX_ADDR_LEN = 256;
+const uint32_t MAX_SCALAR_REQUEST_LEN = 512;
 
 // The Vendor ID (VID) and Product ID (PID) for each device are listed in the
 // table below. Note that the HP Z 3D Camera's High Resolution Camera and UVC
@@ -146,6 +155,115 @@ typedef enum class DeviceNotification {
   on_suspend,
 } DeviceNotification;
 
+// How the notifications of a given type are delivered when they are received
+// faster than the application handles them.
+typedef enum class NotificationPolicy {
+  // Every notification is delivered (default)
+  keep_all,
+  // Only the newest pending notification of the type is delivered: a new
+  // notification replaces (conflates) the one still waiting to be delivered
+  keep_latest,
+  // Same as keep_latest, but the notification is delivered at most
+  // max_rate_hz times per second
+  rate_limit,
+} NotificationPolicy;
+
+// The notifications of a high priority device (the input devices, SButtons
+// and TouchMat, by default) are never queued behind the ones of the normal
+// devices.
+typedef enum class NotificationPriority {
+  normal,
+  high,
+} NotificationPriority;
+
+typedef struct NotificationStats {
+  // notifications passed to the callback (or to the polling queue)
+  uint64_t delivered;
+  // notifications replaced by a newer one of the same type
+  uint64_t conflated;
+  // notifications lost because a queue was full
+  uint64_t dropped;
+  // notifications discarded by the subscribe mask, before being decoded
+  uint64_t filtered;
+} NotificationStats;
+
+// number of buckets of a LatencyHistogram
+const uint32_t LATENCY_HISTOGRAM_BUCKETS = 24;
+
+// log2 histogram of latencies: buckets[i] counts the latencies between 2^i
+// and 2^(i+1) microseconds (buckets[0] also counts the ones under 1us, and
+// the last bucket all the ones over 2^23us, about 8s)
+typedef struct LatencyHistogram {
+  uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t total_us;
+  uint64_t max_us;
+} LatencyHistogram;
+
+typedef struct NotificationLatency {
+  // from the socket receive to the end of the JSON parsing
+  LatencyHistogram decode;
+  // from the end of the parsing to the dispatch to the device, that is the
+  // time spent waiting in the device's notification queue
+  LatencyHistogram queue;
+  // from the socket receive to the dispatch
+  LatencyHistogram total;
+} NotificationLatency;
+
+// The times a notification was received from the socket, decoded and
+// dispatched to the device, in microseconds of std::chrono::steady_clock.
+typedef struct NotificationTimestamps {
+  int64_t received_us;
+  int64_t decoded_us;
+  int64_t dispatched_us;
+} NotificationTimestamps;
+
+// How the getters of a device use its state cache (see
+// HippoDevice::state_cache()).
+typedef enum class StateCacheMode {
+  // every getter reads from SoHal (default)
+  disabled,
+  // while the device is subscribed, the getter of a property that has a
+  // notification (i.e. "brightness" and "on_brightness") returns the last
+  // value read, set or notified without a round trip to SoHal
+  cached,
+  // the getters always read from SoHal, and keep the cache up to date
+  read_through,
+} StateCacheMode;
+
+typedef struct StateCacheEntry {
+  // the cache generation of the last update of the value
+  uint64_t generation;
+  // microseconds since the value was last read, set or notified
+  int64_t age_us;
+  // true if the last update came from a notification
+  bool notified;
+} StateCacheEntry;
+
+typedef struct StateCacheStats {
+  // incremented each time a cached value changes or is invalidated
+  uint64_t generation;
+  // getters served from the cache
+  uint64_t hits;
+  // getters that had to read from SoHal
+  uint64_t misses;
+  // cached values updated by a notification
+  uint64_t notified;
+  // cached values dropped (i.e. after a set or when SoHal disconnected)
+  uint64_t invalidated;
+} StateCacheStats;
+
+// subscribe mask selecting all the notifications of a device (the default)
+const uint64_t ALL_NOTIFICATIONS = ~0ULL;
+
+// Returns the bit of the |notification| type in a subscribe mask, i.e.
+//    NotificationMask(SButtonsNotification::on_button_press) |
+//    NotificationMask(SButtonsNotification::on_device_disconnected)
+template <typename N>
+constexpr uint64_t NotificationMask(N notification) {
+  return 1ULL << static_cast<uint32_t>(notification);
+}
+
 // Describes a base device abstraction that contains functionality that is
 // available on all devices that SoHal supports.
 //
@@ -269,6 +387,11 @@ class DLLEXPORT HippoDevice {
   // in order to avoid a memory leak
   virtual uint64_t info(DeviceInfo *get);
 
+  // Same as info() above, but all the strings of the DeviceInfo are
+  // allocated in the |arena| passed in. The memory is released all at once
+  // by arena->Reset() so free_device_info() must NOT be called.
+  virtual uint64_t info(DeviceInfo *get, ResultArena *arena);
+
   // this function must be called with the same pointer that gets passed
   // into the info() fuction above
   // failing call this function after getting the device info will result
@@ -341,13 +464,67 @@ class DLLEXPORT HippoDevice {
   uint64_t unsubscribe();
   uint64_t unsubscribe(uint32_t *get);
 
+  // Enables (or disables) the coalescing of identical concurrent reads on
+  // this device object. When enabled, a get request whose method and
+  // parameters match a request already in flight from another thread does
+  // not go to SoHal: it waits for the one in flight and returns the same
+  // result (or error). Set requests are never coalesced. Disabled by default.
+  void coalesce_reads(bool enable);
+
+  // Sets the delivery policy of the |notification| notifications (i.e.
+  // "on_rotate") of this device. A slow consumer of a keep_latest or
+  // rate_limit notification always gets the newest value, without a growing
+  // backlog. Up to 16 notification types per device can have a policy.
+  uint64_t notification_policy(const char *notification,
+                               NotificationPolicy policy);
+  uint64_t notification_policy(const char *notification,
+                               NotificationPolicy policy, float max_rate_hz);
+  // Sets the priority of all the notifications of this device.
+  uint64_t notification_priority(NotificationPriority priority);
+  // Returns the number of notifications delivered, conflated and dropped
+  // since the device object was created.
+  uint64_t notification_stats(NotificationStats *stats);
+  // Returns the latency histograms of the notifications delivered since the
+  // device object was created.
+  uint64_t notification_latency(NotificationLatency *latency);
+  // Returns the timestamps of the notification being delivered. Only valid
+  // from the notification callback (HIPPO_WRONG_STATE_ERROR otherwise).
+  uint64_t notification_timestamps(NotificationTimestamps *timestamps);
+
+  // Sets the mode of the state cache of this device (disabled by default).
+  // The cache is filled by the getters and by subscribing (which reads again
+  // the properties read before), and kept current by the notifications: it
+  // is only used while the device is subscribed, and only for the properties
+  // whose notification is selected by the subscribe mask. A cached value
+  // older than |max_age_ms| milliseconds is read again from SoHal (0, the
+  // default, keeps it until a notification or a set changes it).
+  uint64_t state_cache(StateCacheMode mode);
+  uint64_t state_cache(StateCacheMode mode, uint32_t max_age_ms);
+  // Returns the generation and the age of the cached value of |property|
+  // (HIPPO_WRONG_STATE_ERROR if the property is not cached).
+  uint64_t state_cache_entry(const char *property, StateCacheEntry *entry);
+  // Returns the counters of the state cache. Several cached getters form a
+  // consistent snapshot of the device state if the generation did not
+  // change between a call before and a call after them, i.e.
+  //    do {
+  //      state_cache_stats(&before);
+  //      camera.exposure(&exposure);
+  //      camera.gain(&gain);
+  //      state_cache_stats(&after);
+  //    } while (before.generation != after.generation);
+  uint64_t state_cache_stats(StateCacheStats *stats);
+
  protected:
+  // the dispatcher delivers the notifications through ProcessSignal()
+  friend class SignalDispatcher;
+  // and the reactor receives them from SoHal for all the devices
+  friend class NotificationReactor;
+
   virtual uint64_t Connect();
   void Disconnect();
 
   bool IsConnected();
   bool IsConnectedWs();
-  bool IsConnectedWsSig();
   uint64_t EnsureConnected();
 
   virtual void ProcessSignal(char *method, void *params);
@@ -356,6 +533,10 @@ class DLLEXPORT HippoDevice {
   uint64_t SendRawMsg(const char *method, const void *param, void *ret_obj);
   uint64_t SendRawMsg(const char *method, const void *param,
                       unsigned int timeout, void *ret_obj);
+  // same as SendRawMsg() for requests that only read from the device: these
+  // can be coalesced with identical reads in flight (see coalesce_reads())
+  uint64_t SendReadMsg(const char *method, void *ret_obj);
+  uint64_t SendReadMsg(const char *method, const void *param, void *ret_obj);
 
   uint64_t GenerateJsonRpc(const char *devName, const char *method,
                            const void *param, unsigned char **jsonrpc);
@@ -367,11 +548,39 @@ class DLLEXPORT HippoDevice {
 
   uint64_t GetRawResultOrError(void *obj);
 
-  void WaitForSignalRaw(void);
   virtual bool HasRegisteredCallback();
 
-  uint64_t deviceInfo_json2c(void *obj, DeviceInfo *info);
-
+  uint64_t deviceInfo_json2c(void *obj, DeviceInfo *info, ResultArena *arena);
+
+  // Typed accessors for the scalar (bool, uint16_t, uint32_t and float)
+  // properties, with the method name given at compile time, i.e.
+  //    const char kBrightness[] = "brightness";
+  //    property<uint32_t, kBrightness>(set, &get);
+  // The request is encoded and the response decoded in preallocated per
+  // device buffers (see scalar_codec.h), without going through nl::json, so
+  // reading or writing a scalar property does not allocate any memory on the
+  // client side.
+  template <typename T, const char *Name>
+  uint64_t property(T *get) {
+    return scalar_get(Name, get);
+  }
+  template <typename T, const char *Name>
+  uint64_t property(T set, T *get) {
+    return scalar_set_get(Name, set, get);
+  }
+
+  // same as property(), with the method name given at run time
+  uint64_t scalar_get(const char *fname, bool *get);
+  uint64_t scalar_get(const char *fname, uint16_t *get);
+  uint64_t scalar_get(const char *fname, uint32_t *get);
+  uint64_t scalar_get(const char *fname, float *get);
+  uint64_t scalar_set_get(const char *fname, bool set, bool *get);
+  uint64_t scalar_set_get(const char *fname, uint16_t set, uint16_t *get);
+  uint64_t scalar_set_get(const char *fname, uint32_t set, uint32_t *get);
+  uint64_t scalar_set_get(const char *fname, float set, float *get);
+
+  // these are kept for the subclasses built against the previous versions,
+  // and use the scalar accessors
   uint64_t bool_get(const char *fname, bool *get);
   uint64_t bool_set_get(const char *fname, bool set, bool *get);
   uint64_t uint16_get(const char *fname, uint16_t *get);
@@ -390,19 +599,120 @@ class DLLEXPORT HippoDevice {
                             uint64_t *num_temps);
 
   uint64_t subscribe_raw(void *data, uint32_t *get);
-  uint64_t subscribe_raw_p(uint32_t *get);
+  // |names| are the names of the device's notifications in the order of its
+  // notification enum, so that the bits of |mask| can be matched to them
+  uint64_t subscribe_raw(void *data, uint64_t mask, const char **names,
+                         uint32_t num_names, uint32_t *get);
+  // called by the reactor with the |notification| name (not null terminated)
+  // found in the raw message, before parsing it
+  bool AcceptsNotification(const char *notification, size_t len);
+  // true if the reactor must route the notifications to this device: it
+  // has a callback (or a polling queue) or a state cache to keep current
+  bool WantsNotifications();
   void SendSignal(const char *method, void *param);
+  // same as above, for a notification received at |received_us|
+  void SendSignal(const char *method, void *param, int64_t received_us);
+  // returns the first of the notification |params| (a null value if there
+  // is none), for ProcessSignal() to decode it in place instead of copying
+  static const void *NotificationValue(const void *params);
+  // returns the arena the strings and arrays of a notification passed to a
+  // callback are decoded in, reset for each notification so that its memory
+  // is reused (the notifications are delivered one at a time)
+  ResultArena *NotificationArena();
+
+  // Polling mode: the decoded notifications of type P are kept in a queue of
+  // |queue_depth| preallocated slots instead of being passed to a callback.
+  // The queue is created by the first polling subscribe and kept (with its
+  // depth) until the device is destroyed, so the notifications that are
+  // still queued after unsubscribing can be polled. |mask| and |names| are
+  // the same as for subscribe_raw(), so that the state cache and the
+  // reactor's filter work the same as with a callback.
+  template <typename P>
+  uint64_t subscribe_queue(uint32_t queue_depth, uint64_t mask,
+                           const char **names, uint32_t num_names,
+                           uint32_t *get) {
+    if (0 == queue_depth) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+    }
+    if (NULL == poll_queue_) {
+      NotificationQueue<P> *queue =
+          new (std::nothrow) NotificationQueue<P>(queue_depth);
+      if (NULL == queue || !queue->Valid()) {
+        delete queue;
+        return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+      }
+      poll_queue_ = queue;
+    }
+    uint64_t err = subscribe_raw(NULL, mask, names, num_names, get);
+    polling_ = (HIPPO_OK == err);
+    return err;
+  }
+  template <typename P>
+  uint64_t poll_queue(P *params, uint32_t max_params, uint32_t *num_params) {
+    if (NULL == params || NULL == num_params) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+    }
+    if (NULL == poll_queue_) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+    }
+    *num_params = static_cast<NotificationQueue<P>*>(poll_queue_)->Poll(
+        params, max_params);
+    return HIPPO_OK;
+  }
+  // called from ProcessSignal() when there is no callback: returns false if
+  // the notification was not queued (so its memory must be freed)
+  template <typename P>
+  bool QueueNotification(const P &param) {
+    if (!polling_ || NULL == poll_queue_) {
+      return false;
+    }
+    return static_cast<NotificationQueue<P>*>(poll_queue_)->Push(param);
+  }
 
   uint32_t device_index_;
-  HippoWS *ws_, *wsSig_;
+  HippoWS *ws_;
   void *module_;
   uint32_t id_;
   char devName_[MAX_DEV_LEN];
   char host_[MAX_ADDR_LEN];
   uint32_t port_;
   HippoFacility facility_;
-  std::thread *signal_th_;
+  // the reactor routing this device's notifications while subscribed
+  NotificationReactor *reactor_;
   void *callback_data_;
+  NotificationQueueBase *poll_queue_;
+  // read by the dispatcher's workers
+  std::atomic<bool> polling_;
+  ResultArena notification_arena_;
+
+ private:
+  template <typename T>
+  uint64_t SendScalarMsg(const char *method, const T *set, T *get);
+  template <typename T>
+  uint64_t SendScalarMsg_p(const char *method, const T *set, T *get);
+  // the request in scalar_request_ and its |len|
+  template <typename T>
+  uint64_t ScalarRequest(const char *method, const T *set, int *len);
+  template <typename T>
+  uint64_t ScalarResponse(const char *response, size_t res_len, T *get);
+
+  // reads the properties already cached again, after subscribing
+  void RefreshStateCache();
+
+  ReadCoalescer *coalescer_;
+  StateCache *state_cache_;
+  // the subscribe mask, and the notification names its bits refer to
+  std::atomic<uint64_t> notification_mask_;
+  const char **notification_names_;
+  uint32_t num_notification_names_;
+  std::atomic<uint64_t> filtered_;
+  // notifications waiting to be delivered by the SignalDispatcher
+  SignalQueue *signal_queue_;
+
+  // preallocated buffers used by the scalar property accessors
+  char scalar_request_[MAX_SCALAR_REQUEST_LEN];
+  unsigned char *scalar_response_;
+  size_t scalar_response_size_;
 };
 
 }   // namespace hippo
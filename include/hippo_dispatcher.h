@@ -0,0 +1,207 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_HIPPO_DISPATCHER_H_
+#define INCLUDE_HIPPO_DISPATCHER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <utility>
+#include <vector>
+
+#include "../include/hippo.h"
+#include "../include/hippo_device.h"
+#include "../include/spsc_ring.h"
+
+namespace hippo {
+
+const uint32_t MAX_SIGNAL_METHOD_LEN = 64;
+// number of notifications that can be waiting to be delivered per device
+const uint32_t SIGNAL_QUEUE_DEPTH = 256;
+// number of notification types of a device that can have a policy
+const uint32_t MAX_CONFLATED_SIGNALS = 16;
+
+// microseconds of the steady clock, the unit of the notification timestamps
+inline int64_t SteadyTimeUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// LatencyRecorder builds a LatencyHistogram without locking, so the workers
+// can record while the application reads it.
+class LatencyRecorder {
+ public:
+  LatencyRecorder();
+
+  void Record(int64_t latency_us);
+  void Get(LatencyHistogram *histogram);
+
+ private:
+  std::atomic<uint64_t> buckets_[LATENCY_HISTOGRAM_BUCKETS];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> total_us_;
+  std::atomic<uint64_t> max_us_;
+
+  LatencyRecorder(LatencyRecorder const &);   // Don't implement
+  void operator=(LatencyRecorder const &);    // Don't implement
+};
+
+// A notification type with a keep_latest or rate_limit policy. Only the
+// newest pending notification of the type is kept in |latest|, and a single
+// marker in the queue holds its place until it is delivered. A rate limited
+// one that is not due yet is parked in the slot, out of the queue.
+typedef struct ConflationSlot {
+  char method[MAX_SIGNAL_METHOD_LEN];
+  std::atomic<uint32_t> policy;         // NotificationPolicy
+  std::atomic<int64_t> interval_us;     // 0 unless rate limited
+  std::atomic<void*> latest;            // nl::json*, owned by the queue
+  // only used by the worker delivering the queue
+  std::chrono::steady_clock::time_point next_delivery;
+  bool parked;                          // |latest| waits for next_delivery
+  int64_t received_us;                  // the times of the parked marker
+  int64_t decoded_us;
+} ConflationSlot;
+
+// a notification waiting to be delivered to HippoDevice::ProcessSignal()
+typedef struct Signal {
+  char method[MAX_SIGNAL_METHOD_LEN];
+  void *params;                       // nl::json*, owned by the queue
+  ConflationSlot *slot;               // not NULL for a conflated type
+  // for a conflated type, the times of the first notification pending
+  int64_t received_us;
+  int64_t decoded_us;
+} Signal;
+
+// SignalQueue holds the notifications of one device in the order they were
+// received. The reactor thread receiving them is the only producer, and the
+// dispatcher makes sure only one worker at a time consumes from it, so the
+// notifications of a device are always delivered in order.
+class SignalQueue {
+ public:
+  explicit SignalQueue(HippoDevice *device);
+  ~SignalQueue(void);
+
+ private:
+  friend class SignalDispatcher;
+
+  // lock free, called for each notification
+  ConflationSlot *FindSlot(const char *method);
+
+  HippoDevice *device_;
+  SpscRing<Signal> ring_;
+  // true while the queue is in the dispatcher's ready list or being drained
+  // by a worker
+  std::atomic<bool> scheduled_;
+  // set when the device is being destroyed: the pending notifications are
+  // dropped instead of being delivered
+  std::atomic<bool> closed_;
+  // set when the device is destroyed from its own callback: the worker
+  // deletes the queue once it is done with it
+  bool orphaned_;
+  // delivered through the fast lane (under the dispatcher's mutex)
+  bool high_priority_;
+  // the device is subscribed (under the dispatcher's mutex)
+  bool subscribed_;
+  std::atomic<uint64_t> delivered_;
+  std::atomic<uint64_t> conflated_;
+  std::atomic<uint64_t> dropped_;
+  LatencyRecorder decode_latency_;
+  LatencyRecorder queue_latency_;
+  LatencyRecorder total_latency_;
+
+  // the slots are only added (under slots_mutex_) and never removed, so the
+  // reactor thread can look them up without locking
+  ConflationSlot slots_[MAX_CONFLATED_SIGNALS];
+  std::atomic<uint32_t> num_slots_;
+  std::mutex slots_mutex_;
+
+  SignalQueue(SignalQueue const &);          // Don't implement
+  void operator=(SignalQueue const &);       // Don't implement
+};
+
+// SignalDispatcher delivers the notifications of all the devices using a
+// small fixed pool of worker threads, instead of starting one thread per
+// notification. The workers are started by the first notification and exit
+// once there is nothing left to deliver and no device is subscribed, so the
+// pool does not outlive the subscriptions of a process that keeps its device
+// objects around. The high priority queues (the input
+// devices) go through a fast lane, served first by the pool and also by a
+// dedicated worker, so they never wait behind the callbacks of bulk
+// notifications.
+class SignalDispatcher {
+ public:
+  static SignalDispatcher& GetInstance(void) {
+    static SignalDispatcher instance;
+    return instance;
+  }
+
+  // creates the notification queue of |device|, kept with its policies and
+  // statistics until the device is destroyed
+  uint64_t Register(HippoDevice *device, SignalQueue **queue);
+  // drops the pending notifications of |queue|, waits for the one being
+  // delivered (if any) and deletes the queue
+  void Unregister(SignalQueue *queue);
+  // counts the device of |queue| as subscribed or not: the workers keep
+  // running while a device is subscribed
+  void SetSubscribed(SignalQueue *queue, bool subscribed);
+
+  // Called from the device's reactor thread only, once the notification
+  // received at |received_us| is decoded: queues a copy of |method| and takes
+  // ownership of |params|. It never waits: if the queue is full the
+  // notification is dropped (unless it conflates with a pending one) and
+  // HIPPO_DEVICE_BUSY is returned.
+  uint64_t Post(SignalQueue *queue, const char *method, void *params,
+                int64_t received_us);
+
+  // moves |queue| to the fast lane (high priority) or back
+  void SetPriority(SignalQueue *queue, NotificationPriority priority);
+  // sets how the |method| notifications of |queue| are delivered
+  uint64_t SetPolicy(SignalQueue *queue, const char *method,
+                     NotificationPolicy policy, float max_rate_hz);
+  void GetStats(SignalQueue *queue, NotificationStats *stats);
+  void GetLatency(SignalQueue *queue, NotificationLatency *latency);
+  // returns false unless called from the callback of a |queue| notification
+  bool GetTimestamps(SignalQueue *queue, NotificationTimestamps *timestamps);
+
+  SignalDispatcher(SignalDispatcher const &);    // Don't implement
+  void operator=(SignalDispatcher const &);      // Don't implement
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  SignalDispatcher();
+  ~SignalDispatcher() {
+  }
+
+  void Schedule(SignalQueue *queue);
+  void Ready(SignalQueue *queue);
+  void Deliver(SignalQueue *queue, char *method, void *params,
+               int64_t received_us, int64_t decoded_us);
+  bool Drain(SignalQueue *queue, Clock::time_point *due);
+  void worker_loop(bool fast_lane);
+
+  HippoFacility facility_;
+  uint32_t max_workers_;
+  uint32_t num_workers_;
+  bool fast_worker_;        // the fast lane worker is running
+  uint32_t num_subscribed_;
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;   // a queue was scheduled
+  std::condition_variable fast_cv_;    // a high priority queue was
+  std::condition_variable idle_cv_;    // a worker finished with a queue
+  std::deque<SignalQueue*> ready_;
+  std::deque<SignalQueue*> fast_ready_;   // the high priority queues
+  // when the queues with parked rate limited notifications are drained again
+  // (one entry per queue)
+  std::vector<std::pair<Clock::time_point, SignalQueue*>> delayed_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_HIPPO_DISPATCHER_H_
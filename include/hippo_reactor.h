@@ -0,0 +1,146 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_HIPPO_REACTOR_H_
+#define INCLUDE_HIPPO_REACTOR_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <string>
+#include <thread>   // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "../include/hippo.h"
+#include "../include/hippo_device.h"
+
+namespace hippo {
+
+class HippoWS;
+
+// NotificationReactor receives the notifications of all the subscribed
+// devices of a SoHal instance (host:port) on a single connection and a
+// single thread, and routes them to the devices by the prefix of their
+// method (i.e. "hirescamera@0.on_brightness"). The reactor is created by
+// the first device subscribing and destroyed when the last one unsubscribes.
+// Several objects of the same device share its subscription on the
+// connection: each one gets all the notifications its subscribe mask
+// selects, and SoHal only gets the first subscribe and the last unsubscribe.
+//
+// The reactor thread is the only one reading from the connection: the
+// subscribe and unsubscribe requests of the devices are queued and sent by
+// the reactor thread, which routes the responses back by their id.
+class NotificationReactor {
+ public:
+  // subscribes |device| to its notifications, using (or creating) the
+  // reactor of |host|:|port|, which is returned in |*reactor|. |get| is the
+  // number of objects of the device subscribed through the reactor.
+  static uint64_t Subscribe(HippoDevice *device, const char *host,
+                            uint32_t port, NotificationReactor **reactor,
+                            uint32_t *get);
+  // stops routing the notifications to |device|, sends the unsubscribe
+  // request if it was the last object of the device (if |wait| is true,
+  // waits for its response in |get|, otherwise |get| is the number of
+  // objects still subscribed) and releases the reactor
+  static uint64_t Unsubscribe(HippoDevice *device, NotificationReactor *reactor,
+                              bool wait, uint32_t *get);
+
+  // sends the |method| request of |device| (i.e. "subscribe") through the
+  // reactor and waits for its result
+  uint64_t Call(HippoDevice *device, const char *method, uint32_t *get);
+  // the number of objects of the device of |device| subscribed through the
+  // reactor, i.e. for a subscribed device subscribing again
+  uint32_t Subscriptions(HippoDevice *device);
+
+  // while a replay is registered for |host|:|port|, the reactor created for
+  // it does not connect to SoHal: NotificationReplayer feeds it the recorded
+  // frames instead. Returns false if a reactor already exists for it.
+  static bool AddReplay(const char *host, uint32_t port);
+  static void RemoveReplay(const char *host, uint32_t port);
+  // returns the replay reactor of |host|:|port| (NULL if no device is
+  // subscribed to it), which must be released with ReleaseReplay()
+  static NotificationReactor *AcquireReplay(const char *host, uint32_t port);
+  static void ReleaseReplay(NotificationReactor *reactor);
+  // routes a recorded frame like the ones received from SoHal
+  void Replay(const unsigned char *frame, int64_t received_us);
+
+  NotificationReactor(NotificationReactor const &);   // Don't implement
+  void operator=(NotificationReactor const &);        // Don't implement
+
+ private:
+  friend class ReactorRegistry;
+
+  typedef std::chrono::steady_clock Clock;
+
+  typedef struct PendingCall {
+    PendingCall() : done(false), err(0LL) {
+    }
+    bool done;
+    uint64_t err;
+    std::string response;
+  } PendingCall;
+
+  NotificationReactor(const char *host, uint32_t port, bool replay);
+  ~NotificationReactor(void);
+
+  // connects to SoHal and starts the reactor thread, if not done yet
+  uint64_t Start();
+  // stops the reactor thread and closes the connection
+  void Stop();
+  uint64_t Connect(HippoWS **ws);
+  // queues the fire and forget |method| request of |device|, the mutex must
+  // be captured
+  void Queue(HippoDevice *device, const char *method);
+  void reactor_loop(void);
+  void SendQueued();
+  // routes a notification to its devices (the ones whose subscribe mask
+  // selects it) or a response to its pending call
+  void HandleMessage(const unsigned char *msg, int64_t received_us);
+  void Reconnect();
+  // sends |method| to all the devices that want their notifications
+  void Broadcast(const char *method);
+  // fills |devices| with the devices of |prefix| that want the |name|
+  // notification, the mutex must be captured
+  void FindDevices(const char *prefix, size_t len, const char *name,
+                   size_t name_len, std::vector<HippoDevice*> *devices);
+  // the end of routing to the devices found by FindDevices()
+  void Routed();
+
+  HippoFacility facility_;
+  std::string host_;
+  uint32_t port_;
+  // number of devices using the reactor (see ReactorRegistry)
+  uint32_t users_;
+  // fed by a NotificationReplayer, without a connection to SoHal
+  bool replay_;
+
+  HippoWS *ws_;     // replaced (under mutex_) when reconnecting
+  std::thread *thread_;
+  std::atomic<bool> stop_;
+
+  std::mutex mutex_;
+  std::condition_variable calls_cv_;
+  std::vector<HippoDevice*> devices_;
+  // number of subscribed objects of each device, by the device name
+  std::unordered_map<std::string, uint32_t> subscriptions_;
+  // the devices a notification is being posted to, outside of the mutex, by
+  // the thread routing the messages. Unsubscribe() waits until routing_ is
+  // 0, so the devices it points to stay alive.
+  std::vector<HippoDevice*> targets_;
+  uint32_t routing_;
+  std::condition_variable routed_cv_;
+  std::deque<unsigned char*> requests_;
+  bool awaiting_response_;
+  Clock::time_point response_deadline_;
+  std::unordered_map<std::string, PendingCall*> pending_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_HIPPO_REACTOR_H_
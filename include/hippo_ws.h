@@ -41,9 +41,20 @@ class DLLEXPORT HippoWS {
   uint64_t SendRequest(const unsigned char *request, size_t req_len,
                        WsConnectionType type, unsigned int timeout,
                        unsigned char **response, size_t *res_len);
+  // same as above, but the response is copied into the caller's |*buffer|
+  // of |*buffer_size| bytes. The buffer is only reallocated (and
+  // |*buffer_size| updated) when the response does not fit, so reusing the
+  // same buffer makes the requests allocation free.
+  uint64_t SendRequest(const unsigned char *request, size_t req_len,
+                       WsConnectionType type, unsigned int timeout,
+                       unsigned char **buffer, size_t *buffer_size,
+                       size_t *res_len);
 
   uint64_t StopSignalLoop();
   uint64_t WaitForSignal(unsigned char **response);
+  // same as above, also returning the time the message was received (in
+  // microseconds of the steady clock)
+  uint64_t WaitForSignal(unsigned char **response, int64_t *received_us);
   uint64_t ReadResponse(unsigned char **response);
 
  protected:
@@ -872,6 +872,15 @@ class DLLEXPORT HiResCamera : public HippoCamera {
                                  CameraKeystoneTableEntries *get,
                                  uint32_t *num_entries);
 
+  // Same as the keystone_table_entries() get above, but the entries are
+  // allocated in the |arena| passed in, and released all at once by
+  // arena->Reset(). free_keystone_table_entries() must NOT be called in
+  // this case.
+  uint64_t keystone_table_entries(const CameraKeystoneTable &param,
+                                  CameraKeystoneTableEntries *get,
+                                  uint32_t *num_entries,
+                                  ResultArena *arena);
+
   // Get keystone table entries
   // Calling this method with CameraKeystoneTable and a list of
   // CameraResolution parameters acts as Get and will return a
@@ -888,6 +897,17 @@ class DLLEXPORT HiResCamera : public HippoCamera {
                                  CameraKeystoneTableEntries *get,
                                  uint32_t *num_entries);
 
+  // Same as the keystone_table_entries() get above, but the entries are
+  // allocated in the |arena| passed in, and released all at once by
+  // arena->Reset(). free_keystone_table_entries() must NOT be called in
+  // this case.
+  uint64_t keystone_table_entries(const CameraKeystoneTable &param,
+                                  CameraResolution *resoution_list,
+                                  uint32_t num_resolutions,
+                                  CameraKeystoneTableEntries *get,
+                                  uint32_t *num_entries,
+                                  ResultArena *arena);
+
   // Set keystone table entries
   // Calling this method with CameraKeystoneTable and a list of
   // CameraKeystoneTableEntry parameters acts as a Set request. On success it
@@ -1130,6 +1150,23 @@ class DLLEXPORT HiResCamera : public HippoCamera {
   uint64_t subscribe(void(*callback)(const HiResCameraNotificationParam &param,
                                      void *data),
                      void *data, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are decoded and delivered
+  uint64_t subscribe(void(*callback)(const HiResCameraNotificationParam &param,
+                                     void *data),
+                     void *data, uint64_t mask, uint32_t *get);
+
+  // subscribe to notifications in polling mode: up to |queue_depth|
+  // notifications are queued until they are retrieved with poll()
+  uint64_t subscribe(uint32_t queue_depth, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are queued
+  uint64_t subscribe(uint32_t queue_depth, uint64_t mask, uint32_t *get);
+  // copies up to |max_params| queued notifications, oldest first
+  // Note: unlike with a callback, free_keystone_table_entries() must be
+  // called with the on_keystone_table_entries parameters after polling them
+  uint64_t poll(HiResCameraNotificationParam *params, uint32_t max_params,
+                uint32_t *num_params);
 
   // unsubscribe from notifications
   uint64_t unsubscribe();
@@ -1239,7 +1276,8 @@ class DLLEXPORT HiResCamera : public HippoCamera {
                                         void *obj);
   uint64_t CameraKeystoneTableEntries_json2c(const void *obj,
                                              CameraKeystoneTableEntries *get,
-                                             uint32_t *num_entries);
+                                             uint32_t *num_entries,
+                                             ResultArena *arena);
   uint64_t CameraLedState_c2json(const hippo::CameraLedState &set,
                                  void *obj);
   uint64_t CameraLedState_json2c(const void *obj,
@@ -1250,7 +1288,7 @@ class DLLEXPORT HiResCamera : public HippoCamera {
                                      void *obj);
   uint64_t PowerLineFrequency_json2c(const void *obj,
                                      hippo::PowerLineFrequency *get);
-  uint64_t ParsePointJson(void *jsonPoint, Point *cPoint);
+  uint64_t ParsePointJson(const void *jsonPoint, Point *cPoint);
   uint64_t Resolution_c2json(const hippo::CameraResolution &set, void *obj);
   uint64_t Resolution_json2c(const void *obj, hippo::CameraResolution *get);
   uint64_t Strobe_json2c(const  void *obj, hippo::Strobe *get);
@@ -0,0 +1,88 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_KEYSTONE_WARP_H_
+#define INCLUDE_KEYSTONE_WARP_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/hirescamera.h"
+#include "../include/pixel_convert.h"
+#include "../include/remap.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// KeystoneWarp rectifies the frames of the hirescamera on the client: the
+// quadrilateral of the mat area in a frame is warped into a rectangle, the
+// same correction the camera applies with HiResCamera::keystone, but for any
+// resolution and without restarting the stream, so the camera can stay in
+// its fastest mode.
+//
+// SetKeystone() takes the keystone of a resolution as returned by
+// HiResCamera::keystone_table_entries (the offsets of the corners in pixels
+// of the effective size of the resolution, see CameraKeystone), and
+// SetQuadrilateral() the corners in pixels of the frames. Both build a
+// fixed point remap table with the homography from the output rectangle to
+// the quadrilateral once, and Warp() then samples each frame with it,
+// bilinearly, with SIMD, across threads (see remap.h for the formats).
+//
+// e.g.
+//    hippo::CameraKeystoneTable table =
+//        hippo::CameraKeystoneTable::FLASH_FIT_TO_MAT;
+//    hirescamera.keystone_table_entries(table, &entries, &num_entries);
+//    hippo::KeystoneWarp warp;
+//    warp.SetKeystone(entries.entries[i], 4352, 3264, 2176, 1448);
+//    ...
+//    warp.Warp(frame, rectified);
+class DLLEXPORT KeystoneWarp {
+ public:
+  // one thread per core, the best SIMD level of the CPU
+  KeystoneWarp();
+  // |num_threads| 0 means one per core
+  KeystoneWarp(uint32_t num_threads, SimdLevel max_simd);
+  ~KeystoneWarp(void);
+
+  // |quad| is the area of the |src_width| x |src_height| frames warped into
+  // the whole |dst_width| x |dst_height| output (the centers of the corner
+  // pixels). It has to be convex.
+  uint64_t SetQuadrilateral(const CameraQuadrilateral &quad,
+                            uint32_t src_width, uint32_t src_height,
+                            uint32_t dst_width, uint32_t dst_height);
+  // |entry| is the keystone of the frames of |entry.resolution|, in pixels
+  // of |effective_width| x |effective_height|. The frames with another
+  // aspect ratio than the effective size are its centered crop (e.g. 4352 x
+  // 2896 of 4352 x 3264).
+  uint64_t SetKeystone(const CameraKeystoneTableEntry &entry,
+                       uint32_t effective_width, uint32_t effective_height,
+                       uint32_t dst_width, uint32_t dst_height);
+
+  // |src| is a frame of the source size, |dst| has the output size and the
+  // same format
+  uint64_t Warp(const PixelBuffer &src, const PixelBuffer &dst);
+
+  KeystoneWarp(KeystoneWarp const &);          // Don't implement
+  void operator=(KeystoneWarp const &);        // Don't implement
+
+ private:
+  // |corners| are the top left, top right, bottom right and bottom left
+  // corners (x, y) in source pixels
+  uint64_t SetCorners(const double corners[4][2],
+                      uint32_t src_width, uint32_t src_height,
+                      uint32_t dst_width, uint32_t dst_height);
+
+  uint32_t num_threads_;
+  SimdLevel level_;
+  internal::RemapTable table_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_KEYSTONE_WARP_H_
@@ -0,0 +1,60 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_LENS_MODEL_H_
+#define INCLUDE_LENS_MODEL_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/depthcamera.h"
+#include "../include/system.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// The pinhole camera and lens distortion model shared by the imaging stages,
+// for a given stream resolution. A normalized point (x, y) = (X/Z, Y/Z) is
+// distorted as
+//    r2 = x^2 + y^2
+//    radial = (1 + k1 r2 + k2 r2^2 + k3 r2^3) / (1 + k4 r2 + k5 r2^2 + k6 r2^3)
+//    xd = x radial + 2 p1 x y + p2 (r2 + 2 x^2)
+//    yd = y radial + p1 (r2 + 2 y^2) + 2 p2 x y
+// and lands on the pixel (fx xd + cx, fy yd + cy).
+typedef struct LensModel {
+  float fx;
+  float fy;
+  float cx;
+  float cy;
+  float k[6];
+  float p[2];
+} LensModel;
+
+// the model of a CalibrationIntrinsics/CalibrationDistortion pair (i.e. of
+// DepthCamera::ir_to_rgb_calibration), at the resolution they were made for
+DLLEXPORT void LensModelFromCalibration(
+    const CalibrationIntrinsics &intrinsics,
+    const CalibrationDistortion &distortion, LensModel *model);
+// the model of the CameraParameters of System::camera_3d_mapping, scaled
+// from their calibration resolution to a |width| x |height| stream
+DLLEXPORT uint64_t LensModelFromCameraParameters(
+    const CameraParameters &parameters, uint32_t width, uint32_t height,
+    LensModel *model);
+
+// the pixel of the normalized point (|x|, |y|)
+DLLEXPORT void DistortPoint(const LensModel &model, double x, double y,
+                            double *u, double *v);
+// the normalized point of the pixel (|u|, |v|): the inverse of DistortPoint()
+// found iteratively
+DLLEXPORT void UndistortPoint(const LensModel &model, double u, double v,
+                              double *x, double *y);
+
+}  // namespace hippo
+
+#endif  // INCLUDE_LENS_MODEL_H_
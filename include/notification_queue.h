@@ -0,0 +1,72 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_NOTIFICATION_QUEUE_H_
+#define INCLUDE_NOTIFICATION_QUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "../include/spsc_ring.h"
+
+namespace hippo {
+
+// NotificationQueueBase lets HippoDevice own the polling queue of a device
+// without knowing the type of its notification parameters.
+class NotificationQueueBase {
+ public:
+  virtual ~NotificationQueueBase() {
+  }
+  // number of notifications dropped because the queue was full
+  virtual uint64_t Dropped() const = 0;
+};
+
+// NotificationQueue stores the decoded notifications (i.e.
+// SButtonsNotificationParam) of a device subscribed in polling mode, until
+// the application retrieves them with poll(). The notifications are pushed
+// by the notification worker delivering them and popped by the application's
+// thread, and all the slots are preallocated when subscribing.
+template <typename P>
+class NotificationQueue : public NotificationQueueBase {
+ public:
+  explicit NotificationQueue(uint32_t depth) : ring_(depth), dropped_(0) {
+  }
+
+  bool Valid() const {
+    return ring_.Valid();
+  }
+
+  // returns false (and counts the notification as dropped) if the
+  // application did not poll the queue fast enough and it is full
+  bool Push(const P &param) {
+    if (!ring_.Push(param)) {
+      dropped_++;
+      return false;
+    }
+    return true;
+  }
+
+  // copies up to |max_params| notifications into |params|, oldest first,
+  // and returns the number of notifications copied
+  uint32_t Poll(P *params, uint32_t max_params) {
+    uint32_t num = 0;
+    while (num < max_params && ring_.Pop(&params[num])) {
+      num++;
+    }
+    return num;
+  }
+
+  uint64_t Dropped() const override {
+    return dropped_;
+  }
+
+ private:
+  SpscRing<P> ring_;
+  std::atomic<uint64_t> dropped_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_NOTIFICATION_QUEUE_H_
@@ -0,0 +1,102 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_NOTIFICATION_RECORDER_H_
+#define INCLUDE_NOTIFICATION_RECORDER_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/hippo_device.h"   // for MAX_ADDR_LEN
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+class NotificationReactor;
+
+// NotificationRecorder writes the raw notification frames received from
+// SoHal by all the subscribed devices, with the time they were received, to
+// a compact binary file that NotificationReplayer can play back, i.e. to
+// reproduce an event storm such as a hot-plug cascade of
+// on_device_connected / on_device_disconnected notifications.
+//
+// The file starts with the "HPNR" magic and a 32 bit version, followed by
+// one record per frame: the microseconds since the previous frame and the
+// length of the frame (both as LEB128 varints), then the frame itself with
+// its terminating null character.
+class DLLEXPORT NotificationRecorder {
+ public:
+  // starts recording to |path|, which is overwritten
+  static uint64_t Start(const char *path);
+  // stops recording and returns the number of frames in the file
+  static uint64_t Stop(uint64_t *num_frames);
+
+ private:
+  // the reactors record every notification frame they receive
+  friend class NotificationReactor;
+  static void Record(const unsigned char *frame, int64_t received_us);
+};
+
+typedef enum class ReplaySpeed {
+  // the frames are routed with the same intervals as when recorded
+  original,
+  // the frames are routed back to back
+  max,
+} ReplaySpeed;
+
+typedef struct ReplayStats {
+  // frames routed to the subscribed devices
+  uint64_t frames;
+  // time between the first and the last frame when recorded
+  int64_t recorded_us;
+  // time it took to route all the frames
+  int64_t elapsed_us;
+} ReplayStats;
+
+// NotificationReplayer plays a recording back through the same path as the
+// notifications received from SoHal: the devices of |host|:|port| that
+// subscribe while a replayer is open for it do not connect to SoHal, and
+// get the recorded notifications (subject to their subscribe mask and
+// notification policies) in their callbacks when Run() is called.
+//
+// e.g.
+//    hippo::NotificationReplayer replayer;
+//    replayer.Open("storm.hpnr", "localhost", 20641);
+//    system.subscribe(&system_notification, NULL);
+//    replayer.Run(hippo::ReplaySpeed::max, &stats);
+//    system.unsubscribe();
+//    replayer.Close();
+class DLLEXPORT NotificationReplayer {
+ public:
+  NotificationReplayer();
+  ~NotificationReplayer(void);
+
+  // loads the recording in |path| and replaces SoHal at |host|:|port| for
+  // the devices subscribing from now on (HIPPO_WRONG_STATE_ERROR if devices
+  // are already subscribed to that SoHal)
+  uint64_t Open(const char *path, const char *host, uint32_t port);
+  // routes all the recorded frames to the subscribed devices, returning
+  // once the last one was queued for delivery
+  uint64_t Run(ReplaySpeed speed, ReplayStats *stats);
+  // the devices subscribing from now on connect to SoHal again
+  void Close();
+
+  NotificationReplayer(NotificationReplayer const &);   // Don't implement
+  void operator=(NotificationReplayer const &);         // Don't implement
+
+ private:
+  unsigned char *data_;
+  size_t size_;
+  char host_[MAX_ADDR_LEN];
+  uint32_t port_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_NOTIFICATION_RECORDER_H_
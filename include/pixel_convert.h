@@ -0,0 +1,108 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_PIXEL_CONVERT_H_
+#define INCLUDE_PIXEL_CONVERT_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "../include/hippo.h"
+#include "../include/hippo_camera.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// the instruction sets of the image processing kernels
+typedef enum class SimdLevel : uint8_t {
+  scalar = 0,
+  sse2 = 1,
+  avx2 = 2,
+} SimdLevel;
+
+// an image in memory, i.e. a stream of a CameraFrame
+typedef struct PixelBuffer {
+  // the first row of the image. For PIXEL_NV12 the interleaved UV plane
+  // (at half the height) follows the |height| rows of the Y plane, with the
+  // same stride
+  uint8_t *data;
+  uint32_t width;
+  uint32_t height;
+  // bytes from the start of a row to the start of the next one, or 0 if
+  // the rows are packed
+  uint32_t stride;
+  PixelFormat format;
+} PixelBuffer;
+
+typedef struct ConvertOptions {
+  // PIXEL_GRAY16 to PIXEL_GRAY8: the values up to |window_low| become 0,
+  // the values from |window_high| become 255, and the ones in between are
+  // scaled linearly
+  uint16_t window_low;
+  uint16_t window_high;
+  // the rows are split between this many threads (0 means one per core)
+  uint32_t num_threads;
+  // the highest instruction set to use: the kernels use the best one
+  // supported by the CPU up to this level
+  SimdLevel max_simd;
+} ConvertOptions;
+
+// PixelConverter converts images between the pixel formats of the camera
+// streams, with SSE2 and AVX2 kernels and a scalar fallback that produces
+// the same output bit by bit:
+//    PIXEL_YUY2 (and PIXEL_YUYV), PIXEL_UYVY, PIXEL_NV12 to PIXEL_RGB888 or
+//      PIXEL_BGRA8888 (BT.601, limited range)
+//    PIXEL_GRAY16 to PIXEL_GRAY8 (windowed)
+//    PIXEL_RGB888 to PIXEL_BGRA8888
+// The destination is written in place, so it can be a region of a larger
+// image (e.g. a tile of a preview) through its stride.
+//
+// e.g.
+//    hippo::PixelConverter converter;
+//    hippo::PixelBuffer src = { data, 4352, 3264, 0,
+//                               hippo::PixelFormat::PIXEL_YUY2 };
+//    hippo::PixelBuffer dst = { rgb, 4352, 3264, 0,
+//                               hippo::PixelFormat::PIXEL_RGB888 };
+//    converter.Convert(src, dst);
+class DLLEXPORT PixelConverter {
+ public:
+  // no windowing, one thread per core, the best SIMD level of the CPU
+  PixelConverter();
+  explicit PixelConverter(const ConvertOptions &options);
+  ~PixelConverter(void);
+
+  uint64_t Convert(const PixelBuffer &src, const PixelBuffer &dst);
+  // the instruction set used by Convert()
+  SimdLevel GetSimdLevel();
+
+  // the best instruction set supported by the CPU (and the OS)
+  static SimdLevel DetectSimdLevel();
+  // the bytes of a packed row of |width| pixels of |format| (of the Y plane
+  // for PIXEL_NV12), or 0 for the formats without a fixed size
+  static uint32_t RowBytes(PixelFormat format, uint32_t width);
+
+ private:
+  ConvertOptions options_;
+  SimdLevel level_;
+};
+
+namespace internal {
+
+// splits the rows [0, num_rows) in chunks of a multiple of |align| rows and
+// calls |fn(first, last)| for each chunk, from up to |num_threads| threads
+// (0 means one per core). Returns when all the chunks are done.
+void SplitRows(uint32_t num_rows, uint32_t align, uint32_t num_threads,
+               const std::function<void(uint32_t, uint32_t)> &fn);
+
+}  // namespace internal
+
+}  // namespace hippo
+
+#endif  // INCLUDE_PIXEL_CONVERT_H_
@@ -0,0 +1,94 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_POINT_CLOUD_H_
+#define INCLUDE_POINT_CLOUD_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/depthcamera.h"
+#include "../include/pixel_convert.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// the coordinates of a point cloud in separate planes, one float per pixel
+typedef struct PointPlanes {
+  float *x;
+  float *y;
+  float *z;
+  // bytes from the start of a row to the start of the next one in each
+  // plane, or 0 if the rows are packed
+  uint32_t stride;
+} PointPlanes;
+
+// PointCloudProjector computes the XYZ points (in millimeters, in the
+// coordinates of the depth camera) of PIXEL_DEPTH_MM16 depth frames on the
+// client, so the 12 bytes per pixel points stream doesn't need to be
+// streamed along with the depth one.
+//
+// SetCalibration() undistorts the ray of every pixel of the depth stream once
+// (with the ir intrinsics and distortion of ir_to_rgb_calibration), and each
+// Project() multiplies the rays by the depths, with SSE2 or AVX2 and across
+// threads. A pixel without depth (0) becomes the point (0, 0, 0).
+//
+// e.g.
+//    hippo::IrRgbCalibration cal;
+//    depthcamera.ir_to_rgb_calibration(&cal);
+//    hippo::PointCloudProjector projector;
+//    projector.SetCalibration(cal, 640, 480);
+//    ...
+//    hippo::PixelBuffer depth = { frame.streams[0].data, 640, 480, 0,
+//                                 hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+//    hippo::PixelBuffer points = { xyz, 640, 480, 0,
+//                                  hippo::PixelFormat::PIXEL_POINTS_MM32F };
+//    projector.Project(depth, points);
+class DLLEXPORT PointCloudProjector {
+ public:
+  // one thread per core, the best SIMD level of the CPU
+  PointCloudProjector();
+  // |num_threads| 0 means one per core
+  PointCloudProjector(uint32_t num_threads, SimdLevel max_simd);
+  ~PointCloudProjector(void);
+
+  // builds the ray tables of a |width| x |height| depth stream. The
+  // intrinsics must be the ones of that resolution
+  uint64_t SetCalibration(const CalibrationIntrinsics &intrinsics,
+                          const CalibrationDistortion &distortion,
+                          bool mirror, uint32_t width, uint32_t height);
+  // same with the ir camera of |calibration|
+  uint64_t SetCalibration(const IrRgbCalibration &calibration,
+                          uint32_t width, uint32_t height);
+
+  // the interleaved PIXEL_POINTS_MM32F points of |depth|
+  uint64_t Project(const PixelBuffer &depth, const PixelBuffer &points);
+  // same in separate x, y and z planes
+  uint64_t Project(const PixelBuffer &depth, const PointPlanes &planes);
+
+  PointCloudProjector(PointCloudProjector const &);   // Don't implement
+  void operator=(PointCloudProjector const &);        // Don't implement
+
+ private:
+  // |points| or |planes| is NULL
+  uint64_t ProjectRows(const PixelBuffer &depth, const PixelBuffer *points,
+                       const PointPlanes *planes);
+
+  uint32_t num_threads_;
+  SimdLevel level_;
+  uint32_t width_;
+  uint32_t height_;
+  // the undistorted x/z and y/z of each pixel
+  float *ray_x_;
+  float *ray_y_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_POINT_CLOUD_H_
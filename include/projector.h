@@ -53,6 +53,11 @@ class DLLEXPORT Projector : public HippoDevice {
   // memory leak
   uint64_t calibration_data(hippo::CalibrationData *get);
 
+  // Same as calibration_data() above, but the strings are allocated in the
+  // |arena| passed in, and released all at once by arena->Reset().
+  // free_calibration_data() must NOT be called in this case.
+  uint64_t calibration_data(hippo::CalibrationData *get, ResultArena *arena);
+
   // free_calibration_data frees the memory allocated in the calibration_data()
   // function
   // failing call this function after getting the calibration data will
@@ -65,6 +70,12 @@ class DLLEXPORT Projector : public HippoDevice {
   // calling free_projector_specific_info() afterwards to avoid a memory leak
   uint64_t device_specific_info(hippo::ProjectorSpecificInfo *get);
 
+  // Same as device_specific_info() above, but the strings are allocated in
+  // the |arena| passed in, and released all at once by arena->Reset().
+  // free_projector_specific_info() must NOT be called in this case.
+  uint64_t device_specific_info(hippo::ProjectorSpecificInfo *get,
+                                ResultArena *arena);
+
   // frees the memory allocated in device_specific_info
   // failing call this function after getting the projector specific info will
   // result in a memory leak.
@@ -226,6 +237,21 @@ class DLLEXPORT Projector : public HippoDevice {
   uint64_t subscribe(void(*callback)(const ProjectorNotificationParam &param,
                                      void *data),
                      void *data, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are decoded and delivered
+  uint64_t subscribe(void(*callback)(const ProjectorNotificationParam &param,
+                                     void *data),
+                     void *data, uint64_t mask, uint32_t *get);
+
+  // subscribe to notifications in polling mode: up to |queue_depth|
+  // notifications are queued until they are retrieved with poll()
+  uint64_t subscribe(uint32_t queue_depth, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are queued
+  uint64_t subscribe(uint32_t queue_depth, uint64_t mask, uint32_t *get);
+  // copies up to |max_params| queued notifications, oldest first
+  uint64_t poll(ProjectorNotificationParam *params, uint32_t max_params,
+                uint32_t *num_params);
 
   // unsubscribe from notifications
   uint64_t unsubscribe();
@@ -281,7 +307,8 @@ class DLLEXPORT Projector : public HippoDevice {
   uint64_t white_point(const hippo::WhitePoint &set, hippo::WhitePoint *get);
 
  protected:
-  uint64_t calibrationData_json2c(void *obj, hippo::CalibrationData *cal);
+  uint64_t calibrationData_json2c(void *obj, hippo::CalibrationData *cal,
+                                  ResultArena *arena);
   uint64_t dppversion_json2c(void *obj, hippo::DPPVersion *dppversion);
   uint64_t geoversion_json2c(void *obj, hippo::GeoFWVersion *geoversion);
   uint64_t hardwareInfo_json2c(void * obj, hippo::HardwareInfo *info);
@@ -290,7 +317,8 @@ class DLLEXPORT Projector : public HippoDevice {
   uint64_t ledtimes_json2c(void *obj, hippo::ProjectorLedTimes *ledtimes);
   uint64_t mfgData_json2c(void *obj, hippo::ManufacturingData *mfgdata);
   uint64_t projector_specific_info_json2c(void *obj,
-                                      hippo::ProjectorSpecificInfo *info);
+                                      hippo::ProjectorSpecificInfo *info,
+                                      ResultArena *arena);
   uint64_t rectangle_json2c(void *obj, hippo::Rectangle *rect);
   uint64_t state_json2c(void *obj, hippo::ProjectorState *state);
   uint64_t solid_color_c2json(const hippo::SolidColor &color, void *obj);
@@ -0,0 +1,78 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_PYRAMID_H_
+#define INCLUDE_PYRAMID_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/hippo_camera.h"
+#include "../include/pixel_convert.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// FramePyramid downscales the frames of a stream to 1/2, 1/4 and 1/8 of
+// their width and height on the client, e.g. a preview of about 1 MP from
+// the frames of a full resolution capture, without switching the camera
+// mode. Each level is the 2x2 box filter of the previous one (an 8x8 area
+// of the source for the last one, up to the rounding of each step).
+//
+// The levels are computed in tiles of rows, from up to one thread per
+// core: each tile goes through all the levels while its rows are still in
+// the cache. The kernels use SSE2 or AVX2 (the latter with byte shuffles for
+// the interleaved formats), with the same output as the scalar fallback.
+// The supported formats are PIXEL_GRAY8, PIXEL_GRAY16, PIXEL_RGB888,
+// PIXEL_BGRA8888, PIXEL_YUY2 (and PIXEL_YUYV) and PIXEL_UYVY. The odd rows
+// and columns at the end of a level are dropped (the columns of the 4:2:2
+// formats in pairs).
+//
+// The levels are kept in the FramePyramid, and reused by the next Build()
+// of the same size.
+//
+// e.g.
+//    hippo::FramePyramid pyramid;
+//    pyramid.Build(frame, 0, 2);
+//    hippo::PixelBuffer preview;
+//    pyramid.GetLevel(2, &preview);   // 1104 x 828 for MODE_4416x3312
+class DLLEXPORT FramePyramid {
+ public:
+  static const uint32_t kMaxLevels = 3;
+
+  // one thread per core, the best SIMD level of the CPU
+  FramePyramid();
+  // |num_threads| 0 means one per core
+  FramePyramid(uint32_t num_threads, SimdLevel max_simd);
+  ~FramePyramid(void);
+
+  // builds the levels 1 to |num_levels| (up to kMaxLevels) of |src|
+  uint64_t Build(const PixelBuffer &src, uint32_t num_levels);
+  // same, from the stream |index| of |frame|
+  uint64_t Build(const CameraFrame &frame, uint32_t index,
+                 uint32_t num_levels);
+  // a level of the last Build(): 0 is the source, and the data of the
+  // levels belongs to the FramePyramid
+  uint64_t GetLevel(uint32_t level, PixelBuffer *buffer);
+
+  FramePyramid(FramePyramid const &);          // Don't implement
+  void operator=(FramePyramid const &);        // Don't implement
+
+ private:
+  uint32_t num_threads_;
+  SimdLevel level_;
+  uint32_t num_levels_;
+  PixelBuffer levels_[kMaxLevels + 1];
+  // the allocated bytes of each level
+  size_t capacity_[kMaxLevels + 1];
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_PYRAMID_H_
@@ -0,0 +1,112 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_REGISTRATION_H_
+#define INCLUDE_REGISTRATION_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/lens_model.h"
+#include "../include/pixel_convert.h"
+#include "../include/system.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// DepthRegistration aligns the depth frames of the depthcamera with the
+// frames of a color stream (the rgb stream of the depthcamera or of the
+// hirescamera), with the Camera3DMapping returned by
+// System::camera_3d_mapping from the depthcamera depth (or ir) stream to the
+// color stream. The translation of the mapping is in millimeters, like the
+// depths.
+//
+// SetMapping() caches the undistorted ray of every depth pixel, rotated into
+// the color camera, for the resolutions of both streams. Each frame then
+// only needs a multiply-add per coordinate, a division and the distortion of
+// the color lens per depth pixel, computed with SSE2 or AVX2 across threads:
+//    DepthToColor() warps the depth frame into the color frame: a
+//      PIXEL_DEPTH_MM16 image the size of the color stream, with the depths
+//      seen from the color camera. Each depth pixel covers the color pixels
+//      of the bounding box of the projections of its corners, so a small
+//      depth frame fills a large color frame (the nearest depth wins where
+//      footprints overlap, and it's 0 where none lands)
+//    ColorToDepth() warps the color frame into the depth frame: the color of
+//      each depth pixel, black where the depth is 0 or falls outside of the
+//      color frame (PIXEL_GRAY8, PIXEL_GRAY16, PIXEL_RGB888 or
+//      PIXEL_BGRA8888)
+// A DepthRegistration is not thread safe: use one per thread.
+//
+// e.g.
+//    hippo::Camera3DMappingParameter param = { depth_stream, rgb_stream };
+//    system.camera_3d_mapping(param, &mapping);
+//    hippo::DepthRegistration registration;
+//    registration.SetMapping(mapping, 640, 480, 1920, 1080);
+//    ...
+//    registration.ColorToDepth(depth, color, aligned_color);
+class DLLEXPORT DepthRegistration {
+ public:
+  // one thread per core, the best SIMD level of the CPU
+  DepthRegistration();
+  // |num_threads| 0 means one per core
+  DepthRegistration(uint32_t num_threads, SimdLevel max_simd);
+  ~DepthRegistration(void);
+
+  uint64_t SetMapping(const Camera3DMapping &mapping,
+                      uint32_t depth_width, uint32_t depth_height,
+                      uint32_t color_width, uint32_t color_height);
+
+  uint64_t DepthToColor(const PixelBuffer &depth,
+                        const PixelBuffer &registered);
+  uint64_t ColorToDepth(const PixelBuffer &depth, const PixelBuffer &color,
+                        const PixelBuffer &registered);
+
+  DepthRegistration(DepthRegistration const &);    // Don't implement
+  void operator=(DepthRegistration const &);       // Don't implement
+
+ private:
+  // projects every pixel of |depth| into the color frame: the centers of
+  // the pixels, or their four corners for |corners|
+  uint64_t ProjectDepth(const PixelBuffer &depth, bool corners);
+
+  uint32_t num_threads_;
+  SimdLevel level_;
+  uint32_t depth_width_;
+  uint32_t depth_height_;
+  uint32_t color_width_;
+  uint32_t color_height_;
+  LensModel color_lens_;
+  float translation_[3];
+  // the rotated ray of each depth pixel
+  float *ray_x_;
+  float *ray_y_;
+  float *ray_z_;
+  // the rotated ray of each corner of the depth pixels, (depth_width_ + 1)
+  // x (depth_height_ + 1)
+  float *corner_x_;
+  float *corner_y_;
+  float *corner_z_;
+  // the color pixel (y * color_width_ + x, or -1) and the depth in the
+  // color camera of each depth pixel of the last frame projected
+  int32_t *index_;
+  float *z_;
+  // the color pixels of the top left, top right, bottom left and bottom
+  // right corners of the depth pixels of the last frame projected, clamped
+  // to the frame (y * (color_width_ + 1) + x, or -1), one array after the
+  // other
+  int32_t *corner_index_;
+  // the depth pixels sorted by the first color row of their footprint, and
+  // the end of the pixels of each color row in |order_|
+  uint32_t *order_;
+  uint32_t *row_end_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_REGISTRATION_H_
@@ -0,0 +1,68 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_REMAP_H_
+#define INCLUDE_REMAP_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "../include/hippo.h"
+#include "../include/pixel_convert.h"
+
+namespace hippo {
+
+namespace internal {
+
+// A remap table gives the source pixel of every pixel of a destination
+// frame: the top left pixel of the 2x2 pixels to sample, and the fractions
+// between them. The destination and the source frames can have different
+// sizes. It's shared by the geometric corrections (see undistort.h and
+// keystone_warp.h).
+typedef struct RemapTable {
+  uint32_t src_width;
+  uint32_t src_height;
+  uint32_t width;
+  uint32_t height;
+  // the top left source pixel of each pixel ((y << 16) | x), or 0xffffffff
+  // if outside of the source frame
+  uint32_t *pos;
+  // the fractions of the source pixel in 1/128th ((fy << 8) | fx)
+  uint16_t *frac;
+} RemapTable;
+
+// allocates the table of |width| x |height| pixels sampling a |src_width| x
+// |src_height| frame (both at least 2x2 and at most 65535x65535)
+uint64_t AllocateRemapTable(uint32_t src_width, uint32_t src_height,
+                            uint32_t width, uint32_t height,
+                            RemapTable *table);
+void FreeRemapTable(RemapTable *table);
+
+// fills the table from up to |num_threads| threads, with the source point
+// |source(u, v, &x, &y)| of each destination pixel (u, v), in source pixels
+void BuildRemapTable(
+    uint32_t num_threads,
+    const std::function<void(uint32_t, uint32_t, double*, double*)> &source,
+    RemapTable *table);
+
+// true if every pixel of the table is outside, or samples 2x2 pixels inside
+// of the source frame with fractions up to 1 (e.g. a table read from a file)
+bool CheckRemapTable(const RemapTable &table);
+
+// samples |src| (the source size of the table) into |dst| (the size of the
+// table), bilinearly, or from the nearest pixel for PIXEL_DEPTH_MM16 as
+// interpolating depths across edges makes up points. The pixels whose
+// source is outside of the frame are 0. PIXEL_GRAY8 and PIXEL_GRAY16 use
+// AVX2 gathers, PIXEL_BGRA8888 SSE2, and all the levels give the same output
+// as the scalar kernels.
+uint64_t Remap(const RemapTable &table, const PixelBuffer &src,
+               const PixelBuffer &dst, uint32_t num_threads,
+               SimdLevel level);
+
+}  // namespace internal
+
+}  // namespace hippo
+
+#endif  // INCLUDE_REMAP_H_
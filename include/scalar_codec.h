@@ -0,0 +1,198 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_SCALAR_CODEC_H_
+#define INCLUDE_SCALAR_CODEC_H_
+
+#include <ctype.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+
+namespace hippo {
+
+namespace internal {
+
+// The scalar property accessors of HippoDevice encode their JSON-RPC
+// requests and decode the responses with these, in preallocated buffers
+// and without going through nl::json. The numbers are written and read in
+// the "C" locale, as JSON doesn't depend on the LC_NUMERIC of the
+// application.
+inline _locale_t JsonLocale() {
+  static _locale_t locale = _create_locale(LC_NUMERIC, "C");
+  return locale;
+}
+
+// Encode() returns the length of the value written in |str|, or -1 if it
+// doesn't fit or has no JSON representation. Decode() returns false if the
+// value is not of the expected type (or out of its range).
+template <typename T>
+struct ScalarCodec;
+
+template <>
+struct ScalarCodec<bool> {
+  static int Encode(bool value, char *str, size_t len) {
+    int n = snprintf(str, len, "%s", value ? "true" : "false");
+    return (n < 0 || static_cast<size_t>(n) >= len) ? -1 : n;
+  }
+  static bool Decode(const char *str, bool *value) {
+    if (0 == strncmp(str, "true", 4)) {
+      *value = true;
+    } else if (0 == strncmp(str, "false", 5)) {
+      *value = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+};
+
+template <>
+struct ScalarCodec<uint32_t> {
+  static int Encode(uint32_t value, char *str, size_t len) {
+    int n = snprintf(str, len, "%u", value);
+    return (n < 0 || static_cast<size_t>(n) >= len) ? -1 : n;
+  }
+  static bool Decode(const char *str, uint32_t *value) {
+    if (!isdigit(static_cast<unsigned char>(*str))) {
+      return false;
+    }
+    char *end = NULL;
+    unsigned long long v = strtoull(str, &end, 10);   // NOLINT
+    // reject floats and out of range values
+    if ('.' == *end || 'e' == *end || 'E' == *end || v > 0xffffffff) {
+      return false;
+    }
+    *value = static_cast<uint32_t>(v);
+    return true;
+  }
+};
+
+template <>
+struct ScalarCodec<uint16_t> {
+  static int Encode(uint16_t value, char *str, size_t len) {
+    return ScalarCodec<uint32_t>::Encode(value, str, len);
+  }
+  static bool Decode(const char *str, uint16_t *value) {
+    uint32_t v = 0;
+    if (!ScalarCodec<uint32_t>::Decode(str, &v) || v > 0xffff) {
+      return false;
+    }
+    *value = static_cast<uint16_t>(v);
+    return true;
+  }
+};
+
+template <>
+struct ScalarCodec<float> {
+  static int Encode(float value, char *str, size_t len) {
+    // nan and inf are not JSON numbers
+    if (!std::isfinite(value)) {
+      return -1;
+    }
+    int n = _snprintf_l(str, len, "%.9g", JsonLocale(), value);
+    if (n < 0 || static_cast<size_t>(n) >= len) {
+      return -1;
+    }
+    // make sure SoHal gets a float and not an integer
+    if (NULL == strpbrk(str, ".eE")) {
+      if (static_cast<size_t>(n) + 2 >= len) {
+        return -1;
+      }
+      str[n++] = '.';
+      str[n++] = '0';
+      str[n] = '\0';
+    }
+    return n;
+  }
+  static bool Decode(const char *str, float *value) {
+    if ('-' != *str && !isdigit(static_cast<unsigned char>(*str))) {
+      return false;
+    }
+    char *end = NULL;
+    double v = _strtod_l(str, &end, JsonLocale());
+    // strtod also takes hex floats, nan and inf, which JSON doesn't
+    size_t len = static_cast<size_t>(end - str);
+    if (0 == len || len != strspn(str, "0123456789+-.eE") ||
+        !std::isfinite(static_cast<float>(v))) {
+      return false;
+    }
+    *value = static_cast<float>(v);
+    return true;
+  }
+};
+
+// true if |value| can be a property, i.e. a float of a response that went
+// through nl::json is not inf
+template <typename T>
+inline bool ScalarInRange(T value) {
+  return true;
+}
+
+template <>
+inline bool ScalarInRange<float>(float value) {
+  return std::isfinite(value);
+}
+
+// returns a pointer to the value of the "result" key of a JSON-RPC response
+// or NULL if there is none (i.e. it's an error response)
+inline const char *FindRawResult(const char *response) {
+  const char *pos = strstr(response, "\"result\"");
+  if (NULL == pos) {
+    return NULL;
+  }
+  pos += strlen("\"result\"");
+  while (isspace(static_cast<unsigned char>(*pos))) {
+    pos++;
+  }
+  if (':' != *pos++) {
+    return NULL;
+  }
+  while (isspace(static_cast<unsigned char>(*pos))) {
+    pos++;
+  }
+  return pos;
+}
+
+// encodes in |request| (of |size| bytes) the request |id| of the |method|
+// of |dev_name|, with |set| as its param (NULL for a get), the same as
+// HippoDevice::GenerateJsonRpc() does. Returns the length of the request, or
+// -1 if it doesn't fit or |set| can't be encoded.
+template <typename T>
+int EncodeScalarRequest(const char *id, const char *dev_name,
+                        const char *method, const T *set, char *request,
+                        size_t size) {
+  const uint32_t kParamLen = 64;
+  char param[kParamLen] = "";
+  if (NULL != set) {
+    char value[kParamLen - 16];
+    if (ScalarCodec<T>::Encode(*set, value, sizeof(value)) < 0) {
+      return -1;
+    }
+    snprintf(param, sizeof(param), ",\"params\":[%s]", value);
+  }
+  int len = snprintf(request, size,
+                     "{\"id\":\"%s\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"%s.%s\"%s}",
+                     id, dev_name, method, param);
+  return (len <= 0 || static_cast<size_t>(len) >= size) ? -1 : len;
+}
+
+// decodes the result of a JSON-RPC |response| in |value|: returns false if
+// there is no result of type |T| (i.e. an error response), in which case the
+// response has to go through nl::json
+template <typename T>
+bool DecodeScalarResult(const char *response, T *value) {
+  const char *result = FindRawResult(response);
+  return NULL != result && ScalarCodec<T>::Decode(result, value);
+}
+
+}  // namespace internal
+
+}  // namespace hippo
+
+#endif  // INCLUDE_SCALAR_CODEC_H_
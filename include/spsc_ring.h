@@ -0,0 +1,131 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_SPSC_RING_H_
+#define INCLUDE_SPSC_RING_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace hippo {
+
+// SpscRing is a bounded lock-free queue for a single producer thread and a
+// single consumer thread. All the slots are allocated when the ring is
+// created, so pushing and popping never allocate memory.
+//
+// The producer either copies an item in with Push(), or fills a slot in
+// place with Reserve() followed by Commit(). The consumer either copies an
+// item out with Pop(), or uses it in place with Front() followed by
+// Release(); the item is not overwritten until it has been released.
+//
+// Note: the consumer may change threads as long as there is a
+// synchronization point (i.e. a mutex) between the consumers.
+template <typename T>
+class SpscRing {
+ public:
+  // |capacity| gets rounded up to the next power of 2
+  explicit SpscRing(uint32_t capacity) :
+      items_(NULL), mask_(0), head_(0), tail_(0) {
+    uint32_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    if (NULL != (items_ = new (std::nothrow) T[size])) {
+      mask_ = size - 1;
+    }
+  }
+
+  ~SpscRing() {
+    delete[] items_;
+  }
+
+  // returns false if the ring could not be allocated
+  bool Valid() const {
+    return NULL != items_;
+  }
+
+  uint32_t Capacity() const {
+    return (NULL == items_) ? 0 : mask_ + 1;
+  }
+
+  uint32_t Size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  bool Empty() const {
+    return 0 == Size();
+  }
+
+  // producer: returns the next free slot, or NULL if the ring is full
+  T *Reserve() {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (NULL == items_ ||
+        tail - head_.load(std::memory_order_acquire) > mask_) {
+      return NULL;
+    }
+    return &items_[tail & mask_];
+  }
+
+  // producer: publishes the slot returned by Reserve()
+  void Commit() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // producer: returns false if the ring is full
+  bool Push(const T &item) {
+    T *slot = Reserve();
+    if (NULL == slot) {
+      return false;
+    }
+    *slot = item;
+    Commit();
+    return true;
+  }
+
+  // consumer: returns the oldest item, or NULL if the ring is empty
+  T *Front() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    return &items_[head & mask_];
+  }
+
+  // consumer: frees the slot returned by Front()
+  void Release() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // consumer: returns false if the ring is empty
+  bool Pop(T *item) {
+    T *slot = Front();
+    if (NULL == slot) {
+      return false;
+    }
+    *item = *slot;
+    Release();
+    return true;
+  }
+
+ private:
+  T *items_;
+  uint32_t mask_;
+  // head_ is written by the consumer and tail_ by the producer, keep them
+  // in different cache lines
+  alignas(64) std::atomic<uint32_t> head_;
+  alignas(64) std::atomic<uint32_t> tail_;
+
+  SpscRing(SpscRing const &);          // Don't implement
+  void operator=(SpscRing const &);    // Don't implement
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_SPSC_RING_H_
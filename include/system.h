@@ -283,6 +283,12 @@ class DLLEXPORT System : public HippoDevice {
   // is called in order to avoid a memory leak
   uint64_t devices(DeviceInfo **get, uint64_t *num_devices);
 
+  // Same as devices() above, but the DeviceInfo array and all its strings
+  // are allocated in the |arena| passed in, and released all at once by
+  // arena->Reset(). free_devices() must NOT be called in this case.
+  uint64_t devices(DeviceInfo **get, uint64_t *num_devices,
+                   ResultArena *arena);
+
   // frees the memory allocated in the devices() function
   // failing to call this function after calling devices()
   // will result in a memory leak
@@ -335,6 +341,14 @@ class DLLEXPORT System : public HippoDevice {
                         uint64_t *num_projectors,
                         uint64_t *num_touchscreens);
 
+  // Same as hardware_ids() above, but the HardwareIDs lists are allocated
+  // in the |arena| passed in, and released all at once by arena->Reset().
+  // free_hardware_ids() must NOT be called in this case.
+  uint64_t hardware_ids(HardwareIDs *get,
+                        uint64_t *num_projectors,
+                        uint64_t *num_touchscreens,
+                        ResultArena *arena);
+
   // frees the memory allocated inside hardware_ids()
   void free_hardware_ids(HardwareIDs *ids_to_free,
                          uint64_t num_projectors,
@@ -384,6 +398,24 @@ class DLLEXPORT System : public HippoDevice {
   uint64_t subscribe(void(*callback)(const SystemNotificationParam &param,
                                      void *data),
                       void *data, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are decoded and delivered
+  uint64_t subscribe(void(*callback)(const SystemNotificationParam &param,
+                                     void *data),
+                      void *data, uint64_t mask, uint32_t *get);
+
+  // subscribe to notifications in polling mode: up to |queue_depth|
+  // notifications are queued until they are retrieved with poll()
+  uint64_t subscribe(uint32_t queue_depth, uint32_t *get);
+  // same as above, but only the notifications whose bit is set in |mask|
+  // (see NotificationMask()) are queued
+  uint64_t subscribe(uint32_t queue_depth, uint64_t mask, uint32_t *get);
+  // copies up to |max_params| queued notifications, oldest first
+  // Note: unlike with a callback, the DeviceID and DisplayInfo parameters
+  // are not freed automatically: call free_device_ids(&id, 1) and
+  // free_display_list() with them after polling them
+  uint64_t poll(SystemNotificationParam *params, uint32_t max_params,
+                uint32_t *num_params);
 
   // unsubscribe from notifications
   uint64_t unsubscribe();
@@ -401,17 +433,19 @@ class DLLEXPORT System : public HippoDevice {
   uint64_t camera_stream_c2json(
                 const hippo::CameraStream &cameraStream, void *obj);
   uint64_t devices_json2c(const void *obj, DeviceInfo **device_info,
-                          uint64_t *num_devices);
-  uint64_t device_id_json2c(const void *obj, DeviceID *id_info);
+                          uint64_t *num_devices, ResultArena *arena);
+  uint64_t device_id_json2c(const void *obj, DeviceID *id_info,
+                            ResultArena *arena);
   uint64_t device_ids_json2c(const void *obj, DeviceID **id_info,
                              uint64_t *num_devices);
   uint64_t echo_json2c(const void *obj, char **echo_return_str);
   uint64_t hardware_ids_json2c(const void *obj, HardwareIDs *get,
                                uint64_t *num_projectors,
-                               uint64_t *num_touchscreens);
+                               uint64_t *num_touchscreens,
+                               ResultArena *arena);
   uint64_t is_locked_json2c(const void *obj, SessionState *session_state);
   uint64_t list_displays_json2c(const void *obj, DisplayInfo **display_info,
-                                uint64_t *num_displays);
+                                uint64_t *num_displays, ResultArena *arena);
   uint64_t powerstate_json2c(const void *obj, PowerStateType *powerState);
   uint64_t sessionchange_json2c(const void *obj,
                                 hippo::SessionChange *session_change);
@@ -0,0 +1,88 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef INCLUDE_UNDISTORT_H_
+#define INCLUDE_UNDISTORT_H_
+
+#include <stdint.h>
+
+#include "../include/hippo.h"
+#include "../include/lens_model.h"
+#include "../include/pixel_convert.h"
+#include "../include/remap.h"
+
+#if COMPILING_DLL
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __declspec(dllimport)
+#endif
+
+namespace hippo {
+
+// Undistorter removes the lens distortion of the frames of a camera: the
+// output is the image of a pinhole camera with the same intrinsics. The
+// LensModel comes from the LensDistortion of System::camera_3d_mapping or
+// from the CalibrationDistortion of DepthCamera::ir_to_rgb_calibration (see
+// lens_model.h).
+//
+// SetModel() builds a fixed point remap table for a resolution once: the
+// source pixel of every output pixel, with 7 bit fractions. Undistort() then
+// samples the source with it, bilinearly (with AVX2 gathers for PIXEL_GRAY8
+// and PIXEL_GRAY16, and SSE2 for PIXEL_BGRA8888), across threads. The
+// supported formats are PIXEL_GRAY8, PIXEL_GRAY16, PIXEL_RGB888,
+// PIXEL_BGRA8888, and PIXEL_DEPTH_MM16, which is sampled from the nearest
+// pixel as interpolating depths across edges makes up points. The output
+// pixels whose source is outside of the frame are 0.
+//
+// Building the table of a hirescamera frame takes a while, so SetModel() can
+// keep the tables in a directory, in files named after the serial number of
+// the device and the resolution, and load them back when the model matches.
+//
+// e.g.
+//    hippo::LensModel model;
+//    hippo::LensModelFromCameraParameters(mapping.to, 4352, 3264, &model);
+//    hippo::Undistorter undistorter;
+//    undistorter.SetModel(model, 4352, 3264, "C:\\ProgramData\\MyApp",
+//                         info.serial);
+//    ...
+//    undistorter.Undistort(frame, undistorted);
+class DLLEXPORT Undistorter {
+ public:
+  // one thread per core, the best SIMD level of the CPU
+  Undistorter();
+  // |num_threads| 0 means one per core
+  Undistorter(uint32_t num_threads, SimdLevel max_simd);
+  ~Undistorter(void);
+
+  // builds the table of the |width| x |height| frames of a camera
+  uint64_t SetModel(const LensModel &model, uint32_t width, uint32_t height);
+  // same, loading the table from |cache_dir| if it was saved there for the
+  // same |serial|, model and resolution, or saving it there otherwise (a
+  // table that can't be saved is still used)
+  uint64_t SetModel(const LensModel &model, uint32_t width, uint32_t height,
+                    const char *cache_dir, const char *serial);
+  // whether the table of the last SetModel() came from the cache
+  bool LoadedFromCache();
+
+  // |src| and |dst| have the same format and the resolution of the table
+  uint64_t Undistort(const PixelBuffer &src, const PixelBuffer &dst);
+
+  Undistorter(Undistorter const &);          // Don't implement
+  void operator=(Undistorter const &);       // Don't implement
+
+ private:
+  void Build(const LensModel &model);
+  uint64_t Load(const char *path, const LensModel &model);
+  uint64_t Save(const char *path);
+
+  uint32_t num_threads_;
+  SimdLevel level_;
+  LensModel model_;
+  bool from_cache_;
+  internal::RemapTable table_;
+};
+
+}  // namespace hippo
+
+#endif  // INCLUDE_UNDISTORT_H_
@@ -16,8 +16,13 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "capturestage";
+// the scalar properties
+const char kRotate[] = "rotate";
+const char kRotationAngle[] = "rotation_angle";
+const char kTilt[] = "tilt";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *CaptureStageNotification_str[];
 
 CaptureStage::CaptureStage() :
     HippoDevice(devName, defaultHost, defaultPort, HIPPO_CAPTURESTAGE, 0) {
@@ -49,7 +54,7 @@ uint64_t CaptureStage::device_specific_info(CaptureStageSpecificInfo *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("device_specific_info", jptr)) {
+  if (err = SendReadMsg("device_specific_info", jptr)) {
     return err;
   }
   return captureStageInfo_json2c(jptr, get);
@@ -78,7 +83,7 @@ uint64_t CaptureStage::led_on_off_rate(hippo::LedOnOffRate *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("led_on_off_rate", jptr)) {
+  if (err = SendReadMsg("led_on_off_rate", jptr)) {
     return err;
   }
   return ledOnOffRate_json2c(jptr, get);
@@ -189,7 +194,7 @@ uint64_t CaptureStage::led_state(hippo::LedState *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("led_state", jptr)) {
+  if (err = SendReadMsg("led_state", jptr)) {
     return err;
   }
   if (err = ledState_json2c(jptr, get)) {
@@ -314,19 +319,19 @@ uint64_t CaptureStage::ledState_json2c(void *obj,
 }
 
 uint64_t CaptureStage::rotate(float set) {
-  return float_set_get("rotate", set, NULL);
+  return property<float, kRotate>(set, NULL);
 }
 
 uint64_t CaptureStage::rotate(float *get) {
-  return float_get("rotate", get);
+  return property<float, kRotate>(get);
 }
 
 uint64_t CaptureStage::rotate(float set, float *get) {
-  return float_set_get("rotate", set, get);
+  return property<float, kRotate>(set, get);
 }
 
 uint64_t CaptureStage::rotation_angle(float *get) {
-  return float_get("rotation_angle", get);
+  return property<float, kRotationAngle>(get);
 }
 
 uint64_t CaptureStage::subscribe(
@@ -338,9 +343,18 @@ uint64_t CaptureStage::subscribe(
 uint64_t CaptureStage::subscribe(
     void(*callback)(const CaptureStageNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t CaptureStage::subscribe(
+    void(*callback)(const CaptureStageNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      CaptureStageNotification::on_tilt);
   uint64_t err = HIPPO_OK;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, CaptureStageNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -349,15 +363,34 @@ uint64_t CaptureStage::subscribe(
 }
 
 uint64_t CaptureStage::tilt(float set) {
-  return float_set_get("tilt", set, NULL);
+  return property<float, kTilt>(set, NULL);
 }
 
 uint64_t CaptureStage::tilt(float *get) {
-  return float_get("tilt", get);
+  return property<float, kTilt>(get);
 }
 
 uint64_t CaptureStage::tilt(float set, float *get) {
-  return float_set_get("tilt", set, get);
+  return property<float, kTilt>(set, get);
+}
+
+uint64_t CaptureStage::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t CaptureStage::subscribe(uint32_t queue_depth, uint64_t mask,
+                                 uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      CaptureStageNotification::on_tilt);
+
+  callback_ = NULL;
+  return subscribe_queue<CaptureStageNotificationParam>(
+      queue_depth, mask, CaptureStageNotification_str, num_names, get);
+}
+
+uint64_t CaptureStage::poll(CaptureStageNotificationParam *params,
+                            uint32_t max_params, uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
 }
 
 uint64_t CaptureStage::unsubscribe() {
@@ -373,7 +406,7 @@ uint64_t CaptureStage::unsubscribe(uint32_t *get) {
 // Notifications
 
 bool CaptureStage::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *CaptureStageNotification_str[] = {
@@ -385,7 +418,7 @@ const char *CaptureStageNotification_str[] = {
 };
 
 void CaptureStage::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = HIPPO_OK;
@@ -396,16 +429,12 @@ void CaptureStage::ProcessSignal(char *method, void *obj) {
                        hippo::CaptureStageNotification::on_close),
                    static_cast<uint32_t>(
                        hippo::CaptureStageNotification::on_tilt));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   float val = 0;
   CaptureStageNotificationParam param;
   param.type = static_cast<hippo::CaptureStageNotification>(idx);
@@ -435,7 +464,11 @@ void CaptureStage::ProcessSignal(char *method, void *obj) {
       break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
 }
 
@@ -16,8 +16,12 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "depthcamera";
+// the scalar properties
+const char kIrFloodOn[] = "ir_flood_on";
+const char kLaserOn[] = "laser_on";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *DepthCameraNotification_str[];
 
 
 DepthCamera::DepthCamera() :
@@ -42,15 +46,15 @@ DepthCamera::~DepthCamera(void) {
 }
 
 uint64_t DepthCamera::ir_flood_on(bool set) {
-  return bool_set_get("ir_flood_on", set, NULL);
+  return property<bool, kIrFloodOn>(set, NULL);
 }
 
 uint64_t DepthCamera::ir_flood_on(bool *get) {
-  return bool_get("ir_flood_on", get);
+  return property<bool, kIrFloodOn>(get);
 }
 
 uint64_t DepthCamera::ir_flood_on(bool set, bool* get) {
-  return bool_set_get("ir_flood_on", set, get);
+  return property<bool, kIrFloodOn>(set, get);
 }
 
 uint64_t DepthCamera::ir_to_rgb_calibration(IrRgbCalibration *get) {
@@ -62,22 +66,22 @@ uint64_t DepthCamera::ir_to_rgb_calibration(IrRgbCalibration *get) {
   void *jsetptr = reinterpret_cast<void*>(&jset);
   void *jgetptr = reinterpret_cast<void*>(&jget);
   // add the mode name to the parameters
-  if (err = SendRawMsg("ir_to_rgb_calibration", jgetptr)) {
+  if (err = SendReadMsg("ir_to_rgb_calibration", jgetptr)) {
     return err;
   }
   return irRGBcalibration_json2c(jgetptr, get);
 }
 
 uint64_t DepthCamera::laser_on(bool set) {
-  return bool_set_get("laser_on", set, NULL);
+  return property<bool, kLaserOn>(set, NULL);
 }
 
 uint64_t DepthCamera::laser_on(bool *get) {
-  return bool_get("laser_on", get);
+  return property<bool, kLaserOn>(get);
 }
 
 uint64_t DepthCamera::laser_on(bool set, bool* get) {
-  return bool_set_get("laser_on", set, get);
+  return property<bool, kLaserOn>(set, get);
 }
 
 uint64_t DepthCamera::parseIntrinsics(
@@ -162,7 +166,7 @@ uint64_t DepthCamera::parseDistortion(
 }
 
 bool DepthCamera::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 uint64_t DepthCamera::subscribe(
@@ -174,9 +178,18 @@ uint64_t DepthCamera::subscribe(
 uint64_t DepthCamera::subscribe(
     void(*callback)(const DepthCameraNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t DepthCamera::subscribe(
+    void(*callback)(const DepthCameraNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      DepthCameraNotification::on_laser_on);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, DepthCameraNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -184,6 +197,25 @@ uint64_t DepthCamera::subscribe(
   return err;
 }
 
+uint64_t DepthCamera::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t DepthCamera::subscribe(uint32_t queue_depth, uint64_t mask,
+                                uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      DepthCameraNotification::on_laser_on);
+
+  callback_ = NULL;
+  return subscribe_queue<DepthCameraNotificationParam>(
+      queue_depth, mask, DepthCameraNotification_str, num_names, get);
+}
+
+uint64_t DepthCamera::poll(DepthCameraNotificationParam *params,
+                           uint32_t max_params, uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t DepthCamera::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -299,7 +331,7 @@ const char *DepthCameraNotification_str[] = {
 };
 
 void DepthCamera::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -310,17 +342,12 @@ void DepthCamera::ProcessSignal(char *method, void *obj) {
                        DepthCameraNotification::on_close),
                    static_cast<uint32_t>(
                        DepthCameraNotification::on_laser_on));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  }
-  catch (nl::json::exception) {
-    // out_of_range or type_error do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   DepthCameraNotificationParam param;
   param.type = static_cast<hippo::DepthCameraNotification>(idx);
 
@@ -351,8 +378,11 @@ void DepthCamera::ProcessSignal(char *method, void *obj) {
     break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
-  delete params;
 }
 }  // namespace hippo
@@ -17,6 +17,7 @@ extern std::mutex gHippoDeviceMutex;
 const char devName[] = "desklamp";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *DeskLampNotification_str[];
 
 DeskLamp::DeskLamp() :
     HippoDevice(devName, defaultHost, defaultPort, HIPPO_DESKLAMP, 0) {
@@ -65,14 +66,14 @@ uint64_t DeskLamp::state(DeskLampState *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("state", jptr)) {
+  if (err = SendReadMsg("state", jptr)) {
     return err;
   }
   return desklamp_state_json2c(jptr, get);
 }
 
 bool DeskLamp::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 uint64_t DeskLamp::subscribe(
@@ -84,9 +85,18 @@ uint64_t DeskLamp::subscribe(
 uint64_t DeskLamp::subscribe(
   void(*callback)(const DeskLampNotificationParam &param, void *data),
   void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t DeskLamp::subscribe(
+  void(*callback)(const DeskLampNotificationParam &param, void *data),
+  void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      DeskLampNotification::on_state);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, DeskLampNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -94,6 +104,25 @@ uint64_t DeskLamp::subscribe(
   return err;
 }
 
+uint64_t DeskLamp::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t DeskLamp::subscribe(uint32_t queue_depth, uint64_t mask,
+                             uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      DeskLampNotification::on_state);
+
+  callback_ = NULL;
+  return subscribe_queue<DeskLampNotificationParam>(
+      queue_depth, mask, DeskLampNotification_str, num_names, get);
+}
+
+uint64_t DeskLamp::poll(DeskLampNotificationParam *params, uint32_t max_params,
+                        uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t DeskLamp::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -141,7 +170,7 @@ const char *DeskLampNotification_str[] = {
 };
 
 void DeskLamp::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -152,17 +181,13 @@ void DeskLamp::ProcessSignal(char *method, void *obj) {
                      hippo::DeskLampNotification::on_close),
                    static_cast<uint32_t>(
                      hippo::DeskLampNotification::on_state));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  }
-  catch (nl::json::exception) {     // out_of_range or type_error
-                                    // do nothing
-  }
+  nl::json *params = reinterpret_cast<nl::json*>(obj);
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   int val = 0;
   DeskLampNotificationParam param;
   param.type = static_cast<hippo::DeskLampNotification>(idx);
@@ -180,7 +205,11 @@ void DeskLamp::ProcessSignal(char *method, void *obj) {
     break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
 }
 
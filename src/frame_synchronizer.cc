@@ -0,0 +1,228 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+
+#include "../include/frame_synchronizer.h"
+
+namespace hippo {
+
+const uint32_t kDefaultSyncQueueDepth = 4;
+
+// the frames of each source waiting for a match, and the frame sets matched
+class FrameSynchronizer::Queues {
+ public:
+  Queues(int64_t tolerance_us, uint32_t queue_depth) :
+      tolerance_us_(tolerance_us), queue_depth_(queue_depth),
+      num_sources_(0), total_skew_us_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  int64_t tolerance_us_;
+  uint32_t queue_depth_;
+  uint32_t num_sources_;
+  // the stream bit of each source
+  uint32_t stream_[kMaxSyncSources];
+  std::deque<SyncedFrame> frames_[kMaxSyncSources];
+  std::deque<FrameSet> sets_;
+  int64_t total_skew_us_;
+  SyncStats stats_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  // matches the frames at the head of the queues, returns true if any set
+  // was matched. Expects the lock on mutex_ to be captured
+  bool Match() {
+    bool matched = false;
+    while (true) {
+      uint32_t earliest = 0, latest = 0;
+      for (uint32_t i = 0; i < num_sources_; i++) {
+        if (frames_[i].empty()) {
+          return matched;     // waiting for this source
+        }
+        if (frames_[i].front().header->timestamp <
+            frames_[earliest].front().header->timestamp) {
+          earliest = i;
+        }
+        if (frames_[i].front().header->timestamp >
+            frames_[latest].front().header->timestamp) {
+          latest = i;
+        }
+      }
+      int64_t skew_us = static_cast<int64_t>(
+          frames_[latest].front().header->timestamp -
+          frames_[earliest].front().header->timestamp);
+      if (skew_us > tolerance_us_) {
+        // the source of the latest frame has nothing older to match the
+        // earliest one with
+        frames_[earliest].pop_front();
+        stats_.dropped[earliest]++;
+        continue;
+      }
+      if (sets_.size() == queue_depth_) {
+        // nobody is popping them
+        sets_.pop_front();
+        stats_.dropped_sets++;
+      }
+      sets_.push_back(FrameSet());
+      FrameSet &set = sets_.back();
+      for (uint32_t i = 0; i < num_sources_; i++) {
+        set.frames[i] = frames_[i].front();
+        frames_[i].pop_front();
+      }
+      set.num_frames = num_sources_;
+      set.timestamp = set.frames[earliest].header->timestamp;
+      set.skew_us = skew_us;
+      matched = true;
+
+      stats_.framesets++;
+      total_skew_us_ += skew_us;
+      if (skew_us > stats_.max_skew_us) {
+        stats_.max_skew_us = skew_us;
+      }
+      stats_.avg_skew_us = total_skew_us_ /
+          static_cast<int64_t>(stats_.framesets);
+    }
+  }
+
+  // Expects the lock on mutex_ to be captured
+  void Clear() {
+    for (uint32_t i = 0; i < num_sources_; i++) {
+      frames_[i].clear();
+    }
+    sets_.clear();
+    memset(&stats_, 0, sizeof(stats_));
+    total_skew_us_ = 0;
+  }
+};
+
+FrameSynchronizer::FrameSynchronizer(int64_t tolerance_us) :
+    FrameSynchronizer(tolerance_us, kDefaultSyncQueueDepth) {
+}
+
+FrameSynchronizer::FrameSynchronizer(int64_t tolerance_us,
+                                     uint32_t queue_depth) :
+    queues_(new (std::nothrow) Queues(tolerance_us,
+                                      queue_depth ? queue_depth : 1)) {
+}
+
+FrameSynchronizer::~FrameSynchronizer(void) {
+  if (NULL != queues_) {
+    std::lock_guard<std::mutex> lock(queues_->mutex_);
+    queues_->Clear();
+  }
+  delete queues_;
+}
+
+uint64_t FrameSynchronizer::AddSource(const CameraStreams &stream,
+                                      uint32_t *source) {
+  if (NULL == source) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  // a single stream
+  if (0 == stream.value || (stream.value & (stream.value - 1))) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (NULL == queues_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  std::lock_guard<std::mutex> lock(queues_->mutex_);
+
+  if (kMaxSyncSources == queues_->num_sources_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  uint32_t bit = 0;
+  while (!(stream.value & (1 << bit))) {
+    bit++;
+  }
+  *source = queues_->num_sources_++;
+  queues_->stream_[*source] = bit;
+
+  return HIPPO_OK;
+}
+
+uint64_t FrameSynchronizer::Push(uint32_t source, const FrameHandle &frame) {
+  if (NULL == queues_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  const CameraFrame *cam_frame = frame.get();
+  // error frames don't have any stream
+  if (NULL == cam_frame || cam_frame->header->error) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  std::unique_lock<std::mutex> lock(queues_->mutex_);
+
+  if (source >= queues_->num_sources_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  uint32_t bit = queues_->stream_[source];
+  if (!(cam_frame->header->stream.value & (1 << bit))) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  SyncedFrame synced;
+  synced.frame = frame;
+  synced.header = cam_frame->streams[bit].header;
+  synced.data = cam_frame->streams[bit].data;
+
+  std::deque<SyncedFrame> &queue = queues_->frames_[source];
+  if (queue.size() == queues_->queue_depth_) {
+    // the other sources are too far behind
+    queue.pop_front();
+    queues_->stats_.dropped[source]++;
+  }
+  queue.push_back(synced);
+  bool matched = queues_->Match();
+  lock.unlock();
+
+  if (matched) {
+    queues_->cv_.notify_all();
+  }
+  return HIPPO_OK;
+}
+
+uint64_t FrameSynchronizer::Pop(FrameSet *set, uint32_t timeout_ms) {
+  if (NULL == set) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == queues_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  std::unique_lock<std::mutex> lock(queues_->mutex_);
+
+  if (!queues_->cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [this] { return !queues_->sets_.empty(); })) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_TIMEOUT);
+  }
+  *set = queues_->sets_.front();
+  queues_->sets_.pop_front();
+
+  return HIPPO_OK;
+}
+
+uint64_t FrameSynchronizer::GetStats(SyncStats *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == queues_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  std::lock_guard<std::mutex> lock(queues_->mutex_);
+  memcpy(get, &queues_->stats_, sizeof(queues_->stats_));
+
+  return HIPPO_OK;
+}
+
+void FrameSynchronizer::Reset() {
+  if (NULL == queues_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(queues_->mutex_);
+  queues_->Clear();
+}
+
+}  // namespace hippo
@@ -2,12 +2,10 @@
 // Copyright 2019 HP Development Company, L.P.
 // SPDX-License-Identifier: MIT
 
-#include <windows.h>   // for GetCurrentThreadId
-
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctime>
+#include <string.h>
 
 #include <string>
 #include <unordered_map>
@@ -18,57 +16,63 @@
 
 namespace hippo {
 
-class HippoRand {
- public:
-  static HippoRand& GetInstance(void) {
-    static HippoRand instance;
-    return instance;
-  }
-  uint16_t Rand() {
-    return std::rand() % 0xffff + 1;
-  }
- private:
-  HippoRand() {
-    // use current time as seed for random generator
-    std::srand(static_cast<uint32_t>(std::time(nullptr)));
-  }
-  ~HippoRand() {
-  }
-};
+// The last SoHal error message is kept per thread, in a fixed size buffer,
+// so that clearing it (which happens on every SendRawMsg) is a single store
+// and does not need any locking. The last kErrorHistoryLen messages of each
+// thread are kept in a ring and can be retrieved with strerror_history().
+const uint32_t kErrorMsgLen = 512;
+const uint32_t kErrorHistoryLen = 8;
+
+typedef struct ThreadErrors {
+  // points to the ring entry with the last error, or to "" once cleared
+  // (NULL before the first error of the thread)
+  const char *last;
+  // total number of errors set in this thread
+  uint32_t num_errors;
+  char history[kErrorHistoryLen][kErrorMsgLen];
+} ThreadErrors;
+
+thread_local ThreadErrors tErrors = {};
 
-std::unordered_map<int, std::string> errorMap;
 const char* GetFileName(uint16_t file_id);
 
+static inline const char *LastError() {
+  return (NULL == tErrors.last) ? "" : tErrors.last;
+}
+
 uint64_t MakeHippoError(HippoFacility facility, HippoError code,
                                uint16_t line, uint16_t fileId) {
   // we need to convert to an hex representation of the line
   // to be consistent with SoHal
-  char line_str[6];
-  (void)itoa(line, line_str, 10);
-  uint32_t line_hex = strtol(line_str, NULL, 16);
-  uint64_t data = ((int32_t)fileId << 16) | (line_hex & 0xffff);
-  uint32_t err = ((0x20000000) |
-                  (facility << 16) |
-                  ((uint32_t)(code)));
-  return (data << 32) | err;
+  return internal::ComposeHippoError(facility, code,
+                                     internal::LineToHex(line), fileId);
 }
 
 const char* strerror() {
-  std::unordered_map<int, std::string>::const_iterator t;
-  t = errorMap.find(GetCurrentThreadId());
-  if (t == errorMap.end()) {
-    return "";
-  }
-  return t->second.c_str();
+  return LastError();
 }
 
 const char* strerror(uint64_t err) {
-  std::unordered_map<int, std::string>::const_iterator t;
-  t = errorMap.find(GetCurrentThreadId());
-  if (t == errorMap.end()) {
+  if ('\0' == LastError()[0]) {
     return HippoErrorMessage(err);
   }
-  return t->second.c_str();
+  return LastError();
+}
+
+uint32_t strerror_history(const char **msgs, uint32_t max_msgs) {
+  if (NULL == msgs) {
+    return 0;
+  }
+  uint32_t num = tErrors.num_errors < kErrorHistoryLen ?
+                 tErrors.num_errors : kErrorHistoryLen;
+  if (num > max_msgs) {
+    num = max_msgs;
+  }
+  // most recent first
+  for (uint32_t i = 0; i < num; i++) {
+    msgs[i] = tErrors.history[(tErrors.num_errors - 1 - i) % kErrorHistoryLen];
+  }
+  return num;
 }
 
 void strerror(uint64_t err, size_t bufsz, char *str) {
@@ -125,13 +129,7 @@ void strerror(uint64_t err, size_t bufsz, char *str) {
   const char *msg = NULL;
   if (NULL == (file_name = GetFileName(file_id))) {
     // it's an internal SoHal file
-    std::unordered_map<int, std::string>::const_iterator t;
-    t = errorMap.find(GetCurrentThreadId());
-    if (t == errorMap.end()) {
-      msg = "";
-    } else {
-      msg = t->second.c_str();
-    }
+    msg = LastError();
     char line_str[6];
     (void)itoa(line_no, line_str, 16);
     snprintf(str, bufsz, "<unknown_file>:%s (%s) '%s'",
@@ -144,93 +142,86 @@ void strerror(uint64_t err, size_t bufsz, char *str) {
   }
 }
 
+uint64_t clearError() {
+  tErrors.last = "";
+  return 0LL;
+}
+
 uint64_t setError(const char *errStr) {
-  uint64_t err = 0LL;
-  try {
-    hippo::errorMap[GetCurrentThreadId()] = std::string(errStr);
-  } catch (...) {
-    err = -1;
+  if (NULL == errStr || '\0' == errStr[0]) {
+    return clearError();
   }
-  return err;
+  char *msg = tErrors.history[tErrors.num_errors % kErrorHistoryLen];
+  // longer messages get truncated
+  snprintf(msg, kErrorMsgLen, "%s", errStr);
+  tErrors.num_errors++;
+  tErrors.last = msg;
+  return 0LL;
 }
 
-uint64_t clearError() {
-  return setError("");
-}
+// reverse index (id -> name) of the source files that can be reported in
+// the error codes: the hiPPo files plus the ones registered by the clients
+// with ADD_FILE_TO_MAP()
+class FileNameMap {
+ public:
+  static FileNameMap& GetInstance(void) {
+    static FileNameMap instance;
+    return instance;
+  }
+  const char *Find(uint16_t file_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<uint16_t, std::string>::const_iterator t;
+    t = names_.find(file_id);
+    if (t == names_.end()) {
+      return NULL;
+    }
+    return t->second.c_str();
+  }
+  // the first file registered with a given id is kept
+  void Add(uint16_t file_id, const char *name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_.emplace(file_id, name);
+  }
 
-static std::unordered_map <std::string, uint16_t> srcFileMap = {
-  { "base64.cc", 0xbb64 },
-  { "capturestage.cc", 0xbbc5 },
-  { "depthcamera.cc", 0xbbdc },
-  { "desklamp.cc", 0xbbd1 },
-  { "hippo.cc", 0xbb00 },
-  { "hippo_camera.cc", 0xbb01 },
-  { "hippo_device.cc", 0xbb0d },
-  { "hippo_swdevice.cc", 0xbb5d },
-  { "hippo_ws.cc", 0xbb55 },
-  { "hirescamera.cc", 0xbbea },
-  { "projector.cc", 0xbb08 },
-  { "projector_types.cc", 0xbb09 },
-  { "sbuttons.cc", 0xbbb0 },
-  { "sohal.cc", 0xbb0a },
-  { "system.cc", 0xbb5e },
-  { "system_types.cc", 0xbb5d },
-  { "touchmat.cc", 0xbba1 },
-  { "uvccamera.cc", 0xbbcc },
+ private:
+  FileNameMap() {
+    for (uint32_t i = 0; i < internal::kNumFileIds; i++) {
+      names_.emplace(internal::kFileIds[i].id, internal::kFileIds[i].name);
+    }
+  }
+  ~FileNameMap() {
+  }
+  std::mutex mutex_;
+  std::unordered_map<uint16_t, std::string> names_;
 };
 
 const char* GetFileName(uint16_t file_id) {
-  std::unordered_map<std::string, uint16_t>::const_iterator file_it;
-  for (file_it = srcFileMap.begin(); file_it != srcFileMap.end(); ++file_it) {
-    if (file_it->second == file_id) {
-      return file_it->first.c_str();
-    }
-  }
-  return NULL;
+  return FileNameMap::GetInstance().Find(file_id);
 }
 
 void AddFileToFileMap(const char *path) {
   if (!path) {
     return;
   }
-  const char *file_name = strrchr(path, '\\');
-  if (!file_name) {
-    file_name = path;
-  } else {
-    file_name++;
-  }
-  std::unordered_map<std::string, uint16_t>::const_iterator t;
-  t = srcFileMap.find(file_name);
-  if (t != srcFileMap.end()) {
-    return;   // already registered
-  }
-  uint16_t id;
-  do {
-    id = HippoRand::GetInstance().Rand();
-  } while (GetFileName(id));
-
-  // fprintf(stderr, "*** %s %x size: %zd\n", file_name, id, srcFileMap.size());
-
-  srcFileMap.insert(std::pair<std::string, uint16_t>(file_name, id));
+  const char *file_name = internal::FileBasename(path, path);
+  // the id is derived from the file name, so that MAKE_HIPPO_ERROR can
+  // compute it at compile time
+  FileNameMap::GetInstance().Add(internal::FileIdFromName(file_name),
+                                 file_name);
 }
 
 uint16_t GetFileId(const char *path) {
-  uint16_t file_not_found = 0xffff;
+  uint16_t file_not_found = internal::kFileIdNotFound;
   if (!path) {
     return file_not_found;
   }
-  const char *file_name = strrchr(path, '\\');
-  if (!file_name) {
-    file_name = path;
-  } else {
-    file_name++;
-  }
-  std::unordered_map<std::string, uint16_t>::const_iterator t;
-  t = srcFileMap.find(file_name);
-  if (t == srcFileMap.end()) {
+  const char *file_name = internal::FileBasename(path, path);
+  uint16_t file_id = internal::FileIdFromName(file_name);
+  const char *registered_name = GetFileName(file_id);
+  if (NULL == registered_name || strcmp(registered_name, file_name)) {
     return file_not_found;
   }
-  return t->second;
+  return file_id;
 }
 
 uint64_t CaptureLock(std::unique_lock<std::mutex> *lock,
@@ -0,0 +1,139 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hippo_arena.h"
+
+namespace hippo {
+
+const size_t kArenaDefaultBlockSize = 4096;
+const size_t kArenaAlignment = 8;
+
+inline size_t ArenaAlign(size_t size) {
+  return (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+}
+
+ResultArena::ResultArena() : ResultArena(kArenaDefaultBlockSize) {
+}
+
+ResultArena::ResultArena(size_t block_size) :
+    head_(NULL), current_(NULL),
+    block_size_(block_size ? ArenaAlign(block_size) : kArenaDefaultBlockSize) {
+}
+
+ResultArena::~ResultArena(void) {
+  Release();
+}
+
+ResultArena::Block *ResultArena::NewBlock(size_t size) {
+  // the block header is stored right before the data
+  Block *block = reinterpret_cast<Block*>(
+      malloc(ArenaAlign(sizeof(Block)) + size));
+  if (NULL == block) {
+    return NULL;
+  }
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+void *ResultArena::Alloc(size_t size) {
+  size = ArenaAlign(size ? size : 1);
+  // look for space in the current block and the ones kept after a Reset()
+  while (NULL != current_ && current_->used + size > current_->size) {
+    if (NULL == current_->next) {
+      break;
+    }
+    current_ = current_->next;
+  }
+  if (NULL == current_ || current_->used + size > current_->size) {
+    Block *block = NewBlock(size > block_size_ ? size : block_size_);
+    if (NULL == block) {
+      return NULL;
+    }
+    if (NULL == head_) {
+      head_ = block;
+    } else {
+      current_->next = block;
+    }
+    current_ = block;
+  }
+  unsigned char *ptr = reinterpret_cast<unsigned char*>(current_) +
+                       ArenaAlign(sizeof(Block)) + current_->used;
+  current_->used += size;
+  return ptr;
+}
+
+void *ResultArena::Calloc(size_t num, size_t size) {
+  if (0 != size && num > ((size_t)-1) / size) {
+    return NULL;
+  }
+  void *ptr = Alloc(num * size);
+  if (NULL != ptr) {
+    memset(ptr, 0, num * size);
+  }
+  return ptr;
+}
+
+char *ResultArena::StrDup(const char *str) {
+  if (NULL == str) {
+    return NULL;
+  }
+  size_t len = strlen(str) + 1;
+  char *ptr = reinterpret_cast<char*>(Alloc(len));
+  if (NULL != ptr) {
+    memcpy(ptr, str, len);
+  }
+  return ptr;
+}
+
+void ResultArena::Reset() {
+  if (NULL == head_) {
+    return;
+  }
+  if (NULL != head_->next) {
+    // the last results needed more than one block: merge all the blocks
+    // into a single one so that the next results fit without allocating.
+    size_t capacity = Capacity();
+    Release();
+    block_size_ = capacity;
+    head_ = NewBlock(block_size_);
+  }
+  if (NULL != head_) {
+    head_->used = 0;
+  }
+  current_ = head_;
+}
+
+void ResultArena::Release() {
+  Block *block = head_;
+  while (NULL != block) {
+    Block *next = block->next;
+    free(block);
+    block = next;
+  }
+  head_ = NULL;
+  current_ = NULL;
+}
+
+size_t ResultArena::Used() const {
+  size_t used = 0;
+  for (Block *block = head_; NULL != block; block = block->next) {
+    used += block->used;
+  }
+  return used;
+}
+
+size_t ResultArena::Capacity() const {
+  size_t capacity = 0;
+  for (Block *block = head_; NULL != block; block = block->next) {
+    capacity += block->size;
+  }
+  return capacity;
+}
+
+}  // namespace hippo
@@ -3,7 +3,14 @@
 // SPDX-License-Identifier: MIT
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
 #include <mutex>   // NOLINT
+#include <deque>
+#include <thread>   // NOLINT
+#include <vector>
 #include "../include/hippo_camera.h"
 #include "../include/hippo_ws.h"
 #include "../include/json.hpp"
@@ -14,20 +21,643 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "camera";
+// the scalar properties
+const char kCameraIndex[] = "camera_index";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
 
+//
+// ring of frames filled by the streaming thread, see start_streaming()
+//
+class FrameRing {
+ public:
+  FrameRing(HippoCamera *camera, const CameraStreams &streams,
+            uint32_t depth, StreamingPolicy policy) :
+      camera_(camera), policy_(policy), slots_(depth), running_(false),
+      stop_(false), err_(0LL), sequence_(0) {
+    FrameCommand cmd = { { 0x50, 0xa1 }, { 0xde, 0xca }, 1, 0, 0, 0 };
+    cmd.stream.value = streams.value;
+    cmd_ = cmd;
+    memset(&stats_, 0, sizeof(stats_));
+    for (auto &slot : slots_) {
+      memset(&slot.frame, 0, sizeof(slot.frame));
+      slot.buffer_size = 0;
+      slot.state = SlotState::free;
+      slot.sequence = 0;
+    }
+  }
+
+  ~FrameRing() {
+    Stop();
+    for (auto &slot : slots_) {
+      free(slot.frame.raw_data_);
+    }
+  }
+
+  void Start() {
+    running_ = true;
+    thread_ = std::thread(&FrameRing::Loop, this);
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    // the request in flight completes with the next frame captured
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  uint64_t Acquire(CameraFrame **frame, uint32_t timeout_ms) {
+    Slot *slot = NULL;
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+      slot = OldestReady();
+      return NULL != slot || !running_;
+    });
+    if (NULL == slot) {
+      if (running_) {
+        return MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_TIMEOUT);
+      }
+      // the error that stopped the streaming thread
+      return err_ ? err_ :
+          MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_WRONG_STATE_ERROR);
+    }
+    slot->state = SlotState::acquired;
+    stats_.acquired++;
+    *frame = &slot->frame;
+    return 0LL;
+  }
+
+  uint64_t Release(CameraFrame *frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto &slot : slots_) {
+      if (&slot.frame == frame && SlotState::acquired == slot.state) {
+        slot.state = SlotState::free;
+        lock.unlock();
+        cv_.notify_all();
+        return 0LL;
+      }
+    }
+    return MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_INVALID_PARAM);
+  }
+
+  void Stats(StreamingStats *get) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memcpy(get, &stats_, sizeof(stats_));
+  }
+
+ private:
+  enum class SlotState {
+    free,
+    filling,      // by the streaming thread
+    ready,        // waiting to be acquired
+    acquired,     // by the application
+  };
+
+  struct Slot {
+    CameraFrame frame;
+    // the size of frame.raw_data_, which can be larger than the frame
+    size_t buffer_size;
+    SlotState state;
+    // the order in which the frames were received
+    uint64_t sequence;
+  };
+
+  void Loop() {
+    const unsigned int kTimeout = 10;   // in seconds
+    // the wait after a failed request, doubled up to the max while failing
+    const uint32_t kMinBackoffMs = 10;
+    const uint32_t kMaxBackoffMs = 1000;
+    uint32_t backoff_ms = kMinBackoffMs;
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot *slot;
+
+    while (NULL != (slot = NextSlot(&lock))) {
+      slot->state = SlotState::filling;
+      lock.unlock();
+      // the frame is received straight into the memory of the slot, which
+      // is only reallocated while it grows to the size of the frames
+      size_t len = 0;
+      uint64_t err = camera_->wsFrames_->SendRequest(
+          reinterpret_cast<const unsigned char*>(&cmd_), sizeof(cmd_),
+          WsConnectionType::BINARY, kTimeout, &slot->frame.raw_data_,
+          &slot->buffer_size, &len);
+      if (!err) {
+        slot->frame.raw_length_ = len;
+        err = camera_->ParseFrame(&slot->frame, len);
+      }
+      lock.lock();
+      // the frames with an error (e.g. the camera isn't streaming) don't
+      // go in the ring either
+      if (err || slot->frame.header->error) {
+        slot->state = SlotState::free;
+        stats_.errors++;
+        if (err && !camera_->wsFrames_->Connected()) {
+          err_ = err;
+          break;
+        }
+        // don't hammer SoHal with requests that keep failing
+        cv_.wait_for(lock, std::chrono::milliseconds(backoff_ms),
+                     [this] { return stop_; });
+        backoff_ms = std::min(2 * backoff_ms, kMaxBackoffMs);
+        continue;
+      }
+      backoff_ms = kMinBackoffMs;
+      slot->state = SlotState::ready;
+      slot->sequence = sequence_++;
+      stats_.received++;
+      cv_.notify_all();
+    }
+    running_ = false;
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  // returns the slot to fill next, or NULL when stopping. Expects the lock
+  // on mutex_ to be captured
+  Slot *NextSlot(std::unique_lock<std::mutex> *lock) {
+    while (!stop_) {
+      for (auto &slot : slots_) {
+        if (SlotState::free == slot.state) {
+          return &slot;
+        }
+      }
+      Slot *oldest = OldestReady();
+      if (NULL != oldest && StreamingPolicy::drop_oldest == policy_) {
+        stats_.dropped++;
+        return oldest;
+      }
+      // all the frames are acquired, or waiting to be
+      cv_.wait(*lock);
+    }
+    return NULL;
+  }
+
+  // Expects the lock on mutex_ to be captured
+  Slot *OldestReady() {
+    Slot *oldest = NULL;
+    for (auto &slot : slots_) {
+      if (SlotState::ready == slot.state &&
+          (NULL == oldest || slot.sequence < oldest->sequence)) {
+        oldest = &slot;
+      }
+    }
+    return oldest;
+  }
+
+  HippoCamera *camera_;
+  FrameCommand cmd_;
+  StreamingPolicy policy_;
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool running_;
+  bool stop_;
+  // the error that stopped the streaming thread
+  uint64_t err_;
+  uint64_t sequence_;
+  StreamingStats stats_;
+};
+
+
+//
+// a frame of a FramePool, referenced by FrameHandles
+//
+struct PooledFrame {
+  CameraFrame frame;
+  // the size of frame.raw_data_, which can be larger than the frame
+  size_t buffer_size;
+  std::atomic<uint32_t> refs;
+  FramePool *pool;
+};
+
+//
+// recycles the buffers of the frames grabbed into FrameHandles. The pool is
+// reference counted by its camera and by each of its frames in use, so it
+// goes away with the last of them
+//
+class FramePool {
+ public:
+  FramePool() : refs_(1), frame_size_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  void AddRef() {
+    refs_++;
+  }
+
+  void Release() {
+    if (0 == --refs_) {
+      delete this;
+    }
+  }
+
+  // returns a frame with a single reference and a buffer that fits the
+  // frames grabbed so far, or NULL if it can't be allocated
+  PooledFrame *Get() {
+    PooledFrame *frame = NULL;
+    size_t frame_size = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!free_.empty()) {
+        frame = free_.back();
+        free_.pop_back();
+        stats_.recycled++;
+      }
+      frame_size = frame_size_;
+    }
+    if (NULL == frame) {
+      if (NULL == (frame = new (std::nothrow)PooledFrame)) {
+        return NULL;
+      }
+      memset(&frame->frame, 0, sizeof(frame->frame));
+      frame->buffer_size = 0;
+      frame->pool = this;
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.allocated++;
+    }
+    // the websocket layer needs a byte more than the frame
+    if (frame->buffer_size < frame_size + 1) {
+      uint8_t *ptr = reinterpret_cast<uint8_t*>(
+          realloc(frame->frame.raw_data_, frame_size + 1));
+      if (NULL == ptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(frame);
+        return NULL;
+      }
+      frame->frame.raw_data_ = ptr;
+      frame->buffer_size = frame_size + 1;
+    }
+    frame->refs = 1;
+    AddRef();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.in_use++;
+    return frame;
+  }
+
+  // called when the last reference to |frame| goes away
+  void Put(PooledFrame *frame) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.in_use--;
+      free_.push_back(frame);
+    }
+    Release();
+  }
+
+  void SetFrameSize(size_t frame_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frame_size > frame_size_) {
+      frame_size_ = frame_size;
+    }
+  }
+
+  void Stats(FramePoolStats *get) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memcpy(get, &stats_, sizeof(stats_));
+    get->frame_size = frame_size_;
+  }
+
+ private:
+  ~FramePool() {
+    for (auto frame : free_) {
+      free(frame->frame.raw_data_);
+      delete frame;
+    }
+  }
+
+  std::atomic<uint32_t> refs_;
+  std::mutex mutex_;
+  std::vector<PooledFrame*> free_;
+  size_t frame_size_;
+  FramePoolStats stats_;
+};
+
+FrameHandle::FrameHandle() : frame_(NULL) {
+}
+
+FrameHandle::FrameHandle(PooledFrame *frame) : frame_(frame) {
+}
+
+FrameHandle::FrameHandle(const FrameHandle &other) : frame_(other.frame_) {
+  if (NULL != frame_) {
+    frame_->refs++;
+  }
+}
+
+FrameHandle &FrameHandle::operator=(const FrameHandle &other) {
+  if (frame_ != other.frame_) {
+    if (NULL != other.frame_) {
+      other.frame_->refs++;
+    }
+    Reset();
+    frame_ = other.frame_;
+  }
+  return *this;
+}
+
+FrameHandle::~FrameHandle(void) {
+  Reset();
+}
+
+void FrameHandle::Reset() {
+  if (NULL != frame_ && 0 == --frame_->refs) {
+    frame_->pool->Put(frame_);
+  }
+  frame_ = NULL;
+}
+
+const CameraFrame *FrameHandle::get() const {
+  return (NULL != frame_) ? &frame_->frame : NULL;
+}
+
+const CameraFrame *FrameHandle::operator->() const {
+  return get();
+}
+
+uint32_t FrameHandle::use_count() const {
+  return (NULL != frame_) ? frame_->refs.load() : 0;
+}
+
+//
+// a grab_frame_async() request, referenced by its FrameFutures and by the
+// connection it was queued on
+//
+struct AsyncGrab {
+  std::atomic<uint32_t> refs;
+  CameraStreams streams;
+  HippoFacility facility;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done;
+  uint64_t err;
+  FrameHandle frame;
+
+  void Release() {
+    if (0 == --refs) {
+      delete this;
+    }
+  }
+
+  void Complete(uint64_t error, const FrameHandle &result) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      err = error;
+      frame = result;
+      done = true;
+    }
+    cv.notify_all();
+  }
+};
+
+//
+// the connections to the frame server used by grab_frame_async(). Each one
+// has a thread sending its queued requests one after the other, and the
+// requests alternate between them, so one connection is already waiting for
+// the next frame while the other one receives the current frame
+//
+class AsyncGrabber {
+ public:
+  static const uint32_t kNumConnections = 2;
+
+  explicit AsyncGrabber(HippoCamera *camera) :
+      camera_(camera), stop_(false), next_(0), last_timestamp_(0) {
+    for (auto &conn : conns_) {
+      conn.ws = NULL;
+    }
+  }
+
+  ~AsyncGrabber() {
+    Stop();
+  }
+
+  uint64_t Start(const char *host, uint32_t port) {
+    uint64_t err = 0LL;
+    for (auto &conn : conns_) {
+      if (NULL == (conn.ws = new (std::nothrow)HippoWS(camera_->facility_))) {
+        return MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_MEM_ALLOC);
+      }
+      if (err = conn.ws->Connect(host, port, WsConnectionType::BINARY,
+                                 1024)) {
+        return err;
+      }
+    }
+    for (auto &conn : conns_) {
+      conn.thread = std::thread(&AsyncGrabber::Loop, this, &conn);
+    }
+    return err;
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &conn : conns_) {
+      // cancels the request in flight
+      if (NULL != conn.ws && conn.ws->Connected()) {
+        (void)conn.ws->StopSignalLoop();
+      }
+    }
+    for (auto &conn : conns_) {
+      if (conn.thread.joinable()) {
+        conn.thread.join();
+      }
+      if (NULL != conn.ws) {
+        if (conn.ws->Connected()) {
+          (void)conn.ws->Disconnect();
+        }
+        delete conn.ws;
+        conn.ws = NULL;
+      }
+    }
+  }
+
+  uint64_t Submit(const CameraStreams &streams, FrameFuture *future) {
+    AsyncGrab *grab = new (std::nothrow)AsyncGrab;
+    if (NULL == grab) {
+      return MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_MEM_ALLOC);
+    }
+    // referenced by the future and by the connection
+    grab->refs = 2;
+    grab->streams = streams;
+    grab->facility = camera_->facility_;
+    grab->done = false;
+    grab->err = 0LL;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      conns_[next_++ % kNumConnections].queue.push_back(grab);
+    }
+    cv_.notify_all();
+    *future = FrameFuture(grab);
+    // the assignment added its own reference
+    grab->Release();
+
+    return 0LL;
+  }
+
+ private:
+  struct Connection {
+    HippoWS *ws;
+    std::thread thread;
+    std::deque<AsyncGrab*> queue;
+  };
+
+  void Loop(Connection *conn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this, conn] {
+        return stop_ || !conn->queue.empty();
+      });
+      if (stop_) {
+        break;
+      }
+      AsyncGrab *grab = conn->queue.front();
+      lock.unlock();
+      FrameHandle frame;
+      uint64_t err = Grab(conn->ws, grab->streams, &frame);
+      lock.lock();
+      conn->queue.pop_front();
+      grab->Complete(err, frame);
+      grab->Release();
+    }
+    // the requests not sent are cancelled
+    for (auto grab : conn->queue) {
+      grab->Complete(MAKE_HIPPO_ERROR(camera_->facility_, HIPPO_CANCEL),
+                     FrameHandle());
+      grab->Release();
+    }
+    conn->queue.clear();
+  }
+
+  // grabs a frame newer than the last one grabbed on any connection: when
+  // both connections wait for the next frame, both get the same one
+  uint64_t Grab(HippoWS *ws, const CameraStreams &streams,
+                FrameHandle *frame) {
+    const uint32_t kMaxRetries = 2;
+    uint64_t err = 0LL;
+    for (uint32_t i = 0; ; i++) {
+      if (err = camera_->GrabPooledFrame(ws, streams, frame)) {
+        return err;
+      }
+      uint64_t timestamp = Timestamp(*frame->get());
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (0 == timestamp || timestamp > last_timestamp_ || kMaxRetries == i) {
+        if (timestamp > last_timestamp_) {
+          last_timestamp_ = timestamp;
+        }
+        return err;
+      }
+    }
+  }
+
+  // the capture time of the first stream of |frame|, 0 for an error frame
+  static uint64_t Timestamp(const CameraFrame &frame) {
+    if (frame.header->error) {
+      return 0;
+    }
+    for (uint32_t i = 0; i < kMaxNumStreams; i++) {
+      if (frame.header->stream.value & (1 << i)) {
+        return frame.streams[i].header->timestamp;
+      }
+    }
+    return 0;
+  }
+
+  HippoCamera *camera_;
+  Connection conns_[kNumConnections];
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+  // the connection of the next request
+  uint32_t next_;
+  uint64_t last_timestamp_;
+};
+
+FrameFuture::FrameFuture() : grab_(NULL) {
+}
+
+FrameFuture::FrameFuture(AsyncGrab *grab) : grab_(grab) {
+}
+
+FrameFuture::FrameFuture(const FrameFuture &other) : grab_(other.grab_) {
+  if (NULL != grab_) {
+    grab_->refs++;
+  }
+}
+
+FrameFuture &FrameFuture::operator=(const FrameFuture &other) {
+  if (grab_ != other.grab_) {
+    if (NULL != other.grab_) {
+      other.grab_->refs++;
+    }
+    Reset();
+    grab_ = other.grab_;
+  }
+  return *this;
+}
+
+FrameFuture::~FrameFuture(void) {
+  Reset();
+}
+
+void FrameFuture::Reset() {
+  if (NULL != grab_) {
+    grab_->Release();
+  }
+  grab_ = NULL;
+}
+
+bool FrameFuture::ready() const {
+  if (NULL == grab_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(grab_->mutex);
+  return grab_->done;
+}
+
+uint64_t FrameFuture::wait(uint32_t timeout_ms, FrameHandle *frame) {
+  if (NULL == grab_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  std::unique_lock<std::mutex> lock(grab_->mutex);
+  if (!grab_->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [this] { return grab_->done; })) {
+    return MAKE_HIPPO_ERROR(grab_->facility, HIPPO_TIMEOUT);
+  }
+  if (grab_->err) {
+    return grab_->err;
+  }
+  if (NULL != frame) {
+    *frame = grab_->frame;
+  }
+  return 0LL;
+}
 
 HippoCamera::HippoCamera(const char *dev, const char *address, uint32_t port,
                          HippoFacility facility, uint32_t device_index) :
     HippoDevice(dev, address, port, facility, device_index),
-    wsFrames_(NULL) {
+    wsFrames_(NULL), ring_(NULL), pool_(NULL), async_(NULL),
+    frames_port_(0) {
+  memset(&last_streaming_stats_, 0, sizeof(last_streaming_stats_));
 }
 
 HippoCamera::~HippoCamera(void) {
+  (void)stop_streaming();
+  StopAsyncGrabs();
   if (wsFrames_) {
     DisconnectFrames();
   }
+  // the frames still referenced keep the pool alive
+  if (pool_) {
+    pool_->Release();
+  }
 }
 
 bool HippoCamera::IsConnectedFrames() {
@@ -47,6 +677,7 @@ uint64_t HippoCamera::ConnectFrames(uint32_t port) {
     return MAKE_HIPPO_ERROR(facility_,
                             HIPPO_MEM_ALLOC);
   }
+  frames_port_ = port;
   return wsFrames_->Connect(host_, port, WsConnectionType::BINARY, 1024);
 }
 
@@ -61,7 +692,7 @@ void HippoCamera::DisconnectFrames() {
 }
 
 uint64_t HippoCamera::camera_index(uint32_t *get) {
-  return uint32_get("camera_index", get);
+  return property<uint32_t, kCameraIndex>(get);
 }
 
 uint64_t HippoCamera::enable_streams(const CameraStreams &set) {
@@ -76,7 +707,7 @@ uint64_t HippoCamera::enable_streams(EnableStream *get) {
   if (NULL == get) {
     MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  if (err = SendRawMsg("enable_streams", jptr)) {
+  if (err = SendReadMsg("enable_streams", jptr)) {
     return err;
   }
   if (err = EnableStream_json2c(jptr, get)) {
@@ -123,7 +754,7 @@ uint64_t HippoCamera::disable_streams(CameraStreams *get) {
   if (NULL == get) {
     MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  if (err = SendRawMsg("disable_streams", jptr)) {
+  if (err = SendReadMsg("disable_streams", jptr)) {
     return err;
   }
   if (err = CameraStreams_json2c(jptr, get)) {
@@ -153,6 +784,8 @@ uint64_t HippoCamera::disable_streams(const CameraStreams &set,
     memcpy(get, &st, sizeof(st));
   }
   if (wsFrames_ && (0 == st.value)) {
+    (void)stop_streaming();
+    StopAsyncGrabs();
     DisconnectFrames();
   }
   return 0LL;
@@ -273,6 +906,10 @@ uint64_t HippoCamera::grab_frame(const FrameCommand &cmd,
   size_t res_len = 0;
   unsigned char *response = NULL;
 
+  // the frames are requested by the streaming thread
+  if (NULL != ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
   int timeout = 10;
   if (err = wsFrames_->SendRequest(reinterpret_cast<const unsigned char*>(&cmd),
                                    sizeof(FrameCommand),
@@ -286,8 +923,22 @@ uint64_t HippoCamera::grab_frame(const FrameCommand &cmd,
   if (NULL == frame->raw_data_) {
     frame->raw_data_ = reinterpret_cast<uint8_t*>(response);
     frame->raw_length_ = res_len;
-  } else {
+  } else if (res_len <= frame->raw_length_) {
     memcpy(frame->raw_data_, response, res_len);
+  } else {
+    // the caller's buffer is too small for the frame
+    free(response);
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (response != reinterpret_cast<unsigned char*>(frame->raw_data_)) {
+    free(response);
+  }
+  return ParseFrame(frame, res_len);
+}
+
+uint64_t HippoCamera::ParseFrame(CameraFrame *frame, size_t len) {
+  if (len < sizeof(FrameHeader) + sizeof(StreamHeader)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
   }
   frame->header = reinterpret_cast<FrameHeader*>(frame->raw_data_);
 
@@ -297,26 +948,204 @@ uint64_t HippoCamera::grab_frame(const FrameCommand &cmd,
         reinterpret_cast<ErrorCode*>(frame->raw_data_ + idx);
   } else {
     for (uint32_t i = frame->header->stream.value, ii = 0;
-         i > 0;
+         i > 0 && ii < kMaxNumStreams;
          i >>= 1, ii++) {
       if (i & 0x01) {
+        if (len - idx < sizeof(StreamHeader)) {
+          return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
+        }
         // asign the Stream header
         frame->streams[ii].header =
             reinterpret_cast<StreamHeader*>(frame->raw_data_ + idx);
         idx += sizeof(StreamHeader);
         size_t size = GetDataLen(frame->streams[ii].header);
-        // size_t size = (frame->streams[ii].header->width *
-        //                frame->streams[ii].header->height *
-        //                BytesPerPixel(static_cast<PixelFormat>(
-        //                    frame->streams[ii].header->format)));
+        if (len - idx < size) {
+          return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
+        }
         // asign the data
-        frame->streams[ii].data = reinterpret_cast<uint8_t*>(response + idx);
+        frame->streams[ii].data = frame->raw_data_ + idx;
         idx += size;
       }
     }
   }
-  if (response != reinterpret_cast<unsigned char*>(frame->raw_data_)) {
-    free(response);
+  return 0LL;
+}
+
+size_t HippoCamera::GetFrameLen(const CameraFrame &frame) {
+  size_t len = sizeof(FrameHeader);
+  if (frame.header->error) {
+    return len + sizeof(ErrorCode);
+  }
+  for (uint32_t i = frame.header->stream.value, ii = 0;
+       i > 0 && ii < kMaxNumStreams;
+       i >>= 1, ii++) {
+    if (i & 0x01) {
+      len += sizeof(StreamHeader) + GetDataLen(frame.streams[ii].header);
+    }
+  }
+  return len;
+}
+
+uint64_t HippoCamera::grab_frame(const CameraStreams &streams,
+                                 FrameHandle *frame) {
+  if (NULL == frame) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  // the streams must be enabled, and not streaming
+  if (!IsConnectedFrames() || NULL != ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == pool_ && NULL == (pool_ = new (std::nothrow)FramePool())) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  return GrabPooledFrame(wsFrames_, streams, frame);
+}
+
+uint64_t HippoCamera::grab_frame_async(const CameraStreams &streams,
+                                       FrameFuture *future) {
+  uint64_t err = 0LL;
+
+  if (NULL == future) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  // the streams must be enabled
+  if (!IsConnectedFrames()) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == pool_ && NULL == (pool_ = new (std::nothrow)FramePool())) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  if (NULL == async_) {
+    if (NULL == (async_ = new (std::nothrow)AsyncGrabber(this))) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+    }
+    if (err = async_->Start(host_, frames_port_)) {
+      StopAsyncGrabs();
+      return err;
+    }
+  }
+  return async_->Submit(streams, future);
+}
+
+void HippoCamera::StopAsyncGrabs() {
+  // the requests not completed yet fail with HIPPO_CANCEL
+  if (NULL != async_) {
+    delete async_;
+    async_ = NULL;
+  }
+}
+
+uint64_t HippoCamera::GrabPooledFrame(HippoWS *ws,
+                                      const CameraStreams &streams,
+                                      FrameHandle *frame) {
+  uint64_t err = 0LL;
+  size_t res_len = 0;
+  unsigned int timeout = 10;
+
+  PooledFrame *pooled = pool_->Get();
+  if (NULL == pooled) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  // the frame goes back to the pool with this handle if anything fails
+  FrameHandle handle(pooled);
+
+  FrameCommand cmd = { { 0x50, 0xa1 }, { 0xde, 0xca }, 1, 0, 0, 0 };
+  cmd.stream.value = streams.value;
+  if (err = ws->SendRequest(reinterpret_cast<const unsigned char*>(&cmd),
+                            sizeof(FrameCommand),
+                            WsConnectionType::BINARY, timeout,
+                            &pooled->frame.raw_data_,
+                            &pooled->buffer_size, &res_len)) {
+    return err;
+  }
+  pooled->frame.raw_length_ = res_len;
+  if (err = ParseFrame(&pooled->frame, res_len)) {
+    return err;
+  }
+  // the next buffers are allocated at the size of the frames
+  pool_->SetFrameSize(GetFrameLen(pooled->frame));
+  *frame = handle;
+
+  return 0LL;
+}
+
+uint64_t HippoCamera::frame_pool_stats(FramePoolStats *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == pool_) {
+    memset(get, 0, sizeof(*get));
+  } else {
+    pool_->Stats(get);
+  }
+  return 0LL;
+}
+
+uint64_t HippoCamera::start_streaming(const CameraStreams &streams,
+                                      uint32_t ring_depth) {
+  return start_streaming(streams, ring_depth, StreamingPolicy::drop_oldest);
+}
+
+uint64_t HippoCamera::start_streaming(const CameraStreams &streams,
+                                      uint32_t ring_depth,
+                                      StreamingPolicy policy) {
+  if (0 == streams.value || 0 == ring_depth) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  // the streams must be enabled, and not streaming already
+  if (!IsConnectedFrames() || NULL != ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == (ring_ = new (std::nothrow)FrameRing(this, streams, ring_depth,
+                                                   policy))) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  ring_->Start();
+
+  return 0LL;
+}
+
+uint64_t HippoCamera::acquire_frame(CameraFrame **frame,
+                                    uint32_t timeout_ms) {
+  if (NULL == frame) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_NOT_STREAMING);
+  }
+  return ring_->Acquire(frame, timeout_ms);
+}
+
+uint64_t HippoCamera::release_frame(CameraFrame *frame) {
+  if (NULL == frame) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_NOT_STREAMING);
+  }
+  return ring_->Release(frame);
+}
+
+uint64_t HippoCamera::stop_streaming() {
+  if (NULL == ring_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_NOT_STREAMING);
+  }
+  ring_->Stop();
+  ring_->Stats(&last_streaming_stats_);
+  delete ring_;
+  ring_ = NULL;
+
+  return 0LL;
+}
+
+uint64_t HippoCamera::streaming_stats(StreamingStats *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL != ring_) {
+    ring_->Stats(get);
+  } else {
+    memcpy(get, &last_streaming_stats_, sizeof(last_streaming_stats_));
   }
   return 0LL;
 }
@@ -6,17 +6,29 @@
 #include <windows.h>   // for GetCurrentThreadId
 #include <tchar.h>
 
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <atomic>
+#include <condition_variable>   // NOLINT
+#include <functional>
+#include <memory>
 #include <mutex>   // NOLINT
+#include <string>
 #include <thread>   // NOLINT
+#include <unordered_map>
+#include <vector>
 #include <algorithm>    // std::min
 
 #include "../include/hippo_device.h"
+#include "../include/hippo_dispatcher.h"
+#include "../include/hippo_reactor.h"
 #include "../include/hippo_ws.h"
 #include "../include/json.hpp"
+#include "../include/scalar_codec.h"
 
 namespace nl = nlohmann;
 
@@ -33,12 +45,346 @@ uint32_t defaultPort = 20641;
 extern uint64_t clearError();
 extern uint64_t setError(const char *errStr);
 
+// ReadCoalescer implements the single-flight coalescing of the reads of a
+// device: while a read is in flight, identical reads (same key) from other
+// threads wait for it and get a copy of its result instead of sending their
+// own request to SoHal.
+class ReadCoalescer {
+ public:
+  ReadCoalescer() : enabled_(false) {
+  }
+
+  void Enable(bool enable) {
+    enabled_ = enable;
+  }
+
+  bool Enabled() {
+    return enabled_;
+  }
+
+  // calls |read| to fill |result| unless an identical read is in flight,
+  // in which case it waits for that one to finish and copies its result.
+  uint64_t Read(const std::string &key, nl::json *result,
+                const std::function<uint64_t(nl::json*)> &read) {
+    std::shared_ptr<InFlight> flight;
+    bool leader = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = in_flight_.find(key);
+      if (it == in_flight_.end()) {
+        flight = std::make_shared<InFlight>();
+        in_flight_[key] = flight;
+        leader = true;
+      } else {
+        flight = it->second;
+        flight->num_waiters++;
+      }
+    }
+    if (leader) {
+      uint64_t err = read(result);
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_.erase(key);
+      flight->err = err;
+      // only copy the result if someone is waiting for it
+      if (flight->num_waiters > 0) {
+        if (err) {
+          flight->error_msg = hippo::strerror();
+        } else {
+          flight->result = *result;
+        }
+      }
+      flight->done = true;
+      flight->condition.notify_all();
+      return err;
+    }
+    hippo::clearError();
+    std::unique_lock<std::mutex> lock(mutex_);
+    flight->condition.wait(lock, [&flight] { return flight->done; });
+    if (flight->err) {
+      setError(flight->error_msg.c_str());
+      return flight->err;
+    }
+    *result = flight->result;
+    return HIPPO_OK;
+  }
+
+ private:
+  typedef struct InFlight {
+    InFlight() : done(false), err(0LL), num_waiters(0) {
+    }
+    std::condition_variable condition;
+    bool done;
+    uint64_t err;
+    uint32_t num_waiters;
+    nl::json result;
+    std::string error_msg;
+  } InFlight;
+
+  std::atomic<bool> enabled_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<InFlight>> in_flight_;
+};
+
+
+// the notifications after which none of the cached values can be trusted
+static const char *kStateCacheResets[] = {
+  "on_close", "on_device_connected", "on_device_disconnected",
+  "on_factory_default", "on_open", "on_resume", "on_sohal_connected",
+  "on_sohal_disconnected", "on_suspend",
+};
+
+// StateCache keeps the last known value of the properties of a device that
+// SoHal notifies when they change (i.e. "brightness" and "on_brightness"),
+// so that their getters don't need a round trip while the device is
+// subscribed. Every change of a cached value gets a new generation, which
+// lets a value read from SoHal be dropped if a newer one was notified while
+// the read was in flight.
+class StateCache {
+ public:
+  StateCache() : mode_(StateCacheMode::disabled), max_age_us_(0),
+      subscribed_(false), names_(NULL), num_names_(0), generation_(0),
+      hits_(0), misses_(0), notified_(0), invalidated_(0) {
+  }
+
+  void SetMode(StateCacheMode mode, uint32_t max_age_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mode_ = mode;
+    max_age_us_ = 1000LL * max_age_ms;
+    if (StateCacheMode::disabled == mode) {
+      entries_.clear();
+      generation_++;
+    }
+  }
+
+  bool Enabled() {
+    return StateCacheMode::disabled != mode_;
+  }
+
+  // called after subscribing (or unsubscribing), with the names of the
+  // device's notifications in the order of the bits of its subscribe mask
+  void Subscribed(bool subscribed, const char **names, uint32_t num_names) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribed_ = subscribed;
+    if (NULL != names) {
+      names_ = names;
+      num_names_ = num_names;
+      for (auto &entry : entries_) {
+        entry.second.bit = Bit(entry.first.c_str());
+      }
+    }
+    // nothing kept the values current while not subscribed (or while the
+    // mask was different)
+    for (auto &entry : entries_) {
+      Invalidate(&entry.second);
+    }
+  }
+
+  // copies the cached value of |property| in |value| if it can be used,
+  // and returns in |stamp| the generation to pass to Put() along with the
+  // value read from SoHal otherwise
+  bool Get(const char *property, uint64_t mask, nl::json *value,
+           uint64_t *stamp) {
+    *stamp = 0;
+    if (!Enabled()) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(property);
+    if (it == entries_.end()) {
+      misses_++;
+      return false;
+    }
+    Entry &entry = it->second;
+    *stamp = entry.generation;
+    if (StateCacheMode::cached != mode_ || !subscribed_ || !entry.valid ||
+        entry.bit < 0 || 0 == (mask & (1ULL << entry.bit)) ||
+        (max_age_us_ > 0 && SteadyTimeUs() - entry.updated_us > max_age_us_)) {
+      misses_++;
+      return false;
+    }
+    *value = entry.value;
+    hits_++;
+    return true;
+  }
+
+  // returns the generation to pass to Put() along with the value returned
+  // by a set of |property|
+  uint64_t Stamp(const char *property) {
+    if (!Enabled()) {
+      return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(property);
+    return (it == entries_.end()) ? 0 : it->second.generation;
+  }
+
+  // stores the |value| of |property| read from SoHal, unless the cached
+  // value changed since Get() or Stamp() returned |stamp|
+  void Put(const char *property, const nl::json &value, uint64_t stamp) {
+    if (!Enabled()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(property);
+    if (it == entries_.end()) {
+      int32_t bit = Bit(property);
+      // SoHal would not notify the changes of the property
+      if (0 != stamp || bit < 0) {
+        return;
+      }
+      it = entries_.emplace(property, Entry()).first;
+      it->second.bit = bit;
+    } else if (it->second.generation != stamp) {
+      return;
+    }
+    Update(&it->second, value, false);
+  }
+
+  // called from the reactor thread for each notification of the device:
+  // only the properties already cached are updated
+  void Notify(const char *method, const nl::json *params) {
+    if (!Enabled() || strncmp(method, "on_", 3)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto reset : kStateCacheResets) {
+      if (!strcmp(reset, method)) {
+        for (auto &entry : entries_) {
+          Invalidate(&entry.second);
+        }
+        return;
+      }
+    }
+    auto it = entries_.find(method + 3);
+    if (it == entries_.end()) {
+      return;
+    }
+    if (NULL != params && params->is_array() && !params->empty()) {
+      Update(&it->second, params->at(0), true);
+      notified_++;
+    } else {
+      Invalidate(&it->second);
+    }
+  }
+
+  // called after a set of |property| that does not return its new value
+  void Invalidate(const char *property) {
+    if (!Enabled()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(property);
+    if (it != entries_.end()) {
+      Invalidate(&it->second);
+    }
+  }
+
+  std::vector<std::string> Properties() {
+    std::vector<std::string> properties;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &entry : entries_) {
+      properties.push_back(entry.first);
+    }
+    return properties;
+  }
+
+  bool GetEntry(const char *property, StateCacheEntry *info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(property);
+    if (it == entries_.end() || !it->second.valid) {
+      return false;
+    }
+    info->generation = it->second.generation;
+    info->age_us = SteadyTimeUs() - it->second.updated_us;
+    info->notified = it->second.notified;
+    return true;
+  }
+
+  void GetStats(StateCacheStats *stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats->generation = generation_;
+    stats->hits = hits_;
+    stats->misses = misses_;
+    stats->notified = notified_;
+    stats->invalidated = invalidated_;
+  }
+
+ private:
+  typedef struct Entry {
+    Entry() : valid(false), notified(false), bit(-1), generation(0),
+              updated_us(0) {
+    }
+    nl::json value;
+    bool valid;
+    bool notified;
+    // the bit of the property's notification in the subscribe mask
+    int32_t bit;
+    uint64_t generation;
+    int64_t updated_us;
+  } Entry;
+
+  // returns the bit of the "on_<property>" notification, or -1 if the
+  // device has none, the mutex must be captured
+  int32_t Bit(const char *property) {
+    for (uint32_t i = 0; NULL != names_ && i < num_names_ && i < 64; i++) {
+      if (!strncmp(names_[i], "on_", 3) && !strcmp(names_[i] + 3, property)) {
+        return static_cast<int32_t>(i);
+      }
+    }
+    return -1;
+  }
+
+  // the mutex must be captured
+  void Update(Entry *entry, const nl::json &value, bool notified) {
+    entry->value = value;
+    entry->valid = true;
+    entry->notified = notified;
+    entry->generation = ++generation_;
+    entry->updated_us = SteadyTimeUs();
+  }
+
+  // the mutex must be captured
+  void Invalidate(Entry *entry) {
+    if (entry->valid) {
+      entry->valid = false;
+      invalidated_++;
+    }
+    // a read in flight must not store the value it gets
+    entry->generation = ++generation_;
+  }
+
+  std::atomic<StateCacheMode> mode_;
+  int64_t max_age_us_;
+  bool subscribed_;
+  const char **names_;
+  uint32_t num_names_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t generation_;
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t notified_;
+  uint64_t invalidated_;
+};
 
 HippoDevice::HippoDevice(const char *dev, const char *host, uint32_t port,
                          HippoFacility facility, uint32_t device_index) :
-    device_index_(device_index), ws_(NULL), wsSig_(NULL), module_(NULL), id_(0),
-    port_(port), facility_(facility), signal_th_(NULL) {
+    device_index_(device_index), ws_(NULL), module_(NULL), id_(0),
+    port_(port), facility_(facility), reactor_(NULL), poll_queue_(NULL),
+    polling_(false),
+    coalescer_(new (std::nothrow) ReadCoalescer()),
+    state_cache_(new (std::nothrow) StateCache()),
+    notification_mask_(ALL_NOTIFICATIONS), notification_names_(NULL),
+    num_notification_names_(0), filtered_(0), signal_queue_(NULL),
+    scalar_response_(NULL), scalar_response_size_(0) {
   snprintf(devName_, sizeof(devName_), "%s@%d", dev, device_index_);
+  // the queue is created up front so that the notification policies can be
+  // set before subscribing
+  SignalDispatcher::GetInstance().Register(this, &signal_queue_);
+  // the button presses and touches must not wait behind bulk notifications
+  if (HIPPO_SBUTTONS == facility || HIPPO_TOUCHMAT == facility) {
+    (void)notification_priority(NotificationPriority::high);
+  }
   if (host) {
     snprintf(host_, sizeof(host_), "%s", host);
   } else {
@@ -48,20 +394,23 @@ HippoDevice::HippoDevice(const char *dev, const char *host, uint32_t port,
 
 HippoDevice::~HippoDevice(void) {
   Disconnect();
+  // the reactor does not route anything to this device anymore, drop the
+  // notifications not delivered yet
+  SignalDispatcher::GetInstance().Unregister(signal_queue_);
+  delete poll_queue_;
+  free(scalar_response_);
+  delete coalescer_;
+  delete state_cache_;
 }
 
 bool HippoDevice::IsConnected() {
-  return IsConnectedWs() || IsConnectedWsSig();
+  return IsConnectedWs() || (NULL != reactor_);
 }
 
 bool HippoDevice::IsConnectedWs() {
   return (NULL == ws_) ? false : ws_->Connected();
 }
 
-bool HippoDevice::IsConnectedWsSig() {
-  return (NULL == wsSig_) ? false : wsSig_->Connected();
-}
-
 uint64_t HippoDevice::EnsureConnected() {
   uint64_t err = 0LL;
   if (!IsConnectedWs()) {
@@ -92,18 +441,11 @@ void HippoDevice::Disconnect() {
     delete ws_;
     ws_ = NULL;
   }
-  if (IsConnectedWsSig()) {
-    // stop waiting for signals
-    if (!wsSig_->StopSignalLoop()) {
-      // and wait for the signal thread to finish
-      signal_th_->join();
-      // then delete the allocated memory
-      delete signal_th_;
-      signal_th_ = NULL;
-    }
-    wsSig_->Disconnect();
-    delete wsSig_;
-    wsSig_ = NULL;
+  if (NULL != reactor_) {
+    // don't wait for the unsubscribe response, the device is going away
+    (void)NotificationReactor::Unsubscribe(this, reactor_, false, NULL);
+    reactor_ = NULL;
+    SignalDispatcher::GetInstance().SetSubscribed(signal_queue_, false);
   }
 }
 
@@ -114,6 +456,10 @@ uint64_t HippoDevice::factory_default() {
 }
 
 uint64_t HippoDevice::info(DeviceInfo *get) {
+  return info(get, NULL);
+}
+
+uint64_t HippoDevice::info(DeviceInfo *get, ResultArena *arena) {
   if (NULL == get) {
     return  MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
@@ -121,10 +467,10 @@ uint64_t HippoDevice::info(DeviceInfo *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("info", jptr)) {
+  if (err = SendReadMsg("info", jptr)) {
     return err;
   }
-  return deviceInfo_json2c(jptr, get);
+  return deviceInfo_json2c(jptr, get, arena);
 }
 
 uint64_t HippoDevice::is_device_connected(bool *get) {
@@ -148,7 +494,8 @@ uint64_t HippoDevice::open() {
 }
 
 uint64_t HippoDevice::open(uint32_t *open_count) {
-  return uint32_get("open", open_count);
+  // not a read, so it must never be coalesced
+  return SendScalarMsg_p<uint32_t>("open", NULL, open_count);
 }
 
 uint64_t HippoDevice::open_count(uint32_t *open_count) {
@@ -161,77 +508,65 @@ uint64_t HippoDevice::close() {
 }
 
 uint64_t HippoDevice::close(uint32_t *open_count) {
-  return uint32_get("close", open_count);
+  // not a read, so it must never be coalesced
+  return SendScalarMsg_p<uint32_t>("close", NULL, open_count);
 }
 
 uint64_t HippoDevice::subscribe_raw(void *data, uint32_t *get) {
-  uint64_t err = 0LL;
-
-  std::lock_guard<std::mutex> lock(gHippoDeviceMutex);
-
-  if (err = subscribe_raw_p(get)) {
-    delete wsSig_;
-    wsSig_ = NULL;
-    return err;
-  }
-  // everything went OK
-  callback_data_ = data;
-  if (NULL == signal_th_) {
-    signal_th_ = new std::thread(&HippoDevice::WaitForSignalRaw, this);
-  }
-  return err;
+  return subscribe_raw(data, ALL_NOTIFICATIONS, NULL, 0, get);
 }
 
-uint64_t HippoDevice::subscribe_raw_p(uint32_t *get) {
+uint64_t HippoDevice::subscribe_raw(void *data, uint64_t mask,
+                                    const char **names, uint32_t num_names,
+                                    uint32_t *get) {
   uint64_t err = 0LL;
-  if (!IsConnectedWsSig()) {
-    if (NULL == wsSig_) {
-      if (NULL == (wsSig_ = new (std::nothrow)HippoWS(facility_))) {
-        return MAKE_HIPPO_ERROR(facility_,
-                                HIPPO_MEM_ALLOC);
+  {
+    std::lock_guard<std::mutex> lock(gHippoDeviceMutex);
+
+    // set before subscribing, so no unwanted notification gets through
+    if (NULL != names) {
+      notification_names_ = names;
+      num_notification_names_ = std::min(num_names, 64u);
+    }
+    notification_mask_ = mask;
+
+    // all the devices of a SoHal instance share the reactor's connection and
+    // thread, a subscribed device only changes its mask
+    if (NULL == reactor_) {
+      err = NotificationReactor::Subscribe(this, host_, port_, &reactor_,
+                                           get);
+      if (!err) {
+        // the dispatcher's workers run while a device is subscribed
+        SignalDispatcher::GetInstance().SetSubscribed(signal_queue_, true);
       }
+    } else if (NULL != get) {
+      *get = reactor_->Subscriptions(this);
     }
-    int timeout = 5;   // in seconds
-    if (err = wsSig_->Connect(host_, port_, WsConnectionType::TEXT,
-                              timeout)) {
+    if (err) {
       return err;
     }
+    // everything went OK
+    callback_data_ = data;
+    if (NULL != state_cache_) {
+      state_cache_->Subscribed(true, names, num_notification_names_);
+    }
   }
-  nl::json ret_obj;
-  unsigned char *request = NULL, *response = NULL;
-  if (err = GenerateJsonRpc("subscribe", NULL, &request)) {
-    goto clean_up;
-  }
-  int timeout = 10;
-  if (err = wsSig_->SendRequest(request, WsConnectionType::TEXT,
-                                timeout, &response)) {
-    goto clean_up;
-  }
-  // check the return from subscribe is OK
-  try {
-    ret_obj = nl::json::parse(response);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    err = MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
-    goto clean_up;
-  }
-  if (err = GetRawResultOrError(&ret_obj)) {
-    goto clean_up;
+  // the notifications keep the values current from now on
+  RefreshStateCache();
+  return err;
+}
+
+void HippoDevice::RefreshStateCache() {
+  if (NULL == state_cache_ || !state_cache_->Enabled()) {
+    return;
   }
-  if (NULL != get) {
-    // parse out the response
-    uint32_t get_int = 0;
-    try {
-      get_int = ret_obj.get<uint32_t>();
-    } catch (nl::json::exception e) {     // out_of_range or type_error
-      err = MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
-      goto clean_up;
+  for (const auto &property : state_cache_->Properties()) {
+    nl::json j;
+    uint64_t stamp = state_cache_->Stamp(property.c_str());
+    if (!SendRawMsg(property.c_str(), &j)) {
+      state_cache_->Put(property.c_str(), j, stamp);
     }
-    *get = get_int;
   }
-clean_up:
-  free(request);
-  free(response);
-  return err;
 }
 
 uint64_t HippoDevice::temperatures(TemperatureInfo **get, uint64_t *num_temps) {
@@ -242,7 +577,7 @@ uint64_t HippoDevice::temperatures(TemperatureInfo **get, uint64_t *num_temps) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("temperatures", jptr)) {
+  if (err = SendReadMsg("temperatures", jptr)) {
     *get = NULL;
     *num_temps = 0;
     return err;
@@ -264,156 +599,77 @@ uint64_t HippoDevice::unsubscribe(uint32_t *get) {
 
   std::lock_guard<std::mutex> lock(gHippoDeviceMutex);
 
-  if (NULL == signal_th_) {
+  if (NULL == reactor_) {
     return 0LL;
   }
-  // stop waiting for signals
-  if (err = wsSig_->StopSignalLoop()) {
-    return err;
-  }
-  // and wait for the signal thread to finish
-  signal_th_->join();
-  // then delete the allocated memory
-  delete signal_th_;
-  // and assign it to NULL
-  signal_th_ = NULL;
+  polling_ = false;
+  // the reactor stops routing the notifications to this device even if the
+  // unsubscribe request fails, so the device is not subscribed anymore
+  err = NotificationReactor::Unsubscribe(this, reactor_, true, get);
+  reactor_ = NULL;
+  SignalDispatcher::GetInstance().SetSubscribed(signal_queue_, false);
   callback_data_ = NULL;
-
-  // then send the unsubscribe command so we can get the *get param
-  nl::json ret_obj, id;
-  unsigned char *request = NULL, *response = NULL;
-  if (err = GenerateJsonRpc("unsubscribe", NULL, &request)) {
-    goto clean_up;
-  }
-  int timeout = 10;
-  if (err = wsSig_->SendRequest(request, WsConnectionType::TEXT, timeout,
-                                &response)) {
-    goto clean_up;
-  }
-  // make sure we got a response, not a timeout
-  if (response == NULL) {
-    err = MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
-    goto clean_up;
-  }
-  // check the return from unsubscribe is OK
-  try {
-    ret_obj = nl::json::parse(response);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    err = MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
-    goto clean_up;
-  }
-  if (err = GetRawResultOrError(&ret_obj)) {
-    bool found = false;
-    do {
-      if (err = wsSig_->ReadResponse(&response)) {
-        goto clean_up;
-      }
-      // make sure we got a response, not a timeout
-      if (response == NULL) {
-        err = MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
-        goto clean_up;
-      }
-      // check the return from unsubscribe is OK
-      try {
-        ret_obj = nl::json::parse(response);
-      } catch (nl::json::exception) {     // out_of_range or type_error
-        err = MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
-        goto clean_up;
-      }
-      try {
-        id = ret_obj.at("id");
-        found = true;
-      } catch (nl::json::exception) {     // out_of_range or type_error
-        found = false;
-        free(response);
-      }
-    } while (!found);
-
-    if (err = GetRawResultOrError(&ret_obj)) {
-      goto clean_up;
-    }
-  }
-  // parse out the response
-  uint32_t get_int;
-  try {
-    get_int = ret_obj.get<uint32_t>();
-  } catch (nl::json::exception e) {     // out_of_range or type_error
-    err = MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
-    goto clean_up;
-  }
-  if (get) {
-    *get = get_int;
+  if (NULL != state_cache_) {
+    state_cache_->Subscribed(false, NULL, 0);
   }
-  // everything went OK, so we disconnect
-  if (err = wsSig_->Disconnect()) {
-    goto clean_up;
-  }
-  delete wsSig_;
-  wsSig_ = NULL;
 
-clean_up:
-  free(request);
-  free(response);
-
-  // if we got an error, relaunch the thread since this thread needs to exist
-  // in order to properly unsubscribe
-  if (err != HIPPO_OK) {
-    signal_th_ = new std::thread(&HippoDevice::WaitForSignalRaw, this);
-  }
   return err;
 }
 
+// called from the reactor thread: the notifications are delivered in order by
+// the SignalDispatcher's workers, which own |param| from here on
 void HippoDevice::SendSignal(const char *method, void *param) {
-  char *m = strdup(method);
+  SendSignal(method, param, SteadyTimeUs());
+}
+
+void HippoDevice::SendSignal(const char *method, void *param,
+                             int64_t received_us) {
   void *p = (NULL == param) ? new (std::nothrow) nl::json() : param;
 
-  std::thread th(&HippoDevice::ProcessSignal, this, m, p);
+  if (NULL != state_cache_) {
+    state_cache_->Notify(method, reinterpret_cast<nl::json*>(p));
+  }
+  // NULL if it could not be allocated
+  if (NULL == signal_queue_ || !HasRegisteredCallback()) {
+    delete reinterpret_cast<nl::json*>(p);
+    return;
+  }
+  SignalDispatcher::GetInstance().Post(signal_queue_, method, p, received_us);
+}
 
-  th.detach();
+const void *HippoDevice::NotificationValue(const void *params) {
+  static const nl::json kNoValue;
+  const nl::json *p = reinterpret_cast<const nl::json*>(params);
+  if (NULL == p || !p->is_array() || p->empty()) {
+    return &kNoValue;
+  }
+  return &(*p)[0];
 }
 
-void HippoDevice::WaitForSignalRaw(void) {
-  uint64_t err = 0LL;
-  unsigned char *signal = NULL;
-  nl::json *params = NULL;
-
-  while (true) {
-    free(signal);
-    err = wsSig_->WaitForSignal(&signal);
-    // if we got a disconnect signal, then send it out
-    if (HippoErrorCode(err) == HIPPO_WRONG_STATE_ERROR) {
-      if (HasRegisteredCallback()) {
-        SendSignal("on_sohal_disconnected", NULL);
-      }
-      do {
-        Sleep(1000);
-      } while (subscribe_raw_p(NULL));
-      SendSignal("on_sohal_connected", NULL);
-    } else {
-      if (NULL == signal) {
-        // got a NULL signal, meaning we need to exit the thread
-        break;
-      } else if (HasRegisteredCallback()) {
-        try {
-          nl::json jsonRet = nl::json::parse(signal);
-          auto method_j = jsonRet.at("method");
-          if (method_j.is_string()) {
-            std::string method_s = method_j.get<std::string>();
-            params = new (std::nothrow) nl::json(jsonRet.value("params",
-                                                               nl::json()));
-            SendSignal(method_s.c_str() + method_s.find('.') + 1,
-                       params);
-          } else {
-            fprintf(stderr, "** signal.method is not a string\n");
-          }
-        } catch (nl::json::exception) {    // out_of_range or type_error
-          // there is no 'method' key in the notification, so this may
-          // be a response to a 'subscribe' command on the main user thread
-        }
-      }
+ResultArena *HippoDevice::NotificationArena() {
+  notification_arena_.Reset();
+  return &notification_arena_;
+}
+
+bool HippoDevice::AcceptsNotification(const char *notification, size_t len) {
+  uint64_t mask = notification_mask_;
+  if (ALL_NOTIFICATIONS == mask) {
+    return true;
+  }
+  for (uint32_t i = 0; i < num_notification_names_; i++) {
+    if ((mask & (1ULL << i)) &&
+        !strncmp(notification_names_[i], notification, len) &&
+        '\0' == notification_names_[i][len]) {
+      return true;
     }
   }
-  free(signal);
+  filtered_++;
+  return false;
+}
+
+bool HippoDevice::WantsNotifications() {
+  return HasRegisteredCallback() ||
+         (NULL != state_cache_ && state_cache_->Enabled());
 }
 
 bool HippoDevice::HasRegisteredCallback() {
@@ -467,6 +723,11 @@ uint64_t HippoDevice::SendRawMsg(const char *method, const void *param,
     goto clean_up;
   }
   err = GetRawResultOrError(ret_obj);
+  // a set changes the value, the next getter reads it from SoHal
+  if (!err && NULL != param && NULL != state_cache_ &&
+      !reinterpret_cast<const nl::json*>(param)->empty()) {
+    state_cache_->Invalidate(method);
+  }
 
 clean_up:
   free(request);
@@ -475,6 +736,144 @@ clean_up:
   return err;
 }
 
+uint64_t HippoDevice::SendReadMsg(const char *method, void *ret_obj) {
+  return SendReadMsg(method, NULL, ret_obj);
+}
+
+uint64_t HippoDevice::SendReadMsg(const char *method, const void *param,
+                                  void *ret_obj) {
+  uint64_t err = 0LL, stamp = 0;
+  nl::json *ret = reinterpret_cast<nl::json*>(ret_obj);
+  bool no_param = (NULL == param ||
+                   reinterpret_cast<const nl::json*>(param)->empty());
+  // only the reads without parameters are cached
+  bool cached = (no_param && NULL != ret && NULL != state_cache_ &&
+                 state_cache_->Enabled());
+  if (cached && state_cache_->Get(method, notification_mask_, ret, &stamp)) {
+    return hippo::clearError();
+  }
+  if (NULL == coalescer_ || !coalescer_->Enabled() || NULL == ret_obj) {
+    err = SendRawMsg(method, param, ret_obj);
+  } else {
+    // the reads are identical if both the method and the params match
+    std::string key(method);
+    if (!no_param) {
+      key += reinterpret_cast<const nl::json*>(param)->dump();
+    }
+    err = coalescer_->Read(key, ret, [&](nl::json *result) {
+      return SendRawMsg(method, param, result);
+    });
+  }
+  if (!err && cached) {
+    state_cache_->Put(method, *ret, stamp);
+  }
+  return err;
+}
+
+void HippoDevice::coalesce_reads(bool enable) {
+  if (NULL != coalescer_) {
+    coalescer_->Enable(enable);
+  }
+}
+
+uint64_t HippoDevice::notification_policy(const char *notification,
+                                          NotificationPolicy policy) {
+  return notification_policy(notification, policy, 0.0f);
+}
+
+uint64_t HippoDevice::notification_policy(const char *notification,
+                                          NotificationPolicy policy,
+                                          float max_rate_hz) {
+  if (NULL == signal_queue_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  return SignalDispatcher::GetInstance().SetPolicy(signal_queue_,
+                                                   notification, policy,
+                                                   max_rate_hz);
+}
+
+uint64_t HippoDevice::notification_priority(NotificationPriority priority) {
+  if (NULL == signal_queue_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  SignalDispatcher::GetInstance().SetPriority(signal_queue_, priority);
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::notification_stats(NotificationStats *stats) {
+  if (NULL == stats) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == signal_queue_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  SignalDispatcher::GetInstance().GetStats(signal_queue_, stats);
+  stats->filtered = filtered_;
+  // add the notifications the application did not poll in time
+  if (NULL != poll_queue_) {
+    stats->dropped += poll_queue_->Dropped();
+  }
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::notification_latency(NotificationLatency *latency) {
+  if (NULL == latency) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == signal_queue_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  SignalDispatcher::GetInstance().GetLatency(signal_queue_, latency);
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::state_cache(StateCacheMode mode) {
+  return state_cache(mode, 0);
+}
+
+uint64_t HippoDevice::state_cache(StateCacheMode mode, uint32_t max_age_ms) {
+  if (NULL == state_cache_) {   // could not be allocated
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  state_cache_->SetMode(mode, max_age_ms);
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::state_cache_entry(const char *property,
+                                        StateCacheEntry *entry) {
+  if (NULL == property || NULL == entry) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == state_cache_ || !state_cache_->GetEntry(property, entry)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::state_cache_stats(StateCacheStats *stats) {
+  if (NULL == stats) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == state_cache_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  state_cache_->GetStats(stats);
+  return HIPPO_OK;
+}
+
+uint64_t HippoDevice::notification_timestamps(
+    NotificationTimestamps *timestamps) {
+  if (NULL == timestamps) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  if (NULL == signal_queue_ ||
+      !SignalDispatcher::GetInstance().GetTimestamps(signal_queue_,
+                                                     timestamps)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRONG_STATE_ERROR);
+  }
+  return HIPPO_OK;
+}
+
 uint64_t HippoDevice::GenerateJsonRpc(const char *method, const void *param,
                                       unsigned char **jsonrpc) {
   return GenerateJsonRpc(devName_, method, param, jsonrpc);
@@ -576,7 +975,8 @@ uint64_t HippoDevice::GetRawResultOrError(void *obj) {
 
 // json2c
 uint64_t HippoDevice::deviceInfo_json2c(void *obj,
-                                        DeviceInfo *info) {
+                                        DeviceInfo *info,
+                                        ResultArena *arena) {
   if (obj == NULL || info == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
   }
@@ -594,9 +994,10 @@ uint64_t HippoDevice::deviceInfo_json2c(void *obj,
         !vendor_id.is_number_integer() || !product_id.is_number_integer()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
-    info->fw_version = strdup(fw_version.get<std::string>().c_str());
-    info->name = strdup(name.get<std::string>().c_str());
-    info->serial = strdup(serial.get<std::string>().c_str());
+    info->fw_version = ArenaStrDup(arena,
+                                   fw_version.get<std::string>().c_str());
+    info->name = ArenaStrDup(arena, name.get<std::string>().c_str());
+    info->serial = ArenaStrDup(arena, serial.get<std::string>().c_str());
     info->index = index.get<uint32_t>();
     info->vendor_id = vendor_id.get<uint32_t>();
     info->product_id = product_id.get<uint32_t>();
@@ -744,158 +1145,221 @@ uint64_t HippoDevice::tempInfos_json2c(
 // generic API calls
 ///////////////
 
-uint64_t HippoDevice::bool_get(const char *fname, bool *get) {
-  uint64_t err = 0LL;
-  if (NULL == get) {
-    MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+template <typename T>
+uint64_t HippoDevice::SendScalarMsg(const char *method, const T *set,
+                                    T *get) {
+  uint64_t err = 0LL, stamp = 0;
+  bool cached = (NULL != state_cache_ && state_cache_->Enabled());
+  nl::json j;
+  T value;
+
+  if (cached && NULL != set) {
+    stamp = state_cache_->Stamp(method);
+  } else if (cached && state_cache_->Get(method, notification_mask_, &j,
+                                         &stamp)) {
+    try {
+      value = j.get<T>();
+      if (NULL != get) {
+        *get = value;
+      }
+      return hippo::clearError();
+    } catch (nl::json::exception) {     // i.e. an "auto" exposure
+      // read it from SoHal
+    }
+  }
+  // only the reads can be coalesced
+  if (NULL != set || NULL == coalescer_ || !coalescer_->Enabled()) {
+    err = SendScalarMsg_p(method, set, &value);
+  } else {
+    err = coalescer_->Read(method, &j, [&](nl::json *result) {
+      T v;
+      uint64_t e = SendScalarMsg_p(method, set, &v);
+      if (!e) {
+        *result = v;
+      }
+      return e;
+    });
+    if (!err) {
+      try {
+        value = j.get<T>();
+      } catch (nl::json::exception) {     // out_of_range or type_error
+        err = MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+      }
+    }
   }
-  nl::json jget;
-  // send the request to SoHAL
-  void *jptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg(fname, jptr)) {
+  if (err) {
     return err;
   }
-  // and parse out the response
-  try {
-    *get = reinterpret_cast<const nl::json*>(jptr)->get<bool>();
-  } catch (nl::json::exception e) {     // out_of_range or type_error
-    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  // a set returns the new value of the property
+  if (cached) {
+    state_cache_->Put(method, nl::json(value), stamp);
   }
-  return err;
+  if (NULL != get) {
+    *get = value;
+  }
+  return HIPPO_OK;
 }
 
-uint64_t HippoDevice::bool_set_get(const char *fname, bool set, bool *get) {
+template <typename T>
+uint64_t HippoDevice::SendScalarMsg_p(const char *method, const T *set,
+                                      T *get) {
   uint64_t err = 0LL;
-  nl::json jset;
-  nl::json jget;
-  // set the parameter to true or false
-  jset.push_back(set);
-  void *jset_ptr = reinterpret_cast<void*>(&jset);
-  void *jget_ptr = reinterpret_cast<void*>(&jget);
-  // send the request to SoHAL
-  if (err = SendRawMsg(fname, jset_ptr, jget_ptr)) {
+  unsigned int timeout = 10;
+
+  std::lock_guard<std::mutex> lock(gHippoDeviceMutex);      // lock the mutex
+
+  if (err = EnsureConnected()) {
     return err;
   }
-  // if the get value is requested, then parse the response
-  if (get != NULL) {
-    try {
-      *get = reinterpret_cast<const nl::json*>(jget_ptr)->get<bool>();
-    } catch (nl::json::exception e) {     // out_of_range or type_error
-      return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
-    }
+  if (err = hippo::clearError()) {
+    return err;
   }
-  return 0LL;
-}
-
-uint64_t HippoDevice::uint16_get(const char *fname, uint16_t *get) {
-  if (NULL == get) {
-    MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  int len = 0;
+  if (err = ScalarRequest(method, set, &len)) {
+    return err;
   }
-  uint32_t get32 = 0;
-  uint64_t err = uint32_get(fname, &get32);
-  *get = static_cast<uint16_t>(get32);
-  return err;
+  size_t res_len = 0;
+  if (err = ws_->SendRequest(
+          reinterpret_cast<const unsigned char*>(scalar_request_), len,
+          WsConnectionType::TEXT, timeout,
+          &scalar_response_, &scalar_response_size_, &res_len)) {
+    return err;
+  }
+  return ScalarResponse(reinterpret_cast<const char*>(scalar_response_),
+                        res_len, get);
 }
 
-uint64_t HippoDevice::uint16_set_get(const char *fname,
-                                     uint16_t set, uint16_t *get) {
-  uint64_t err = 0;
-  if (NULL == get) {
-    err = uint32_set_get(fname, static_cast<uint32_t>(set), NULL);
-  } else {
-    uint32_t get32 = 0;
-    err = uint32_set_get(fname, static_cast<uint32_t>(set), &get32);
-    *get = static_cast<uint16_t>(get32);
+// encodes the request in scalar_request_ (same as GenerateJsonRpc() does)
+template <typename T>
+uint64_t HippoDevice::ScalarRequest(const char *method, const T *set,
+                                    int *len) {
+  char id[64];
+  snprintf(id, sizeof(id), "%p:%04x:%d", this, GetCurrentThreadId(), id_++);
+  *len = internal::EncodeScalarRequest(id, devName_, method, set,
+                                       scalar_request_,
+                                       sizeof(scalar_request_));
+  if (*len < 0) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  return err;
+  return HIPPO_OK;
 }
 
-uint64_t HippoDevice::uint32_get(const char *fname, uint32_t *get) {
+template <typename T>
+uint64_t HippoDevice::ScalarResponse(const char *response, size_t res_len,
+                                     T *get) {
   uint64_t err = 0LL;
-  if (NULL == get) {
-    MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  // fast path: decode the result in place
+  T value;
+  if (internal::DecodeScalarResult(response, &value)) {
+    if (NULL != get) {
+      *get = value;
+    }
+    return HIPPO_OK;
+  }
+  // error responses (and unexpected results) go through nl::json
+  nl::json j;
+  try {
+    j = nl::json::parse(response, response + res_len);
+  } catch (nl::json::exception) {     // out_of_range or type_error
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  nl::json jget;
-  // send the request to SoHAL
-  void *jptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg(fname, jptr)) {
+  if (err = GetRawResultOrError(&j)) {
     return err;
   }
-  // and parse out the response
   try {
-    *get = reinterpret_cast<const nl::json*>(jptr)->get<uint32_t>();
-  } catch (nl::json::exception e) {     // out_of_range or type_error
+    value = j.get<T>();
+  } catch (nl::json::exception) {     // out_of_range or type_error
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
   }
-  return err;
+  if (!internal::ScalarInRange(value)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (NULL != get) {
+    *get = value;
+  }
+  return HIPPO_OK;
 }
 
-uint64_t HippoDevice::uint32_set_get(const char *fname,
-                                     uint32_t set, uint32_t *get) {
-  uint64_t err = 0LL;
-  nl::json jset;
-  nl::json jget;
-  // set the parameter to true or false
-  jset.push_back(set);
-  void *jset_ptr = reinterpret_cast<void*>(&jset);
-  void *jget_ptr = reinterpret_cast<void*>(&jget);
-  // send the request to SoHAL
-  if (err = SendRawMsg(fname, jset_ptr, jget_ptr)) {
-    return err;
-  }
-  // if the get value is requested, then parse the response
-  if (get != NULL) {
-    try {
-      *get = reinterpret_cast<const nl::json*>(jget_ptr)->get<uint32_t>();
-    } catch (nl::json::exception e) {     // out_of_range or type_error
-      return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
-    }
+uint64_t HippoDevice::scalar_get(const char *fname, bool *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
   }
-  return 0LL;
+  return SendScalarMsg<bool>(fname, NULL, get);
 }
 
-uint64_t HippoDevice::float_get(const char *fname, float *get) {
-  uint64_t err = 0LL;
+uint64_t HippoDevice::scalar_get(const char *fname, uint16_t *get) {
   if (NULL == get) {
-    MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  nl::json jget;
-  // send the request to SoHAL
-  void *jptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg(fname, jptr)) {
-    return err;
+  return SendScalarMsg<uint16_t>(fname, NULL, get);
+}
+
+uint64_t HippoDevice::scalar_get(const char *fname, uint32_t *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  // and parse out the response
-  try {
-    *get = reinterpret_cast<const nl::json*>(jptr)->get<float>();
-  } catch (nl::json::exception e) {     // out_of_range or type_error
-    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  return SendScalarMsg<uint32_t>(fname, NULL, get);
+}
+
+uint64_t HippoDevice::scalar_get(const char *fname, float *get) {
+  if (NULL == get) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
-  return err;
+  return SendScalarMsg<float>(fname, NULL, get);
+}
+
+uint64_t HippoDevice::scalar_set_get(const char *fname, bool set, bool *get) {
+  return SendScalarMsg<bool>(fname, &set, get);
+}
+
+uint64_t HippoDevice::scalar_set_get(const char *fname,
+                                     uint16_t set, uint16_t *get) {
+  return SendScalarMsg<uint16_t>(fname, &set, get);
+}
+
+uint64_t HippoDevice::scalar_set_get(const char *fname,
+                                     uint32_t set, uint32_t *get) {
+  return SendScalarMsg<uint32_t>(fname, &set, get);
+}
+
+uint64_t HippoDevice::scalar_set_get(const char *fname,
+                                     float set, float *get) {
+  return SendScalarMsg<float>(fname, &set, get);
+}
+
+uint64_t HippoDevice::bool_get(const char *fname, bool *get) {
+  return scalar_get(fname, get);
+}
+
+uint64_t HippoDevice::bool_set_get(const char *fname, bool set, bool *get) {
+  return scalar_set_get(fname, set, get);
+}
+
+uint64_t HippoDevice::uint16_get(const char *fname, uint16_t *get) {
+  return scalar_get(fname, get);
+}
+
+uint64_t HippoDevice::uint16_set_get(const char *fname,
+                                     uint16_t set, uint16_t *get) {
+  return scalar_set_get(fname, set, get);
+}
+
+uint64_t HippoDevice::uint32_get(const char *fname, uint32_t *get) {
+  return scalar_get(fname, get);
+}
+
+uint64_t HippoDevice::uint32_set_get(const char *fname,
+                                     uint32_t set, uint32_t *get) {
+  return scalar_set_get(fname, set, get);
+}
+
+uint64_t HippoDevice::float_get(const char *fname, float *get) {
+  return scalar_get(fname, get);
 }
 
 uint64_t HippoDevice::float_set_get(const char *fname,
                                     float set, float *get) {
-  uint64_t err = 0LL;
-  nl::json jset;
-  nl::json jget;
-  // set the parameter to true or false
-  jset.push_back(set);
-  void *jset_ptr = reinterpret_cast<void*>(&jset);
-  void *jget_ptr = reinterpret_cast<void*>(&jget);
-  // send the request to SoHAL
-  if (err = SendRawMsg(fname, jset_ptr, jget_ptr)) {
-    return err;
-  }
-  // if the get value is requested, then parse the response
-  if (get != NULL) {
-    try {
-      *get = reinterpret_cast<const nl::json*>(jget_ptr)->get<float>();
-    } catch (nl::json::exception e) {     // out_of_range or type_error
-      return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
-    }
-  }
-  return 0LL;
+  return scalar_set_get(fname, set, get);
 }
 
 int32_t HippoDevice::str_to_idx(const char **names,
@@ -0,0 +1,460 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>    // std::min, std::max
+#include <chrono>   // NOLINT
+#include <thread>   // NOLINT
+
+#include "../include/hippo_device.h"
+#include "../include/hippo_dispatcher.h"
+#include "../include/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace hippo {
+
+// upper limit of the worker pool, the workers only run the user callbacks
+const uint32_t kMaxSignalWorkers = 4;
+// number of notifications a worker delivers from a queue before giving the
+// other devices' queues a chance to run
+const uint32_t kSignalBatchSize = 32;
+
+// the queue being drained by the current thread (only set in the workers)
+thread_local SignalQueue *tDrainingQueue = NULL;
+// the timestamps of the notification being delivered by the current thread
+thread_local NotificationTimestamps tTimestamps;
+thread_local bool tDelivering = false;
+
+LatencyRecorder::LatencyRecorder() :
+    count_(0), total_us_(0), max_us_(0) {
+  for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    buckets_[i] = 0;
+  }
+}
+
+void LatencyRecorder::Record(int64_t latency_us) {
+  uint64_t us = (latency_us > 0) ? static_cast<uint64_t>(latency_us) : 0;
+  uint32_t bucket = 0;
+  while ((us >> (bucket + 1)) && bucket < LATENCY_HISTOGRAM_BUCKETS - 1) {
+    bucket++;
+  }
+  buckets_[bucket]++;
+  count_++;
+  total_us_ += us;
+  uint64_t max_us = max_us_;
+  while (us > max_us && !max_us_.compare_exchange_weak(max_us, us)) {
+  }
+}
+
+void LatencyRecorder::Get(LatencyHistogram *histogram) {
+  for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    histogram->buckets[i] = buckets_[i];
+  }
+  histogram->count = count_;
+  histogram->total_us = total_us_;
+  histogram->max_us = max_us_;
+}
+
+SignalQueue::SignalQueue(HippoDevice *device) :
+    device_(device), ring_(SIGNAL_QUEUE_DEPTH), scheduled_(false),
+    closed_(false), orphaned_(false), high_priority_(false),
+    subscribed_(false), delivered_(0),
+    conflated_(0),
+    dropped_(0), num_slots_(0) {
+  for (uint32_t i = 0; i < MAX_CONFLATED_SIGNALS; i++) {
+    slots_[i].method[0] = '\0';
+    slots_[i].policy = static_cast<uint32_t>(NotificationPolicy::keep_all);
+    slots_[i].interval_us = 0;
+    slots_[i].latest = NULL;
+    slots_[i].parked = false;
+  }
+}
+
+SignalQueue::~SignalQueue(void) {
+  Signal *signal;
+  while (NULL != (signal = ring_.Front())) {
+    delete reinterpret_cast<nl::json*>(signal->params);
+    ring_.Release();
+  }
+  for (uint32_t i = 0; i < MAX_CONFLATED_SIGNALS; i++) {
+    delete reinterpret_cast<nl::json*>(slots_[i].latest.load());
+  }
+}
+
+ConflationSlot *SignalQueue::FindSlot(const char *method) {
+  uint32_t num_slots = num_slots_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (!strcmp(slots_[i].method, method)) {
+      return &slots_[i];
+    }
+  }
+  return NULL;
+}
+
+SignalDispatcher::SignalDispatcher() :
+    facility_(HIPPO_DEVICE), num_workers_(0), fast_worker_(false),
+    num_subscribed_(0) {
+  uint32_t hw_threads = std::thread::hardware_concurrency();
+  max_workers_ = std::max(2u, std::min(hw_threads, kMaxSignalWorkers));
+}
+
+uint64_t SignalDispatcher::Register(HippoDevice *device, SignalQueue **queue) {
+  SignalQueue *q = new (std::nothrow) SignalQueue(device);
+  if (NULL == q || !q->ring_.Valid()) {
+    delete q;
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  *queue = q;
+  return HIPPO_OK;
+}
+
+void SignalDispatcher::Unregister(SignalQueue *queue) {
+  if (NULL == queue) {
+    return;
+  }
+  SetSubscribed(queue, false);
+  queue->closed_ = true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (tDrainingQueue == queue) {
+    // the device is being destroyed from its own callback, so the worker
+    // running this thread deletes the queue when the callback returns
+    queue->orphaned_ = true;
+    return;
+  }
+  // the parked notifications are deleted with the queue
+  for (auto it = delayed_.begin(); it != delayed_.end(); ++it) {
+    if (it->second == queue) {
+      delayed_.erase(it);
+      break;
+    }
+  }
+  idle_cv_.wait(lock, [queue] { return !queue->scheduled_; });
+  lock.unlock();
+  delete queue;
+}
+
+void SignalDispatcher::SetSubscribed(SignalQueue *queue, bool subscribed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (NULL == queue || queue->subscribed_ == subscribed) {
+    return;
+  }
+  queue->subscribed_ = subscribed;
+  if (subscribed) {
+    num_subscribed_++;
+  } else if (0 == --num_subscribed_) {
+    // let the idle workers exit
+    ready_cv_.notify_all();
+    fast_cv_.notify_all();
+  }
+}
+
+uint64_t SignalDispatcher::Post(SignalQueue *queue, const char *method,
+                                void *params, int64_t received_us) {
+  int64_t decoded_us = SteadyTimeUs();
+  ConflationSlot *slot = queue->FindSlot(method);
+  if (NULL != slot && static_cast<uint32_t>(NotificationPolicy::keep_all) !=
+                      slot->policy) {
+    // replace the pending notification of this type, if there is one: its
+    // marker is already in the queue
+    void *pending = slot->latest.exchange(params);
+    if (NULL != pending) {
+      delete reinterpret_cast<nl::json*>(pending);
+      queue->conflated_++;
+      return HIPPO_OK;
+    }
+    params = NULL;   // the marker gets the params from the slot
+  } else {
+    slot = NULL;
+  }
+
+  Signal *signal = queue->ring_.Reserve();
+  if (NULL == signal || queue->closed_) {
+    // the callbacks are not keeping up: drop the notification right away,
+    // the reactor thread routing it never waits for them
+    queue->dropped_++;
+    if (NULL != slot) {
+      params = slot->latest.exchange(NULL);
+    }
+    delete reinterpret_cast<nl::json*>(params);
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_DEVICE_BUSY);
+  }
+  snprintf(signal->method, sizeof(signal->method), "%s", method);
+  signal->params = params;
+  signal->slot = slot;
+  signal->received_us = received_us;
+  signal->decoded_us = decoded_us;
+  queue->ring_.Commit();
+  // pairs with the fence in worker_loop(), so either the worker sees this
+  // notification or we see scheduled_ == false and schedule the queue
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!queue->scheduled_.exchange(true)) {
+    Schedule(queue);
+  }
+  return HIPPO_OK;
+}
+
+uint64_t SignalDispatcher::SetPolicy(SignalQueue *queue, const char *method,
+                                     NotificationPolicy policy,
+                                     float max_rate_hz) {
+  if (NULL == method || strlen(method) >= MAX_SIGNAL_METHOD_LEN ||
+      (NotificationPolicy::rate_limit == policy && max_rate_hz <= 0.0f)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
+  }
+  std::lock_guard<std::mutex> lock(queue->slots_mutex_);
+  ConflationSlot *slot = queue->FindSlot(method);
+  bool new_slot = (NULL == slot);
+  if (new_slot) {
+    if (NotificationPolicy::keep_all == policy) {
+      return HIPPO_OK;    // that's the default
+    }
+    uint32_t num_slots = queue->num_slots_;
+    if (num_slots >= MAX_CONFLATED_SIGNALS) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+    }
+    slot = &queue->slots_[num_slots];
+    snprintf(slot->method, sizeof(slot->method), "%s", method);
+    slot->next_delivery = Clock::time_point();
+  }
+  slot->interval_us = (NotificationPolicy::rate_limit == policy) ?
+      static_cast<int64_t>(1e6f / max_rate_hz) : 0;
+  slot->policy = static_cast<uint32_t>(policy);
+  if (new_slot) {
+    // publish the new slot once it is filled
+    queue->num_slots_.store(queue->num_slots_ + 1, std::memory_order_release);
+  }
+  return HIPPO_OK;
+}
+
+void SignalDispatcher::SetPriority(SignalQueue *queue,
+                                   NotificationPriority priority) {
+  // a scheduled queue moves to its new lane the next time it is scheduled
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue->high_priority_ = (NotificationPriority::high == priority);
+}
+
+void SignalDispatcher::GetStats(SignalQueue *queue, NotificationStats *stats) {
+  stats->delivered = queue->delivered_;
+  stats->conflated = queue->conflated_;
+  stats->dropped = queue->dropped_;
+}
+
+void SignalDispatcher::GetLatency(SignalQueue *queue,
+                                  NotificationLatency *latency) {
+  queue->decode_latency_.Get(&latency->decode);
+  queue->queue_latency_.Get(&latency->queue);
+  queue->total_latency_.Get(&latency->total);
+}
+
+bool SignalDispatcher::GetTimestamps(SignalQueue *queue,
+                                     NotificationTimestamps *timestamps) {
+  if (!tDelivering || tDrainingQueue != queue) {
+    return false;
+  }
+  *timestamps = tTimestamps;
+  return true;
+}
+
+void SignalDispatcher::Schedule(SignalQueue *queue) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // workers that are about to exit check the lanes again before leaving, so
+  // we only start the ones that are missing
+  while (num_workers_ < max_workers_) {
+    std::thread th(&SignalDispatcher::worker_loop, this, false);
+    th.detach();
+    num_workers_++;
+  }
+  if (queue->high_priority_ && !fast_worker_) {
+    std::thread th(&SignalDispatcher::worker_loop, this, true);
+    th.detach();
+    fast_worker_ = true;
+  }
+  Ready(queue);
+}
+
+// puts |queue| in its lane and wakes a worker up, the mutex must be captured
+void SignalDispatcher::Ready(SignalQueue *queue) {
+  if (queue->high_priority_) {
+    fast_ready_.push_back(queue);
+    fast_cv_.notify_one();
+  } else {
+    ready_.push_back(queue);
+  }
+  // the regular workers also take the fast lane first
+  ready_cv_.notify_one();
+}
+
+// calls the callback of the device with |params| (unless the queue is
+// closed) and deletes them
+void SignalDispatcher::Deliver(SignalQueue *queue, char *method, void *params,
+                               int64_t received_us, int64_t decoded_us) {
+  if (!queue->closed_ && NULL != params) {
+    tTimestamps.received_us = received_us;
+    tTimestamps.decoded_us = decoded_us;
+    tTimestamps.dispatched_us = SteadyTimeUs();
+    queue->decode_latency_.Record(decoded_us - received_us);
+    queue->queue_latency_.Record(tTimestamps.dispatched_us - decoded_us);
+    queue->total_latency_.Record(tTimestamps.dispatched_us - received_us);
+    tDelivering = true;
+    queue->device_->ProcessSignal(method, params);
+    tDelivering = false;
+    queue->delivered_++;
+  }
+  delete reinterpret_cast<nl::json*>(params);
+}
+
+// A rate limited notification that is not due yet is parked in its slot,
+// where the newer ones conflate with it, and the notifications behind it
+// keep flowing. Returns true if some are parked, |due| being when the first
+// one is.
+bool SignalDispatcher::Drain(SignalQueue *queue, Clock::time_point *due) {
+  // the parked notifications that are due go first
+  Clock::time_point now = Clock::now();
+  uint32_t num_slots = queue->num_slots_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    ConflationSlot *slot = &queue->slots_[i];
+    int64_t interval_us = slot->interval_us;
+    if (slot->parked && (queue->closed_ || 0 == interval_us ||
+                         now >= slot->next_delivery)) {
+      slot->parked = false;
+      slot->next_delivery = now + std::chrono::microseconds(interval_us);
+      Deliver(queue, slot->method, slot->latest.exchange(NULL),
+              slot->received_us, slot->decoded_us);
+    }
+  }
+
+  Signal *signal;
+  for (uint32_t i = 0; i < kSignalBatchSize; i++) {
+    if (NULL == (signal = queue->ring_.Front())) {
+      break;
+    }
+    void *params = signal->params;
+    ConflationSlot *slot = signal->slot;
+    if (NULL != slot) {
+      if (!queue->closed_ && slot->interval_us) {
+        now = Clock::now();
+        if (now < slot->next_delivery) {
+          slot->parked = true;
+          slot->received_us = signal->received_us;
+          slot->decoded_us = signal->decoded_us;
+          queue->ring_.Release();
+          continue;
+        }
+        slot->next_delivery = now +
+            std::chrono::microseconds(slot->interval_us.load());
+      }
+      // from here on, a new notification of this type gets a new marker
+      params = slot->latest.exchange(NULL);
+    }
+    Deliver(queue, signal->method, params, signal->received_us,
+            signal->decoded_us);
+    signal->params = NULL;
+    queue->ring_.Release();
+  }
+
+  bool parked = false;
+  num_slots = queue->num_slots_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    ConflationSlot *slot = &queue->slots_[i];
+    if (slot->parked && (!parked || slot->next_delivery < *due)) {
+      *due = slot->next_delivery;
+      parked = true;
+    }
+  }
+  return parked && !queue->closed_;
+}
+
+// The fast lane worker only delivers the high priority queues, so it is
+// never busy with a slow callback of a normal device when an input
+// notification arrives. The regular workers deliver both lanes, the fast one
+// first.
+void SignalDispatcher::worker_loop(bool fast_lane) {
+  std::condition_variable &cv = fast_lane ? fast_cv_ : ready_cv_;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // move the queues whose rate limited notification is due to their lane
+    Clock::time_point now = Clock::now();
+    Clock::time_point next_due = Clock::time_point::max();
+    for (auto it = delayed_.begin(); it != delayed_.end();) {
+      if (it->first <= now) {
+        // unless a worker has it already, which delivers them
+        if (!it->second->scheduled_.exchange(true)) {
+          Ready(it->second);
+        }
+        it = delayed_.erase(it);
+      } else {
+        next_due = std::min(next_due, it->first);
+        ++it;
+      }
+    }
+    std::deque<SignalQueue*> *lane = NULL;
+    if (!fast_ready_.empty()) {
+      lane = &fast_ready_;
+    } else if (!fast_lane && !ready_.empty()) {
+      lane = &ready_;
+    }
+    if (NULL == lane) {
+      if (0 == num_subscribed_ && delayed_.empty()) {
+        break;   // no device is subscribed, a new notification restarts us
+      }
+      if (Clock::time_point::max() == next_due) {
+        cv.wait(lock);
+      } else {
+        cv.wait_until(lock, next_due);
+      }
+      continue;
+    }
+    SignalQueue *queue = lane->front();
+    lane->pop_front();
+    lock.unlock();
+
+    Clock::time_point due;
+    tDrainingQueue = queue;
+    bool delayed = Drain(queue, &due);
+    tDrainingQueue = NULL;
+
+    lock.lock();
+    if (queue->orphaned_) {
+      for (auto it = delayed_.begin(); it != delayed_.end(); ++it) {
+        if (it->second == queue) {
+          delayed_.erase(it);
+          break;
+        }
+      }
+      delete queue;
+      continue;
+    }
+    if (delayed && !queue->closed_) {
+      // a worker drains the queue again when its first parked notification
+      // is due, the queue has a single entry
+      auto it = delayed_.begin();
+      while (it != delayed_.end() && it->second != queue) {
+        ++it;
+      }
+      if (it == delayed_.end()) {
+        delayed_.push_back(std::make_pair(due, queue));
+      } else {
+        it->first = due;
+      }
+      ready_cv_.notify_one();
+      fast_cv_.notify_one();
+    }
+    queue->scheduled_ = false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!queue->ring_.Empty() && !queue->scheduled_.exchange(true)) {
+      // more notifications (or a batch limit): back to the end of its lane
+      Ready(queue);
+    }
+    idle_cv_.notify_all();
+  }
+  if (fast_lane) {
+    fast_worker_ = false;
+  } else {
+    num_workers_--;
+  }
+}
+
+}  // namespace hippo
@@ -0,0 +1,607 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>   // NOLINT
+#include <unordered_set>
+#include <utility>
+
+#include "../include/hippo_reactor.h"
+#include "../include/hippo_ws.h"
+#include "../include/json.hpp"
+#include "../include/notification_recorder.h"
+
+namespace nl = nlohmann;
+
+namespace hippo {
+
+// time a subscribe or unsubscribe request waits for its response
+const uint32_t kReactorCallTimeoutS = 10;
+// time to wait between attempts to reconnect to SoHal
+const uint32_t kReactorReconnectMs = 1000;
+
+// ReactorRegistry keeps one reactor per SoHal instance (host:port)
+class ReactorRegistry {
+ public:
+  static ReactorRegistry& GetInstance(void) {
+    static ReactorRegistry instance;
+    return instance;
+  }
+
+  // returns the reactor of |host|:|port|, creating it if needed, and counts
+  // the caller as one of its users
+  NotificationReactor *Acquire(const char *host, uint32_t port) {
+    char key[MAX_ADDR_LEN + 16];
+    snprintf(key, sizeof(key), "%s:%u", host, port);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    NotificationReactor *reactor = NULL;
+    auto it = reactors_.find(key);
+    if (it != reactors_.end()) {
+      reactor = it->second;
+    } else {
+      bool replay = (replays_.end() != replays_.find(key));
+      if (NULL == (reactor = new (std::nothrow)
+                   NotificationReactor(host, port, replay))) {
+        return NULL;
+      }
+      reactors_[key] = reactor;
+    }
+    reactor->users_++;
+    return reactor;
+  }
+
+  // same as Acquire() for an existing replay reactor only
+  NotificationReactor *AcquireReplay(const char *host, uint32_t port) {
+    char key[MAX_ADDR_LEN + 16];
+    snprintf(key, sizeof(key), "%s:%u", host, port);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = reactors_.find(key);
+    if (it == reactors_.end() || !it->second->replay_) {
+      return NULL;
+    }
+    it->second->users_++;
+    return it->second;
+  }
+
+  bool AddReplay(const char *host, uint32_t port) {
+    char key[MAX_ADDR_LEN + 16];
+    snprintf(key, sizeof(key), "%s:%u", host, port);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reactors_.end() != reactors_.find(key) ||
+        replays_.end() != replays_.find(key)) {
+      return false;
+    }
+    replays_.insert(key);
+    return true;
+  }
+
+  void RemoveReplay(const char *host, uint32_t port) {
+    char key[MAX_ADDR_LEN + 16];
+    snprintf(key, sizeof(key), "%s:%u", host, port);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    replays_.erase(key);
+  }
+
+  // returns true if the caller was the last user of |reactor|, in which case
+  // it is not in the registry anymore and the caller must stop and delete it
+  bool Release(NotificationReactor *reactor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--reactor->users_) {
+      return false;
+    }
+    for (auto it = reactors_.begin(); it != reactors_.end(); ++it) {
+      if (it->second == reactor) {
+        reactors_.erase(it);
+        break;
+      }
+    }
+    return true;
+  }
+
+  ReactorRegistry(ReactorRegistry const &);   // Don't implement
+  void operator=(ReactorRegistry const &);    // Don't implement
+
+ private:
+  ReactorRegistry() {
+  }
+  ~ReactorRegistry() {
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, NotificationReactor*> reactors_;
+  // the host:port replaced by a NotificationReplayer
+  std::unordered_set<std::string> replays_;
+};
+
+NotificationReactor::NotificationReactor(const char *host, uint32_t port,
+                                         bool replay) :
+    facility_(HIPPO_DEVICE), host_(host), port_(port), users_(0),
+    replay_(replay), ws_(NULL), thread_(NULL), stop_(false), routing_(0),
+    awaiting_response_(false) {
+}
+
+NotificationReactor::~NotificationReactor(void) {
+  for (auto request : requests_) {
+    free(request);
+  }
+  delete ws_;
+}
+
+uint64_t NotificationReactor::Subscribe(HippoDevice *device, const char *host,
+                                        uint32_t port,
+                                        NotificationReactor **reactor,
+                                        uint32_t *get) {
+  uint64_t err = 0LL;
+  uint32_t subscriptions = 0;
+  NotificationReactor *r = ReactorRegistry::GetInstance().Acquire(host, port);
+  if (NULL == r) {
+    return MAKE_HIPPO_ERROR(device->facility_, HIPPO_MEM_ALLOC);
+  }
+  if (err = r->Start()) {
+    goto clean_up;
+  }
+  {
+    std::lock_guard<std::mutex> lock(r->mutex_);
+    r->devices_.push_back(device);
+    subscriptions = ++r->subscriptions_[device->devName_];
+  }
+  // the other objects of the device already subscribed the connection
+  if (1 < subscriptions) {
+    if (NULL != get) {
+      *get = subscriptions;
+    }
+  } else if (err = r->Call(device, "subscribe", get)) {
+    std::lock_guard<std::mutex> lock(r->mutex_);
+    r->devices_.erase(std::find(r->devices_.begin(), r->devices_.end(),
+                                device));
+    r->subscriptions_.erase(device->devName_);
+    goto clean_up;
+  }
+  *reactor = r;
+
+clean_up:
+  if (err && ReactorRegistry::GetInstance().Release(r)) {
+    r->Stop();
+    delete r;
+  }
+  return err;
+}
+
+uint64_t NotificationReactor::Unsubscribe(HippoDevice *device,
+                                          NotificationReactor *reactor,
+                                          bool wait, uint32_t *get) {
+  uint64_t err = 0LL;
+  uint32_t subscriptions = 0;
+  {
+    // no notification is routed to |device| once it is out of the list, and
+    // the one being posted to it (if any) is done when routing_ is 0
+    std::unique_lock<std::mutex> lock(reactor->mutex_);
+    auto it = std::find(reactor->devices_.begin(), reactor->devices_.end(),
+                        device);
+    if (it == reactor->devices_.end()) {
+      goto clean_up;
+    }
+    reactor->devices_.erase(it);
+    reactor->routed_cv_.wait(lock, [reactor] {
+      return 0 == reactor->routing_;
+    });
+    auto sub = reactor->subscriptions_.find(device->devName_);
+    if (sub != reactor->subscriptions_.end() && 0 == --sub->second) {
+      reactor->subscriptions_.erase(sub);
+    } else if (sub != reactor->subscriptions_.end()) {
+      // the other objects of the device keep the connection subscribed
+      subscriptions = sub->second;
+      wait = false;
+    }
+    if (!subscriptions && !wait && !reactor->replay_) {
+      // dropped if this is the last user: SoHal also drops the
+      // subscriptions when the connection is closed
+      reactor->Queue(device, "unsubscribe");
+      (void)reactor->ws_->StopSignalLoop();
+    }
+  }
+  if (wait) {
+    err = reactor->Call(device, "unsubscribe", get);
+  } else if (NULL != get) {
+    *get = subscriptions;
+  }
+
+clean_up:
+  if (ReactorRegistry::GetInstance().Release(reactor)) {
+    reactor->Stop();
+    delete reactor;
+  }
+  return err;
+}
+
+uint64_t NotificationReactor::Call(HippoDevice *device, const char *method,
+                                   uint32_t *get) {
+  uint64_t err = 0LL;
+  unsigned char *request = NULL;
+  std::string id;
+  PendingCall call;
+  nl::json ret_obj;
+
+  if (replay_) {
+    // the replay stands in for SoHal, as its only client
+    if (NULL != get) {
+      *get = 1;
+    }
+    return err;
+  }
+  if (err = device->GenerateJsonRpc(method, NULL, &request)) {
+    return err;
+  }
+  try {
+    id = nl::json::parse(request).at("id").get<std::string>();
+  } catch (nl::json::exception) {     // out_of_range or type_error
+    free(request);
+    return MAKE_HIPPO_ERROR(device->facility_, HIPPO_MESSAGE_ERROR);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_[id] = &call;
+    requests_.push_back(request);
+    // wake the reactor thread up so it sends the request
+    (void)ws_->StopSignalLoop();
+    calls_cv_.wait_for(lock, std::chrono::seconds(kReactorCallTimeoutS),
+                       [&call] { return call.done; });
+    pending_.erase(id);
+    if (!call.done) {
+      return MAKE_HIPPO_ERROR(device->facility_, HIPPO_TIMEOUT);
+    }
+  }
+  if (call.err) {
+    return call.err;
+  }
+  // check the return of the request is OK
+  try {
+    ret_obj = nl::json::parse(call.response);
+  } catch (nl::json::exception) {     // out_of_range or type_error
+    return MAKE_HIPPO_ERROR(device->facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (err = device->GetRawResultOrError(&ret_obj)) {
+    return err;
+  }
+  if (NULL != get) {
+    try {
+      *get = ret_obj.get<uint32_t>();
+    } catch (nl::json::exception) {     // out_of_range or type_error
+      return MAKE_HIPPO_ERROR(device->facility_, HIPPO_INVALID_PARAM);
+    }
+  }
+  return err;
+}
+
+uint32_t NotificationReactor::Subscriptions(HippoDevice *device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = subscriptions_.find(device->devName_);
+  return (it != subscriptions_.end()) ? it->second : 0;
+}
+
+bool NotificationReactor::AddReplay(const char *host, uint32_t port) {
+  return ReactorRegistry::GetInstance().AddReplay(host, port);
+}
+
+void NotificationReactor::RemoveReplay(const char *host, uint32_t port) {
+  ReactorRegistry::GetInstance().RemoveReplay(host, port);
+}
+
+NotificationReactor *NotificationReactor::AcquireReplay(const char *host,
+                                                        uint32_t port) {
+  return ReactorRegistry::GetInstance().AcquireReplay(host, port);
+}
+
+void NotificationReactor::ReleaseReplay(NotificationReactor *reactor) {
+  if (ReactorRegistry::GetInstance().Release(reactor)) {
+    reactor->Stop();
+    delete reactor;
+  }
+}
+
+void NotificationReactor::Replay(const unsigned char *frame,
+                                 int64_t received_us) {
+  HandleMessage(frame, received_us);
+}
+
+uint64_t NotificationReactor::Start() {
+  uint64_t err = 0LL;
+  if (NULL != thread_ || replay_) {
+    return err;     // already running, or fed by a NotificationReplayer
+  }
+  if (err = Connect(&ws_)) {
+    return err;
+  }
+  if (NULL == (thread_ = new (std::nothrow)
+               std::thread(&NotificationReactor::reactor_loop, this))) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  return err;
+}
+
+// called once the reactor is out of the registry, so nobody else uses it
+void NotificationReactor::Stop() {
+  stop_ = true;
+  if (NULL != thread_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      (void)ws_->StopSignalLoop();
+    }
+    thread_->join();
+    delete thread_;
+    thread_ = NULL;
+  }
+  if (NULL != ws_) {
+    (void)ws_->Disconnect();
+  }
+}
+
+uint64_t NotificationReactor::Connect(HippoWS **ws) {
+  uint64_t err = 0LL;
+  HippoWS *w = new (std::nothrow) HippoWS(HIPPO_WS);
+  if (NULL == w) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+  }
+  int timeout = 5;   // in seconds
+  if (err = w->Connect(host_.c_str(), port_, WsConnectionType::TEXT,
+                       timeout)) {
+    delete w;
+    return err;
+  }
+  *ws = w;
+  return err;
+}
+
+void NotificationReactor::Queue(HippoDevice *device, const char *method) {
+  unsigned char *request = NULL;
+  if (!device->GenerateJsonRpc(method, NULL, &request)) {
+    requests_.push_back(request);
+  }
+}
+
+void NotificationReactor::reactor_loop(void) {
+  uint64_t err = 0LL;
+  unsigned char *msg = NULL;
+  int64_t received_us = 0;
+
+  while (true) {
+    free(msg);
+    msg = NULL;
+    SendQueued();
+    err = ws_->WaitForSignal(&msg, &received_us);
+    if (HippoErrorCode(err) == HIPPO_WRONG_STATE_ERROR) {
+      if (stop_) {
+        break;
+      }
+      Reconnect();
+    } else if (NULL == msg) {
+      // woken up to send a request or to exit the thread
+      if (stop_) {
+        break;
+      }
+    } else {
+      NotificationRecorder::Record(msg, received_us);
+      HandleMessage(msg, received_us);
+    }
+  }
+  free(msg);
+}
+
+void NotificationReactor::SendQueued() {
+  unsigned char *request = NULL;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the connection has a single request slot, so a request is only sent
+    // once the previous one got its response (or timed out)
+    if (requests_.empty() ||
+        (awaiting_response_ && Clock::now() < response_deadline_)) {
+      return;
+    }
+    request = requests_.front();
+    requests_.pop_front();
+    awaiting_response_ = true;
+    response_deadline_ = Clock::now() +
+        std::chrono::seconds(kReactorCallTimeoutS);
+  }
+  // the response is read by the loop like any other message
+  (void)ws_->SendRequest(request, WsConnectionType::TEXT);
+  free(request);
+}
+
+// Finds the method of a notification in the raw |msg|, without parsing it.
+// SoHal sends the top level "method" key before "params", so the first
+// "method" key found is the notification's one.
+static bool FindMethod(const char *msg, const char **method, size_t *len) {
+  const char kMethodKey[] = "\"method\"";
+  const char *p = strstr(msg, kMethodKey);
+  if (NULL == p) {
+    return false;   // i.e. a response
+  }
+  p += sizeof(kMethodKey) - 1;
+  while (isspace(static_cast<unsigned char>(*p))) {
+    p++;
+  }
+  if (':' != *p++) {
+    return false;
+  }
+  while (isspace(static_cast<unsigned char>(*p))) {
+    p++;
+  }
+  if ('"' != *p++) {
+    return false;
+  }
+  const char *end = strchr(p, '"');
+  if (NULL == end) {
+    return false;
+  }
+  *method = p;
+  *len = end - p;
+  return true;
+}
+
+void NotificationReactor::HandleMessage(const unsigned char *msg,
+                                        int64_t received_us) {
+  const char *method_raw = NULL;
+  size_t len = 0;
+  bool notification = FindMethod(reinterpret_cast<const char*>(msg),
+                                 &method_raw, &len);
+  if (notification) {
+    // drop the notifications nobody wants before paying for the parsing
+    const char *dot = reinterpret_cast<const char*>(
+        memchr(method_raw, '.', len));
+    if (NULL == dot) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    FindDevices(method_raw, dot - method_raw, dot + 1,
+                method_raw + len - dot - 1, &targets_);
+    if (targets_.empty()) {
+      return;
+    }
+    // the devices stay subscribed until the notification is posted to them
+    routing_++;
+  }
+  nl::json message;
+  try {
+    message = nl::json::parse(msg);
+  } catch (nl::json::exception) {     // out_of_range or type_error
+    if (notification) {
+      Routed();
+    }
+    return;
+  }
+
+  if (!notification) {
+    // the response to a subscribe or unsubscribe request
+    auto id = message.find("id");
+    if (id == message.end() || !id->is_string()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    awaiting_response_ = false;
+    auto it = pending_.find(id->get<std::string>());
+    if (it != pending_.end()) {
+      it->second->response = reinterpret_cast<const char*>(msg);
+      it->second->done = true;
+      calls_cv_.notify_all();
+    }
+    return;
+  }
+  // i.e. "hirescamera@0.on_brightness", posted outside of the mutex as the
+  // subscribe and unsubscribe calls must not wait for the devices' queues
+  auto method_j = message.find("method");
+  size_t dot = std::string::npos;
+  if (method_j != message.end() && method_j->is_string()) {
+    dot = method_j->get_ref<const std::string&>().find('.');
+  }
+  if (std::string::npos != dot) {
+    const char *method = method_j->get_ref<const std::string&>().c_str();
+    auto params = message.find("params");
+    for (size_t i = 0; i < targets_.size(); i++) {
+      nl::json *p;
+      if (params == message.end()) {
+        p = new (std::nothrow) nl::json();
+      } else if (i + 1 < targets_.size()) {
+        p = new (std::nothrow) nl::json(*params);
+      } else {
+        // the params are moved out of the parsed message for the last one
+        p = new (std::nothrow) nl::json(std::move(*params));
+      }
+      targets_[i]->SendSignal(method + dot + 1, p, received_us);
+    }
+  }
+  Routed();
+}
+
+void NotificationReactor::Reconnect() {
+  Broadcast("on_sohal_disconnected");
+  {
+    // the requests sent on the closed connection won't get a response
+    std::lock_guard<std::mutex> lock(mutex_);
+    awaiting_response_ = false;
+    for (auto &pending : pending_) {
+      pending.second->err = MAKE_HIPPO_ERROR(facility_,
+                                             HIPPO_WRONG_STATE_ERROR);
+      pending.second->done = true;
+    }
+    calls_cv_.notify_all();
+  }
+  while (!stop_) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(kReactorReconnectMs));
+    HippoWS *ws = NULL;
+    if (Connect(&ws)) {
+      continue;
+    }
+    HippoWS *old_ws = NULL;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      old_ws = ws_;
+      ws_ = ws;
+      // SoHal forgot the subscriptions along with the old connection, one
+      // per device however many objects share it
+      std::unordered_set<std::string> subscribed;
+      for (auto device : devices_) {
+        if (subscribed.insert(device->devName_).second) {
+          Queue(device, "subscribe");
+        }
+      }
+    }
+    delete old_ws;
+    Broadcast("on_sohal_connected");
+    break;
+  }
+}
+
+void NotificationReactor::Broadcast(const char *method) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    targets_.clear();
+    for (auto device : devices_) {
+      if (device->WantsNotifications()) {
+        targets_.push_back(device);
+      }
+    }
+    routing_++;
+  }
+  for (auto device : targets_) {
+    device->SendSignal(method, NULL);
+  }
+  Routed();
+}
+
+// |prefix| is the part of the notification's method before the '.', either
+// the name of the device with its index ("hirescamera@0") or without it for
+// the device of index 0 ("hirescamera")
+void NotificationReactor::FindDevices(const char *prefix, size_t len,
+                                      const char *name, size_t name_len,
+                                      std::vector<HippoDevice*> *devices) {
+  devices->clear();
+  for (auto device : devices_) {
+    const char *dev_name = device->devName_;
+    if (!strncmp(dev_name, prefix, len) &&
+        ('\0' == dev_name[len] || !strcmp(dev_name + len, "@0")) &&
+        device->WantsNotifications() &&
+        device->AcceptsNotification(name, name_len)) {
+      devices->push_back(device);
+    }
+  }
+}
+
+void NotificationReactor::Routed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (0 == --routing_) {
+    routed_cv_.notify_all();
+  }
+}
+
+}  // namespace hippo
@@ -129,7 +129,7 @@ uint64_t HippoSwDevice::disconnect_device() {
 }
 
 // SR: we need to revisit this command and see if can simulate
-// void HippoDevice::WaitForSignalRaw(void) better
+// NotificationReactor::reactor_loop() better
 void HippoSwDevice::WaitForCommand(void) {
   uint64_t err = 0LL;
   unsigned char *signal = NULL;
@@ -576,9 +576,10 @@ void HippoSwDevice::ProcessSignal(char *method, void *obj) {
   }
 
   // now try to cast the json as the various types
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   try {
-    v = params->at(0);
     if (v.is_number_integer()) {
       param.uint32Data = v.get<uint32_t>();
     }
@@ -593,7 +594,7 @@ void HippoSwDevice::ProcessSignal(char *method, void *obj) {
       // copy over the char* interpretation of the parameter
       // This mallocs data which gets freed in the
       // SWDeviceNotificationParam destructor
-      std::string strDat = v.get<std::string>();
+      const std::string &strDat = v.get_ref<const std::string&>();
       param.charData = reinterpret_cast<char*>(malloc(strDat.length() + 1));
       memcpy(param.charData, strDat.c_str(), strDat.length());
       param.charData[strDat.length()] = 0;
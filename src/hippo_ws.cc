@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <libwebsockets.h>
 
+#include <chrono>    // NOLINT
 #include <mutex>     // NOLINT
 #include <thread>    // NOLINT
 #include <atomic>    // NOLINT
@@ -69,6 +70,12 @@ static struct lws_protocols protocols_[] = { {
   },   /* End of list */
 };
 
+// microseconds of the steady clock, used to timestamp the notifications
+static int64_t SteadyTimeUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // returns the next multiple of 'mult' of the input 'value'
 size_t NextMultiple(size_t mult, size_t value) {
   return (mult + value - 1) & ~(mult-1);
@@ -128,7 +135,8 @@ class WsRequest {
 class WsResponse {
  public:
   WsResponse() :
-      data_len_(0), ptr_len_(0), data_(NULL), received_(false) {
+      data_len_(0), ptr_len_(0), data_(NULL), received_(false),
+      received_us_(0) {
   }
 
   ~WsResponse() {
@@ -151,6 +159,7 @@ class WsResponse {
     data_len_ += len;
     if (finalFragment) {
       received_ = true;
+      received_us_ = SteadyTimeUs();
     }
     return 0;
   }
@@ -166,14 +175,42 @@ class WsResponse {
     return HIPPO_OK;
   }
 
+  // copies the data into the caller's |*buffer| of |*buffer_size| bytes,
+  // which is only reallocated if the data does not fit. As in GetData() the
+  // buffer is always a byte longer than the data.
+  HippoError CopyData(unsigned char **buffer, size_t *buffer_size,
+                      size_t *len) {
+    if (!received_) {
+      return HIPPO_READ;
+    }
+    if (data_len_ + 1 > *buffer_size) {
+      size_t size = NextMultiple(128, data_len_ + 1);
+      unsigned char *ptr = (unsigned char*)realloc(*buffer, size);
+      if (NULL == ptr) {
+        return HIPPO_MEM_ALLOC;
+      }
+      *buffer = ptr;
+      *buffer_size = size;
+    }
+    memcpy(*buffer, data_, data_len_);
+    *len = data_len_;
+    return HIPPO_OK;
+  }
+
   bool Received() {
     return received_;
   }
 
+  // the time the last fragment of the message was received
+  int64_t ReceivedUs() {
+    return received_us_;
+  }
+
  private:
   size_t data_len_, ptr_len_;
   unsigned char *data_;
   bool received_;
+  int64_t received_us_;
 };
 
 
@@ -212,11 +249,17 @@ class HippoLWS {
   uint64_t SendRequest(const unsigned char *request, size_t req_len,
                        WsConnectionType type, unsigned int timeout,
                        unsigned char **response, size_t *res_len);
+  uint64_t SendRequest(const unsigned char *request, size_t req_len,
+                       WsConnectionType type, unsigned int timeout,
+                       unsigned char **buffer, size_t *buffer_size,
+                       size_t *res_len);
 
-  uint64_t Read(unsigned char **response, size_t *len, unsigned int timeout);
+  uint64_t Read(unsigned char **response, size_t *len, unsigned int timeout,
+                int64_t *received_us);
   uint64_t Read_p(std::unique_lock<std::mutex> *lock,
                   unsigned char **response, size_t *len,
                   unsigned int timeout);
+  uint64_t Wait_p(std::unique_lock<std::mutex> *lock, unsigned int timeout);
 
   bool Connected(void);
 
@@ -600,8 +643,47 @@ clean_up:
   return err;
 }
 
+// same as above, but the response is copied into the caller's buffer
+uint64_t HippoLWS::SendRequest(const unsigned char *request,
+                               size_t req_len,
+                               WsConnectionType type,
+                               unsigned int timeout,
+                               unsigned char **buffer,
+                               size_t *buffer_size,
+                               size_t *resp_len) {
+  uint64_t err = 0LL;
+  std::unique_lock<std::mutex> lock(ws_mutex_, std::defer_lock);
+  if (CaptureLock(&lock, facility_)) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_ERROR);
+  }
+  if (!connected_) {
+    err = MAKE_HIPPO_ERROR(facility_, HIPPO_WRITE);
+    goto clean_up;
+  }
+  // fill up the request
+  HippoError hr;
+  client_data_.response_.Init();
+  if (hr = client_data_.request_.SetData(request, req_len, type)) {
+    err = MAKE_HIPPO_ERROR(facility_, hr);
+    goto clean_up;
+  }
+  // request a callback so we can write the command to the ws
+  lws_callback_on_writable(lws_);
+
+  if (err = Wait_p(&lock, timeout)) {
+    goto clean_up;
+  }
+  if (hr = client_data_.response_.CopyData(buffer, buffer_size, resp_len)) {
+    err = MAKE_HIPPO_ERROR(facility_, hr);
+  }
+clean_up:
+  lock.unlock();
+
+  return err;
+}
+
 uint64_t HippoLWS::Read(unsigned char **response, size_t *len,
-                        unsigned int timeout) {
+                        unsigned int timeout, int64_t *received_us) {
   uint64_t err = 0;
 
   client_data_.response_.Init();
@@ -611,6 +693,9 @@ uint64_t HippoLWS::Read(unsigned char **response, size_t *len,
     return MAKE_HIPPO_ERROR(facility_, HIPPO_ERROR);
   }
   err = Read_p(&lock, response, len, timeout);
+  if (!err && NULL != received_us) {
+    *received_us = client_data_.response_.ReceivedUs();
+  }
   lock.unlock();
 
   return err;
@@ -623,6 +708,25 @@ uint64_t HippoLWS::Read_p(std::unique_lock<std::mutex> *lock,
   uint64_t err = 0;
   *len = 0;
   *response = NULL;
+  if (err = Wait_p(lock, timeout)) {
+    return err;
+  }
+#ifdef VERBOSE_MSG
+  fprintf(stderr, "%s got data %p\n", __FUNCTION__, this);
+#endif
+  client_data_.response_.GetData(response, len);
+#ifdef VERBOSE_MSG
+  fprintf(stderr, "[%d] %s err: %llx  %s!!\n", GetCurrentThreadId(),
+          __FUNCTION__, err, *response);
+#endif
+  return err;
+}
+
+// Waits for a response to be received. This function expect the lock on the
+// ws_mutex to be captured
+uint64_t HippoLWS::Wait_p(std::unique_lock<std::mutex> *lock,
+                          unsigned int timeout) {
+  uint64_t err = 0;
 #ifdef VERBOSE_MSG
   int tid = GetCurrentThreadId();
 #endif
@@ -655,10 +759,7 @@ uint64_t HippoLWS::Read_p(std::unique_lock<std::mutex> *lock,
 #endif
   }
   if (client_data_.response_.Received()) {
-#ifdef VERBOSE_MSG
-    fprintf(stderr, "%s got data %p\n", __FUNCTION__, this);
-#endif
-    client_data_.response_.GetData(response, len);
+    err = 0LL;
   } else if (cancel_read_) {
 #ifdef VERBOSE_MSG
     fprintf(stderr, "%s cancelled %p\n", __FUNCTION__, this);
@@ -676,10 +777,6 @@ uint64_t HippoLWS::Read_p(std::unique_lock<std::mutex> *lock,
 #endif
     err = MAKE_HIPPO_ERROR(facility_, HIPPO_TIMEOUT);
   }
-#ifdef VERBOSE_MSG
-  fprintf(stderr, "[%d] %s err: %llx  %s!!\n", tid, __FUNCTION__,
-          err, *response);
-#endif
   return err;
 }
 
@@ -775,12 +872,42 @@ uint64_t HippoWS::SendRequest(const unsigned char *request, size_t req_len,
   return hlws_->SendRequest(request, req_len, type, timeout, response, res_len);
 }
 
+uint64_t HippoWS::SendRequest(const unsigned char *request, size_t req_len,
+                              WsConnectionType type, unsigned int timeout,
+                              unsigned char **buffer, size_t *buffer_size,
+                              size_t *res_len) {
+  uint64_t err = 0LL;
+  *res_len = 0;
+
+  if (NULL == request || 0 == req_len || NULL == buffer ||
+      NULL == buffer_size) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (NULL == hlws_) {
+    return MAKE_HIPPO_ERROR(facility_, HIPPO_WRITE);
+  }
+  if (err = hlws_->SendRequest(request, req_len, type, timeout,
+                               buffer, buffer_size, res_len)) {
+    return err;
+  }
+  if (WsConnectionType::TEXT == type) {
+    // the buffer is always a byte longer so we can do this
+    (*buffer)[*res_len] = '\0';
+  }
+  return err;
+}
+
 uint64_t HippoWS::WaitForSignal(unsigned char **response) {
+  return WaitForSignal(response, NULL);
+}
+
+uint64_t HippoWS::WaitForSignal(unsigned char **response,
+                                int64_t *received_us) {
   uint64_t err;
   size_t len;
   unsigned int timeout = 0;         // wait forever
 
-  if (err = hlws_->Read(response, &len, timeout)) {
+  if (err = hlws_->Read(response, &len, timeout, received_us)) {
     return err;
   }
   if (*response) {
@@ -799,7 +926,7 @@ uint64_t HippoWS::ReadResponse(unsigned char **response) {
   size_t len;
   unsigned int timeout = 10;      // in seconds
 
-  if (err = hlws_->Read(response, &len, timeout)) {
+  if (err = hlws_->Read(response, &len, timeout, NULL)) {
     return err;
   }
   if (*response) {
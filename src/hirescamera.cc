@@ -14,8 +14,26 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "hirescamera";
+// the scalar properties
+const char kAutoExposure[] = "auto_exposure";
+const char kAutoGain[] = "auto_gain";
+const char kAutoWhiteBalance[] = "auto_white_balance";
+const char kBrightness[] = "brightness";
+const char kCameraIndex[] = "camera_index";
+const char kContrast[] = "contrast";
+const char kExposure[] = "exposure";
+const char kFlipFrame[] = "flip_frame";
+const char kGain[] = "gain";
+const char kGammaCorrection[] = "gamma_correction";
+const char kLensColorShading[] = "lens_color_shading";
+const char kLensShading[] = "lens_shading";
+const char kMirrorFrame[] = "mirror_frame";
+const char kSaturation[] = "saturation";
+const char kSharpness[] = "sharpness";
+const char kWhiteBalanceTemperature[] = "white_balance_temperature";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *HiResCameraNotification_str[];
 
 HiResCamera::HiResCamera() :
     HippoCamera(devName, defaultHost, defaultPort, HIPPO_HIRESCAMERA, 0),
@@ -43,55 +61,55 @@ HiResCamera::~HiResCamera(void) {
 }
 
 uint64_t HiResCamera::auto_exposure(bool set) {
-  return bool_set_get("auto_exposure", set, NULL);
+  return property<bool, kAutoExposure>(set, NULL);
 }
 
 uint64_t HiResCamera::auto_exposure(bool *get) {
-  return bool_get("auto_exposure", get);
+  return property<bool, kAutoExposure>(get);
 }
 
 uint64_t HiResCamera::auto_exposure(bool set, bool* get) {
-  return bool_set_get("auto_exposure", set, get);
+  return property<bool, kAutoExposure>(set, get);
 }
 
 uint64_t HiResCamera::auto_gain(bool set) {
-  return bool_set_get("auto_gain", set, NULL);
+  return property<bool, kAutoGain>(set, NULL);
 }
 
 uint64_t HiResCamera::auto_gain(bool *get) {
-  return bool_get("auto_gain", get);
+  return property<bool, kAutoGain>(get);
 }
 
 uint64_t HiResCamera::auto_gain(bool set, bool* get) {
-  return bool_set_get("auto_gain", set, get);
+  return property<bool, kAutoGain>(set, get);
 }
 
 uint64_t HiResCamera::auto_white_balance(bool set) {
-  return bool_set_get("auto_white_balance", set, NULL);
+  return property<bool, kAutoWhiteBalance>(set, NULL);
 }
 
 uint64_t HiResCamera::auto_white_balance(bool *get) {
-  return bool_get("auto_white_balance", get);
+  return property<bool, kAutoWhiteBalance>(get);
 }
 
 uint64_t HiResCamera::auto_white_balance(bool set, bool *get) {
-  return bool_set_get("auto_white_balance", set, get);
+  return property<bool, kAutoWhiteBalance>(set, get);
 }
 
 uint64_t HiResCamera::brightness(uint16_t set) {
-  return  uint16_set_get("brightness", set, NULL);
+  return property<uint16_t, kBrightness>(set, NULL);
 }
 
 uint64_t HiResCamera::brightness(uint16_t *get) {
-  return uint16_get("brightness", get);
+  return property<uint16_t, kBrightness>(get);
 }
 
 uint64_t HiResCamera::brightness(uint16_t set, uint16_t *get) {
-  return uint16_set_get("brightness", set, get);
+  return property<uint16_t, kBrightness>(set, get);
 }
 
 uint64_t HiResCamera::camera_index(uint32_t *get) {
-  return uint32_get("camera_index", get);
+  return property<uint32_t, kCameraIndex>(get);
 }
 
 uint64_t HiResCamera::camera_settings(const CameraSettings &set) {
@@ -106,7 +124,7 @@ uint64_t HiResCamera::camera_settings(CameraSettings *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("camera_settings", jptr)) {
+  if (err = SendReadMsg("camera_settings", jptr)) {
     return err;
   }
   if (err = CameraSettings_json2c(jptr, get)) {
@@ -138,15 +156,15 @@ uint64_t HiResCamera::camera_settings(const CameraSettings &set,
 }
 
 uint64_t HiResCamera::contrast(uint16_t set) {
-  return  uint16_set_get("contrast", set, NULL);
+  return property<uint16_t, kContrast>(set, NULL);
 }
 
 uint64_t HiResCamera::contrast(uint16_t *get) {
-  return uint16_get("contrast", get);
+  return property<uint16_t, kContrast>(get);
 }
 
 uint64_t HiResCamera::contrast(uint16_t set, uint16_t *get) {
-  return uint16_set_get("contrast", set, get);
+  return property<uint16_t, kContrast>(set, get);
 }
 
 uint64_t HiResCamera::default_config(CameraMode mode, CameraConfig *get) {
@@ -173,7 +191,7 @@ uint64_t HiResCamera::device_status(CameraDeviceStatus *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("device_status", jptr)) {
+  if (err = SendReadMsg("device_status", jptr)) {
     return err;
   }
   if (err = CameraDeviceStatus_json2c(jptr, get)) {
@@ -183,51 +201,51 @@ uint64_t HiResCamera::device_status(CameraDeviceStatus *get) {
 }
 
 uint64_t HiResCamera::exposure(uint16_t set) {
-  return  uint16_set_get("exposure", set, NULL);
+  return property<uint16_t, kExposure>(set, NULL);
 }
 
 uint64_t HiResCamera::exposure(uint16_t *get) {
-  return uint16_get("exposure", get);
+  return property<uint16_t, kExposure>(get);
 }
 
 uint64_t HiResCamera::exposure(uint16_t set, uint16_t *get) {
-  return uint16_set_get("exposure", set, get);
+  return property<uint16_t, kExposure>(set, get);
 }
 
 uint64_t HiResCamera::flip_frame(bool set) {
-  return bool_set_get("flip_frame", set, NULL);
+  return property<bool, kFlipFrame>(set, NULL);
 }
 
 uint64_t HiResCamera::flip_frame(bool *get) {
-  return bool_get("flip_frame", get);
+  return property<bool, kFlipFrame>(get);
 }
 
 uint64_t HiResCamera::flip_frame(bool set, bool *get) {
-  return bool_set_get("flip_frame", set, get);
+  return property<bool, kFlipFrame>(set, get);
 }
 
 uint64_t HiResCamera::gain(uint16_t set) {
-  return uint16_set_get("gain", set, NULL);
+  return property<uint16_t, kGain>(set, NULL);
 }
 
 uint64_t HiResCamera::gain(uint16_t *get) {
-  return uint16_get("gain", get);
+  return property<uint16_t, kGain>(get);
 }
 
 uint64_t HiResCamera::gain(uint16_t set, uint16_t *get) {
-  return uint16_set_get("gain", set, get);
+  return property<uint16_t, kGain>(set, get);
 }
 
 uint64_t HiResCamera::gamma_correction(bool set) {
-  return bool_set_get("gamma_correction", set, NULL);
+  return property<bool, kGammaCorrection>(set, NULL);
 }
 
 uint64_t HiResCamera::gamma_correction(bool *get) {
-  return bool_get("gamma_correction", get);
+  return property<bool, kGammaCorrection>(get);
 }
 
 uint64_t HiResCamera::gamma_correction(bool set, bool *get) {
-  return bool_set_get("gamma_correction", set, get);
+  return property<bool, kGammaCorrection>(set, get);
 }
 
 uint64_t HiResCamera::keystone(CameraKeystone *get) {
@@ -237,7 +255,7 @@ uint64_t HiResCamera::keystone(CameraKeystone *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("keystone", jptr)) {
+  if (err = SendReadMsg("keystone", jptr)) {
     return err;
   }
   if (err = CameraKeystone_json2c(jptr, get)) {
@@ -274,7 +292,7 @@ uint64_t HiResCamera::keystone_table(CameraKeystoneTable *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("keystone_table", jptr)) {
+  if (err = SendReadMsg("keystone_table", jptr)) {
     return err;
   }
   if (err = CameraKeystoneTable_json2c(jptr, get)) {
@@ -308,6 +326,13 @@ uint64_t HiResCamera::keystone_table(const CameraKeystoneTable &set,
 uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &param,
                                              CameraKeystoneTableEntries *get,
                                              uint32_t *num_entries) {
+  return keystone_table_entries(param, get, num_entries, NULL);
+}
+
+uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &param,
+                                             CameraKeystoneTableEntries *get,
+                                             uint32_t *num_entries,
+                                             ResultArena *arena) {
   uint64_t err = HIPPO_OK;
   nl::json jset, jget;
   void *jsetptr = reinterpret_cast<void*>(&jset);
@@ -319,7 +344,8 @@ uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &param,
     return err;
   }
   if (get != NULL) {
-    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_entries);
+    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_entries,
+                                            arena);
   }
   return err;
 }
@@ -329,6 +355,16 @@ uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &table,
                                              uint32_t num_resolutions,
                                              CameraKeystoneTableEntries *get,
                                              uint32_t *num_entries) {
+  return keystone_table_entries(table, resoution_list, num_resolutions,
+                                get, num_entries, NULL);
+}
+
+uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &table,
+                                             CameraResolution *resoution_list,
+                                             uint32_t num_resolutions,
+                                             CameraKeystoneTableEntries *get,
+                                             uint32_t *num_entries,
+                                             ResultArena *arena) {
   uint64_t err = HIPPO_OK;
   nl::json jset, jget;
   void *jsetptr = reinterpret_cast<void*>(&jset);
@@ -344,7 +380,8 @@ uint64_t HiResCamera::keystone_table_entries(const CameraKeystoneTable &table,
     return err;
   }
   if (get != NULL) {
-    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_entries);
+    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_entries,
+                                            arena);
   }
   return err;
 }
@@ -373,7 +410,8 @@ uint64_t HiResCamera::keystone_table_entries(
     return err;
   }
   if (get != NULL) {
-    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_get_entries);
+    err = CameraKeystoneTableEntries_json2c(jgetptr, get, num_get_entries,
+                                            NULL);
   }
   return err;
 }
@@ -394,7 +432,7 @@ uint64_t HiResCamera::led_state(CameraLedState *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("led_state", jptr)) {
+  if (err = SendReadMsg("led_state", jptr)) {
     return err;
   }
   if (err = CameraLedState_json2c(jptr, get)) {
@@ -426,39 +464,39 @@ uint64_t HiResCamera::led_state(const CameraLedState &set,
 
 
 uint64_t HiResCamera::lens_color_shading(bool set) {
-  return bool_set_get("lens_color_shading", set, NULL);
+  return property<bool, kLensColorShading>(set, NULL);
 }
 
 uint64_t HiResCamera::lens_color_shading(bool *get) {
-  return bool_get("lens_color_shading", get);
+  return property<bool, kLensColorShading>(get);
 }
 
 uint64_t HiResCamera::lens_color_shading(bool set, bool *get) {
-  return bool_set_get("lens_color_shading", set, get);
+  return property<bool, kLensColorShading>(set, get);
 }
 
 uint64_t HiResCamera::lens_shading(bool set) {
-  return bool_set_get("lens_shading", set, NULL);
+  return property<bool, kLensShading>(set, NULL);
 }
 
 uint64_t HiResCamera::lens_shading(bool *get) {
-  return bool_get("lens_shading", get);
+  return property<bool, kLensShading>(get);
 }
 
 uint64_t HiResCamera::lens_shading(bool set, bool *get) {
-  return bool_set_get("lens_shading", set, get);
+  return property<bool, kLensShading>(set, get);
 }
 
 uint64_t HiResCamera::mirror_frame(bool set) {
-  return bool_set_get("mirror_frame", set, NULL);
+  return property<bool, kMirrorFrame>(set, NULL);
 }
 
 uint64_t HiResCamera::mirror_frame(bool *get) {
-  return bool_get("mirror_frame", get);
+  return property<bool, kMirrorFrame>(get);
 }
 
 uint64_t HiResCamera::mirror_frame(bool set, bool *get) {
-  return bool_set_get("mirror_frame", set, get);
+  return property<bool, kMirrorFrame>(set, get);
 }
 
 uint64_t HiResCamera::parent_resolution(CameraResolution *get) {
@@ -468,7 +506,7 @@ uint64_t HiResCamera::parent_resolution(CameraResolution *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("parent_resolution", jptr)) {
+  if (err = SendReadMsg("parent_resolution", jptr)) {
     return err;
   }
   if (err = Resolution_json2c(jptr, get)) {
@@ -502,7 +540,7 @@ uint64_t HiResCamera::power_line_frequency(PowerLineFrequency *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("power_line_frequency", jptr)) {
+  if (err = SendReadMsg("power_line_frequency", jptr)) {
     return err;
   }
   if (err = PowerLineFrequency_json2c(jptr, get)) {
@@ -539,27 +577,27 @@ uint64_t HiResCamera::reset() {
 }
 
 uint64_t HiResCamera::saturation(uint16_t set) {
-  return uint16_set_get("saturation", set, NULL);
+  return property<uint16_t, kSaturation>(set, NULL);
 }
 
 uint64_t HiResCamera::saturation(uint16_t *get) {
-  return uint16_get("saturation", get);
+  return property<uint16_t, kSaturation>(get);
 }
 
 uint64_t HiResCamera::saturation(uint16_t set, uint16_t *get) {
-  return uint16_set_get("saturation", set, get);
+  return property<uint16_t, kSaturation>(set, get);
 }
 
 uint64_t HiResCamera::sharpness(uint16_t set) {
-  return uint16_set_get("sharpness", set, NULL);
+  return property<uint16_t, kSharpness>(set, NULL);
 }
 
 uint64_t HiResCamera::sharpness(uint16_t *get) {
-  return uint16_get("sharpness", get);
+  return property<uint16_t, kSharpness>(get);
 }
 
 uint64_t HiResCamera::sharpness(uint16_t set, uint16_t *get) {
-  return uint16_set_get("sharpness", set, get);
+  return property<uint16_t, kSharpness>(set, get);
 }
 
 uint64_t HiResCamera::streaming_resolution(CameraResolution *get) {
@@ -569,7 +607,7 @@ uint64_t HiResCamera::streaming_resolution(CameraResolution *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("streaming_resolution", jptr)) {
+  if (err = SendReadMsg("streaming_resolution", jptr)) {
     return err;
   }
   if (err = Resolution_json2c(jptr, get)) {
@@ -598,9 +636,18 @@ uint64_t HiResCamera::subscribe(
 uint64_t HiResCamera::subscribe(
     void (*callback)(const HiResCameraNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t HiResCamera::subscribe(
+    void (*callback)(const HiResCameraNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      HiResCameraNotification::on_white_balance_temperature);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, HiResCameraNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -608,6 +655,25 @@ uint64_t HiResCamera::subscribe(
   return err;
 }
 
+uint64_t HiResCamera::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t HiResCamera::subscribe(uint32_t queue_depth, uint64_t mask,
+                                uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      HiResCameraNotification::on_white_balance_temperature);
+
+  callback_ = NULL;
+  return subscribe_queue<HiResCameraNotificationParam>(
+      queue_depth, mask, HiResCameraNotification_str, num_names, get);
+}
+
+uint64_t HiResCamera::poll(HiResCameraNotificationParam *params,
+                           uint32_t max_params, uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t HiResCamera::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -629,7 +695,7 @@ uint64_t HiResCamera::white_balance(hippo::Rgb *get) {
   }
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("white_balance", jptr)) {
+  if (err = SendReadMsg("white_balance", jptr)) {
     return err;
   }
   if (err = WhiteBalance_json2c(jptr, get)) {
@@ -657,15 +723,15 @@ uint64_t HiResCamera::white_balance(const hippo::Rgb &set,
 }
 
 uint64_t HiResCamera::white_balance_temperature(uint16_t set) {
-  return  uint16_set_get("white_balance_temperature", set, NULL);
+  return property<uint16_t, kWhiteBalanceTemperature>(set, NULL);
 }
 
 uint64_t HiResCamera::white_balance_temperature(uint16_t *get) {
-  return uint16_get("white_balance_temperature", get);
+  return property<uint16_t, kWhiteBalanceTemperature>(get);
 }
 
 uint64_t HiResCamera::white_balance_temperature(uint16_t set, uint16_t *get) {
-  return uint16_set_get("white_balance_temperature", set, get);
+  return property<uint16_t, kWhiteBalanceTemperature>(set, get);
 }
 
 /////////////////
@@ -729,10 +795,10 @@ uint64_t HiResCamera::CameraQuadrilateral_json2c(const void *obj,
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
 
-    auto tl = quadData->at("top_left");
-    auto tr = quadData->at("top_right");
-    auto bl = quadData->at("bottom_left");
-    auto br = quadData->at("bottom_right");
+    const nl::json &tl = quadData->at("top_left");
+    const nl::json &tr = quadData->at("top_right");
+    const nl::json &bl = quadData->at("bottom_left");
+    const nl::json &br = quadData->at("bottom_right");
 
     // validate that values are the expected type
     if (!tl.is_object() ||
@@ -882,7 +948,8 @@ uint64_t HiResCamera::CameraKeystoneTable_json2c(
     }
     // convert the type
     int32_t idx;
-    std::string ksTableData = keystoneTableData->get<std::string>();
+    const std::string &ksTableData =
+        keystoneTableData->get_ref<const std::string&>();
     idx = str_to_idx(HiResCameraKeystoneTable_str,
                      ksTableData.c_str(),
                      static_cast<uint32_t>(
@@ -954,9 +1021,9 @@ uint64_t HiResCamera::CameraKeystoneTableEntry_json2c(
     if (!keystoneData->is_object()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
-    auto jsonEnabled = keystoneData->at("enabled");
-    auto jsonValue = keystoneData->at("value");
-    auto jsonResolution = keystoneData->at("resolution");
+    const nl::json &jsonEnabled = keystoneData->at("enabled");
+    const nl::json &jsonValue = keystoneData->at("value");
+    const nl::json &jsonResolution = keystoneData->at("resolution");
     // validate that values are the expected type
     if (!jsonEnabled.is_boolean() ||
         !jsonValue.is_object() ||
@@ -1036,7 +1103,8 @@ uint64_t HiResCamera::CameraKeystoneTableEntries_c2json(
 
 uint64_t HiResCamera::CameraKeystoneTableEntries_json2c(const void *obj,
                                            CameraKeystoneTableEntries *get,
-                                           uint32_t *num_entries) {
+                                           uint32_t *num_entries,
+                                           ResultArena *arena) {
   uint64_t err = HIPPO_OK;
   if (obj == NULL || get == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
@@ -1051,8 +1119,8 @@ uint64_t HiResCamera::CameraKeystoneTableEntries_json2c(const void *obj,
     if (!keystoneEntries->is_object()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
-    auto jsonType = keystoneEntries->at("type");
-    auto jsonEntries = keystoneEntries->at("entries");
+    const nl::json &jsonType = keystoneEntries->at("type");
+    const nl::json &jsonEntries = keystoneEntries->at("entries");
     // validate that values are the expected type
     if (!jsonType.is_string() ||
         !jsonEntries.is_array()) {
@@ -1072,7 +1140,10 @@ uint64_t HiResCamera::CameraKeystoneTableEntries_json2c(const void *obj,
 
     // allocate the memory to store the CameraKeystoneTableEntries
     get->entries = reinterpret_cast<CameraKeystoneTableEntry*>(
-      calloc(num_items, sizeof(CameraKeystoneTableEntry)));
+      ArenaCalloc(arena, num_items, sizeof(CameraKeystoneTableEntry)));
+    if (NULL == get->entries) {
+      return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
+    }
 
     for (int i = 0; i < num_items; i++) {
       if (err = CameraKeystoneTableEntry_json2c(&jsonEntries.at(i),
@@ -1089,7 +1160,7 @@ uint64_t HiResCamera::CameraKeystoneTableEntries_json2c(const void *obj,
 }
 
 
-uint64_t HiResCamera::ParsePointJson(void *jsonPoint, Point *cPoint) {
+uint64_t HiResCamera::ParsePointJson(const void *jsonPoint, Point *cPoint) {
   if (jsonPoint == NULL || cPoint == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
   }
@@ -1098,8 +1169,8 @@ uint64_t HiResCamera::ParsePointJson(void *jsonPoint, Point *cPoint) {
     if (!jPoint->is_object()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
-    auto jx = jPoint->at("x");
-    auto jy = jPoint->at("y");
+    const nl::json &jx = jPoint->at("x");
+    const nl::json &jy = jPoint->at("y");
     if (!jx.is_number_integer() || !jy.is_number_integer()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
@@ -1140,9 +1211,9 @@ uint64_t HiResCamera::Resolution_json2c(const void *obj,
     }
 
     // get the actual height and width values from their parents
-    auto res_height = jsonRes->at("height");
-    auto res_width = jsonRes->at("width");
-    auto res_fps = jsonRes->at("fps");
+    const nl::json &res_height = jsonRes->at("height");
+    const nl::json &res_width = jsonRes->at("width");
+    const nl::json &res_fps = jsonRes->at("fps");
 
     // validate that they are integers
     if (!res_height.is_number_integer() ||
@@ -1226,9 +1297,9 @@ uint64_t HiResCamera::Strobe_json2c(const void *obj,
   uint64_t err = 0LL;
   const nl::json *strobeData = reinterpret_cast<const nl::json*>(obj);
   try {
-    auto jsonExposure = strobeData->at("exposure");
-    auto jsonGain = strobeData->at("gain");
-    auto jsonFrames = strobeData->at("frames");
+    const nl::json &jsonExposure = strobeData->at("exposure");
+    const nl::json &jsonGain = strobeData->at("gain");
+    const nl::json &jsonFrames = strobeData->at("frames");
 
     if (!jsonExposure.is_number_integer() ||
         !jsonGain.is_number_integer() ||
@@ -1668,7 +1739,7 @@ uint64_t HiResCamera::Bool_json2c(const void *obj, const char *key, bool *get) {
 }
 
 bool HiResCamera::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *HiResCameraNotification_str[] = {
@@ -1684,7 +1755,7 @@ const char *HiResCameraNotification_str[] = {
 };
 
 void HiResCamera::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -1695,16 +1766,15 @@ void HiResCamera::ProcessSignal(char *method, void *obj) {
                        HiResCameraNotification::on_close),
                    static_cast<uint32_t>(
                        HiResCameraNotification::on_white_balance_temperature));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
+  // the keystone table entries passed to a callback are decoded in the
+  // notification arena, which reuses its memory from one to the next
+  ResultArena *arena = (NULL != callback_) ? NotificationArena() : NULL;
   HiResCameraNotificationParam param;
   param.type = static_cast<hippo::HiResCameraNotification>(idx);
 
@@ -1782,7 +1852,8 @@ void HiResCamera::ProcessSignal(char *method, void *obj) {
     case HiResCameraNotification::on_keystone_table_entries:
       err = CameraKeystoneTableEntries_json2c(reinterpret_cast<const void*>(&v),
                                         &param.on_keystone_table_entries,
-                                        &param.num_keystone_table_entries);
+                                        &param.num_keystone_table_entries,
+                                        arena);
       break;
 
     case HiResCameraNotification::on_strobe:
@@ -1803,9 +1874,19 @@ void HiResCamera::ProcessSignal(char *method, void *obj) {
     default:
       break;
   }
-  // call the callback function
+  // call the callback function, or queue the notification when polling
+  bool queued = false;
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      queued = QueueNotification(param);
+    }
+  }
+  // a queued notification is freed by the application after poll(), and
+  // the arena is reset by the next notification
+  if (queued || NULL != arena) {
+    return;
   }
 
   // and clean up
@@ -1818,8 +1899,6 @@ void HiResCamera::ProcessSignal(char *method, void *obj) {
   default:
     break;
   }
-
-  delete params;
 }
 
 }  // namespace hippo
@@ -0,0 +1,143 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include "../include/keystone_warp.h"
+
+namespace hippo {
+
+static inline double Clamp(double value, double low, double high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+KeystoneWarp::KeystoneWarp() : KeystoneWarp(0, SimdLevel::avx2) {
+}
+
+KeystoneWarp::KeystoneWarp(uint32_t num_threads, SimdLevel max_simd) :
+    num_threads_(num_threads) {
+  level_ = PixelConverter::DetectSimdLevel();
+  if (max_simd < level_) {
+    level_ = max_simd;
+  }
+  memset(&table_, 0, sizeof(table_));
+}
+
+KeystoneWarp::~KeystoneWarp(void) {
+  internal::FreeRemapTable(&table_);
+}
+
+uint64_t KeystoneWarp::SetQuadrilateral(const CameraQuadrilateral &quad,
+                                        uint32_t src_width,
+                                        uint32_t src_height,
+                                        uint32_t dst_width,
+                                        uint32_t dst_height) {
+  const double corners[4][2] = {
+    { static_cast<double>(quad.top_left.x),
+      static_cast<double>(quad.top_left.y) },
+    { static_cast<double>(quad.top_right.x),
+      static_cast<double>(quad.top_right.y) },
+    { static_cast<double>(quad.bottom_right.x),
+      static_cast<double>(quad.bottom_right.y) },
+    { static_cast<double>(quad.bottom_left.x),
+      static_cast<double>(quad.bottom_left.y) },
+  };
+  return SetCorners(corners, src_width, src_height, dst_width, dst_height);
+}
+
+uint64_t KeystoneWarp::SetKeystone(const CameraKeystoneTableEntry &entry,
+                                   uint32_t effective_width,
+                                   uint32_t effective_height,
+                                   uint32_t dst_width, uint32_t dst_height) {
+  const double frame_width = entry.resolution.width;
+  const double frame_height = entry.resolution.height;
+
+  if (0 == effective_width || 0 == effective_height ||
+      0 == entry.resolution.width || 0 == entry.resolution.height) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  // the frame is the effective size scaled to cover it, and cropped
+  double scale_x = frame_width / effective_width;
+  double scale_y = frame_height / effective_height;
+  double scale = scale_x > scale_y ? scale_x : scale_y;
+  double crop_x = (effective_width * scale - frame_width) / 2.0;
+  double crop_y = (effective_height * scale - frame_height) / 2.0;
+  double right = effective_width - 1.0, bottom = effective_height - 1.0;
+  // the camera streams the whole frame when the keystone is disabled
+  const Point zero = { 0, 0 };
+  const Point *offsets[4] = {
+    &entry.value.top_left, &entry.value.top_right,
+    &entry.value.bottom_right, &entry.value.bottom_left,
+  };
+  const double base[4][2] = {
+    { 0.0, 0.0 }, { right, 0.0 }, { right, bottom }, { 0.0, bottom },
+  };
+  double corners[4][2];
+  for (uint32_t i = 0; i < 4; i++) {
+    const Point &offset = entry.enabled ? *offsets[i] : zero;
+    // pixel centers of the effective size to pixel centers of the frame
+    corners[i][0] = (base[i][0] + offset.x + 0.5) * scale - 0.5 - crop_x;
+    corners[i][1] = (base[i][1] + offset.y + 0.5) * scale - 0.5 - crop_y;
+    // the corners of a downscaled frame are less than a pixel out
+    corners[i][0] = Clamp(corners[i][0], 0.0, frame_width - 1.0);
+    corners[i][1] = Clamp(corners[i][1], 0.0, frame_height - 1.0);
+  }
+  return SetCorners(corners, entry.resolution.width,
+                    entry.resolution.height, dst_width, dst_height);
+}
+
+// the homography from the unit square to the quadrilateral (Heckbert,
+// "Fundamentals of Texture Mapping and Image Warping"), evaluated for each
+// output pixel
+uint64_t KeystoneWarp::SetCorners(const double corners[4][2],
+                                  uint32_t src_width, uint32_t src_height,
+                                  uint32_t dst_width, uint32_t dst_height) {
+  uint64_t err = 0LL;
+  const double x0 = corners[0][0], y0 = corners[0][1];
+  const double x1 = corners[1][0], y1 = corners[1][1];
+  const double x2 = corners[2][0], y2 = corners[2][1];
+  const double x3 = corners[3][0], y3 = corners[3][1];
+
+  // convex: the turns at all the corners go the same way
+  double turns[4];
+  for (uint32_t i = 0; i < 4; i++) {
+    const double *a = corners[i];
+    const double *b = corners[(i + 1) % 4];
+    const double *c = corners[(i + 2) % 4];
+    turns[i] = (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+  }
+  for (uint32_t i = 0; i < 4; i++) {
+    if (!(turns[i] > 0.0)) {
+      return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+    }
+  }
+  double sx = x0 - x1 + x2 - x3, sy = y0 - y1 + y2 - y3;
+  double dx1 = x1 - x2, dx2 = x3 - x2, dy1 = y1 - y2, dy2 = y3 - y2;
+  double den = dx1 * dy2 - dx2 * dy1;
+  double g = (sx * dy2 - dx2 * sy) / den;
+  double h = (dx1 * sy - sx * dy1) / den;
+  double a = x1 - x0 + g * x1, b = x3 - x0 + h * x3, c = x0;
+  double d = y1 - y0 + g * y1, e = y3 - y0 + h * y3, f = y0;
+
+  if (err = internal::AllocateRemapTable(src_width, src_height, dst_width,
+                                         dst_height, &table_)) {
+    return err;
+  }
+  double step_s = dst_width > 1 ? 1.0 / (dst_width - 1) : 0.0;
+  double step_t = dst_height > 1 ? 1.0 / (dst_height - 1) : 0.0;
+  internal::BuildRemapTable(num_threads_,
+                            [&](uint32_t u, uint32_t v, double *x, double *y) {
+    double s = u * step_s, t = v * step_t;
+    double w = g * s + h * t + 1.0;
+    *x = (a * s + b * t + c) / w;
+    *y = (d * s + e * t + f) / w;
+  }, &table_);
+
+  return HIPPO_OK;
+}
+
+uint64_t KeystoneWarp::Warp(const PixelBuffer &src, const PixelBuffer &dst) {
+  return internal::Remap(table_, src, dst, num_threads_, level_);
+}
+
+}  // namespace hippo
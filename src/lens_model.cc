@@ -0,0 +1,88 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include "../include/lens_model.h"
+
+namespace hippo {
+
+// iterations of UndistortPoint(): it converges to well under a hundredth of
+// a pixel within the field of view of the cameras
+const uint32_t kUndistortIterations = 10;
+
+void LensModelFromCalibration(const CalibrationIntrinsics &intrinsics,
+                              const CalibrationDistortion &distortion,
+                              LensModel *model) {
+  memset(model, 0, sizeof(*model));
+  model->fx = intrinsics.fx;
+  model->fy = intrinsics.fy;
+  model->cx = intrinsics.cx;
+  model->cy = intrinsics.cy;
+  model->k[0] = distortion.k1;
+  model->k[1] = distortion.k2;
+  model->k[2] = distortion.k3;
+  model->p[0] = distortion.p1;
+  model->p[1] = distortion.p2;
+}
+
+uint64_t LensModelFromCameraParameters(const CameraParameters &parameters,
+                                       uint32_t width, uint32_t height,
+                                       LensModel *model) {
+  if (NULL == model) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (0 == parameters.calibration_resolution.width ||
+      0 == parameters.calibration_resolution.height ||
+      0 == width || 0 == height) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  float scale_x = static_cast<float>(width) /
+      static_cast<float>(parameters.calibration_resolution.width);
+  float scale_y = static_cast<float>(height) /
+      static_cast<float>(parameters.calibration_resolution.height);
+  model->fx = parameters.focal_length.x * scale_x;
+  model->fy = parameters.focal_length.y * scale_y;
+  // the center of the distortion is the principal point of the camera
+  model->cx = parameters.lens_distortion.center.x * scale_x;
+  model->cy = parameters.lens_distortion.center.y * scale_y;
+  memcpy(model->k, parameters.lens_distortion.kappa, sizeof(model->k));
+  memcpy(model->p, parameters.lens_distortion.p, sizeof(model->p));
+
+  return HIPPO_OK;
+}
+
+// the radial factor and the tangential offsets of the normalized (x, y)
+static void Distortion(const LensModel &model, double x, double y,
+                       double *radial, double *dx, double *dy) {
+  double r2 = x * x + y * y;
+  *radial = (1.0 + r2 * (model.k[0] + r2 * (model.k[1] + r2 * model.k[2]))) /
+      (1.0 + r2 * (model.k[3] + r2 * (model.k[4] + r2 * model.k[5])));
+  *dx = 2.0 * model.p[0] * x * y + model.p[1] * (r2 + 2.0 * x * x);
+  *dy = model.p[0] * (r2 + 2.0 * y * y) + 2.0 * model.p[1] * x * y;
+}
+
+void DistortPoint(const LensModel &model, double x, double y,
+                  double *u, double *v) {
+  double radial, dx, dy;
+  Distortion(model, x, y, &radial, &dx, &dy);
+  *u = model.fx * (x * radial + dx) + model.cx;
+  *v = model.fy * (y * radial + dy) + model.cy;
+}
+
+void UndistortPoint(const LensModel &model, double u, double v,
+                    double *x, double *y) {
+  double xd = (u - model.cx) / model.fx;
+  double yd = (v - model.cy) / model.fy;
+  double radial, dx, dy;
+
+  *x = xd;
+  *y = yd;
+  for (uint32_t i = 0; i < kUndistortIterations; i++) {
+    Distortion(model, *x, *y, &radial, &dx, &dy);
+    *x = (xd - dx) / radial;
+    *y = (yd - dy) / radial;
+  }
+}
+
+}  // namespace hippo
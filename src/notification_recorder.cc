@@ -0,0 +1,264 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>   // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>   // NOLINT
+
+#include "../include/notification_recorder.h"
+#include "../include/hippo_dispatcher.h"   // for SteadyTimeUs
+#include "../include/hippo_reactor.h"
+
+namespace hippo {
+
+const char kRecordingMagic[] = "HPNR";
+const uint32_t kRecordingVersion = 1;
+// magic and version
+const size_t kRecordingHeaderLen = 8;
+// a LEB128 encoded uint64_t takes up to 10 bytes
+const size_t kMaxVarintLen = 10;
+
+// the recording in progress, if any
+std::mutex gRecorderMutex;
+std::atomic<bool> gRecording(false);
+FILE *gRecordingFile = NULL;
+int64_t gLastFrameUs = 0;
+uint64_t gNumFrames = 0;
+
+// writes |value| to |buf| as a LEB128 varint and returns its length
+static size_t PutVarint(uint64_t value, unsigned char *buf) {
+  size_t len = 0;
+  do {
+    buf[len] = static_cast<unsigned char>(value & 0x7f);
+    value >>= 7;
+    if (value) {
+      buf[len] |= 0x80;
+    }
+    len++;
+  } while (value);
+  return len;
+}
+
+// reads a LEB128 varint at |*pos| (not past |end|) and moves |*pos| past it
+static bool GetVarint(const unsigned char **pos, const unsigned char *end,
+                      uint64_t *value) {
+  *value = 0;
+  for (uint32_t shift = 0; *pos < end && shift < 64; shift += 7) {
+    unsigned char byte = *(*pos)++;
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (0 == (byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t NotificationRecorder::Start(const char *path) {
+  if (NULL == path) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  std::lock_guard<std::mutex> lock(gRecorderMutex);
+
+  if (NULL != gRecordingFile) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  FILE *file = fopen(path, "wb");
+  if (NULL == file) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_OPEN);
+  }
+  unsigned char header[kRecordingHeaderLen];
+  memcpy(header, kRecordingMagic, 4);
+  for (uint32_t i = 0; i < 4; i++) {     // little endian
+    header[4 + i] = static_cast<unsigned char>(kRecordingVersion >> (8 * i));
+  }
+  if (sizeof(header) != fwrite(header, 1, sizeof(header), file)) {
+    fclose(file);
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRITE);
+  }
+  gRecordingFile = file;
+  gLastFrameUs = 0;
+  gNumFrames = 0;
+  gRecording = true;
+
+  return HIPPO_OK;
+}
+
+uint64_t NotificationRecorder::Stop(uint64_t *num_frames) {
+  uint64_t err = 0LL;
+  std::lock_guard<std::mutex> lock(gRecorderMutex);
+
+  if (NULL == gRecordingFile) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  gRecording = false;
+  if (fclose(gRecordingFile)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRITE);
+  }
+  gRecordingFile = NULL;
+  if (NULL != num_frames) {
+    *num_frames = gNumFrames;
+  }
+  return err;
+}
+
+// called from the reactor threads with every message received from SoHal
+void NotificationRecorder::Record(const unsigned char *frame,
+                                  int64_t received_us) {
+  if (!gRecording) {
+    return;
+  }
+  // the responses to the subscribe requests don't have a method
+  const char *msg = reinterpret_cast<const char*>(frame);
+  if (NULL == strstr(msg, "\"method\"")) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(gRecorderMutex);
+
+  if (NULL == gRecordingFile) {
+    return;
+  }
+  int64_t delta_us = gNumFrames ? received_us - gLastFrameUs : 0;
+  size_t frame_len = strlen(msg) + 1;   // with the null character
+  unsigned char header[2 * kMaxVarintLen];
+  size_t header_len =
+      PutVarint(static_cast<uint64_t>(delta_us > 0 ? delta_us : 0), header);
+  header_len += PutVarint(frame_len, header + header_len);
+  if (header_len != fwrite(header, 1, header_len, gRecordingFile) ||
+      frame_len != fwrite(frame, 1, frame_len, gRecordingFile)) {
+    // keep what was recorded so far
+    gRecording = false;
+    return;
+  }
+  if (gNumFrames++ == 0 || delta_us > 0) {
+    gLastFrameUs = received_us;
+  }
+}
+
+NotificationReplayer::NotificationReplayer() :
+    data_(NULL), size_(0), port_(0) {
+  host_[0] = '\0';
+}
+
+NotificationReplayer::~NotificationReplayer(void) {
+  Close();
+}
+
+uint64_t NotificationReplayer::Open(const char *path, const char *host,
+                                    uint32_t port) {
+  uint64_t err = 0LL;
+  FILE *file = NULL;
+  long size = 0;    // NOLINT(runtime/int)
+
+  if (NULL == path || NULL == host) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (NULL != data_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == (file = fopen(path, "rb"))) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_OPEN);
+  }
+  if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+      fseek(file, 0, SEEK_SET)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_READ);
+    goto clean_up;
+  }
+  if (static_cast<size_t>(size) < kRecordingHeaderLen) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_READ_LEN_ERROR);
+    goto clean_up;
+  }
+  if (NULL == (data_ = reinterpret_cast<unsigned char*>(
+                   malloc(static_cast<size_t>(size))))) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+    goto clean_up;
+  }
+  size_ = static_cast<size_t>(size);
+  if (size_ != fread(data_, 1, size_, file)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_READ);
+    goto clean_up;
+  }
+  if (memcmp(data_, kRecordingMagic, 4) ||
+      kRecordingVersion != (data_[4] | (data_[5] << 8) | (data_[6] << 16) |
+                            (static_cast<uint32_t>(data_[7]) << 24))) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MESSAGE_ERROR);
+    goto clean_up;
+  }
+  snprintf(host_, sizeof(host_), "%s", host);
+  port_ = port;
+  if (!NotificationReactor::AddReplay(host_, port_)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+
+clean_up:
+  fclose(file);
+  if (err) {
+    free(data_);
+    data_ = NULL;
+    size_ = 0;
+  }
+  return err;
+}
+
+uint64_t NotificationReplayer::Run(ReplaySpeed speed, ReplayStats *stats) {
+  uint64_t err = 0LL;
+  uint64_t frames = 0, delta_us = 0, frame_len = 0;
+  int64_t recorded_us = 0, start_us = 0;
+
+  if (NULL == data_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  const unsigned char *pos = data_ + kRecordingHeaderLen;
+  const unsigned char *end = data_ + size_;
+  // the devices must be subscribed, so the reactor exists
+  NotificationReactor *reactor =
+      NotificationReactor::AcquireReplay(host_, port_);
+  if (NULL == reactor) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  start_us = SteadyTimeUs();
+  while (pos < end) {
+    if (!GetVarint(&pos, end, &delta_us) ||
+        !GetVarint(&pos, end, &frame_len) ||
+        0 == frame_len || frame_len > static_cast<size_t>(end - pos) ||
+        '\0' != pos[frame_len - 1]) {
+      err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MESSAGE_ERROR);
+      break;
+    }
+    recorded_us += static_cast<int64_t>(delta_us);
+    if (ReplaySpeed::original == speed) {
+      int64_t wait_us = start_us + recorded_us - SteadyTimeUs();
+      if (wait_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+      }
+    }
+    // the latencies are measured from the replay, not from the recording
+    reactor->Replay(pos, SteadyTimeUs());
+    pos += static_cast<size_t>(frame_len);
+    frames++;
+  }
+  if (NULL != stats) {
+    stats->frames = frames;
+    stats->recorded_us = recorded_us;
+    stats->elapsed_us = SteadyTimeUs() - start_us;
+  }
+  NotificationReactor::ReleaseReplay(reactor);
+
+  return err;
+}
+
+void NotificationReplayer::Close() {
+  if (NULL == data_) {
+    return;
+  }
+  NotificationReactor::RemoveReplay(host_, port_);
+  free(data_);
+  data_ = NULL;
+  size_ = 0;
+}
+
+}  // namespace hippo
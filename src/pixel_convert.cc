@@ -0,0 +1,696 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <immintrin.h>
+#include <intrin.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <thread>   // NOLINT
+
+#include "../include/pixel_convert.h"
+
+namespace hippo {
+
+// the arguments of the conversion of one row
+typedef struct RowArgs {
+  const uint8_t *src;
+  // the UV row of PIXEL_NV12
+  const uint8_t *uv;
+  uint8_t *dst;
+  uint32_t width;
+  // PIXEL_GRAY16 windowing: out = min(255, ((min(in - low, range) << shift)
+  // * mult) >> 16), where mult is rounded up so that in >= low + range is 255
+  uint16_t low;
+  uint16_t range;
+  uint16_t mult;
+  int shift;
+} RowArgs;
+
+// converts the pixels of a row from the first one, and returns the first
+// pixel left for the scalar kernel (the SIMD kernels don't do the tails)
+typedef uint32_t (*SimdRowFunc)(const RowArgs &args);
+// converts the pixels of a row from pixel |x|
+typedef void (*ScalarRowFunc)(const RowArgs &args, uint32_t x);
+
+typedef struct RowKernel {
+  SimdRowFunc simd;     // NULL if there isn't one for the SIMD level
+  ScalarRowFunc scalar;
+} RowKernel;
+
+typedef enum class YuvLayout {
+  yuy2,   // Y0 U Y1 V
+  uyvy,   // U Y0 V Y1
+  nv12,   // a Y plane and an interleaved UV plane
+} YuvLayout;
+
+static inline uint8_t Clip(int value) {
+  return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// BT.601 limited range, in 8 bit fixed point. The SIMD kernels compute the
+// same sums in 32 bits, so the outputs match the scalar ones exactly
+template <bool bgra>
+static inline void StoreYuvPixel(uint8_t *dst, int y, int u, int v) {
+  int c = 298 * (y - 16) + 128;
+  int d = u - 128;
+  int e = v - 128;
+  uint8_t r = Clip((c + 409 * e) >> 8);
+  uint8_t g = Clip((c - 100 * d - 208 * e) >> 8);
+  uint8_t b = Clip((c + 516 * d) >> 8);
+  if (bgra) {
+    dst[0] = b;
+    dst[1] = g;
+    dst[2] = r;
+    dst[3] = 0xff;
+  } else {
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+  }
+}
+
+template <YuvLayout layout, bool bgra>
+static void YuvRowScalar(const RowArgs &args, uint32_t x) {
+  const uint32_t bpp = bgra ? 4 : 3;
+
+  for (; x < args.width; x += 2) {
+    int y0, y1, u, v;
+    if (YuvLayout::nv12 == layout) {
+      y0 = args.src[x];
+      y1 = args.src[x + 1];
+      u = args.uv[x];
+      v = args.uv[x + 1];
+    } else {
+      const uint8_t *p = args.src + 2 * x;
+      bool yuy2 = YuvLayout::yuy2 == layout;
+      y0 = p[yuy2 ? 0 : 1];
+      u = p[yuy2 ? 1 : 0];
+      y1 = p[yuy2 ? 2 : 3];
+      v = p[yuy2 ? 3 : 2];
+    }
+    StoreYuvPixel<bgra>(args.dst + bpp * x, y0, u, v);
+    StoreYuvPixel<bgra>(args.dst + bpp * (x + 1), y1, u, v);
+  }
+}
+
+static void Gray16RowScalar(const RowArgs &args, uint32_t x) {
+  for (; x < args.width; x++) {
+    // little endian, the rows don't need to be aligned
+    uint32_t value = static_cast<uint32_t>(args.src[2 * x]) |
+        (static_cast<uint32_t>(args.src[2 * x + 1]) << 8);
+    uint32_t d = value > args.low ? value - args.low : 0;
+    if (d > args.range) {
+      d = args.range;
+    }
+    uint32_t out = ((d << args.shift) * args.mult) >> 16;
+    args.dst[x] = static_cast<uint8_t>(out > 255 ? 255 : out);
+  }
+}
+
+static void RgbToBgraRowScalar(const RowArgs &args, uint32_t x) {
+  for (; x < args.width; x++) {
+    args.dst[4 * x] = args.src[3 * x + 2];
+    args.dst[4 * x + 1] = args.src[3 * x + 1];
+    args.dst[4 * x + 2] = args.src[3 * x];
+    args.dst[4 * x + 3] = 0xff;
+  }
+}
+
+// the 16 bit values |a| (low) and |b| (high) of a 32 bit lane
+static inline int32_t Pair16(int a, int b) {
+  return static_cast<int32_t>((static_cast<uint32_t>(b) << 16) |
+                              (static_cast<uint32_t>(a) & 0xffff));
+}
+
+// stores the |num| bytes of each of |r|, |g|, |b| as |num| RGB pixels
+static inline void StoreRgb(uint8_t *dst, __m128i r, __m128i g, __m128i b,
+                            uint32_t num) {
+  alignas(16) uint8_t rb[16], gb[16], bb[16];
+  _mm_store_si128(reinterpret_cast<__m128i*>(rb), r);
+  _mm_store_si128(reinterpret_cast<__m128i*>(gb), g);
+  _mm_store_si128(reinterpret_cast<__m128i*>(bb), b);
+  for (uint32_t i = 0; i < num; i++) {
+    dst[3 * i] = rb[i];
+    dst[3 * i + 1] = gb[i];
+    dst[3 * i + 2] = bb[i];
+  }
+}
+
+// stores the first 8 bytes of each of |b|, |g|, |r| as 8 BGRA pixels
+static inline void StoreBgra8(uint8_t *dst, __m128i b, __m128i g, __m128i r) {
+  __m128i bg = _mm_unpacklo_epi8(b, g);
+  __m128i ra = _mm_unpacklo_epi8(r, _mm_set1_epi8(-1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                   _mm_unpacklo_epi16(bg, ra));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16),
+                   _mm_unpackhi_epi16(bg, ra));
+}
+
+// The vector operations of the kernels that are written once for both SSE2
+// (8 pixels of 16 bits per vector) and AVX2 (16 pixels). The 16 bit lanes
+// are widened to 32 bits and packed back within each 128 bit lane, which
+// keeps the order of the pixels in both
+struct Sse2 {
+  typedef __m128i V;
+  static const uint32_t kPixels = 8;
+
+  static V Set16(int value) {
+    return _mm_set1_epi16(static_cast<int16_t>(value));
+  }
+  // the pairs (a, b) for Madd()
+  static V SetPair(int a, int b) {
+    return _mm_set1_epi32(Pair16(a, b));
+  }
+  static V Set32(int value) { return _mm_set1_epi32(value); }
+  static V Sub16(V a, V b) { return _mm_sub_epi16(a, b); }
+  static V SubsU16(V a, V b) { return _mm_subs_epu16(a, b); }
+  static V Sll16(V a, int count) {
+    return _mm_sll_epi16(a, _mm_cvtsi32_si128(count));
+  }
+  static V MulhiU16(V a, V b) { return _mm_mulhi_epu16(a, b); }
+  static V Add32(V a, V b) { return _mm_add_epi32(a, b); }
+  static V Shift8(V a) { return _mm_srai_epi32(a, 8); }
+  static V Madd(V a, V b) { return _mm_madd_epi16(a, b); }
+  static V UnpackLo16(V a, V b) { return _mm_unpacklo_epi16(a, b); }
+  static V UnpackHi16(V a, V b) { return _mm_unpackhi_epi16(a, b); }
+  static V Packs32(V a, V b) { return _mm_packs_epi32(a, b); }
+  // the U (even) and the V (odd) values of each pair of pixels, twice
+  static V DupEven16(V a) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(2, 2, 0, 0)),
+                               _MM_SHUFFLE(2, 2, 0, 0));
+  }
+  static V DupOdd16(V a) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 1, 1)),
+                               _MM_SHUFFLE(3, 3, 1, 1));
+  }
+  // the 16 bit lanes saturated to bytes, in the first kPixels bytes
+  static __m128i PackBytes(V a) { return _mm_packus_epi16(a, a); }
+
+  static void LoadYuv(const RowArgs &args, uint32_t x, YuvLayout layout,
+                      V *y, V *uv) {
+    if (YuvLayout::nv12 == layout) {
+      const V zero = _mm_setzero_si128();
+      *y = _mm_unpacklo_epi8(_mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(args.src + x)), zero);
+      *uv = _mm_unpacklo_epi8(_mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(args.uv + x)), zero);
+    } else {
+      V v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(args.src + 2 * x));
+      V low = _mm_and_si128(v, _mm_set1_epi16(0xff));
+      V high = _mm_srli_epi16(v, 8);
+      *y = YuvLayout::yuy2 == layout ? low : high;
+      *uv = YuvLayout::yuy2 == layout ? high : low;
+    }
+  }
+  static V LoadGray16(const uint8_t *src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  }
+  static void StoreGray8(uint8_t *dst, __m128i a) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), a);
+  }
+  static void StoreBgra(uint8_t *dst, __m128i b, __m128i g, __m128i r) {
+    StoreBgra8(dst, b, g, r);
+  }
+};
+
+struct Avx2 {
+  typedef __m256i V;
+  static const uint32_t kPixels = 16;
+
+  static V Set16(int value) {
+    return _mm256_set1_epi16(static_cast<int16_t>(value));
+  }
+  static V SetPair(int a, int b) {
+    return _mm256_set1_epi32(Pair16(a, b));
+  }
+  static V Set32(int value) { return _mm256_set1_epi32(value); }
+  static V Sub16(V a, V b) { return _mm256_sub_epi16(a, b); }
+  static V SubsU16(V a, V b) { return _mm256_subs_epu16(a, b); }
+  static V Sll16(V a, int count) {
+    return _mm256_sll_epi16(a, _mm_cvtsi32_si128(count));
+  }
+  static V MulhiU16(V a, V b) { return _mm256_mulhi_epu16(a, b); }
+  static V Add32(V a, V b) { return _mm256_add_epi32(a, b); }
+  static V Shift8(V a) { return _mm256_srai_epi32(a, 8); }
+  static V Madd(V a, V b) { return _mm256_madd_epi16(a, b); }
+  static V UnpackLo16(V a, V b) { return _mm256_unpacklo_epi16(a, b); }
+  static V UnpackHi16(V a, V b) { return _mm256_unpackhi_epi16(a, b); }
+  static V Packs32(V a, V b) { return _mm256_packs_epi32(a, b); }
+  static V DupEven16(V a) {
+    return _mm256_shufflehi_epi16(
+        _mm256_shufflelo_epi16(a, _MM_SHUFFLE(2, 2, 0, 0)),
+        _MM_SHUFFLE(2, 2, 0, 0));
+  }
+  static V DupOdd16(V a) {
+    return _mm256_shufflehi_epi16(
+        _mm256_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 1, 1)),
+        _MM_SHUFFLE(3, 3, 1, 1));
+  }
+  static __m128i PackBytes(V a) {
+    // packus works within each 128 bit lane: keep the first 64 bits of both
+    return _mm256_castsi256_si128(
+        _mm256_permute4x64_epi64(_mm256_packus_epi16(a, a),
+                                 _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+
+  static void LoadYuv(const RowArgs &args, uint32_t x, YuvLayout layout,
+                      V *y, V *uv) {
+    if (YuvLayout::nv12 == layout) {
+      *y = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(args.src + x)));
+      *uv = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(args.uv + x)));
+    } else {
+      V v = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(args.src + 2 * x));
+      V low = _mm256_and_si256(v, _mm256_set1_epi16(0xff));
+      V high = _mm256_srli_epi16(v, 8);
+      *y = YuvLayout::yuy2 == layout ? low : high;
+      *uv = YuvLayout::yuy2 == layout ? high : low;
+    }
+  }
+  static V LoadGray16(const uint8_t *src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+  }
+  static void StoreGray8(uint8_t *dst, __m128i a) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), a);
+  }
+  static void StoreBgra(uint8_t *dst, __m128i b, __m128i g, __m128i r) {
+    StoreBgra8(dst, b, g, r);
+    StoreBgra8(dst + 32, _mm_srli_si128(b, 8), _mm_srli_si128(g, 8),
+               _mm_srli_si128(r, 8));
+  }
+};
+
+template <class Ops, YuvLayout layout, bool bgra>
+static uint32_t YuvRowSimd(const RowArgs &args) {
+  typedef typename Ops::V V;
+  const V offset_y = Ops::Set16(16);
+  const V offset_uv = Ops::Set16(128);
+  const V round = Ops::Set32(128);
+  const V coef_r = Ops::SetPair(298, 409);        // C, E
+  const V coef_g = Ops::SetPair(298, -100);       // C, D
+  const V coef_g_e = Ops::SetPair(-208, 1);       // E, 128
+  const V coef_b = Ops::SetPair(298, 516);        // C, D
+  const uint32_t bpp = bgra ? 4 : 3;
+  uint32_t x = 0;
+
+  for (; x + Ops::kPixels <= args.width; x += Ops::kPixels) {
+    V y, uv;
+    Ops::LoadYuv(args, x, layout, &y, &uv);
+    V c = Ops::Sub16(y, offset_y);
+    uv = Ops::Sub16(uv, offset_uv);
+    V d = Ops::DupEven16(uv);
+    V e = Ops::DupOdd16(uv);
+    // (C, E), (C, D) and (E, 128) pairs for the madds
+    V ce_lo = Ops::UnpackLo16(c, e), ce_hi = Ops::UnpackHi16(c, e);
+    V cd_lo = Ops::UnpackLo16(c, d), cd_hi = Ops::UnpackHi16(c, d);
+    V e1_lo = Ops::UnpackLo16(e, offset_uv);
+    V e1_hi = Ops::UnpackHi16(e, offset_uv);
+
+    V r = Ops::Packs32(
+        Ops::Shift8(Ops::Add32(Ops::Madd(ce_lo, coef_r), round)),
+        Ops::Shift8(Ops::Add32(Ops::Madd(ce_hi, coef_r), round)));
+    V g = Ops::Packs32(
+        Ops::Shift8(Ops::Add32(Ops::Madd(cd_lo, coef_g),
+                               Ops::Madd(e1_lo, coef_g_e))),
+        Ops::Shift8(Ops::Add32(Ops::Madd(cd_hi, coef_g),
+                               Ops::Madd(e1_hi, coef_g_e))));
+    V b = Ops::Packs32(
+        Ops::Shift8(Ops::Add32(Ops::Madd(cd_lo, coef_b), round)),
+        Ops::Shift8(Ops::Add32(Ops::Madd(cd_hi, coef_b), round)));
+
+    uint8_t *dst = args.dst + bpp * x;
+    if (bgra) {
+      Ops::StoreBgra(dst, Ops::PackBytes(b), Ops::PackBytes(g),
+                     Ops::PackBytes(r));
+    } else {
+      StoreRgb(dst, Ops::PackBytes(r), Ops::PackBytes(g), Ops::PackBytes(b),
+               Ops::kPixels);
+    }
+  }
+  return x;
+}
+
+template <class Ops>
+static uint32_t Gray16RowSimd(const RowArgs &args) {
+  typedef typename Ops::V V;
+  const V low = Ops::Set16(args.low);
+  const V range = Ops::Set16(args.range);
+  const V mult = Ops::Set16(args.mult);
+  uint32_t x = 0;
+
+  for (; x + Ops::kPixels <= args.width; x += Ops::kPixels) {
+    V d = Ops::SubsU16(Ops::LoadGray16(args.src + 2 * x), low);
+    // min(d, range)
+    d = Ops::Sub16(d, Ops::SubsU16(d, range));
+    d = Ops::MulhiU16(Ops::Sll16(d, args.shift), mult);
+    Ops::StoreGray8(args.dst + x, Ops::PackBytes(d));
+  }
+  return x;
+}
+
+// SSE2 doesn't have a byte shuffle, so this one is AVX2 (SSSE3) only
+static uint32_t RgbToBgraRowAvx2(const RowArgs &args) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+      2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(0xff000000));
+  uint32_t x = 0;
+
+  // 8 pixels from 2 loads of 16 bytes, 4 pixels apart: the second load reads
+  // 4 bytes past the 8th pixel, which must still be in the row
+  for (; x + 10 <= args.width; x += 8) {
+    const uint8_t *src = args.src + 3 * x;
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(args.dst + 4 * x),
+                        _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle),
+                                        alpha));
+  }
+  return x;
+}
+
+template <YuvLayout layout, bool bgra>
+static RowKernel YuvKernel(SimdLevel level) {
+  RowKernel kernel = { NULL, YuvRowScalar<layout, bgra> };
+  if (SimdLevel::avx2 == level) {
+    kernel.simd = YuvRowSimd<Avx2, layout, bgra>;
+  } else if (SimdLevel::sse2 == level) {
+    kernel.simd = YuvRowSimd<Sse2, layout, bgra>;
+  }
+  return kernel;
+}
+
+static bool GetKernel(PixelFormat src, PixelFormat dst, SimdLevel level,
+                      RowKernel *kernel) {
+  bool bgra = PixelFormat::PIXEL_BGRA8888 == dst;
+  if (!bgra && PixelFormat::PIXEL_RGB888 != dst &&
+      PixelFormat::PIXEL_GRAY8 != dst) {
+    return false;
+  }
+  switch (src) {
+    case PixelFormat::PIXEL_YUY2:
+    case PixelFormat::PIXEL_YUYV:
+      if (PixelFormat::PIXEL_GRAY8 == dst) {
+        return false;
+      }
+      *kernel = bgra ? YuvKernel<YuvLayout::yuy2, true>(level) :
+          YuvKernel<YuvLayout::yuy2, false>(level);
+      return true;
+    case PixelFormat::PIXEL_UYVY:
+      if (PixelFormat::PIXEL_GRAY8 == dst) {
+        return false;
+      }
+      *kernel = bgra ? YuvKernel<YuvLayout::uyvy, true>(level) :
+          YuvKernel<YuvLayout::uyvy, false>(level);
+      return true;
+    case PixelFormat::PIXEL_NV12:
+      if (PixelFormat::PIXEL_GRAY8 == dst) {
+        return false;
+      }
+      *kernel = bgra ? YuvKernel<YuvLayout::nv12, true>(level) :
+          YuvKernel<YuvLayout::nv12, false>(level);
+      return true;
+    case PixelFormat::PIXEL_GRAY16:
+      if (PixelFormat::PIXEL_GRAY8 != dst) {
+        return false;
+      }
+      kernel->scalar = Gray16RowScalar;
+      kernel->simd = SimdLevel::avx2 == level ? Gray16RowSimd<Avx2> :
+          (SimdLevel::sse2 == level ? Gray16RowSimd<Sse2> : NULL);
+      return true;
+    case PixelFormat::PIXEL_RGB888:
+      if (!bgra) {
+        return false;
+      }
+      kernel->scalar = RgbToBgraRowScalar;
+      kernel->simd = SimdLevel::avx2 == level ? RgbToBgraRowAvx2 : NULL;
+      return true;
+    default:
+      return false;
+  }
+}
+
+PixelConverter::PixelConverter() {
+  options_.window_low = 0;
+  options_.window_high = 0xffff;
+  options_.num_threads = 0;
+  options_.max_simd = SimdLevel::avx2;
+  level_ = DetectSimdLevel();
+}
+
+PixelConverter::PixelConverter(const ConvertOptions &options) :
+    options_(options) {
+  level_ = DetectSimdLevel();
+  if (options_.max_simd < level_) {
+    level_ = options_.max_simd;
+  }
+}
+
+PixelConverter::~PixelConverter(void) {
+}
+
+uint64_t PixelConverter::Convert(const PixelBuffer &src,
+                                 const PixelBuffer &dst) {
+  RowKernel kernel;
+  RowArgs args;
+
+  if (NULL == src.data || NULL == dst.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (0 == src.width || 0 == src.height ||
+      src.width != dst.width || src.height != dst.height) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (!GetKernel(src.format, dst.format, level_, &kernel)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_FUNC_NOT_AVAILABLE);
+  }
+  uint32_t src_row = RowBytes(src.format, src.width);
+  uint32_t dst_row = RowBytes(dst.format, dst.width);
+  uint32_t src_stride = src.stride ? src.stride : src_row;
+  uint32_t dst_stride = dst.stride ? dst.stride : dst_row;
+  if (src_stride < src_row || dst_stride < dst_row) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  // the chroma of the 4:2:2 formats is shared by pairs of pixels, and the
+  // one of PIXEL_NV12 by 2x2 pixels
+  bool nv12 = PixelFormat::PIXEL_NV12 == src.format;
+  if ((src.width & 1) && PixelFormat::PIXEL_GRAY16 != src.format &&
+      PixelFormat::PIXEL_RGB888 != src.format) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (nv12 && (src.height & 1)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  memset(&args, 0, sizeof(args));
+  args.width = src.width;
+  if (PixelFormat::PIXEL_GRAY16 == src.format) {
+    if (options_.window_high <= options_.window_low) {
+      return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+    }
+    // shifts the window up to 16 bits for the precision of mulhi
+    uint32_t range = options_.window_high - options_.window_low;
+    while ((range << args.shift) < 0x8000) {
+      args.shift++;
+    }
+    uint32_t shifted = range << args.shift;
+    args.low = options_.window_low;
+    args.range = static_cast<uint16_t>(range);
+    args.mult = static_cast<uint16_t>((255 * 65536 + shifted - 1) / shifted);
+  }
+
+  internal::SplitRows(src.height, nv12 ? 2 : 1, options_.num_threads,
+                      [&](uint32_t first, uint32_t last) {
+    RowArgs row = args;
+    for (uint32_t y = first; y < last; y++) {
+      row.src = src.data + static_cast<size_t>(src_stride) * y;
+      row.dst = dst.data + static_cast<size_t>(dst_stride) * y;
+      if (nv12) {
+        row.uv = src.data + static_cast<size_t>(src_stride) *
+            (src.height + y / 2);
+      }
+      uint32_t x = kernel.simd ? kernel.simd(row) : 0;
+      kernel.scalar(row, x);
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+SimdLevel PixelConverter::GetSimdLevel() {
+  return level_;
+}
+
+static SimdLevel CpuSimdLevel() {
+  int info[4];
+
+  __cpuid(info, 0);
+  int max_id = info[0];
+  __cpuid(info, 1);
+  if (!(info[3] & (1 << 26))) {
+    return SimdLevel::scalar;
+  }
+  // AVX2 also needs the OS to save the ymm registers (OSXSAVE and AVX, and
+  // the xmm and ymm state enabled in XCR0)
+  bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+      (_xgetbv(0) & 6) == 6;
+  if (!avx || max_id < 7) {
+    return SimdLevel::sse2;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) ? SimdLevel::avx2 : SimdLevel::sse2;
+}
+
+SimdLevel PixelConverter::DetectSimdLevel() {
+  static const SimdLevel level = CpuSimdLevel();
+  return level;
+}
+
+uint32_t PixelConverter::RowBytes(PixelFormat format, uint32_t width) {
+  switch (format) {
+    case PixelFormat::PIXEL_GRAY8:
+    case PixelFormat::PIXEL_NV12:     // the Y plane
+      return width;
+    case PixelFormat::PIXEL_GRAY16:
+    case PixelFormat::PIXEL_DEPTH_MM16:
+    case PixelFormat::PIXEL_YUYV:
+    case PixelFormat::PIXEL_YUY2:
+    case PixelFormat::PIXEL_UYVY:
+      return 2 * width;
+    case PixelFormat::PIXEL_RGB888:
+      return 3 * width;
+    case PixelFormat::PIXEL_BGRA8888:
+      return 4 * width;
+    case PixelFormat::PIXEL_POINTS_MM32F:
+      return 12 * width;
+    default:
+      return 0;
+  }
+}
+
+namespace internal {
+
+// idle time after which a worker of the row pool exits
+const uint32_t kRowWorkerIdleMs = 1000;
+
+// RowPool keeps the threads of SplitRows between the calls, as starting and
+// joining them costs as much as converting a small frame. Each split is a
+// job whose chunks are claimed by the workers and by the calling thread, so
+// concurrent splits share the pool. The workers are started on demand and
+// exit once idle, and the pool is never destroyed, so it outlives them.
+class RowPool {
+ public:
+  static RowPool& GetInstance(void) {
+    static RowPool *instance = new RowPool();
+    return *instance;
+  }
+
+  // calls |fn(i)| for each chunk i of [0, num_chunks), from up to
+  // |num_threads| threads including the calling one
+  void Run(uint32_t num_chunks, uint32_t num_threads,
+           const std::function<void(uint32_t)> &fn);
+
+  RowPool(RowPool const &);                // Don't implement
+  void operator=(RowPool const &);         // Don't implement
+
+ private:
+  typedef struct Job {
+    const std::function<void(uint32_t)> *fn;
+    uint32_t num_chunks;
+    uint32_t next;      // the next chunk to claim
+    uint32_t done;
+  } Job;
+
+  RowPool() : num_workers_(0) {
+  }
+
+  // runs the next chunk of |job|, the mutex must be captured
+  void RunChunk(Job *job, std::unique_lock<std::mutex> *lock);
+  void worker_loop();
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;    // a job was queued
+  std::condition_variable done_cv_;    // a chunk is done
+  // the jobs with chunks left to claim
+  std::deque<Job*> jobs_;
+  uint32_t num_workers_;
+};
+
+void RowPool::Run(uint32_t num_chunks, uint32_t num_threads,
+                  const std::function<void(uint32_t)> &fn) {
+  Job job = { &fn, num_chunks, 0, 0 };
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobs_.push_back(&job);
+  for (; num_workers_ + 1 < num_threads; num_workers_++) {
+    std::thread th(&RowPool::worker_loop, this);
+    th.detach();
+  }
+  work_cv_.notify_all();
+  while (job.next < job.num_chunks) {
+    RunChunk(&job, &lock);
+  }
+  done_cv_.wait(lock, [&job] { return job.done == job.num_chunks; });
+}
+
+void RowPool::RunChunk(Job *job, std::unique_lock<std::mutex> *lock) {
+  uint32_t chunk = job->next++;
+  if (job->next == job->num_chunks) {
+    jobs_.erase(std::find(jobs_.begin(), jobs_.end(), job));
+  }
+  lock->unlock();
+  (*job->fn)(chunk);
+  lock->lock();
+  // the caller of Run() returns (and the job goes away) after this
+  if (++job->done == job->num_chunks) {
+    done_cv_.notify_all();
+  }
+}
+
+void RowPool::worker_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (jobs_.empty() &&
+        !work_cv_.wait_for(lock, std::chrono::milliseconds(kRowWorkerIdleMs),
+                           [this] { return !jobs_.empty(); })) {
+      break;
+    }
+    RunChunk(jobs_.front(), &lock);
+  }
+  num_workers_--;
+}
+
+void SplitRows(uint32_t num_rows, uint32_t align, uint32_t num_threads,
+               const std::function<void(uint32_t, uint32_t)> &fn) {
+  if (0 == num_threads) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  if (0 == align) {
+    align = 1;
+  }
+  uint32_t num_chunks = (num_rows + align - 1) / align;
+  if (num_threads > num_chunks) {
+    num_threads = num_chunks;
+  }
+  if (num_threads <= 1) {
+    fn(0, num_rows);
+    return;
+  }
+  uint32_t chunk = (num_chunks + num_threads - 1) / num_threads * align;
+  RowPool::GetInstance().Run((num_rows + chunk - 1) / chunk, num_threads,
+                             [&](uint32_t i) {
+    uint32_t first = i * chunk;
+    fn(first, first + chunk < num_rows ? first + chunk : num_rows);
+  });
+}
+
+}  // namespace internal
+
+}  // namespace hippo
@@ -0,0 +1,251 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <immintrin.h>
+#include <stdlib.h>
+
+#include "../include/point_cloud.h"
+#include "../include/lens_model.h"
+
+namespace hippo {
+
+// the arguments of the projection of one row
+typedef struct PointRow {
+  // PIXEL_DEPTH_MM16, little endian
+  const uint8_t *depth;
+  const float *ray_x;
+  const float *ray_y;
+  // the interleaved points, or NULL for the planes
+  float *xyz;
+  float *x;
+  float *y;
+  float *z;
+  uint32_t width;
+} PointRow;
+
+static void ProjectRowScalar(const PointRow &row, uint32_t x) {
+  for (; x < row.width; x++) {
+    float z = static_cast<float>(static_cast<uint32_t>(row.depth[2 * x]) |
+                                 (static_cast<uint32_t>(row.depth[2 * x + 1])
+                                  << 8));
+    float px = row.ray_x[x] * z;
+    float py = row.ray_y[x] * z;
+    if (NULL != row.xyz) {
+      row.xyz[3 * x] = px;
+      row.xyz[3 * x + 1] = py;
+      row.xyz[3 * x + 2] = z;
+    } else {
+      row.x[x] = px;
+      row.y[x] = py;
+      row.z[x] = z;
+    }
+  }
+}
+
+// stores 4 points at |x|, transposing them for the interleaved layout
+static inline void StorePoints4(const PointRow &row, uint32_t x, __m128 px,
+                                __m128 py, __m128 pz) {
+  if (NULL == row.xyz) {
+    _mm_storeu_ps(row.x + x, px);
+    _mm_storeu_ps(row.y + x, py);
+    _mm_storeu_ps(row.z + x, pz);
+    return;
+  }
+  // (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3)
+  __m128 xy01 = _mm_unpacklo_ps(px, py);
+  __m128 xy23 = _mm_unpackhi_ps(px, py);
+  __m128 z0x1 = _mm_shuffle_ps(pz, px, _MM_SHUFFLE(1, 1, 0, 0));
+  __m128 y1z1 = _mm_shuffle_ps(py, pz, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 z2x3 = _mm_shuffle_ps(pz, px, _MM_SHUFFLE(3, 3, 2, 2));
+  __m128 y3z3 = _mm_shuffle_ps(py, pz, _MM_SHUFFLE(3, 3, 3, 3));
+  float *dst = row.xyz + 3 * x;
+  _mm_storeu_ps(dst, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(dst + 4, _mm_shuffle_ps(y1z1, xy23,
+                                        _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(dst + 8, _mm_shuffle_ps(z2x3, y3z3,
+                                        _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// returns the first pixel left for the scalar kernel
+static uint32_t ProjectRowSse2(const PointRow &row) {
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t x = 0;
+
+  for (; x + 8 <= row.width; x += 8) {
+    __m128i depth = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(row.depth + 2 * x));
+    __m128 z0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(depth, zero));
+    __m128 z1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(depth, zero));
+    StorePoints4(row, x, _mm_mul_ps(_mm_loadu_ps(row.ray_x + x), z0),
+                 _mm_mul_ps(_mm_loadu_ps(row.ray_y + x), z0), z0);
+    StorePoints4(row, x + 4, _mm_mul_ps(_mm_loadu_ps(row.ray_x + x + 4), z1),
+                 _mm_mul_ps(_mm_loadu_ps(row.ray_y + x + 4), z1), z1);
+  }
+  return x;
+}
+
+static uint32_t ProjectRowAvx2(const PointRow &row) {
+  uint32_t x = 0;
+
+  for (; x + 8 <= row.width; x += 8) {
+    __m256 z = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(row.depth + 2 * x))));
+    __m256 px = _mm256_mul_ps(_mm256_loadu_ps(row.ray_x + x), z);
+    __m256 py = _mm256_mul_ps(_mm256_loadu_ps(row.ray_y + x), z);
+    if (NULL == row.xyz) {
+      _mm256_storeu_ps(row.x + x, px);
+      _mm256_storeu_ps(row.y + x, py);
+      _mm256_storeu_ps(row.z + x, z);
+    } else {
+      StorePoints4(row, x, _mm256_castps256_ps128(px),
+                   _mm256_castps256_ps128(py), _mm256_castps256_ps128(z));
+      StorePoints4(row, x + 4, _mm256_extractf128_ps(px, 1),
+                   _mm256_extractf128_ps(py, 1), _mm256_extractf128_ps(z, 1));
+    }
+  }
+  return x;
+}
+
+PointCloudProjector::PointCloudProjector() :
+    PointCloudProjector(0, SimdLevel::avx2) {
+}
+
+PointCloudProjector::PointCloudProjector(uint32_t num_threads,
+                                         SimdLevel max_simd) :
+    num_threads_(num_threads), width_(0), height_(0),
+    ray_x_(NULL), ray_y_(NULL) {
+  level_ = PixelConverter::DetectSimdLevel();
+  if (max_simd < level_) {
+    level_ = max_simd;
+  }
+}
+
+PointCloudProjector::~PointCloudProjector(void) {
+  free(ray_x_);
+  free(ray_y_);
+}
+
+uint64_t PointCloudProjector::SetCalibration(
+    const CalibrationIntrinsics &intrinsics,
+    const CalibrationDistortion &distortion,
+    bool mirror, uint32_t width, uint32_t height) {
+  if (0 == width || 0 == height ||
+      0.0f == intrinsics.fx || 0.0f == intrinsics.fy) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  size_t num_pixels = static_cast<size_t>(width) * height;
+  float *ray_x = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  float *ray_y = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  if (NULL == ray_x || NULL == ray_y) {
+    free(ray_x);
+    free(ray_y);
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  LensModel model;
+  LensModelFromCalibration(intrinsics, distortion, &model);
+  for (uint32_t v = 0; v < height; v++) {
+    for (uint32_t u = 0; u < width; u++) {
+      // the column of the sensor of a mirrored image
+      uint32_t col = mirror ? width - 1 - u : u;
+      double x, y;
+      UndistortPoint(model, col, v, &x, &y);
+      size_t i = static_cast<size_t>(v) * width + u;
+      ray_x[i] = static_cast<float>(x);
+      ray_y[i] = static_cast<float>(y);
+    }
+  }
+  free(ray_x_);
+  free(ray_y_);
+  ray_x_ = ray_x;
+  ray_y_ = ray_y;
+  width_ = width;
+  height_ = height;
+
+  return HIPPO_OK;
+}
+
+uint64_t PointCloudProjector::SetCalibration(
+    const IrRgbCalibration &calibration, uint32_t width, uint32_t height) {
+  return SetCalibration(calibration.ir_intrinsics, calibration.ir_distortion,
+                        calibration.mirror, width, height);
+}
+
+uint64_t PointCloudProjector::Project(const PixelBuffer &depth,
+                                      const PixelBuffer &points) {
+  return ProjectRows(depth, &points, NULL);
+}
+
+uint64_t PointCloudProjector::Project(const PixelBuffer &depth,
+                                      const PointPlanes &planes) {
+  return ProjectRows(depth, NULL, &planes);
+}
+
+uint64_t PointCloudProjector::ProjectRows(const PixelBuffer &depth,
+                                          const PixelBuffer *points,
+                                          const PointPlanes *planes) {
+  uint32_t dst_stride = 0, row_bytes = 0;
+
+  if (NULL == ray_x_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == depth.data ||
+      (NULL != points && NULL == points->data) ||
+      (NULL != planes &&
+       (NULL == planes->x || NULL == planes->y || NULL == planes->z))) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (PixelFormat::PIXEL_DEPTH_MM16 != depth.format ||
+      depth.width != width_ || depth.height != height_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (NULL != points) {
+    if (PixelFormat::PIXEL_POINTS_MM32F != points->format ||
+        points->width != width_ || points->height != height_) {
+      return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+    }
+    row_bytes = PixelConverter::RowBytes(points->format, width_);
+    dst_stride = points->stride ? points->stride : row_bytes;
+  } else {
+    row_bytes = width_ * static_cast<uint32_t>(sizeof(float));
+    dst_stride = planes->stride ? planes->stride : row_bytes;
+  }
+  uint32_t src_row = PixelConverter::RowBytes(depth.format, width_);
+  uint32_t src_stride = depth.stride ? depth.stride : src_row;
+  // the float rows must stay aligned to floats
+  if (src_stride < src_row || dst_stride < row_bytes ||
+      dst_stride % sizeof(float)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  uint32_t (*simd)(const PointRow &row) =
+      SimdLevel::avx2 == level_ ? ProjectRowAvx2 :
+      (SimdLevel::sse2 == level_ ? ProjectRowSse2 : NULL);
+
+  internal::SplitRows(height_, 1, num_threads_,
+                      [&](uint32_t first, uint32_t last) {
+    PointRow row;
+    row.width = width_;
+    for (uint32_t v = first; v < last; v++) {
+      size_t offset = static_cast<size_t>(dst_stride) * v;
+      row.depth = depth.data + static_cast<size_t>(src_stride) * v;
+      row.ray_x = ray_x_ + static_cast<size_t>(width_) * v;
+      row.ray_y = ray_y_ + static_cast<size_t>(width_) * v;
+      if (NULL != points) {
+        row.xyz = reinterpret_cast<float*>(points->data + offset);
+        row.x = row.y = row.z = NULL;
+      } else {
+        row.xyz = NULL;
+        row.x = reinterpret_cast<float*>(
+            reinterpret_cast<uint8_t*>(planes->x) + offset);
+        row.y = reinterpret_cast<float*>(
+            reinterpret_cast<uint8_t*>(planes->y) + offset);
+        row.z = reinterpret_cast<float*>(
+            reinterpret_cast<uint8_t*>(planes->z) + offset);
+      }
+      ProjectRowScalar(row, simd ? simd(row) : 0);
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+}  // namespace hippo
@@ -13,8 +13,13 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "projector";
+// the scalar properties
+const char kBrightness[] = "brightness";
+const char kFlash[] = "flash";
+const char kStructuredLightMode[] = "structured_light_mode";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *ProjectorNotification_str[];
 
 Projector::Projector() :
     HippoDevice(devName, defaultHost, defaultPort, HIPPO_PROJECTOR, 0),
@@ -42,18 +47,23 @@ Projector::~Projector(void) {
 }
 
 uint64_t Projector::brightness(uint32_t set) {
-  return uint32_set_get("brightness", set, NULL);
+  return property<uint32_t, kBrightness>(set, NULL);
 }
 
 uint64_t Projector::brightness(uint32_t *get) {
-  return uint32_get("brightness", get);
+  return property<uint32_t, kBrightness>(get);
 }
 
 uint64_t Projector::brightness(uint32_t set, uint32_t *get) {
-  return uint32_set_get("brightness", set, get);
+  return property<uint32_t, kBrightness>(set, get);
 }
 
 uint64_t Projector::calibration_data(hippo::CalibrationData *get) {
+  return calibration_data(get, NULL);
+}
+
+uint64_t Projector::calibration_data(hippo::CalibrationData *get,
+                                     ResultArena *arena) {
   if (NULL == get) {
     return  MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
@@ -61,15 +71,20 @@ uint64_t Projector::calibration_data(hippo::CalibrationData *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("calibration_data", jptr)) {
+  if (err = SendReadMsg("calibration_data", jptr)) {
     return err;
   }
-  err = calibrationData_json2c(jptr, get);
+  err = calibrationData_json2c(jptr, get, arena);
 
   return err;
 }
 
 uint64_t Projector::device_specific_info(hippo::ProjectorSpecificInfo *get) {
+  return device_specific_info(get, NULL);
+}
+
+uint64_t Projector::device_specific_info(hippo::ProjectorSpecificInfo *get,
+                                         ResultArena *arena) {
   if (NULL == get) {
     return  MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
@@ -77,16 +92,16 @@ uint64_t Projector::device_specific_info(hippo::ProjectorSpecificInfo *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("device_specific_info", jptr)) {
+  if (err = SendReadMsg("device_specific_info", jptr)) {
     return err;
   }
-  err = projector_specific_info_json2c(jptr, get);
+  err = projector_specific_info_json2c(jptr, get, arena);
 
   return err;
 }
 
 uint64_t Projector::flash(bool set) {
-  return bool_set_get("flash", set, NULL);
+  return property<bool, kFlash>(set, NULL);
 }
 
 // the get returns the number of seconds left that the projector will
@@ -128,7 +143,7 @@ uint64_t Projector::hardware_info(HardwareInfo *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("hardware_info", jptr)) {
+  if (err = SendReadMsg("hardware_info", jptr)) {
     return err;
   }
   return hardwareInfo_json2c(jptr, get);
@@ -145,7 +160,7 @@ uint64_t Projector::keystone(hippo::Keystone *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("keystone", jgetptr)) {
+  if (err = SendReadMsg("keystone", jgetptr)) {
     return err;
   }
   return keystone_json2c(jgetptr, get);
@@ -176,7 +191,7 @@ uint64_t Projector::led_times(hippo::ProjectorLedTimes *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("led_times", jgetptr)) {
+  if (err = SendReadMsg("led_times", jgetptr)) {
     return err;
   }
   return ledtimes_json2c(jgetptr, get);
@@ -189,7 +204,7 @@ uint64_t Projector::manufacturing_data(hippo::ManufacturingData *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("manufacturing_data", jgetptr)) {
+  if (err = SendReadMsg("manufacturing_data", jgetptr)) {
     return err;
   }
   return mfgData_json2c(jgetptr, get);
@@ -202,7 +217,7 @@ uint64_t Projector::monitor_coordinates(hippo::Rectangle *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("monitor_coordinates", jgetptr)) {
+  if (err = SendReadMsg("monitor_coordinates", jgetptr)) {
     return err;
   }
   return rectangle_json2c(jgetptr, get);
@@ -231,7 +246,7 @@ uint64_t Projector::solid_color(hippo::SolidColor *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("solid_color", jgetptr)) {
+  if (err = SendReadMsg("solid_color", jgetptr)) {
     return err;
   }
   return solid_color_json2c(jgetptr, get);
@@ -262,22 +277,22 @@ uint64_t Projector::state(hippo::ProjectorState *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("state", jgetptr)) {
+  if (err = SendReadMsg("state", jgetptr)) {
     return err;
   }
   return state_json2c(jgetptr, get);
 }
 
 uint64_t Projector::structured_light_mode(const bool set) {
-  return bool_set_get("structured_light_mode", set, NULL);
+  return property<bool, kStructuredLightMode>(set, NULL);
 }
 
 uint64_t Projector::structured_light_mode(bool *get) {
-  return bool_get("structured_light_mode", get);
+  return property<bool, kStructuredLightMode>(get);
 }
 
 uint64_t Projector::structured_light_mode(const bool set, bool *get) {
-  return bool_set_get("structured_light_mode", set, get);
+  return property<bool, kStructuredLightMode>(set, get);
 }
 
 uint64_t Projector::subscribe(
@@ -289,9 +304,18 @@ uint64_t Projector::subscribe(
 uint64_t Projector::subscribe(
     void(*callback)(const ProjectorNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t Projector::subscribe(
+    void(*callback)(const ProjectorNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      ProjectorNotification::on_white_point);
   uint64_t err = HIPPO_OK;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, ProjectorNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -299,6 +323,25 @@ uint64_t Projector::subscribe(
   return err;
 }
 
+uint64_t Projector::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t Projector::subscribe(uint32_t queue_depth, uint64_t mask,
+                              uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      ProjectorNotification::on_white_point);
+
+  callback_ = NULL;
+  return subscribe_queue<ProjectorNotificationParam>(
+      queue_depth, mask, ProjectorNotification_str, num_names, get);
+}
+
+uint64_t Projector::poll(ProjectorNotificationParam *params,
+                         uint32_t max_params, uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t Projector::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -320,7 +363,7 @@ uint64_t Projector::white_point(hippo::WhitePoint *get) {
   uint64_t err = HIPPO_OK;
   nl::json jget;
   void *jgetptr = reinterpret_cast<void*>(&jget);
-  if (err = SendRawMsg("white_point", jgetptr)) {
+  if (err = SendReadMsg("white_point", jgetptr)) {
     return err;
   }
   return white_point_json2c(jgetptr, get);
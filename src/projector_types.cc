@@ -11,7 +11,8 @@ namespace nl = nlohmann;
 namespace hippo {
 
 uint64_t Projector::calibrationData_json2c(void *obj,
-                                           hippo::CalibrationData *cal) {
+                                           hippo::CalibrationData *cal,
+                                           ResultArena *arena) {
   // test inputs to ensure non-null pointers
   if (obj == NULL || cal == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
@@ -37,16 +38,16 @@ uint64_t Projector::calibrationData_json2c(void *obj,
         std::string val = tmp->get<std::string>();
         switch (i) {
         case 0:
-          cal->cam_cal = strdup(val.c_str());
+          cal->cam_cal = ArenaStrDup(arena, val.c_str());
           break;
         case 1:
-          cal->cam_cal_hd = strdup(val.c_str());
+          cal->cam_cal_hd = ArenaStrDup(arena, val.c_str());
           break;
         case 2:
-          cal->proj_cal = strdup(val.c_str());
+          cal->proj_cal = ArenaStrDup(arena, val.c_str());
           break;
         case 3:
-          cal->proj_cal_hd = strdup(val.c_str());
+          cal->proj_cal_hd = ArenaStrDup(arena, val.c_str());
           break;
         }
       } else {
@@ -141,7 +142,8 @@ uint64_t Projector::geoversion_json2c(void *obj,
 }
 
 uint64_t Projector::projector_specific_info_json2c(void *obj,
-                                       hippo::ProjectorSpecificInfo *info) {
+                                       hippo::ProjectorSpecificInfo *info,
+                                       ResultArena *arena) {
   uint64_t err = HIPPO_OK;
   if (obj == NULL || info == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
@@ -176,7 +178,8 @@ uint64_t Projector::projector_specific_info_json2c(void *obj,
                                              &info->asic_version))) {
       return err;
     }
-    info->column_serial = strdup(jsonColSerial.get<std::string>().c_str());
+    info->column_serial = ArenaStrDup(arena,
+                                      jsonColSerial.get<std::string>().c_str());
     info->eeprom_version = jsonEepromVer.get<uint32_t>();
     if (HIPPO_OK != (err = dppversion_json2c(&jsonFlashVer,
                                              &info->flash_version))) {
@@ -187,7 +190,8 @@ uint64_t Projector::projector_specific_info_json2c(void *obj,
       return err;
     }
     info->hw_version = jsonHWVer.get<uint32_t>();
-    info->manufacturing_time = strdup(jsonMfgTime.get<std::string>().c_str());
+    info->manufacturing_time = ArenaStrDup(arena,
+                                        jsonMfgTime.get<std::string>().c_str());
   } catch (nl::json::exception) {     // out_of_range or type_error
     return MAKE_HIPPO_ERROR(facility_, HIPPO_ERROR);
   }
@@ -730,7 +734,7 @@ uint64_t Projector::white_point_json2c(void *obj,
 }
 
 bool Projector::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *ProjectorNotification_str[] = {
@@ -745,7 +749,7 @@ const char *ProjectorNotification_str[] = {
 void Projector::ProcessSignal(char *method, void *obj) {
   // fprintf(stderr, "[projector]: %s, %p\n", method, obj);
 
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -756,16 +760,12 @@ void Projector::ProcessSignal(char *method, void *obj) {
                        hippo::ProjectorNotification::on_close),
                    static_cast<uint32_t>(
                        hippo::ProjectorNotification::on_white_point));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   int val = 0;
   ProjectorNotificationParam param;
   param.type = static_cast<hippo::ProjectorNotification>(idx);
@@ -803,7 +803,11 @@ void Projector::ProcessSignal(char *method, void *obj) {
       break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
 }
 
@@ -0,0 +1,408 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/pyramid.h"
+
+namespace hippo {
+
+// the arguments of the downscaling of one row: the 2 source rows of each
+// output row
+typedef struct BoxRow {
+  const uint8_t *top;
+  const uint8_t *bottom;
+  uint8_t *dst;
+  // in output pixels
+  uint32_t width;
+  // the 8 bit formats: the bytes of a pixel, and the source bytes of each
+  // byte of a group of output bytes (in 2 * group source bytes)
+  uint32_t bpp;
+  uint32_t group;
+  const uint8_t (*pairs)[2];
+} BoxRow;
+
+// downscales the pixels of a row from the first one, and returns the first
+// pixel left for the scalar kernel
+typedef uint32_t (*SimdBoxFunc)(const BoxRow &row);
+// downscales the pixels of a row from pixel |x|
+typedef void (*ScalarBoxFunc)(const BoxRow &row, uint32_t x);
+
+typedef struct BoxKernel {
+  SimdBoxFunc simd;     // NULL if there isn't one for the SIMD level
+  ScalarBoxFunc scalar;
+  uint32_t bpp;
+  uint32_t group;
+  const uint8_t (*pairs)[2];
+  // the output widths are a multiple of this
+  uint32_t align;
+} BoxKernel;
+
+const uint8_t kGray8Pairs[1][2] = { { 0, 1 } };
+const uint8_t kRgbPairs[3][2] = { { 0, 3 }, { 1, 4 }, { 2, 5 } };
+const uint8_t kBgraPairs[4][2] = { { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+// 2 pairs of pixels to 1: the Y of the first 2 pixels, the U of both pairs,
+// the Y of the last 2 pixels and the V of both pairs
+const uint8_t kYuy2Pairs[4][2] = { { 0, 2 }, { 1, 5 }, { 4, 6 }, { 3, 7 } };
+const uint8_t kUyvyPairs[4][2] = { { 0, 4 }, { 1, 3 }, { 2, 6 }, { 5, 7 } };
+
+static inline uint32_t Load16(const uint8_t *src) {
+  return static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8);
+}
+
+static void Box8RowScalar(const BoxRow &row, uint32_t x) {
+  const uint32_t end = row.width * row.bpp;
+
+  for (uint32_t i = x * row.bpp; i < end; i += row.group) {
+    const uint8_t *top = row.top + 2 * i;
+    const uint8_t *bottom = row.bottom + 2 * i;
+    for (uint32_t j = 0; j < row.group; j++) {
+      uint32_t a = row.pairs[j][0], b = row.pairs[j][1];
+      row.dst[i + j] = static_cast<uint8_t>(
+          (top[a] + top[b] + bottom[a] + bottom[b] + 2) >> 2);
+    }
+  }
+}
+
+static void Box16RowScalar(const BoxRow &row, uint32_t x) {
+  for (; x < row.width; x++) {
+    const uint8_t *top = row.top + 4 * x;
+    const uint8_t *bottom = row.bottom + 4 * x;
+    uint32_t value = (Load16(top) + Load16(top + 2) + Load16(bottom) +
+                      Load16(bottom + 2) + 2) >> 2;
+    row.dst[2 * x] = static_cast<uint8_t>(value);
+    row.dst[2 * x + 1] = static_cast<uint8_t>(value >> 8);
+  }
+}
+
+// The vector operations of the PIXEL_GRAY8 and PIXEL_GRAY16 kernels, for
+// SSE2 and AVX2: the pairs of pixels are the low and high halves of the 16
+// (or 32) bit lanes
+struct BoxSse2 {
+  typedef __m128i V;
+  static const uint32_t kBytes = 16;
+
+  static V Load(const uint8_t *src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  }
+  static V Set16(int value) {
+    return _mm_set1_epi16(static_cast<int16_t>(value));
+  }
+  static V Set32(int value) { return _mm_set1_epi32(value); }
+  static V And(V a, V b) { return _mm_and_si128(a, b); }
+  static V Add16(V a, V b) { return _mm_add_epi16(a, b); }
+  static V Add32(V a, V b) { return _mm_add_epi32(a, b); }
+  static V High8(V a) { return _mm_srli_epi16(a, 8); }
+  static V High16(V a) { return _mm_srli_epi32(a, 16); }
+  static V Quarter16(V a) { return _mm_srli_epi16(a, 2); }
+  static V Quarter32(V a) { return _mm_srli_epi32(a, 2); }
+  // the 16 bit lanes saturated to bytes (kBytes / 2 bytes)
+  static void StoreBytes(uint8_t *dst, V a) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(a, a));
+  }
+  // the 32 bit lanes (up to 0xffff) as 16 bits (kBytes / 2 bytes): SSE2
+  // only packs signed values, so they are biased around 0 and back
+  static void StoreWords(uint8_t *dst, V a) {
+    V biased = _mm_sub_epi32(a, _mm_set1_epi32(0x8000));
+    V packed = _mm_xor_si128(_mm_packs_epi32(biased, biased),
+                             _mm_set1_epi16(static_cast<int16_t>(0x8000)));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+  }
+};
+
+struct BoxAvx2 {
+  typedef __m256i V;
+  static const uint32_t kBytes = 32;
+
+  static V Load(const uint8_t *src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+  }
+  static V Set16(int value) {
+    return _mm256_set1_epi16(static_cast<int16_t>(value));
+  }
+  static V Set32(int value) { return _mm256_set1_epi32(value); }
+  static V And(V a, V b) { return _mm256_and_si256(a, b); }
+  static V Add16(V a, V b) { return _mm256_add_epi16(a, b); }
+  static V Add32(V a, V b) { return _mm256_add_epi32(a, b); }
+  static V High8(V a) { return _mm256_srli_epi16(a, 8); }
+  static V High16(V a) { return _mm256_srli_epi32(a, 16); }
+  static V Quarter16(V a) { return _mm256_srli_epi16(a, 2); }
+  static V Quarter32(V a) { return _mm256_srli_epi32(a, 2); }
+  // packus works within each 128 bit lane: keep the first 64 bits of both
+  static void StoreBytes(uint8_t *dst, V a) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                     _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                         _mm256_packus_epi16(a, a), _MM_SHUFFLE(0, 0, 2, 0))));
+  }
+  static void StoreWords(uint8_t *dst, V a) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                     _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                         _mm256_packus_epi32(a, a), _MM_SHUFFLE(0, 0, 2, 0))));
+  }
+};
+
+template <class Ops>
+static uint32_t Gray8RowSimd(const BoxRow &row) {
+  typedef typename Ops::V V;
+  const V low = Ops::Set16(0xff);
+  const V round = Ops::Set16(2);
+  const uint32_t step = Ops::kBytes / 2;
+  uint32_t x = 0;
+
+  for (; x + step <= row.width; x += step) {
+    V top = Ops::Load(row.top + 2 * x);
+    V bottom = Ops::Load(row.bottom + 2 * x);
+    V sum = Ops::Add16(Ops::Add16(Ops::And(top, low), Ops::High8(top)),
+                       Ops::Add16(Ops::And(bottom, low), Ops::High8(bottom)));
+    Ops::StoreBytes(row.dst + x, Ops::Quarter16(Ops::Add16(sum, round)));
+  }
+  return x;
+}
+
+template <class Ops>
+static uint32_t Gray16RowSimd(const BoxRow &row) {
+  typedef typename Ops::V V;
+  const V low = Ops::Set32(0xffff);
+  const V round = Ops::Set32(2);
+  const uint32_t step = Ops::kBytes / 4;
+  uint32_t x = 0;
+
+  for (; x + step <= row.width; x += step) {
+    V top = Ops::Load(row.top + 4 * x);
+    V bottom = Ops::Load(row.bottom + 4 * x);
+    V sum = Ops::Add32(
+        Ops::Add32(Ops::And(top, low), Ops::High16(top)),
+        Ops::Add32(Ops::And(bottom, low), Ops::High16(bottom)));
+    Ops::StoreWords(row.dst + 2 * x, Ops::Quarter32(Ops::Add32(sum, round)));
+  }
+  return x;
+}
+
+// the interleaved formats with groups of 4 bytes (PIXEL_BGRA8888 and the
+// 4:2:2 ones): a byte shuffle puts the 2 source bytes of each output byte
+// side by side, and a multiply-add by 1 sums them
+static uint32_t Interleaved8RowAvx2(const BoxRow &row) {
+  alignas(32) int8_t order[32];
+  for (uint32_t i = 0; i < 32; i += 8) {
+    for (uint32_t j = 0; j < 4; j++) {
+      for (uint32_t k = 0; k < 2; k++) {
+        order[i + 2 * j + k] = static_cast<int8_t>(
+            i % 16 + row.pairs[j % row.group][k] +
+            2 * row.group * (j / row.group));
+      }
+    }
+  }
+  const __m256i shuffle = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(order));
+  const __m256i ones = _mm256_set1_epi8(1);
+  const __m256i round = _mm256_set1_epi16(2);
+  // 32 source bytes per step
+  const uint32_t step = 16 / row.bpp;
+  uint32_t x = 0;
+
+  for (; x + step <= row.width; x += step) {
+    __m256i top = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(row.top + 2 * row.bpp * x));
+    __m256i bottom = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(row.bottom + 2 * row.bpp * x));
+    __m256i sum = _mm256_add_epi16(
+        _mm256_maddubs_epi16(_mm256_shuffle_epi8(top, shuffle), ones),
+        _mm256_maddubs_epi16(_mm256_shuffle_epi8(bottom, shuffle), ones));
+    sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(row.dst + row.bpp * x),
+                     _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                         _mm256_packus_epi16(sum, sum),
+                         _MM_SHUFFLE(0, 0, 2, 0))));
+  }
+  return x;
+}
+
+static void Interleaved8Kernel(SimdLevel level, uint32_t bpp,
+                               const uint8_t (*pairs)[2], uint32_t align,
+                               BoxKernel *kernel) {
+  kernel->simd = SimdLevel::avx2 == level ? Interleaved8RowAvx2 : NULL;
+  kernel->scalar = Box8RowScalar;
+  kernel->bpp = bpp;
+  kernel->group = 4;
+  kernel->pairs = pairs;
+  kernel->align = align;
+}
+
+static bool GetKernel(PixelFormat format, SimdLevel level,
+                      BoxKernel *kernel) {
+  memset(kernel, 0, sizeof(*kernel));
+  kernel->align = 1;
+  switch (format) {
+    case PixelFormat::PIXEL_GRAY8:
+      kernel->simd = SimdLevel::avx2 == level ? Gray8RowSimd<BoxAvx2> :
+          (SimdLevel::sse2 == level ? Gray8RowSimd<BoxSse2> : NULL);
+      kernel->scalar = Box8RowScalar;
+      kernel->bpp = 1;
+      kernel->group = 1;
+      kernel->pairs = kGray8Pairs;
+      return true;
+    case PixelFormat::PIXEL_GRAY16:
+      kernel->simd = SimdLevel::avx2 == level ? Gray16RowSimd<BoxAvx2> :
+          (SimdLevel::sse2 == level ? Gray16RowSimd<BoxSse2> : NULL);
+      kernel->scalar = Box16RowScalar;
+      kernel->bpp = 2;
+      return true;
+    case PixelFormat::PIXEL_RGB888:
+      // 3 byte pixels don't fit the shuffles of 8 bytes
+      kernel->scalar = Box8RowScalar;
+      kernel->bpp = 3;
+      kernel->group = 3;
+      kernel->pairs = kRgbPairs;
+      return true;
+    case PixelFormat::PIXEL_BGRA8888:
+      Interleaved8Kernel(level, 4, kBgraPairs, 1, kernel);
+      return true;
+    case PixelFormat::PIXEL_YUY2:
+    case PixelFormat::PIXEL_YUYV:
+      Interleaved8Kernel(level, 2, kYuy2Pairs, 2, kernel);
+      return true;
+    case PixelFormat::PIXEL_UYVY:
+      Interleaved8Kernel(level, 2, kUyvyPairs, 2, kernel);
+      return true;
+    default:
+      return false;
+  }
+}
+
+FramePyramid::FramePyramid() : FramePyramid(0, SimdLevel::avx2) {
+}
+
+FramePyramid::FramePyramid(uint32_t num_threads, SimdLevel max_simd) :
+    num_threads_(num_threads), num_levels_(0) {
+  level_ = PixelConverter::DetectSimdLevel();
+  if (max_simd < level_) {
+    level_ = max_simd;
+  }
+  memset(levels_, 0, sizeof(levels_));
+  memset(capacity_, 0, sizeof(capacity_));
+}
+
+FramePyramid::~FramePyramid(void) {
+  for (uint32_t i = 1; i <= kMaxLevels; i++) {
+    free(levels_[i].data);
+  }
+}
+
+uint64_t FramePyramid::Build(const PixelBuffer &src, uint32_t num_levels) {
+  BoxKernel kernel;
+
+  num_levels_ = 0;
+  if (NULL == src.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (0 == num_levels || num_levels > kMaxLevels) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (!GetKernel(src.format, level_, &kernel)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_FUNC_NOT_AVAILABLE);
+  }
+  uint32_t row_bytes = PixelConverter::RowBytes(src.format, src.width);
+  if (src.stride && src.stride < row_bytes) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  levels_[0] = src;
+  levels_[0].stride = src.stride ? src.stride : row_bytes;
+  for (uint32_t i = 1; i <= num_levels; i++) {
+    PixelBuffer *level = &levels_[i];
+    level->width = levels_[i - 1].width / 2 / kernel.align * kernel.align;
+    level->height = levels_[i - 1].height / 2;
+    level->format = src.format;
+    if (0 == level->width || 0 == level->height) {
+      return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+    }
+    level->stride = PixelConverter::RowBytes(src.format, level->width);
+    size_t size = static_cast<size_t>(level->stride) * level->height;
+    if (size > capacity_[i]) {
+      free(level->data);
+      capacity_[i] = 0;
+      level->data = reinterpret_cast<uint8_t*>(malloc(size));
+      if (NULL == level->data) {
+        return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+      }
+      capacity_[i] = size;
+    }
+  }
+
+  // row |y| of level |i| from rows 2 * y and 2 * y + 1 of level i - 1
+  auto downscale = [&](uint32_t i, uint32_t y) {
+    const PixelBuffer &from = levels_[i - 1];
+    const PixelBuffer &to = levels_[i];
+    BoxRow row;
+    row.top = from.data + static_cast<size_t>(from.stride) * 2 * y;
+    row.bottom = row.top + from.stride;
+    row.dst = to.data + static_cast<size_t>(to.stride) * y;
+    row.width = to.width;
+    row.bpp = kernel.bpp;
+    row.group = kernel.group;
+    row.pairs = kernel.pairs;
+    kernel.scalar(row, kernel.simd ? kernel.simd(row) : 0);
+  };
+  // a tile is a row of the last level, and the rows of the other levels it
+  // comes from, which are still in the cache when they are downscaled again
+  uint32_t num_tiles = levels_[num_levels].height;
+  internal::SplitRows(num_tiles, 1, num_threads_,
+                      [&](uint32_t first, uint32_t last) {
+    for (uint32_t tile = first; tile < last; tile++) {
+      for (uint32_t i = 1; i <= num_levels; i++) {
+        uint32_t shift = num_levels - i;
+        for (uint32_t y = tile << shift; y < (tile + 1) << shift; y++) {
+          downscale(i, y);
+        }
+      }
+    }
+  });
+  // the rows of the odd heights, below the last tile
+  for (uint32_t i = 1; i < num_levels; i++) {
+    for (uint32_t y = num_tiles << (num_levels - i); y < levels_[i].height;
+         y++) {
+      downscale(i, y);
+    }
+  }
+  num_levels_ = num_levels;
+
+  return HIPPO_OK;
+}
+
+uint64_t FramePyramid::Build(const CameraFrame &frame, uint32_t index,
+                             uint32_t num_levels) {
+  if (NULL == frame.header || frame.header->error ||
+      index >= kMaxNumStreams) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  // the pointers of the streams that aren't in this frame can be left over
+  // from a previous frame
+  if (!(frame.header->stream.value & (1 << index))) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  const FrameHeaderData &stream = frame.streams[index];
+  if (NULL == stream.header || NULL == stream.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  PixelBuffer src = { stream.data, stream.header->width,
+                      stream.header->height, 0, stream.header->format };
+  return Build(src, num_levels);
+}
+
+uint64_t FramePyramid::GetLevel(uint32_t level, PixelBuffer *buffer) {
+  if (NULL == buffer) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  if (0 == num_levels_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (level > num_levels_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  *buffer = levels_[level];
+
+  return HIPPO_OK;
+}
+
+}  // namespace hippo
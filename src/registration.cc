@@ -0,0 +1,595 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+#include "../include/registration.h"
+
+namespace hippo {
+
+// the constants of the projection of the depth pixels into the color frame
+typedef struct Projection {
+  float tx;
+  float ty;
+  float tz;
+  float fx;
+  float fy;
+  // the principal point plus half a pixel, so that truncating rounds
+  float cx;
+  float cy;
+  float k[6];
+  float p1;
+  float p2;
+  // 2 p1 and 2 p2
+  float p1x2;
+  float p2x2;
+  float width;
+  float height;
+  // the row stride of the pixel indexes: the width, or the width + 1 for
+  // the corners (their right and bottom edges are the end of the frame)
+  float stride;
+} Projection;
+
+// the arguments of the projection of one row
+typedef struct ProjectRow {
+  // PIXEL_DEPTH_MM16, little endian
+  const uint8_t *depth;
+  const float *ray_x;
+  const float *ray_y;
+  const float *ray_z;
+  int32_t *index;
+  float *z;
+  uint32_t width;
+} ProjectRow;
+
+// The scalar kernel evaluates the same operations in the same order as the
+// SIMD ones, so all of them land depth pixels on the same color pixels. The
+// corners (|kCorners|) are clamped to the frame instead of dropped, and the
+// depth is only stored if |row.z| isn't NULL.
+template <bool kCorners>
+static void ProjectRowScalar(const Projection &p, const ProjectRow &row,
+                             uint32_t i) {
+  for (; i < row.width; i++) {
+    float d = static_cast<float>(static_cast<uint32_t>(row.depth[2 * i]) |
+                                 (static_cast<uint32_t>(row.depth[2 * i + 1])
+                                  << 8));
+    float qx = d * row.ray_x[i] + p.tx;
+    float qy = d * row.ray_y[i] + p.ty;
+    float qz = d * row.ray_z[i] + p.tz;
+    float inv = 1.0f / qz;
+    float x = qx * inv;
+    float y = qy * inv;
+    float xx = x * x;
+    float yy = y * y;
+    float xy = x * y;
+    float r2 = xx + yy;
+    float radial = (1.0f + r2 * (p.k[0] + r2 * (p.k[1] + r2 * p.k[2]))) /
+        (1.0f + r2 * (p.k[3] + r2 * (p.k[4] + r2 * p.k[5])));
+    float xd = x * radial + p.p1x2 * xy + p.p2 * (r2 + 2.0f * xx);
+    float yd = y * radial + p.p1 * (r2 + 2.0f * yy) + p.p2x2 * xy;
+    float u = p.fx * xd + p.cx;
+    float v = p.fy * yd + p.cy;
+    if (kCorners) {
+      // the same as max(min()) of the SIMD kernels, NaNs included
+      u = u > 0.0f ? u : 0.0f;
+      u = u < p.width ? u : p.width;
+      v = v > 0.0f ? v : 0.0f;
+      v = v < p.height ? v : p.height;
+    }
+    if (d > 0.0f && qz > 0.0f &&
+        (kCorners || (u >= 0.0f && u < p.width && v >= 0.0f &&
+                      v < p.height))) {
+      row.index[i] = static_cast<int32_t>(
+          static_cast<float>(static_cast<int32_t>(v)) * p.stride +
+          static_cast<float>(static_cast<int32_t>(u)));
+    } else {
+      row.index[i] = -1;
+    }
+    if (row.z) {
+      row.z[i] = qz;
+    }
+  }
+}
+
+struct Sse2F {
+  typedef __m128 V;
+  static const uint32_t kLanes = 4;
+
+  static V Set(float value) { return _mm_set1_ps(value); }
+  static V Load(const float *src) { return _mm_loadu_ps(src); }
+  static V LoadDepth(const uint8_t *src) {
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)),
+        _mm_setzero_si128()));
+  }
+  static V Add(V a, V b) { return _mm_add_ps(a, b); }
+  static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V Div(V a, V b) { return _mm_div_ps(a, b); }
+  // |b| if |a| is a NaN
+  static V Max(V a, V b) { return _mm_max_ps(a, b); }
+  static V Min(V a, V b) { return _mm_min_ps(a, b); }
+  static V And(V a, V b) { return _mm_and_ps(a, b); }
+  static V Gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+  static V Ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+  static V Lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+  static V Trunc(V a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+  static void Store(float *dst, V a) { _mm_storeu_ps(dst, a); }
+  // the (integer) |index| where |valid|, -1 elsewhere
+  static void StoreIndex(int32_t *dst, V index, V valid) {
+    __m128i mask = _mm_castps_si128(valid);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                     _mm_or_si128(_mm_and_si128(mask, _mm_cvttps_epi32(index)),
+                                  _mm_andnot_si128(mask,
+                                                   _mm_set1_epi32(-1))));
+  }
+};
+
+struct Avx2F {
+  typedef __m256 V;
+  static const uint32_t kLanes = 8;
+
+  static V Set(float value) { return _mm256_set1_ps(value); }
+  static V Load(const float *src) { return _mm256_loadu_ps(src); }
+  static V LoadDepth(const uint8_t *src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+  }
+  static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V And(V a, V b) { return _mm256_and_ps(a, b); }
+  static V Gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static V Ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+  static V Lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static V Trunc(V a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+  static void Store(float *dst, V a) { _mm256_storeu_ps(dst, a); }
+  static void StoreIndex(int32_t *dst, V index, V valid) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+                        _mm256_blendv_epi8(_mm256_set1_epi32(-1),
+                                           _mm256_cvttps_epi32(index),
+                                           _mm256_castps_si256(valid)));
+  }
+};
+
+// returns the first pixel left for the scalar kernel
+template <class F, bool kCorners>
+static uint32_t ProjectRowSimd(const Projection &p, const ProjectRow &row) {
+  typedef typename F::V V;
+  const V zero = F::Set(0.0f);
+  const V one = F::Set(1.0f);
+  const V two = F::Set(2.0f);
+  const V tx = F::Set(p.tx), ty = F::Set(p.ty), tz = F::Set(p.tz);
+  const V k0 = F::Set(p.k[0]), k1 = F::Set(p.k[1]), k2 = F::Set(p.k[2]);
+  const V k3 = F::Set(p.k[3]), k4 = F::Set(p.k[4]), k5 = F::Set(p.k[5]);
+  const V p1 = F::Set(p.p1), p2 = F::Set(p.p2);
+  const V p1x2 = F::Set(p.p1x2), p2x2 = F::Set(p.p2x2);
+  const V fx = F::Set(p.fx), fy = F::Set(p.fy);
+  const V cx = F::Set(p.cx), cy = F::Set(p.cy);
+  const V width = F::Set(p.width), height = F::Set(p.height);
+  const V stride = F::Set(p.stride);
+  uint32_t i = 0;
+
+  for (; i + F::kLanes <= row.width; i += F::kLanes) {
+    V d = F::LoadDepth(row.depth + 2 * i);
+    V qx = F::Add(F::Mul(d, F::Load(row.ray_x + i)), tx);
+    V qy = F::Add(F::Mul(d, F::Load(row.ray_y + i)), ty);
+    V qz = F::Add(F::Mul(d, F::Load(row.ray_z + i)), tz);
+    V inv = F::Div(one, qz);
+    V x = F::Mul(qx, inv);
+    V y = F::Mul(qy, inv);
+    V xx = F::Mul(x, x);
+    V yy = F::Mul(y, y);
+    V xy = F::Mul(x, y);
+    V r2 = F::Add(xx, yy);
+    V num = F::Add(k1, F::Mul(r2, k2));
+    num = F::Add(one, F::Mul(r2, F::Add(k0, F::Mul(r2, num))));
+    V den = F::Add(k4, F::Mul(r2, k5));
+    den = F::Add(one, F::Mul(r2, F::Add(k3, F::Mul(r2, den))));
+    V radial = F::Div(num, den);
+    V xd = F::Add(F::Add(F::Mul(x, radial), F::Mul(p1x2, xy)),
+                  F::Mul(p2, F::Add(r2, F::Mul(two, xx))));
+    V yd = F::Add(F::Add(F::Mul(y, radial),
+                         F::Mul(p1, F::Add(r2, F::Mul(two, yy)))),
+                  F::Mul(p2x2, xy));
+    V u = F::Add(F::Mul(fx, xd), cx);
+    V v = F::Add(F::Mul(fy, yd), cy);
+    V valid = F::And(F::Gt(d, zero), F::Gt(qz, zero));
+    if (kCorners) {
+      u = F::Min(F::Max(u, zero), width);
+      v = F::Min(F::Max(v, zero), height);
+    } else {
+      valid = F::And(valid,
+                     F::And(F::And(F::Ge(u, zero), F::Lt(u, width)),
+                            F::And(F::Ge(v, zero), F::Lt(v, height))));
+    }
+    F::StoreIndex(row.index + i,
+                  F::Add(F::Mul(F::Trunc(v), stride), F::Trunc(u)), valid);
+    if (row.z) {
+      F::Store(row.z + i, qz);
+    }
+  }
+  return i;
+}
+
+DepthRegistration::DepthRegistration() :
+    DepthRegistration(0, SimdLevel::avx2) {
+}
+
+DepthRegistration::DepthRegistration(uint32_t num_threads,
+                                     SimdLevel max_simd) :
+    num_threads_(num_threads), depth_width_(0), depth_height_(0),
+    color_width_(0), color_height_(0), ray_x_(NULL), ray_y_(NULL),
+    ray_z_(NULL), corner_x_(NULL), corner_y_(NULL), corner_z_(NULL),
+    index_(NULL), z_(NULL), corner_index_(NULL), order_(NULL),
+    row_end_(NULL) {
+  level_ = PixelConverter::DetectSimdLevel();
+  if (max_simd < level_) {
+    level_ = max_simd;
+  }
+  memset(&color_lens_, 0, sizeof(color_lens_));
+  memset(translation_, 0, sizeof(translation_));
+}
+
+DepthRegistration::~DepthRegistration(void) {
+  free(ray_x_);
+  free(ray_y_);
+  free(ray_z_);
+  free(corner_x_);
+  free(corner_y_);
+  free(corner_z_);
+  free(index_);
+  free(z_);
+  free(corner_index_);
+  free(order_);
+  free(row_end_);
+}
+
+// the ray of the undistorted point (x, y, 1) of the depth camera in the
+// color camera (matrix_transformation is column major: [column][row])
+static void RotateRay(const float (*m)[4], double x, double y, float *ray_x,
+                      float *ray_y, float *ray_z) {
+  *ray_x = static_cast<float>(m[0][0] * x + m[1][0] * y + m[2][0]);
+  *ray_y = static_cast<float>(m[0][1] * x + m[1][1] * y + m[2][1]);
+  *ray_z = static_cast<float>(m[0][2] * x + m[1][2] * y + m[2][2]);
+}
+
+uint64_t DepthRegistration::SetMapping(const Camera3DMapping &mapping,
+                                       uint32_t depth_width,
+                                       uint32_t depth_height,
+                                       uint32_t color_width,
+                                       uint32_t color_height) {
+  uint64_t err = 0LL;
+  LensModel depth_lens, color_lens;
+  float *ray_x = NULL, *ray_y = NULL, *ray_z = NULL, *z = NULL;
+  float *corner_x = NULL, *corner_y = NULL, *corner_z = NULL;
+  int32_t *index = NULL, *corner_index = NULL;
+  uint32_t *order = NULL, *row_end = NULL;
+
+  if (err = LensModelFromCameraParameters(mapping.from, depth_width,
+                                          depth_height, &depth_lens)) {
+    return err;
+  }
+  if (err = LensModelFromCameraParameters(mapping.to, color_width,
+                                          color_height, &color_lens)) {
+    return err;
+  }
+  if (0.0f == depth_lens.fx || 0.0f == depth_lens.fy) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  // the pixel indexes (of the corners too) are computed exactly in floats
+  if ((static_cast<uint64_t>(color_width) + 1) * (color_height + 1) >
+      (1 << 24)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  size_t num_pixels = static_cast<size_t>(depth_width) * depth_height;
+  size_t num_corners = (static_cast<size_t>(depth_width) + 1) *
+      (depth_height + 1);
+  ray_x = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  ray_y = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  ray_z = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  corner_x = reinterpret_cast<float*>(malloc(num_corners * sizeof(float)));
+  corner_y = reinterpret_cast<float*>(malloc(num_corners * sizeof(float)));
+  corner_z = reinterpret_cast<float*>(malloc(num_corners * sizeof(float)));
+  z = reinterpret_cast<float*>(malloc(num_pixels * sizeof(float)));
+  index = reinterpret_cast<int32_t*>(malloc(num_pixels * sizeof(int32_t)));
+  corner_index = reinterpret_cast<int32_t*>(malloc(4 * num_pixels *
+                                                   sizeof(int32_t)));
+  order = reinterpret_cast<uint32_t*>(malloc(num_pixels * sizeof(uint32_t)));
+  row_end = reinterpret_cast<uint32_t*>(malloc(color_height *
+                                               sizeof(uint32_t)));
+  if (NULL == ray_x || NULL == ray_y || NULL == ray_z || NULL == corner_x ||
+      NULL == corner_y || NULL == corner_z || NULL == z || NULL == index ||
+      NULL == corner_index || NULL == order || NULL == row_end) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+    goto clean_up;
+  }
+  for (uint32_t v = 0; v <= depth_height; v++) {
+    for (uint32_t u = 0; u <= depth_width; u++) {
+      double x, y;
+      if (u < depth_width && v < depth_height) {
+        size_t i = static_cast<size_t>(v) * depth_width + u;
+        UndistortPoint(depth_lens, u, v, &x, &y);
+        RotateRay(mapping.matrix_transformation, x, y, &ray_x[i], &ray_y[i],
+                  &ray_z[i]);
+      }
+      // the top left corner of the pixel
+      size_t i = static_cast<size_t>(v) * (depth_width + 1) + u;
+      UndistortPoint(depth_lens, u - 0.5, v - 0.5, &x, &y);
+      RotateRay(mapping.matrix_transformation, x, y, &corner_x[i],
+                &corner_y[i], &corner_z[i]);
+    }
+  }
+  for (uint32_t i = 0; i < 3; i++) {
+    translation_[i] = mapping.matrix_transformation[3][i];
+  }
+  std::swap(ray_x, ray_x_);
+  std::swap(ray_y, ray_y_);
+  std::swap(ray_z, ray_z_);
+  std::swap(corner_x, corner_x_);
+  std::swap(corner_y, corner_y_);
+  std::swap(corner_z, corner_z_);
+  std::swap(z, z_);
+  std::swap(index, index_);
+  std::swap(corner_index, corner_index_);
+  std::swap(order, order_);
+  std::swap(row_end, row_end_);
+  color_lens_ = color_lens;
+  depth_width_ = depth_width;
+  depth_height_ = depth_height;
+  color_width_ = color_width;
+  color_height_ = color_height;
+
+clean_up:
+  // the previous tables, or the new ones on errors
+  free(ray_x);
+  free(ray_y);
+  free(ray_z);
+  free(corner_x);
+  free(corner_y);
+  free(corner_z);
+  free(z);
+  free(index);
+  free(corner_index);
+  free(order);
+  free(row_end);
+  return err;
+}
+
+uint64_t DepthRegistration::ProjectDepth(const PixelBuffer &depth,
+                                         bool corners) {
+  Projection p;
+
+  if (NULL == ray_x_) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == depth.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  uint32_t depth_row = PixelConverter::RowBytes(depth.format, depth.width);
+  uint32_t depth_stride = depth.stride ? depth.stride : depth_row;
+  if (PixelFormat::PIXEL_DEPTH_MM16 != depth.format ||
+      depth.width != depth_width_ || depth.height != depth_height_ ||
+      depth_stride < depth_row) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  p.tx = translation_[0];
+  p.ty = translation_[1];
+  p.tz = translation_[2];
+  p.fx = color_lens_.fx;
+  p.fy = color_lens_.fy;
+  p.cx = color_lens_.cx + 0.5f;
+  p.cy = color_lens_.cy + 0.5f;
+  memcpy(p.k, color_lens_.k, sizeof(p.k));
+  p.p1 = color_lens_.p[0];
+  p.p2 = color_lens_.p[1];
+  p.p1x2 = 2.0f * p.p1;
+  p.p2x2 = 2.0f * p.p2;
+  p.width = static_cast<float>(color_width_);
+  p.height = static_cast<float>(color_height_);
+  p.stride = corners ? p.width + 1.0f : p.width;
+  void (*scalar)(const Projection &p, const ProjectRow &row, uint32_t i) =
+      corners ? ProjectRowScalar<true> : ProjectRowScalar<false>;
+  uint32_t (*simd)(const Projection &p, const ProjectRow &row) = NULL;
+  if (SimdLevel::avx2 == level_) {
+    simd = corners ? ProjectRowSimd<Avx2F, true> :
+        ProjectRowSimd<Avx2F, false>;
+  } else if (SimdLevel::sse2 == level_) {
+    simd = corners ? ProjectRowSimd<Sse2F, true> :
+        ProjectRowSimd<Sse2F, false>;
+  }
+
+  size_t num_pixels = static_cast<size_t>(depth_width_) * depth_height_;
+  internal::SplitRows(depth_height_, 1, num_threads_,
+                      [&](uint32_t first, uint32_t last) {
+    ProjectRow row;
+    row.width = depth_width_;
+    for (uint32_t v = first; v < last; v++) {
+      size_t offset = static_cast<size_t>(depth_width_) * v;
+      row.depth = depth.data + static_cast<size_t>(depth_stride) * v;
+      if (!corners) {
+        row.ray_x = ray_x_ + offset;
+        row.ray_y = ray_y_ + offset;
+        row.ray_z = ray_z_ + offset;
+        row.index = index_ + offset;
+        row.z = z_ + offset;
+        scalar(p, row, simd ? simd(p, row) : 0);
+        continue;
+      }
+      // the top left, top right, bottom left and bottom right corners, with
+      // the depth of the pixels (stored once)
+      row.z = z_ + offset;
+      for (uint32_t c = 0; c < 4; c++) {
+        size_t corner = static_cast<size_t>(depth_width_ + 1) * (v + c / 2) +
+            c % 2;
+        row.ray_x = corner_x_ + corner;
+        row.ray_y = corner_y_ + corner;
+        row.ray_z = corner_z_ + corner;
+        row.index = corner_index_ + c * num_pixels + offset;
+        scalar(p, row, simd ? simd(p, row) : 0);
+        row.z = NULL;
+      }
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+uint64_t DepthRegistration::DepthToColor(const PixelBuffer &depth,
+                                         const PixelBuffer &registered) {
+  uint64_t err = 0LL;
+
+  if (NULL == registered.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  uint32_t row_bytes = PixelConverter::RowBytes(registered.format,
+                                                registered.width);
+  uint32_t stride = registered.stride ? registered.stride : row_bytes;
+  if (PixelFormat::PIXEL_DEPTH_MM16 != registered.format ||
+      registered.width != color_width_ ||
+      registered.height != color_height_ || stride < row_bytes ||
+      stride % sizeof(uint16_t)) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (err = ProjectDepth(depth, true)) {
+    return err;
+  }
+  // each depth pixel covers the bounding box of its corners (stored in place
+  // of its top left and bottom right ones). The footprints are sorted by
+  // their first row once, so that the thread of a band of rows only visits
+  // the footprints that cross it.
+  const uint32_t corner_stride = color_width_ + 1;
+  size_t num_pixels = static_cast<size_t>(depth_width_) * depth_height_;
+  int32_t *top_left = corner_index_;
+  int32_t *bottom_right = corner_index_ + 3 * num_pixels;
+  uint32_t max_rows = 0;
+  memset(row_end_, 0, color_height_ * sizeof(uint32_t));
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint32_t x0 = corner_stride, y0 = color_height_, x1 = 0, y1 = 0;
+    uint32_t c = 0;
+    for (; c < 4; c++) {
+      int32_t index = corner_index_[c * num_pixels + i];
+      if (index < 0) {
+        break;
+      }
+      uint32_t x = static_cast<uint32_t>(index) % corner_stride;
+      uint32_t y = static_cast<uint32_t>(index) / corner_stride;
+      x0 = x < x0 ? x : x0;
+      y0 = y < y0 ? y : y0;
+      x1 = x > x1 ? x : x1;
+      y1 = y > y1 ? y : y1;
+    }
+    // no pixel center in it, its neighbors cover the pixels around
+    if (c < 4 || x0 == x1 || y0 == y1) {
+      top_left[i] = -1;
+      continue;
+    }
+    top_left[i] = static_cast<int32_t>(y0 * corner_stride + x0);
+    bottom_right[i] = static_cast<int32_t>(y1 * corner_stride + x1);
+    max_rows = y1 - y0 > max_rows ? y1 - y0 : max_rows;
+    row_end_[y0]++;
+  }
+  // the start of each row, then its end once its footprints are in place
+  uint32_t num_footprints = 0;
+  for (uint32_t y = 0; y < color_height_; y++) {
+    uint32_t count = row_end_[y];
+    row_end_[y] = num_footprints;
+    num_footprints += count;
+  }
+  for (size_t i = 0; i < num_pixels; i++) {
+    if (top_left[i] >= 0) {
+      uint32_t y0 = static_cast<uint32_t>(top_left[i]) / corner_stride;
+      order_[row_end_[y0]++] = static_cast<uint32_t>(i);
+    }
+  }
+
+  internal::SplitRows(color_height_, 1, num_threads_,
+                      [&](uint32_t first, uint32_t last) {
+    for (uint32_t v = first; v < last; v++) {
+      memset(registered.data + static_cast<size_t>(stride) * v, 0, row_bytes);
+    }
+    // the footprints that start above the band can reach into it
+    uint32_t top = first + 1 > max_rows ? first + 1 - max_rows : 0;
+    for (uint32_t k = top ? row_end_[top - 1] : 0; k < row_end_[last - 1];
+         k++) {
+      uint32_t i = order_[k];
+      uint32_t x0 = static_cast<uint32_t>(top_left[i]) % corner_stride;
+      uint32_t y0 = static_cast<uint32_t>(top_left[i]) / corner_stride;
+      uint32_t x1 = static_cast<uint32_t>(bottom_right[i]) % corner_stride;
+      uint32_t y1 = static_cast<uint32_t>(bottom_right[i]) / corner_stride;
+      y0 = y0 > first ? y0 : first;
+      y1 = y1 < last ? y1 : last;
+      float z = z_[i] + 0.5f;
+      uint16_t value = z < 65535.0f ? static_cast<uint16_t>(z) : 0xffff;
+      for (uint32_t y = y0; y < y1; y++) {
+        uint16_t *dst = reinterpret_cast<uint16_t*>(
+            registered.data + static_cast<size_t>(stride) * y);
+        for (uint32_t x = x0; x < x1; x++) {
+          if (0 == dst[x] || value < dst[x]) {
+            dst[x] = value;
+          }
+        }
+      }
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+uint64_t DepthRegistration::ColorToDepth(const PixelBuffer &depth,
+                                         const PixelBuffer &color,
+                                         const PixelBuffer &registered) {
+  uint64_t err = 0LL;
+
+  if (NULL == color.data || NULL == registered.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  // a pixel of the 4:2:2 and 4:2:0 formats can't be copied on its own
+  if (PixelFormat::PIXEL_GRAY8 != color.format &&
+      PixelFormat::PIXEL_GRAY16 != color.format &&
+      PixelFormat::PIXEL_RGB888 != color.format &&
+      PixelFormat::PIXEL_BGRA8888 != color.format) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_FUNC_NOT_AVAILABLE);
+  }
+  uint32_t bpp = PixelConverter::RowBytes(color.format, 1);
+  uint32_t color_row = PixelConverter::RowBytes(color.format, color.width);
+  uint32_t color_stride = color.stride ? color.stride : color_row;
+  uint32_t dst_row = PixelConverter::RowBytes(registered.format,
+                                              registered.width);
+  uint32_t dst_stride = registered.stride ? registered.stride : dst_row;
+  if (color.width != color_width_ || color.height != color_height_ ||
+      color_stride < color_row || registered.format != color.format ||
+      registered.width != depth_width_ ||
+      registered.height != depth_height_ || dst_stride < dst_row) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (err = ProjectDepth(depth, false)) {
+    return err;
+  }
+  internal::SplitRows(depth_height_, 1, num_threads_,
+                      [&](uint32_t first, uint32_t last) {
+    for (uint32_t v = first; v < last; v++) {
+      const int32_t *index = index_ + static_cast<size_t>(depth_width_) * v;
+      uint8_t *dst = registered.data + static_cast<size_t>(dst_stride) * v;
+      for (uint32_t u = 0; u < depth_width_; u++, dst += bpp) {
+        if (index[u] < 0) {
+          memset(dst, 0, bpp);
+          continue;
+        }
+        uint32_t row = static_cast<uint32_t>(index[u]) / color_width_;
+        uint32_t col = static_cast<uint32_t>(index[u]) % color_width_;
+        memcpy(dst, color.data + static_cast<size_t>(color_stride) * row +
+               static_cast<size_t>(bpp) * col, bpp);
+      }
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+}  // namespace hippo
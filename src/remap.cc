@@ -0,0 +1,385 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/remap.h"
+
+namespace hippo {
+
+namespace internal {
+
+const uint32_t kOutside = 0xffffffff;
+// the fractions of the table are in 1/128th, so the 4 bilinear weights add
+// up to 1 << 14
+const uint32_t kFracOne = 128;
+const uint32_t kWeightShift = 14;
+
+// the arguments of the sampling of one output row
+typedef struct SampleRow {
+  // the first row of the source frame
+  const uint8_t *src;
+  uint32_t src_stride;
+  const uint32_t *pos;
+  const uint16_t *frac;
+  uint8_t *dst;
+  uint32_t width;
+} SampleRow;
+
+// samples the pixels of a row from pixel |x|
+typedef void (*ScalarSampleFunc)(const SampleRow &row, uint32_t x);
+// returns the first pixel left for the scalar kernel
+typedef uint32_t (*SimdSampleFunc)(const SampleRow &row);
+
+static inline uint32_t Load16(const uint8_t *src) {
+  return static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8);
+}
+
+// the source pixel of an output pixel
+static inline const uint8_t *SourcePixel(const SampleRow &row, uint32_t pos,
+                                         uint32_t bpp) {
+  return row.src + static_cast<size_t>(pos >> 16) * row.src_stride +
+      static_cast<size_t>(pos & 0xffff) * bpp;
+}
+
+// bilinear sampling of |channels| 8 bit channels
+template <uint32_t channels>
+static void SampleRow8(const SampleRow &row, uint32_t x) {
+  for (; x < row.width; x++) {
+    uint8_t *dst = row.dst + channels * x;
+    if (kOutside == row.pos[x]) {
+      memset(dst, 0, channels);
+      continue;
+    }
+    const uint8_t *top = SourcePixel(row, row.pos[x], channels);
+    const uint8_t *bottom = top + row.src_stride;
+    uint32_t fx = row.frac[x] & 0xff, fy = row.frac[x] >> 8;
+    uint32_t w00 = (kFracOne - fx) * (kFracOne - fy);
+    uint32_t w01 = fx * (kFracOne - fy);
+    uint32_t w10 = (kFracOne - fx) * fy;
+    uint32_t w11 = fx * fy;
+    for (uint32_t c = 0; c < channels; c++) {
+      dst[c] = static_cast<uint8_t>(
+          (top[c] * w00 + top[channels + c] * w01 + bottom[c] * w10 +
+           bottom[channels + c] * w11 + (1 << (kWeightShift - 1))) >>
+          kWeightShift);
+    }
+  }
+}
+
+static void SampleRowGray16(const SampleRow &row, uint32_t x) {
+  for (; x < row.width; x++) {
+    uint8_t *dst = row.dst + 2 * x;
+    if (kOutside == row.pos[x]) {
+      dst[0] = dst[1] = 0;
+      continue;
+    }
+    const uint8_t *top = SourcePixel(row, row.pos[x], 2);
+    const uint8_t *bottom = top + row.src_stride;
+    uint32_t fx = row.frac[x] & 0xff, fy = row.frac[x] >> 8;
+    uint32_t value = (Load16(top) * ((kFracOne - fx) * (kFracOne - fy)) +
+                      Load16(top + 2) * (fx * (kFracOne - fy)) +
+                      Load16(bottom) * ((kFracOne - fx) * fy) +
+                      Load16(bottom + 2) * (fx * fy) +
+                      (1 << (kWeightShift - 1))) >> kWeightShift;
+    dst[0] = static_cast<uint8_t>(value);
+    dst[1] = static_cast<uint8_t>(value >> 8);
+  }
+}
+
+// the nearest pixel: interpolated depths would be points that aren't there
+static void SampleRowDepth(const SampleRow &row, uint32_t x) {
+  for (; x < row.width; x++) {
+    uint8_t *dst = row.dst + 2 * x;
+    if (kOutside == row.pos[x]) {
+      dst[0] = dst[1] = 0;
+      continue;
+    }
+    const uint8_t *src = SourcePixel(row, row.pos[x], 2);
+    if ((row.frac[x] >> 8) >= kFracOne / 2) {
+      src += row.src_stride;
+    }
+    if ((row.frac[x] & 0xff) >= kFracOne / 2) {
+      src += 2;
+    }
+    dst[0] = src[0];
+    dst[1] = src[1];
+  }
+}
+
+// the 4 channels of a pixel in a vector: the rows are interpolated in 16
+// bits, and the columns with a multiply-add of the two pixels of each row
+static uint32_t SampleRowBgraSse2(const SampleRow &row) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(1 << (kWeightShift - 1));
+
+  for (uint32_t x = 0; x < row.width; x++) {
+    uint8_t *dst = row.dst + 4 * x;
+    if (kOutside == row.pos[x]) {
+      memset(dst, 0, 4);
+      continue;
+    }
+    const uint8_t *top = SourcePixel(row, row.pos[x], 4);
+    int fx = row.frac[x] & 0xff, fy = row.frac[x] >> 8;
+    __m128i t = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(top)), zero);
+    __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(top + row.src_stride)), zero);
+    __m128i v = _mm_add_epi16(
+        _mm_mullo_epi16(t, _mm_set1_epi16(static_cast<int16_t>(kFracOne - fy))),
+        _mm_mullo_epi16(b, _mm_set1_epi16(static_cast<int16_t>(fy))));
+    // (left, right) pairs of each channel
+    __m128i pairs = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+    __m128i sum = _mm_madd_epi16(pairs, _mm_set1_epi32(
+        static_cast<int32_t>((fx << 16) | (kFracOne - fx))));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, round), kWeightShift);
+    sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+    int32_t pixel = _mm_cvtsi128_si32(sum);
+    memcpy(dst, &pixel, 4);
+  }
+  return row.width;
+}
+
+// 8 pixels with 2 gathers of 32 bits each: the 2 pixels of the top row, and
+// the 2 of the bottom row (ending at the second one for PIXEL_GRAY8, so the
+// gathers never read past the frame)
+template <bool gray16>
+static uint32_t SampleRowGrayAvx2(const SampleRow &row) {
+  const __m256i outside = _mm256_set1_epi32(-1);
+  const __m256i low8 = _mm256_set1_epi32(0xff);
+  const __m256i low16 = _mm256_set1_epi32(0xffff);
+  const __m256i one = _mm256_set1_epi32(kFracOne);
+  const __m256i round = _mm256_set1_epi32(1 << (kWeightShift - 1));
+  const __m256i stride = _mm256_set1_epi32(
+      static_cast<int32_t>(row.src_stride));
+  const int *top_base = reinterpret_cast<const int*>(row.src);
+  const int *bottom_base = reinterpret_cast<const int*>(
+      row.src + row.src_stride - (gray16 ? 0 : 2));
+  uint32_t x = 0;
+
+  for (; x + 8 <= row.width; x += 8) {
+    __m256i pos = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(row.pos + x));
+    __m256i inside = _mm256_xor_si256(_mm256_cmpeq_epi32(pos, outside),
+                                      outside);
+    __m256i col = _mm256_and_si256(pos, low16);
+    __m256i offset = _mm256_add_epi32(
+        _mm256_mullo_epi32(_mm256_srli_epi32(pos, 16), stride),
+        gray16 ? _mm256_slli_epi32(col, 1) : col);
+    // the pixels outside of the frame read the first one
+    offset = _mm256_and_si256(offset, inside);
+    __m256i top = _mm256_i32gather_epi32(top_base, offset, 1);
+    __m256i bottom = _mm256_i32gather_epi32(bottom_base, offset, 1);
+    __m256i p00, p01, p10, p11;
+    if (gray16) {
+      p00 = _mm256_and_si256(top, low16);
+      p01 = _mm256_srli_epi32(top, 16);
+      p10 = _mm256_and_si256(bottom, low16);
+      p11 = _mm256_srli_epi32(bottom, 16);
+    } else {
+      p00 = _mm256_and_si256(top, low8);
+      p01 = _mm256_and_si256(_mm256_srli_epi32(top, 8), low8);
+      p10 = _mm256_and_si256(_mm256_srli_epi32(bottom, 16), low8);
+      p11 = _mm256_srli_epi32(bottom, 24);
+    }
+    __m256i frac = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row.frac + x)));
+    __m256i fx = _mm256_and_si256(frac, low8);
+    __m256i fy = _mm256_srli_epi32(frac, 8);
+    __m256i ifx = _mm256_sub_epi32(one, fx);
+    __m256i ify = _mm256_sub_epi32(one, fy);
+    __m256i sum = _mm256_add_epi32(
+        _mm256_mullo_epi32(p00, _mm256_mullo_epi32(ifx, ify)),
+        _mm256_mullo_epi32(p01, _mm256_mullo_epi32(fx, ify)));
+    sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+        _mm256_mullo_epi32(p10, _mm256_mullo_epi32(ifx, fy)),
+        _mm256_mullo_epi32(p11, _mm256_mullo_epi32(fx, fy))));
+    sum = _mm256_and_si256(
+        _mm256_srli_epi32(_mm256_add_epi32(sum, round), kWeightShift), inside);
+    // packus works within each 128 bit lane
+    __m256i packed = _mm256_packus_epi32(sum, sum);
+    if (gray16) {
+      packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(row.dst + 2 * x),
+                       _mm256_castsi256_si128(packed));
+    } else {
+      packed = _mm256_packus_epi16(packed, packed);
+      packed = _mm256_permutevar8x32_epi32(
+          packed, _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(row.dst + x),
+                       _mm256_castsi256_si128(packed));
+    }
+  }
+  return x;
+}
+
+uint64_t AllocateRemapTable(uint32_t src_width, uint32_t src_height,
+                            uint32_t width, uint32_t height,
+                            RemapTable *table) {
+  if (NULL == table) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  // the positions of the table are 16 bit, and the bilinear sampling needs
+  // 2x2 pixels
+  if (src_width < 2 || src_height < 2 || src_width > 0xffff ||
+      src_height > 0xffff || 0 == width || 0 == height ||
+      width > 0xffff || height > 0xffff) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  FreeRemapTable(table);
+  size_t num_pixels = static_cast<size_t>(width) * height;
+  table->pos = reinterpret_cast<uint32_t*>(
+      malloc(num_pixels * sizeof(uint32_t)));
+  table->frac = reinterpret_cast<uint16_t*>(
+      malloc(num_pixels * sizeof(uint16_t)));
+  if (NULL == table->pos || NULL == table->frac) {
+    FreeRemapTable(table);
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MEM_ALLOC);
+  }
+  table->src_width = src_width;
+  table->src_height = src_height;
+  table->width = width;
+  table->height = height;
+
+  return HIPPO_OK;
+}
+
+void FreeRemapTable(RemapTable *table) {
+  free(table->pos);
+  free(table->frac);
+  memset(table, 0, sizeof(*table));
+}
+
+void BuildRemapTable(
+    uint32_t num_threads,
+    const std::function<void(uint32_t, uint32_t, double*, double*)> &source,
+    RemapTable *table) {
+  const uint32_t src_width = table->src_width;
+  const uint32_t src_height = table->src_height;
+  const uint32_t width = table->width;
+
+  SplitRows(table->height, 1, num_threads,
+            [&](uint32_t first, uint32_t last) {
+    for (uint32_t v = first; v < last; v++) {
+      for (uint32_t u = 0; u < width; u++) {
+        size_t i = static_cast<size_t>(v) * width + u;
+        double sx, sy;
+        source(u, v, &sx, &sy);
+        // rounded to the table fractions first, so the pixels of the edges
+        // stay inside
+        double rx = floor(sx * kFracOne + 0.5);
+        double ry = floor(sy * kFracOne + 0.5);
+        if (!(rx >= 0.0 && ry >= 0.0 &&
+              rx <= static_cast<double>((src_width - 1) * kFracOne) &&
+              ry <= static_cast<double>((src_height - 1) * kFracOne))) {
+          table->pos[i] = kOutside;
+          table->frac[i] = 0;
+          continue;
+        }
+        uint32_t qx = static_cast<uint32_t>(rx);
+        uint32_t qy = static_cast<uint32_t>(ry);
+        // the last column and row are the right/bottom pixels of the
+        // previous ones
+        uint32_t x0 = qx / kFracOne, fx = qx % kFracOne;
+        uint32_t y0 = qy / kFracOne, fy = qy % kFracOne;
+        if (x0 > src_width - 2) {
+          x0 = src_width - 2;
+          fx = kFracOne;
+        }
+        if (y0 > src_height - 2) {
+          y0 = src_height - 2;
+          fy = kFracOne;
+        }
+        table->pos[i] = (y0 << 16) | x0;
+        table->frac[i] = static_cast<uint16_t>((fy << 8) | fx);
+      }
+    }
+  });
+}
+
+bool CheckRemapTable(const RemapTable &table) {
+  size_t num_pixels = static_cast<size_t>(table.width) * table.height;
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    if (kOutside == table.pos[i]) {
+      continue;
+    }
+    uint32_t x0 = table.pos[i] & 0xffff, y0 = table.pos[i] >> 16;
+    uint32_t fx = table.frac[i] & 0xff, fy = table.frac[i] >> 8;
+    if (x0 > table.src_width - 2 || y0 > table.src_height - 2 ||
+        fx > kFracOne || fy > kFracOne) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t Remap(const RemapTable &table, const PixelBuffer &src,
+               const PixelBuffer &dst, uint32_t num_threads,
+               SimdLevel level) {
+  ScalarSampleFunc scalar = NULL;
+  SimdSampleFunc simd = NULL;
+
+  if (NULL == table.pos) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRONG_STATE_ERROR);
+  }
+  if (NULL == src.data || NULL == dst.data) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  switch (src.format) {
+    case PixelFormat::PIXEL_GRAY8:
+      scalar = SampleRow8<1>;
+      simd = SimdLevel::avx2 == level ? SampleRowGrayAvx2<false> : NULL;
+      break;
+    case PixelFormat::PIXEL_GRAY16:
+      scalar = SampleRowGray16;
+      simd = SimdLevel::avx2 == level ? SampleRowGrayAvx2<true> : NULL;
+      break;
+    case PixelFormat::PIXEL_RGB888:
+      scalar = SampleRow8<3>;
+      break;
+    case PixelFormat::PIXEL_BGRA8888:
+      scalar = SampleRow8<4>;
+      simd = SimdLevel::scalar != level ? SampleRowBgraSse2 : NULL;
+      break;
+    case PixelFormat::PIXEL_DEPTH_MM16:
+      scalar = SampleRowDepth;
+      break;
+    default:
+      return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_FUNC_NOT_AVAILABLE);
+  }
+  uint32_t src_row_bytes = PixelConverter::RowBytes(src.format,
+                                                    table.src_width);
+  uint32_t dst_row_bytes = PixelConverter::RowBytes(dst.format, table.width);
+  uint32_t src_stride = src.stride ? src.stride : src_row_bytes;
+  uint32_t dst_stride = dst.stride ? dst.stride : dst_row_bytes;
+  if (src.format != dst.format || src.width != table.src_width ||
+      src.height != table.src_height || dst.width != table.width ||
+      dst.height != table.height || src_stride < src_row_bytes ||
+      dst_stride < dst_row_bytes) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+
+  SplitRows(table.height, 1, num_threads,
+            [&](uint32_t first, uint32_t last) {
+    SampleRow row;
+    row.src = src.data;
+    row.src_stride = src_stride;
+    row.width = table.width;
+    for (uint32_t v = first; v < last; v++) {
+      row.pos = table.pos + static_cast<size_t>(table.width) * v;
+      row.frac = table.frac + static_cast<size_t>(table.width) * v;
+      row.dst = dst.data + static_cast<size_t>(dst_stride) * v;
+      scalar(row, simd ? simd(row) : 0);
+    }
+  });
+
+  return HIPPO_OK;
+}
+
+}  // namespace internal
+
+}  // namespace hippo
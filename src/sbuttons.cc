@@ -13,8 +13,13 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "sbuttons";
+// the scalar properties
+const char kHoldThreshold[] = "hold_threshold";
+const char kLedOnOffRate[] = "led_on_off_rate";
+const char kLedPulseRate[] = "led_pulse_rate";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *SButtonsNotification_str[];
 
 SButtons::SButtons() :
         HippoDevice(devName, defaultHost, defaultPort, HIPPO_SBUTTONS, 0),
@@ -42,39 +47,39 @@ SButtons::~SButtons(void) {
 }
 
 uint64_t SButtons::hold_threshold(uint32_t set) {
-  return uint32_set_get("hold_threshold", set, NULL);
+  return property<uint32_t, kHoldThreshold>(set, NULL);
 }
 
 uint64_t SButtons::hold_threshold(uint32_t *get) {
-  return uint32_get("hold_threshold", get);
+  return property<uint32_t, kHoldThreshold>(get);
 }
 
 uint64_t SButtons::hold_threshold(uint32_t set, uint32_t *get) {
-  return uint32_set_get("hold_threshold", set, get);
+  return property<uint32_t, kHoldThreshold>(set, get);
 }
 
 uint64_t SButtons::led_on_off_rate(uint32_t set) {
-  return uint32_set_get("led_on_off_rate", set, NULL);
+  return property<uint32_t, kLedOnOffRate>(set, NULL);
 }
 
 uint64_t SButtons::led_on_off_rate(uint32_t *get) {
-  return uint32_get("led_on_off_rate", get);
+  return property<uint32_t, kLedOnOffRate>(get);
 }
 
 uint64_t SButtons::led_on_off_rate(uint32_t set, uint32_t *get) {
-  return uint32_set_get("led_on_off_rate", set, get);
+  return property<uint32_t, kLedOnOffRate>(set, get);
 }
 
 uint64_t SButtons::led_pulse_rate(uint32_t set) {
-  return uint32_set_get("led_pulse_rate", set, NULL);
+  return property<uint32_t, kLedPulseRate>(set, NULL);
 }
 
 uint64_t SButtons::led_pulse_rate(uint32_t *get) {
-  return uint32_get("led_pulse_rate", get);
+  return property<uint32_t, kLedPulseRate>(get);
 }
 
 uint64_t SButtons::led_pulse_rate(uint32_t set, uint32_t *get) {
-  return uint32_set_get("led_pulse_rate", set, get);
+  return property<uint32_t, kLedPulseRate>(set, get);
 }
 
 // map between button IDs and json strings
@@ -247,9 +252,18 @@ uint64_t SButtons::subscribe(
 uint64_t SButtons::subscribe(
     void (*callback)(const SButtonsNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t SButtons::subscribe(
+    void (*callback)(const SButtonsNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SButtonsNotification::on_button_press);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, SButtonsNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -257,6 +271,25 @@ uint64_t SButtons::subscribe(
   return err;
 }
 
+uint64_t SButtons::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t SButtons::subscribe(uint32_t queue_depth, uint64_t mask,
+                             uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SButtonsNotification::on_button_press);
+
+  callback_ = NULL;
+  return subscribe_queue<SButtonsNotificationParam>(
+      queue_depth, mask, SButtonsNotification_str, num_names, get);
+}
+
+uint64_t SButtons::poll(SButtonsNotificationParam *params, uint32_t max_params,
+                        uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t SButtons::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -269,8 +302,8 @@ uint64_t SButtons::unsubscribe(uint32_t *get) {
 
 const char *SButtonPressType_str[] = { "tap", "hold", };
 
-uint64_t SButtons::button_press_notification_json2c(void *obj,
-                                                    hippo::ButtonPress *touch) {
+uint64_t SButtons::button_press_notification_json2c(
+    const void *obj, hippo::ButtonPress *touch) {
   uint64_t err = 0LL;
   if (obj == NULL || touch == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
@@ -313,7 +346,7 @@ clean_up:
 }
 
 bool SButtons::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *SButtonsNotification_str[] = {
@@ -325,7 +358,7 @@ const char *SButtonsNotification_str[] = {
 };
 
 void SButtons::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -336,16 +369,13 @@ void SButtons::ProcessSignal(char *method, void *obj) {
                        hippo::SButtonsNotification::on_close),
                    static_cast<uint32_t>(
                        hippo::SButtonsNotification::on_button_press));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    // do nothing
-  }
+  nl::json *params = reinterpret_cast<nl::json*>(obj);
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   int val = 0;
   SButtonsNotificationParam param;
   param.type = static_cast<hippo::SButtonsNotification>(idx);
@@ -379,7 +409,11 @@ void SButtons::ProcessSignal(char *method, void *obj) {
       break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
 }
 
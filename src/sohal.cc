@@ -15,6 +15,7 @@ extern std::mutex gHippoDeviceMutex;
 const char devName[] = "sohal";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *SoHalNotification_str[];
 
 SoHal::SoHal() :
         HippoDevice(devName, defaultHost, defaultPort, HIPPO_SOHAL, 0) {
@@ -34,7 +35,7 @@ uint64_t SoHal::exit() {
 }
 
 bool SoHal::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 uint64_t SoHal::log(LogInfo *get) {
@@ -45,7 +46,7 @@ uint64_t SoHal::log(LogInfo *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("log", jptr)) {
+  if (err = SendReadMsg("log", jptr)) {
     return err;
   }
   return logInfo_json2c(jptr, get);
@@ -82,9 +83,18 @@ uint64_t SoHal::subscribe(
 uint64_t SoHal::subscribe(
             void(*callback)(const SoHalNotificationParam &param, void *data),
             void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t SoHal::subscribe(
+            void(*callback)(const SoHalNotificationParam &param, void *data),
+            void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SoHalNotification::on_log);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, SoHalNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -92,12 +102,31 @@ uint64_t SoHal::subscribe(
   return err;
 }
 
+uint64_t SoHal::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t SoHal::subscribe(uint32_t queue_depth, uint64_t mask,
+                          uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SoHalNotification::on_log);
+
+  callback_ = NULL;
+  return subscribe_queue<SoHalNotificationParam>(
+      queue_depth, mask, SoHalNotification_str, num_names, get);
+}
+
+uint64_t SoHal::poll(SoHalNotificationParam *params, uint32_t max_params,
+                     uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t SoHal::version(char **get) {
   uint64_t err = 0;
 
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
-  if (err = SendRawMsg("version", jptr)) {
+  if (err = SendReadMsg("version", jptr)) {
     *get = NULL;
     return err;
   }
@@ -158,7 +187,7 @@ const char *SoHalNotification_str[] = {
 };
 
 void SoHal::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -169,16 +198,12 @@ void SoHal::ProcessSignal(char *method, void *obj) {
       SoHalNotification::on_close),
     static_cast<uint32_t>(
       SoHalNotification::on_log));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-                                    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   SoHalNotificationParam param;
   param.type = static_cast<hippo::SoHalNotification>(idx);
 
@@ -199,9 +224,12 @@ void SoHal::ProcessSignal(char *method, void *obj) {
     break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
-  delete params;
 }
 
 }  // namespace hippo
@@ -13,8 +13,11 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "system";
+// the scalar properties
+const char kSessionId[] = "session_id";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *SystemNotification_str[];
 
 System::System() :
     HippoDevice(devName, defaultHost, defaultPort, HIPPO_SYSTEM, 0) {
@@ -47,6 +50,11 @@ uint64_t System::camera_3d_mapping(const Camera3DMappingParameter &set,
 }
 
 uint64_t System::devices(DeviceInfo **get, uint64_t *num_devices) {
+  return devices(get, num_devices, NULL);
+}
+
+uint64_t System::devices(DeviceInfo **get, uint64_t *num_devices,
+                         ResultArena *arena) {
   *num_devices = 0;
   if (NULL == get) {
     return  MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
@@ -55,12 +63,12 @@ uint64_t System::devices(DeviceInfo **get, uint64_t *num_devices) {
   nl::json j;
   void *jptr = reinterpret_cast<void *>(&j);
 
-  if (err = SendRawMsg("devices", jptr)) {
+  if (err = SendReadMsg("devices", jptr)) {
     *get = NULL;
     *num_devices = 0;
     return err;
   }
-  return devices_json2c(jptr, get, num_devices);
+  return devices_json2c(jptr, get, num_devices, arena);
 }
 
 uint64_t System::device_ids(DeviceID **get, uint64_t *num_devices) {
@@ -72,7 +80,7 @@ uint64_t System::device_ids(DeviceID **get, uint64_t *num_devices) {
   nl::json j;
   void *jptr = reinterpret_cast<void *>(&j);
 
-  if (err = SendRawMsg("device_ids", jptr)) {
+  if (err = SendReadMsg("device_ids", jptr)) {
     *get = NULL;
     *num_devices = 0;
     return err;
@@ -102,6 +110,13 @@ uint64_t System::echo(const char *set, char **get) {
 uint64_t System::hardware_ids(HardwareIDs *get,
                       uint64_t *num_projectors,
                       uint64_t *num_touchscreens) {
+  return hardware_ids(get, num_projectors, num_touchscreens, NULL);
+}
+
+uint64_t System::hardware_ids(HardwareIDs *get,
+                      uint64_t *num_projectors,
+                      uint64_t *num_touchscreens,
+                      ResultArena *arena) {
   if (NULL == get) {
     return  MAKE_HIPPO_ERROR(facility_, HIPPO_PARAM_OUT_OF_RANGE);
   }
@@ -110,10 +125,11 @@ uint64_t System::hardware_ids(HardwareIDs *get,
   nl::json j;
   void *jptr = reinterpret_cast<void *>(&j);
 
-  if (err = SendRawMsg("hardware_ids", jptr)) {
+  if (err = SendReadMsg("hardware_ids", jptr)) {
     return err;
   }
-  return hardware_ids_json2c(jptr, get, num_projectors, num_touchscreens);
+  return hardware_ids_json2c(jptr, get, num_projectors, num_touchscreens,
+                             arena);
 }
 
 
@@ -144,7 +160,7 @@ uint64_t System::is_locked(SessionState * get) {
   nl::json j;
   void *jptr = reinterpret_cast<void *>(&j);
 
-  if (err = SendRawMsg("is_locked", jptr)) {
+  if (err = SendReadMsg("is_locked", jptr)) {
     return err;
   }
   return is_locked_json2c(jptr, get);
@@ -160,12 +176,12 @@ uint64_t System::list_displays(DisplayInfo **get, uint64_t *num_displays) {
   nl::json j;
   void *jptr = reinterpret_cast<void *>(&j);
 
-  if (err = SendRawMsg("list_displays", jptr)) {
+  if (err = SendReadMsg("list_displays", jptr)) {
     *get = NULL;
     *num_displays = 0;
     return err;
   }
-  return list_displays_json2c(jptr, get, num_displays);
+  return list_displays_json2c(jptr, get, num_displays, NULL);
 }
 
 uint64_t System::supported_devices(SupportedDevice **get,
@@ -178,7 +194,7 @@ uint64_t System::supported_devices(SupportedDevice **get,
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("supported_devices", jptr)) {
+  if (err = SendReadMsg("supported_devices", jptr)) {
     *get = NULL;
     *num_devices = 0;
     return err;
@@ -187,7 +203,7 @@ uint64_t System::supported_devices(SupportedDevice **get,
 }
 
 uint64_t System::session_id(uint32_t *get) {
-  return uint32_get("session_id", get);
+  return property<uint32_t, kSessionId>(get);
 }
 
 uint64_t System::subscribe(
@@ -199,9 +215,18 @@ uint64_t System::subscribe(
 uint64_t System::subscribe(
   void(*callback)(const SystemNotificationParam &param, void *data),
   void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t System::subscribe(
+  void(*callback)(const SystemNotificationParam &param, void *data),
+  void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SystemNotification::on_sohal_connected);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, SystemNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -209,6 +234,25 @@ uint64_t System::subscribe(
   return err;
 }
 
+uint64_t System::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t System::subscribe(uint32_t queue_depth, uint64_t mask,
+                           uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      SystemNotification::on_sohal_connected);
+
+  callback_ = NULL;
+  return subscribe_queue<SystemNotificationParam>(
+      queue_depth, mask, SystemNotification_str, num_names, get);
+}
+
+uint64_t System::poll(SystemNotificationParam *params, uint32_t max_params,
+                      uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t System::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -220,7 +264,7 @@ uint64_t System::unsubscribe(uint32_t *get) {
 }
 
 bool System::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *SystemNotification_str[] = {
@@ -231,7 +275,7 @@ const char *SystemNotification_str[] = {
 };
 
 void System::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -242,32 +286,31 @@ void System::ProcessSignal(char *method, void *obj) {
       SystemNotification::on_device_connected),
     static_cast<uint32_t>(
       SystemNotification::on_sohal_connected));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-                                    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
+  // the strings and the display list passed to a callback are decoded in the
+  // notification arena, which reuses its memory from one to the next
+  ResultArena *arena = (NULL != callback_) ? NotificationArena() : NULL;
   SystemNotificationParam param;
   param.num_displays = 0;
   param.type = static_cast<hippo::SystemNotification>(idx);
   switch (param.type) {
   case SystemNotification::on_device_connected:
     err = device_id_json2c(reinterpret_cast<const void*>(&v),
-                           &param.on_device_connected);
+                           &param.on_device_connected, arena);
     break;
   case SystemNotification::on_device_disconnected:
     err = device_id_json2c(reinterpret_cast<const void*>(&v),
-                           &param.on_device_disconnected);
+                           &param.on_device_disconnected, arena);
     break;
   case SystemNotification::on_display_change:
     err = list_displays_json2c(reinterpret_cast<const void*>(&v),
                               &param.on_display_change,
-                              &param.num_displays);
+                              &param.num_displays, arena);
     break;
   case SystemNotification::on_power_state:
     err = powerstate_json2c(reinterpret_cast<const void*>(&v),
@@ -292,9 +335,20 @@ void System::ProcessSignal(char *method, void *obj) {
   default:
     break;
   }
-  // call the user supplied callback function
+  // call the user supplied callback function, or queue the notification
+  // when polling
+  bool queued = false;
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      queued = QueueNotification(param);
+    }
+  }
+  // a queued notification is freed by the application after poll(), and
+  // the arena is reset by the next notification
+  if (queued || NULL != arena) {
+    return;
   }
 
   // now free the memory that was allocated in the notifications
@@ -312,7 +366,6 @@ void System::ProcessSignal(char *method, void *obj) {
     break;
   }
 
-  delete params;
 }
 
 }  // namespace hippo
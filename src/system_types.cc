@@ -316,7 +316,7 @@ uint64_t System::camera_stream_json2c(const void *obj,
 }
 
 uint64_t System::devices_json2c(const void *obj, DeviceInfo **info,
-                                uint64_t *num_devices) {
+                                uint64_t *num_devices, ResultArena *arena) {
   *num_devices = 0;
   // assign *info to nullptr as soon as possible
   if (info == NULL) {
@@ -339,8 +339,8 @@ uint64_t System::devices_json2c(const void *obj, DeviceInfo **info,
 
     // allocate the memory to store the device info
     *info = reinterpret_cast<DeviceInfo*>(
-      calloc(num_items, sizeof(DeviceInfo)));
-    if (!info) {
+      ArenaCalloc(arena, num_items, sizeof(DeviceInfo)));
+    if (!*info) {
       fprintf(stderr, "** Error allocating device ID array\n");
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
     }
@@ -365,9 +365,11 @@ uint64_t System::devices_json2c(const void *obj, DeviceInfo **info,
         return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
       }
 
-      (*info)[i].fw_version = strdup(fw_version.get<std::string>().c_str());
-      (*info)[i].name = strdup(name.get<std::string>().c_str());
-      (*info)[i].serial = strdup(serial.get<std::string>().c_str());
+      (*info)[i].fw_version =
+          ArenaStrDup(arena, fw_version.get<std::string>().c_str());
+      (*info)[i].name = ArenaStrDup(arena, name.get<std::string>().c_str());
+      (*info)[i].serial = ArenaStrDup(arena,
+                                      serial.get<std::string>().c_str());
       (*info)[i].index = index.get<uint32_t>();
       (*info)[i].vendor_id = vendor_id.get<uint32_t>();
       (*info)[i].product_id = product_id.get<uint32_t>();
@@ -379,27 +381,29 @@ uint64_t System::devices_json2c(const void *obj, DeviceInfo **info,
   return HIPPO_OK;
 }
 
-uint64_t System::device_id_json2c(const void *obj, DeviceID *id_info) {
+uint64_t System::device_id_json2c(const void *obj, DeviceID *id_info,
+                                  ResultArena *arena) {
   if (obj == NULL || id_info == NULL) {
     return MAKE_HIPPO_ERROR(facility_, HIPPO_INVALID_PARAM);
   }
   const nl::json *jsonDevInfo = reinterpret_cast<const nl::json*>(obj);
   try {
-    auto curr_device_id = *jsonDevInfo;
+    const nl::json &curr_device_id = *jsonDevInfo;
     if (!curr_device_id.is_object()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
 
-    auto name = curr_device_id.at("name");
-    auto index = curr_device_id.at("index");
-    auto vendor_id = curr_device_id.at("vendor_id");
-    auto product_id = curr_device_id.at("product_id");
+    const nl::json &name = curr_device_id.at("name");
+    const nl::json &index = curr_device_id.at("index");
+    const nl::json &vendor_id = curr_device_id.at("vendor_id");
+    const nl::json &product_id = curr_device_id.at("product_id");
     if (!name.is_string() || !index.is_number_integer() ||
       !vendor_id.is_number_integer() || !product_id.is_number_integer()) {
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
     }
 
-    (*id_info).name = strdup(name.get<std::string>().c_str());
+    (*id_info).name = ArenaStrDup(
+        arena, name.get_ref<const std::string&>().c_str());
     (*id_info).index = index.get<uint32_t>();
     (*id_info).vendor_id = vendor_id.get<uint32_t>();
     (*id_info).product_id = product_id.get<uint32_t>();
@@ -442,8 +446,7 @@ uint64_t System::device_ids_json2c(const void *obj, DeviceID **id_info,
 
     // iterate over the list to parse the individual devices
     for (int i = 0; i < num_items; i++) {
-      auto curr_device_id = jsonDevInfo->at(i);
-      device_id_json2c(&curr_device_id, &(*id_info)[i]);
+      device_id_json2c(&jsonDevInfo->at(i), &(*id_info)[i], NULL);
       *num_devices = i + 1;
     }
   } catch (nl::json::exception) {     // out_of_range or type_error
@@ -476,7 +479,8 @@ uint64_t System::echo_json2c(const void *obj, char **echo_return_str) {
 
 uint64_t System::list_displays_json2c(const void *obj,
                                       DisplayInfo **display_info,
-                                      uint64_t *num_displays) {
+                                      uint64_t *num_displays,
+                                      ResultArena *arena) {
   *num_displays = 0;
   uint64_t err = HIPPO_OK;
   if (display_info == NULL) {
@@ -498,31 +502,31 @@ uint64_t System::list_displays_json2c(const void *obj,
     }
 
     // allocate the memory to store the display info
-    *display_info = reinterpret_cast<DisplayInfo*>(calloc(num_items,
-                                                         sizeof(DisplayInfo)));
-    if (!display_info) {
+    *display_info = reinterpret_cast<DisplayInfo*>(
+        ArenaCalloc(arena, num_items, sizeof(DisplayInfo)));
+    if (!*display_info) {
       fprintf(stderr, "** Error allocating display info array\n");
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
     }
     // iterate over the list to parse the individual displays
     for (int i = 0; i < num_items; i++) {
-      auto curr_info = jsonDisplayList->at(i);
+      const nl::json &curr_info = jsonDisplayList->at(i);
       if (!curr_info.is_object()) {
         return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
       }
-      auto hardware_id = curr_info.at("hardware_id");
-      auto is_primary = curr_info.at("primary_display");
-      auto coordinates = curr_info.at("coordinates");
+      const nl::json &hardware_id = curr_info.at("hardware_id");
+      const nl::json &is_primary = curr_info.at("primary_display");
+      const nl::json &coordinates = curr_info.at("coordinates");
 
       if (!hardware_id.is_string() || !is_primary.is_boolean() ||
           !coordinates.is_object()) {
         return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
       }
 
-      auto dispX = coordinates.at("x");
-      auto dispY = coordinates.at("y");
-      auto dispWidth = coordinates.at("width");
-      auto dispHeight = coordinates.at("height");
+      const nl::json &dispX = coordinates.at("x");
+      const nl::json &dispY = coordinates.at("y");
+      const nl::json &dispWidth = coordinates.at("width");
+      const nl::json &dispHeight = coordinates.at("height");
 
       // check the types of the display area objects
       if (!dispX.is_number_integer() ||
@@ -533,8 +537,8 @@ uint64_t System::list_displays_json2c(const void *obj,
       }
 
       // assign the values
-      (*display_info)[i].hardware_id = strdup(
-                              hardware_id.get<std::string>().c_str());
+      (*display_info)[i].hardware_id = ArenaStrDup(
+          arena, hardware_id.get_ref<const std::string&>().c_str());
       (*display_info)[i].primary_display = is_primary.get<bool>();
       (*display_info)[i].coordinates.height = dispHeight.get<uint16_t>();
       (*display_info)[i].coordinates.width = dispWidth.get<uint16_t>();
@@ -632,7 +636,8 @@ uint64_t System::is_locked_json2c(const void *obj,
 
 uint64_t System::hardware_ids_json2c(const void *obj, HardwareIDs *get,
                              uint64_t *num_projectors,
-                             uint64_t *num_touchscreens) {
+                             uint64_t *num_touchscreens,
+                             ResultArena *arena) {
   *num_projectors = 0;
   *num_touchscreens = 0;
 
@@ -656,13 +661,13 @@ uint64_t System::hardware_ids_json2c(const void *obj, HardwareIDs *get,
 
     // allocate the memory to store the info
     get->sprout_projector = reinterpret_cast<char**>(
-                          calloc(numProj, sizeof(char*)));
+                          ArenaCalloc(arena, numProj, sizeof(char*)));
     if (!get->sprout_projector) {
       fprintf(stderr, "** Error allocating projector info array\n");
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
     }
     get->sprout_touchscreen = reinterpret_cast<char**>(
-                         calloc(numTS, sizeof(char*)));
+                         ArenaCalloc(arena, numTS, sizeof(char*)));
     if (!get->sprout_touchscreen) {
       fprintf(stderr, "** Error allocating touchscreen info array\n");
       return MAKE_HIPPO_ERROR(facility_, HIPPO_MEM_ALLOC);
@@ -673,7 +678,8 @@ uint64_t System::hardware_ids_json2c(const void *obj, HardwareIDs *get,
       if (!currProj.is_string()) {
         return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
       }
-      get->sprout_projector[i] = strdup(currProj.get<std::string>().c_str());
+      get->sprout_projector[i] = ArenaStrDup(arena,
+                                       currProj.get<std::string>().c_str());
       *num_projectors = i + 1;
     }
 
@@ -682,7 +688,8 @@ uint64_t System::hardware_ids_json2c(const void *obj, HardwareIDs *get,
       if (!currTS.is_string()) {
         return MAKE_HIPPO_ERROR(facility_, HIPPO_MESSAGE_ERROR);
       }
-      get->sprout_touchscreen[i] = strdup(currTS.get<std::string>().c_str());
+      get->sprout_touchscreen[i] = ArenaStrDup(arena,
+                                         currTS.get<std::string>().c_str());
       *num_touchscreens = i + 1;
     }
   } catch (nl::json::exception) {     // out_of_range or type_error
@@ -13,8 +13,12 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "touchmat";
+// the scalar properties
+const char kDevicePalmRejection[] = "device_palm_rejection";
+const char kPalmRejectionTimeout[] = "palm_rejection_timeout";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *TouchMatNotification_str[];
 
 TouchMat::TouchMat() :
     HippoDevice(devName, defaultHost, defaultPort, HIPPO_TOUCHMAT, 0) {
@@ -47,7 +51,7 @@ uint64_t TouchMat::active_area(ActiveArea *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("active_area", jptr)) {
+  if (err = SendReadMsg("active_area", jptr)) {
     return err;
   }
   return active_area_json2c(jptr, get);
@@ -87,7 +91,7 @@ uint64_t TouchMat::active_pen_range(ActivePenRange *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("active_pen_range", jptr)) {
+  if (err = SendReadMsg("active_pen_range", jptr)) {
     return err;
   }
   return active_pen_range_json2c(jptr, get);
@@ -123,15 +127,15 @@ uint64_t TouchMat::calibrate() {
 }
 
 uint64_t TouchMat::device_palm_rejection(bool set) {
-  return bool_set_get("device_palm_rejection", set, NULL);
+  return property<bool, kDevicePalmRejection>(set, NULL);
 }
 
 uint64_t TouchMat::device_palm_rejection(bool *get) {
-  return bool_get("device_palm_rejection", get);
+  return property<bool, kDevicePalmRejection>(get);
 }
 
 uint64_t TouchMat::device_palm_rejection(bool set, bool *get) {
-  return bool_set_get("device_palm_rejection", set, get);
+  return property<bool, kDevicePalmRejection>(set, get);
 }
 
 uint64_t TouchMat::hardware_info(TouchmatHardwareInfo *get) {
@@ -142,22 +146,22 @@ uint64_t TouchMat::hardware_info(TouchmatHardwareInfo *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("hardware_info", jptr)) {
+  if (err = SendReadMsg("hardware_info", jptr)) {
     return err;
   }
   return hardware_info_json2c(jptr, get);
 }
 
 uint64_t TouchMat::palm_rejection_timeout(uint32_t *get) {
-  return uint32_get("palm_rejection_timeout", get);
+  return property<uint32_t, kPalmRejectionTimeout>(get);
 }
 
 uint64_t TouchMat::palm_rejection_timeout(uint32_t set) {
-  return uint32_set_get("palm_rejection_timeout", set, NULL);
+  return property<uint32_t, kPalmRejectionTimeout>(set, NULL);
 }
 
 uint64_t TouchMat::palm_rejection_timeout(uint32_t set, uint32_t *get) {
-  return uint32_set_get("palm_rejection_timeout", set, get);
+  return property<uint32_t, kPalmRejectionTimeout>(set, get);
 }
 
 uint64_t TouchMat::reset() {
@@ -174,7 +178,7 @@ uint64_t TouchMat::state(hippo::TouchMatState *get) {
   nl::json j;
   void *jptr = reinterpret_cast<void*>(&j);
 
-  if (err = SendRawMsg("state", jptr)) {
+  if (err = SendReadMsg("state", jptr)) {
     return err;
   }
   return touchMatState_json2c(jptr, get);
@@ -212,9 +216,18 @@ uint64_t TouchMat::subscribe(
 uint64_t TouchMat::subscribe(
     void(*callback)(const TouchMatNotificationParam &param, void *data),
     void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t TouchMat::subscribe(
+    void(*callback)(const TouchMatNotificationParam &param, void *data),
+    void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      TouchMatNotification::on_state);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, TouchMatNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -222,6 +235,25 @@ uint64_t TouchMat::subscribe(
   return err;
 }
 
+uint64_t TouchMat::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t TouchMat::subscribe(uint32_t queue_depth, uint64_t mask,
+                             uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      TouchMatNotification::on_state);
+
+  callback_ = NULL;
+  return subscribe_queue<TouchMatNotificationParam>(
+      queue_depth, mask, TouchMatNotification_str, num_names, get);
+}
+
+uint64_t TouchMat::poll(TouchMatNotificationParam *params, uint32_t max_params,
+                        uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t TouchMat::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -404,7 +436,7 @@ uint64_t TouchMat::hardware_info_json2c(void *obj,
 // Notifications
 
 bool TouchMat::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *TouchMatNotification_str[] = {
@@ -417,7 +449,7 @@ const char *TouchMatNotification_str[] = {
 };
 
 void TouchMat::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -428,16 +460,12 @@ void TouchMat::ProcessSignal(char *method, void *obj) {
                        hippo::TouchMatNotification::on_close),
                    static_cast<uint32_t>(
                        hippo::TouchMatNotification::on_state));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   int val = 0;
   TouchMatNotificationParam param;
   param.type = static_cast<hippo::TouchMatNotification>(idx);
@@ -471,7 +499,11 @@ void TouchMat::ProcessSignal(char *method, void *obj) {
       break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
 }
 
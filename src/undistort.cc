@@ -0,0 +1,181 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/undistort.h"
+
+namespace hippo {
+
+const char kTableMagic[] = "HPUD";
+const uint32_t kTableVersion = 1;
+
+typedef struct TableHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  LensModel model;
+} TableHeader;
+
+Undistorter::Undistorter() : Undistorter(0, SimdLevel::avx2) {
+}
+
+Undistorter::Undistorter(uint32_t num_threads, SimdLevel max_simd) :
+    num_threads_(num_threads), from_cache_(false) {
+  level_ = PixelConverter::DetectSimdLevel();
+  if (max_simd < level_) {
+    level_ = max_simd;
+  }
+  memset(&model_, 0, sizeof(model_));
+  memset(&table_, 0, sizeof(table_));
+}
+
+Undistorter::~Undistorter(void) {
+  internal::FreeRemapTable(&table_);
+}
+
+// the source of each output pixel is where the lens takes the ray of the
+// pinhole camera
+void Undistorter::Build(const LensModel &model) {
+  internal::BuildRemapTable(num_threads_,
+                            [&](uint32_t u, uint32_t v, double *x, double *y) {
+    DistortPoint(model, (u - model.cx) / model.fx, (v - model.cy) / model.fy,
+                 x, y);
+  }, &table_);
+}
+
+uint64_t Undistorter::SetModel(const LensModel &model, uint32_t width,
+                               uint32_t height) {
+  uint64_t err = 0LL;
+
+  if (0.0f == model.fx || 0.0f == model.fy) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (err = internal::AllocateRemapTable(width, height, width, height,
+                                         &table_)) {
+    return err;
+  }
+  Build(model);
+  model_ = model;
+  from_cache_ = false;
+
+  return HIPPO_OK;
+}
+
+uint64_t Undistorter::SetModel(const LensModel &model, uint32_t width,
+                               uint32_t height, const char *cache_dir,
+                               const char *serial) {
+  uint64_t err = 0LL;
+  char path[1024], name[64];
+
+  if (NULL == cache_dir || NULL == serial) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_INVALID_PARAM);
+  }
+  // the serial number is part of the file name
+  size_t len = 0;
+  for (; serial[len] && len < sizeof(name) - 1; len++) {
+    name[len] = isalnum(static_cast<unsigned char>(serial[len])) ?
+        serial[len] : '_';
+  }
+  name[len] = '\0';
+  snprintf(path, sizeof(path), "%s/undistort_%s_%ux%u.lut", cache_dir, name,
+           width, height);
+
+  if (0.0f == model.fx || 0.0f == model.fy) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_PARAM_OUT_OF_RANGE);
+  }
+  if (err = internal::AllocateRemapTable(width, height, width, height,
+                                         &table_)) {
+    return err;
+  }
+  model_ = model;
+  if (HIPPO_OK == Load(path, model)) {
+    from_cache_ = true;
+    return HIPPO_OK;
+  }
+  Build(model);
+  from_cache_ = false;
+  // the table is still good if it can't be saved
+  Save(path);
+
+  return HIPPO_OK;
+}
+
+bool Undistorter::LoadedFromCache() {
+  return from_cache_;
+}
+
+uint64_t Undistorter::Load(const char *path, const LensModel &model) {
+  uint64_t err = 0LL;
+  TableHeader header;
+  size_t num_pixels = static_cast<size_t>(table_.width) * table_.height;
+
+  FILE *file = fopen(path, "rb");
+  if (NULL == file) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_OPEN);
+  }
+  if (1 != fread(&header, sizeof(header), 1, file)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_READ);
+    goto clean_up;
+  }
+  if (memcmp(header.magic, kTableMagic, 4) ||
+      kTableVersion != header.version || table_.width != header.width ||
+      table_.height != header.height ||
+      memcmp(&header.model, &model, sizeof(model))) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MESSAGE_ERROR);
+    goto clean_up;
+  }
+  if (num_pixels != fread(table_.pos, sizeof(uint32_t), num_pixels, file) ||
+      num_pixels != fread(table_.frac, sizeof(uint16_t), num_pixels, file)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_READ_LEN_ERROR);
+    goto clean_up;
+  }
+  // a corrupted entry would sample outside of the frames
+  if (!internal::CheckRemapTable(table_)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_MESSAGE_ERROR);
+    goto clean_up;
+  }
+
+clean_up:
+  fclose(file);
+  return err;
+}
+
+uint64_t Undistorter::Save(const char *path) {
+  uint64_t err = 0LL;
+  TableHeader header;
+  size_t num_pixels = static_cast<size_t>(table_.width) * table_.height;
+
+  memcpy(header.magic, kTableMagic, 4);
+  header.version = kTableVersion;
+  header.width = table_.width;
+  header.height = table_.height;
+  header.model = model_;
+  FILE *file = fopen(path, "wb");
+  if (NULL == file) {
+    return MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_OPEN);
+  }
+  if (1 != fwrite(&header, sizeof(header), 1, file) ||
+      num_pixels != fwrite(table_.pos, sizeof(uint32_t), num_pixels, file) ||
+      num_pixels != fwrite(table_.frac, sizeof(uint16_t), num_pixels, file)) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRITE);
+  }
+  if (fclose(file) && !err) {
+    err = MAKE_HIPPO_ERROR(HIPPO_DEVICE, HIPPO_WRITE);
+  }
+  if (err) {
+    // a partial table would fail to load anyway
+    remove(path);
+  }
+  return err;
+}
+
+uint64_t Undistorter::Undistort(const PixelBuffer &src,
+                                const PixelBuffer &dst) {
+  return internal::Remap(table_, src, dst, num_threads_, level_);
+}
+
+}  // namespace hippo
@@ -14,8 +14,11 @@ namespace hippo {
 
 extern std::mutex gHippoDeviceMutex;
 const char devName[] = "uvccamera";
+// the scalar properties
+const char kCameraIndex[] = "camera_index";
 extern const char *defaultHost;
 extern uint32_t defaultPort;
+extern const char *UVCCameraNotification_str[];
 
 UVCCamera::UVCCamera() :
         HippoCamera(devName, defaultHost, defaultPort, HIPPO_UVCCAMERA, 0),
@@ -43,7 +46,7 @@ UVCCamera::~UVCCamera(void) {
 }
 
 uint64_t UVCCamera::camera_index(uint32_t *get) {
-  return uint32_get("camera_index", get);
+  return property<uint32_t, kCameraIndex>(get);
 }
 
 uint64_t UVCCamera::subscribe(
@@ -55,9 +58,18 @@ uint64_t UVCCamera::subscribe(
 uint64_t UVCCamera::subscribe(
   void(*callback)(const UVCCameraNotificationParam &param, void *data),
   void *data, uint32_t *get) {
+  return subscribe(callback, data, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t UVCCamera::subscribe(
+  void(*callback)(const UVCCameraNotificationParam &param, void *data),
+  void *data, uint64_t mask, uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      UVCCameraNotification::on_sohal_connected);
   uint64_t err = 0LL;
 
-  if (err = HippoDevice::subscribe_raw(data, get)) {
+  if (err = HippoDevice::subscribe_raw(
+          data, mask, UVCCameraNotification_str, num_names, get)) {
     return err;
   }
   callback_ = callback;
@@ -65,6 +77,25 @@ uint64_t UVCCamera::subscribe(
   return err;
 }
 
+uint64_t UVCCamera::subscribe(uint32_t queue_depth, uint32_t *get) {
+  return subscribe(queue_depth, ALL_NOTIFICATIONS, get);
+}
+
+uint64_t UVCCamera::subscribe(uint32_t queue_depth, uint64_t mask,
+                              uint32_t *get) {
+  const uint32_t num_names = 1 + static_cast<uint32_t>(
+      UVCCameraNotification::on_sohal_connected);
+
+  callback_ = NULL;
+  return subscribe_queue<UVCCameraNotificationParam>(
+      queue_depth, mask, UVCCameraNotification_str, num_names, get);
+}
+
+uint64_t UVCCamera::poll(UVCCameraNotificationParam *params,
+                         uint32_t max_params, uint32_t *num_params) {
+  return poll_queue(params, max_params, num_params);
+}
+
 uint64_t UVCCamera::unsubscribe() {
   callback_ = NULL;
   return HippoDevice::unsubscribe();
@@ -76,7 +107,7 @@ uint64_t UVCCamera::unsubscribe(uint32_t *get) {
 }
 
 bool UVCCamera::HasRegisteredCallback() {
-  return (NULL != callback_);
+  return (NULL != callback_) || polling_;
 }
 
 const char *UVCCameraNotification_str[] = {
@@ -86,7 +117,7 @@ const char *UVCCameraNotification_str[] = {
 };
 
 void UVCCamera::ProcessSignal(char *method, void *obj) {
-  if (NULL == callback_) {
+  if (!HasRegisteredCallback()) {
     return;
   }
   uint64_t err = 0LL;
@@ -97,16 +128,12 @@ void UVCCamera::ProcessSignal(char *method, void *obj) {
       UVCCameraNotification::on_close),
     static_cast<uint32_t>(
       UVCCameraNotification::on_sohal_connected));
-  free(method);
   if (idx < 0) {
     return;
   }
-  nl::json v, *params = reinterpret_cast<nl::json*>(obj);
-  try {
-    v = params->at(0);
-  } catch (nl::json::exception) {     // out_of_range or type_error
-                                    // do nothing
-  }
+  // decoded in place, without copying it
+  const nl::json &v =
+      *reinterpret_cast<const nl::json*>(NotificationValue(obj));
   UVCCameraNotificationParam param;
   param.type = static_cast<hippo::UVCCameraNotification>(idx);
 
@@ -119,9 +146,12 @@ void UVCCamera::ProcessSignal(char *method, void *obj) {
     break;
   }
   if (!err) {
-    (*callback_)(param, callback_data_);
+    if (NULL != callback_) {
+      (*callback_)(param, callback_data_);
+    } else {
+      QueueNotification(param);
+    }
   }
-  delete params;
 }
 
 }  // namespace hippo
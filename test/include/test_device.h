@@ -0,0 +1,73 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#ifndef TEST_INCLUDE_TEST_DEVICE_H_
+#define TEST_INCLUDE_TEST_DEVICE_H_
+
+#include <functional>
+
+#include "include/hippo_device.h"
+
+//
+// the device of the tests that run without SoHal: a device of class D whose
+// notifications go to the |on_notification| function of the test (or to the
+// callback of D when there is none), and whose protected members the tests
+// drive are public
+//
+//   TestDevice<> device("signalbench", 20641, 0,
+//                       [&](const char *method, void *params) { ... });
+//   TestDevice<hippo::System> system;
+//   system.set_device_callback(&on_system_notification, &data);
+//
+template <typename D = hippo::HippoDevice>
+class TestDevice : public D {
+ public:
+  typedef std::function<void(const char *method, void *params)> Callback;
+
+  TestDevice(const char *name, uint32_t port, uint32_t index,
+             Callback on_notification = Callback()) :
+      D(name, "localhost", port, hippo::HIPPO_DEVICE, index),
+      on_notification_(on_notification) {
+  }
+  // a device of a derived class, e.g. hippo::System
+  TestDevice() {
+  }
+
+  using D::GetRawResultOrError;
+  using D::NotificationArena;
+  using D::SendSignal;
+  using D::deviceInfo_json2c;
+  using D::poll_queue;
+  using D::subscribe_raw;
+
+  // sets the callback of D, which gets the decoded notifications
+  template <typename C>
+  void set_device_callback(C callback, void *data) {
+    this->callback_ = callback;
+    this->callback_data_ = data;
+  }
+
+  // hands the pre-parsed |params| to ProcessSignal(), as the dispatcher does
+  void Deliver(const char *method, void *params) {
+    ProcessSignal(const_cast<char*>(method), params);
+  }
+
+ protected:
+  bool HasRegisteredCallback() override {
+    return on_notification_ ? true : D::HasRegisteredCallback();
+  }
+
+  void ProcessSignal(char *method, void *params) override {
+    if (on_notification_) {
+      on_notification_(method, params);
+    } else {
+      D::ProcessSignal(method, params);
+    }
+  }
+
+ private:
+  Callback on_notification_;
+};
+
+#endif  // TEST_INCLUDE_TEST_DEVICE_H_
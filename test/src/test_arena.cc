@@ -0,0 +1,116 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "include/hippo_arena.h"
+#include "include/hippo_device.h"
+#include "include/json.hpp"
+#include "../include/test_device.h"
+
+namespace nl = nlohmann;
+
+//
+// the ResultArena, checked without SoHal: the json2c functions carve the
+// fields of a result out of the arena, which releases them all at once
+//
+
+// the allocations that don't fit go to new blocks
+bool TestArenaGrowth() {
+  hippo::ResultArena arena(64);
+  const char str[] = "a string of forty characters, and a half";
+  char *strs[10];
+  bool ok = true;
+
+  for (uint32_t i = 0; i < 10; i++) {
+    strs[i] = arena.StrDup(str);
+    ok &= (NULL != strs[i]) &&
+          (0 == (reinterpret_cast<uintptr_t>(strs[i]) & 7));
+  }
+  for (uint32_t i = 0; ok && i < 10; i++) {
+    ok &= !strcmp(str, strs[i]);
+  }
+  // 42 bytes rounded up to 48
+  ok &= (10 * 48 == arena.Used());
+  ok &= (arena.Capacity() >= arena.Used() && arena.Capacity() > 64);
+  uint32_t *zeros = reinterpret_cast<uint32_t*>(arena.Calloc(100, 4));
+  for (uint32_t i = 0; ok && i < 100; i++) {
+    ok &= (0 == zeros[i]);
+  }
+
+  // the blocks are merged into one that fits the same results again
+  size_t capacity = arena.Capacity();
+  arena.Reset();
+  ok &= (0 == arena.Used() && capacity == arena.Capacity());
+  for (uint32_t i = 0; i < 10; i++) {
+    ok &= (NULL != arena.StrDup(str));
+  }
+  ok &= (NULL != arena.Calloc(100, 4));
+  ok &= (capacity == arena.Capacity());
+
+  arena.Release();
+  ok &= (0 == arena.Used() && 0 == arena.Capacity());
+  return ok;
+}
+
+// all the strings of a DeviceInfo go away with one Reset(), and the next
+// one reuses the same memory instead of allocating
+bool TestArenaResult() {
+  TestDevice<> device("arenabench", 20641, 0);
+  hippo::ResultArena arena(16);
+  hippo::DeviceInfo info, again;
+  nl::json json = {
+    { "fw_version", "0.9.1.2" }, { "name", "arenabench" },
+    { "serial", "SERIAL-NUMBER-OF-THE-ARENA-BENCH" }, { "index", 0 },
+    { "vendor_id", 0x03f0 }, { "product_id", 0x0001 },
+  };
+  bool ok = true;
+
+  // the result doesn't fit in the first block
+  ok &= (0LL == device.deviceInfo_json2c(&json, &info, &arena));
+  ok &= !strcmp("0.9.1.2", info.fw_version) &&
+        !strcmp("arenabench", info.name) &&
+        !strcmp("SERIAL-NUMBER-OF-THE-ARENA-BENCH", info.serial) &&
+        0x03f0 == info.vendor_id && 0x0001 == info.product_id;
+  // 8 + 16 + 40 bytes, in three blocks
+  size_t used = arena.Used();
+  ok &= (64 == used && arena.Capacity() > 16);
+
+  // the blocks are merged by Reset(): from then on, the same result is
+  // carved out of the same memory
+  arena.Reset();
+  ok &= (0 == arena.Used());
+  ok &= (0LL == device.deviceInfo_json2c(&json, &info, &arena));
+  size_t capacity = arena.Capacity();
+  arena.Reset();
+  ok &= (0LL == device.deviceInfo_json2c(&json, &again, &arena));
+  ok &= (info.fw_version == again.fw_version && info.name == again.name &&
+         info.serial == again.serial);
+  ok &= (used == arena.Used() && capacity == arena.Capacity());
+
+  // without an arena, the fields are freed one by one
+  ok &= (0LL == device.deviceInfo_json2c(&json, &info, NULL));
+  ok &= !strcmp("SERIAL-NUMBER-OF-THE-ARENA-BENCH", info.serial);
+  device.free_device_info(&info);
+  ok &= (NULL == info.fw_version && NULL == info.name &&
+         NULL == info.serial);
+  return ok;
+}
+
+uint64_t TestArena() {
+  fprintf(stderr, "#################################\n");
+  fprintf(stderr, "  Now Testing ResultArena\n");
+  fprintf(stderr, "#################################\n");
+
+  bool ok = TestArenaGrowth();
+  fprintf(stderr, "arena: growth across blocks and reset %s\n",
+          ok ? "OK" : "failed");
+  bool result_ok = TestArenaResult();
+  fprintf(stderr, "arena: one reset per multi-field result %s\n",
+          result_ok ? "OK" : "failed");
+
+  return (ok && result_ok) ? 0LL :
+      MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+}
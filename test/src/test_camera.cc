@@ -6,7 +6,9 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <chrono>   // NOLINT
 
+#include "include/frame_synchronizer.h"
 #include "include/hippo_camera.h"
 
 #define _LATENCY_CHECK_
@@ -19,6 +21,179 @@ extern void print_error(uint64_t err, const char *msg);
 void print_camera_frame(const hippo::CameraFrame &frame);
 
 
+// grabs frames into FrameHandles, which must recycle the pool's buffers
+uint64_t TestFramePool(hippo::HippoCamera *cam, hippo::CameraStreams st) {
+  const uint32_t kNumFrames = 60;
+  uint64_t err = 0LL;
+  hippo::FrameHandle previous, current;
+
+  for (uint32_t i = 0; i < kNumFrames; i++) {
+    if (err = cam->grab_frame(st, &current)) {
+      return err;
+    }
+    // keep two frames referenced at a time
+    previous = current;
+  }
+  previous.Reset();
+  current.Reset();
+
+  hippo::FramePoolStats stats;
+  if (err = cam->frame_pool_stats(&stats)) {
+    return err;
+  }
+  fprintf(stderr, "frame pool: %lld buffers of %zd bytes for %d frames, "
+          "%lld recycled, %lld in use\n", stats.allocated, stats.frame_size,
+          kNumFrames, stats.recycled, stats.in_use);
+  if (stats.allocated > 3 || stats.in_use) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+// grabs frames with a request always in flight, while processing the previous
+// frame, and checks that they are all distinct
+uint64_t TestAsyncGrab(hippo::HippoCamera *cam, hippo::CameraStreams st) {
+  typedef std::chrono::steady_clock Clock;
+  const uint32_t kNumFrames = 60;
+  uint64_t err = 0LL;
+  uint32_t repeated = 0;
+  uint16_t last_index = 0;
+
+  hippo::FrameFuture next;
+  if (err = cam->grab_frame_async(st, &next)) {
+    return err;
+  }
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < kNumFrames; i++) {
+    hippo::FrameFuture current = next;
+    if (err = cam->grab_frame_async(st, &next)) {
+      break;
+    }
+    hippo::FrameHandle frame;
+    if (err = current.wait(1000, &frame)) {
+      break;
+    }
+    if (!frame->header->error) {
+      for (uint32_t j = 0; j < hippo::kMaxNumStreams; j++) {
+        if (frame->header->stream.value & (1 << j)) {
+          if (i && frame->streams[j].header->index == last_index) {
+            repeated++;
+          }
+          last_index = frame->streams[j].header->index;
+          break;
+        }
+      }
+    }
+  }
+  double fps = 1e3 * kNumFrames /
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          Clock::now() - start).count();
+  // the last request completes with the frame or is cancelled
+  next.wait(1000, NULL);
+  fprintf(stderr, "grab_frame_async: %.1f fps, %d repeated frames\n",
+          fps, repeated);
+  if (!err && repeated) {
+    err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+// matches the streams of the frames grabbed by their timestamps
+uint64_t TestFrameSync(hippo::HippoCamera *cam, hippo::CameraStreams st) {
+  const uint32_t kNumFrames = 30;
+  const int64_t kToleranceUs = 20000;
+  uint64_t err = 0LL;
+  hippo::FrameSynchronizer sync(kToleranceUs);
+  uint32_t sources[hippo::kMaxNumStreams] = { 0 };
+  uint32_t num_sets = 0;
+
+  for (uint32_t i = 0; i < hippo::kMaxNumStreams; i++) {
+    hippo::CameraStreams stream = { static_cast<uint8_t>(1 << i) };
+    if ((st.value & stream.value) &&
+        (err = sync.AddSource(stream, &sources[i]))) {
+      return err;
+    }
+  }
+  for (uint32_t n = 0; n < kNumFrames; n++) {
+    hippo::FrameHandle frame;
+    if (err = cam->grab_frame(st, &frame)) {
+      return err;
+    }
+    if (frame->header->error) {
+      continue;
+    }
+    for (uint32_t i = 0; i < hippo::kMaxNumStreams; i++) {
+      if ((st.value & (1 << i)) && (err = sync.Push(sources[i], frame))) {
+        return err;
+      }
+    }
+    hippo::FrameSet set;
+    while (!sync.Pop(&set, 0)) {
+      num_sets++;
+    }
+  }
+  hippo::SyncStats stats;
+  sync.GetStats(&stats);
+  fprintf(stderr, "frame sync: %lld sets from %d frames, skew avg %lld us "
+          "max %lld us, dropped", stats.framesets, kNumFrames,
+          stats.avg_skew_us, stats.max_skew_us);
+  for (uint32_t i = 0; i < hippo::kMaxNumStreams; i++) {
+    if (st.value & (1 << i)) {
+      fprintf(stderr, " %lld", stats.dropped[sources[i]]);
+    }
+  }
+  fprintf(stderr, ", dropped sets %lld\n", stats.dropped_sets);
+  if (num_sets + stats.dropped_sets != stats.framesets) {
+    err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+// compares the frame rate of grab_frame() with the one of the streaming ring
+uint64_t TestCameraStreaming(hippo::HippoCamera *cam,
+                             hippo::CameraStreams st) {
+  typedef std::chrono::steady_clock Clock;
+  const uint32_t kNumFrames = 60;
+  uint64_t err = 0LL;
+
+  hippo::CameraFrame grabbed = { 0 };
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < kNumFrames; i++) {
+    if (err = cam->grab_frame(st, &grabbed)) {
+      free(grabbed.raw_data_);
+      return err;
+    }
+  }
+  double grab_fps = 1e3 * kNumFrames /
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          Clock::now() - start).count();
+  free(grabbed.raw_data_);
+
+  if (err = cam->start_streaming(st, 4)) {
+    return err;
+  }
+  start = Clock::now();
+  for (uint32_t i = 0; i < kNumFrames; i++) {
+    hippo::CameraFrame *frame = NULL;
+    if (err = cam->acquire_frame(&frame, 1000)) {
+      break;
+    }
+    cam->release_frame(frame);
+  }
+  double stream_fps = 1e3 * kNumFrames /
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          Clock::now() - start).count();
+  cam->stop_streaming();
+
+  hippo::StreamingStats stats;
+  cam->streaming_stats(&stats);
+  fprintf(stderr, "grab_frame: %.1f fps, streaming: %.1f fps "
+          "(received %lld, acquired %lld, dropped %lld, errors %lld)\n",
+          grab_fps, stream_fps, stats.received, stats.acquired,
+          stats.dropped, stats.errors);
+  return err;
+}
+
 uint64_t TestCameraStreams(hippo::HippoCamera *cam,
                            hippo::CameraStreams st) {
   uint64_t err;
@@ -48,6 +223,19 @@ uint64_t TestCameraStreams(hippo::HippoCamera *cam,
   }
   free(frame.raw_data_);
 
+  if (err = TestFramePool(cam, st)) {
+    return err;
+  }
+  if (err = TestAsyncGrab(cam, st)) {
+    return err;
+  }
+  if (err = TestFrameSync(cam, st)) {
+    return err;
+  }
+  if (err = TestCameraStreaming(cam, st)) {
+    return err;
+  }
+
   fprintf(stderr, "1!\n");
 
   // test disable_stream
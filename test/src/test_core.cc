@@ -0,0 +1,259 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>    // NOLINT
+
+#include "include/hippo_device.h"
+#include "include/json.hpp"
+#include "include/scalar_codec.h"
+#include "../include/test_device.h"
+
+namespace nl = nlohmann;
+
+extern void print_error(uint64_t err);
+
+//
+// the encoding of the scalar accessors' requests and the decoding of their
+// responses, which bypass nl::json, checked without SoHal
+//
+template <typename T>
+static bool CheckRequest(const char *fname, const T *set,
+                         const char *expected) {
+  char request[256];
+  int len = hippo::internal::EncodeScalarRequest("1", "scalarbench", fname,
+                                                 set, request,
+                                                 sizeof(request));
+  bool ok = (len > 0) && !strcmp(request, expected);
+  if (!ok) {
+    fprintf(stderr, "scalar request '%s', expected '%s'\n",
+            len > 0 ? request : "", expected);
+  }
+  return ok;
+}
+
+// returns true if the |result| of a response decodes to |expected|
+template <typename T>
+static bool CheckResult(const char *result, T expected) {
+  char response[128];
+  T value;
+  snprintf(response, sizeof(response),
+           "{\"id\":\"1\",\"jsonrpc\":\"2.0\",\"result\":%s}", result);
+  if (!hippo::internal::DecodeScalarResult(response, &value) ||
+      value != expected) {
+    fprintf(stderr, "scalar response '%s' decoded wrong\n", response);
+    return false;
+  }
+  return true;
+}
+
+// returns true if |result| has to go through nl::json (e.g. to be rejected)
+template <typename T>
+static bool CheckNoResult(const char *result) {
+  char response[128];
+  T value;
+  snprintf(response, sizeof(response),
+           "{\"id\":\"1\",\"jsonrpc\":\"2.0\",\"result\":%s}", result);
+  return !hippo::internal::DecodeScalarResult(response, &value);
+}
+
+static bool CheckFloatCodec() {
+  const float f = 2.0f, f_frac = 0.1f, f_neg = -1.5f;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float inf = std::numeric_limits<float>::infinity();
+  char request[256];
+  bool ok = true;
+
+  // SoHal must get a float, not an integer
+  ok &= CheckRequest("gain", &f,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.gain\",\"params\":[2.0]}");
+  ok &= CheckRequest("gain", &f_frac,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.gain\","
+                     "\"params\":[0.100000001]}");
+  ok &= CheckRequest("gain", &f_neg,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.gain\",\"params\":[-1.5]}");
+  ok &= CheckResult("0.100000001", f_frac);
+  ok &= CheckResult("-2.5e1", -25.0f);
+  ok &= CheckResult("1.5 ", 1.5f);
+  ok &= CheckResult("3", 3.0f);
+  // nan and inf are not JSON
+  ok &= (0 > hippo::internal::EncodeScalarRequest("1", "scalarbench", "gain",
+                                                  &nan, request,
+                                                  sizeof(request)));
+  ok &= (0 > hippo::internal::EncodeScalarRequest("1", "scalarbench", "gain",
+                                                  &inf, request,
+                                                  sizeof(request)));
+  ok &= CheckNoResult<float>("1e39");
+  ok &= CheckNoResult<float>("-inf");
+  ok &= CheckNoResult<float>("nan");
+  ok &= CheckNoResult<float>("0x1p3");
+  return ok;
+}
+
+uint64_t TestScalarCodec() {
+  const bool b = true;
+  const uint16_t u16 = 65535;
+  const uint32_t u32 = 4294967295u;
+  bool ok = true;
+
+  ok &= CheckRequest<bool>("flip_frame", NULL,
+                           "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                           "\"method\":\"scalarbench.flip_frame\"}");
+  ok &= CheckRequest("flip_frame", &b,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.flip_frame\","
+                     "\"params\":[true]}");
+  ok &= CheckRequest("brightness", &u16,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.brightness\","
+                     "\"params\":[65535]}");
+  ok &= CheckRequest("led_on_off_rate", &u32,
+                     "{\"id\":\"1\",\"jsonrpc\":\"2.0\","
+                     "\"method\":\"scalarbench.led_on_off_rate\","
+                     "\"params\":[4294967295]}");
+  ok &= CheckResult("true", true);
+  ok &= CheckResult(" false", false);
+  ok &= CheckResult("65535", u16);
+  ok &= CheckResult("4294967295", u32);
+  // error responses and out of range results go through nl::json
+  uint32_t value;
+  ok &= !hippo::internal::DecodeScalarResult(
+      "{\"id\":\"1\",\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32602,"
+      "\"message\":\"Invalid params\"}}", &value);
+  ok &= CheckNoResult<bool>("1");
+  ok &= CheckNoResult<uint16_t>("65536");
+  ok &= CheckNoResult<uint32_t>("4294967296");
+  ok &= CheckNoResult<uint32_t>("1.5");
+
+  ok &= CheckFloatCodec();
+  // the JSON numbers don't depend on the locale of the application
+  const char *comma_locales[] = {
+    "de-DE", "de_DE.UTF-8", "de_DE.utf8", "German_Germany.1252",
+  };
+  const char *comma_locale = NULL;
+  for (const char *name : comma_locales) {
+    if (NULL != setlocale(LC_NUMERIC, name)) {
+      comma_locale = name;
+      break;
+    }
+  }
+  if (NULL != comma_locale) {
+    ok &= CheckFloatCodec();
+    setlocale(LC_NUMERIC, "C");
+  }
+
+  fprintf(stderr, "scalar accessors: encoding and decoding %s%s%s\n",
+          ok ? "OK" : "failed", comma_locale ? ", also in " : "",
+          comma_locale ? comma_locale : "");
+  return ok ? 0LL : MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+}
+
+//
+// the error codes: the line and file id of MAKE_HIPPO_ERROR are computed at
+// compile time, including for the errors made by the templates of a header
+//
+static_assert(0x7 == hippo::internal::LineToHex(7), "one digit line");
+static_assert(0x123 == hippo::internal::LineToHex(123), "decimal as hex");
+static_assert(0x9999 == hippo::internal::LineToHex(9999), "four digits");
+static_assert(0xbb00 == hippo::internal::FileIdFromPath("hippo.cc"),
+              "hiPPo file");
+static_assert(0xbb0d == hippo::internal::FileIdFromPath(
+                  "C:\\hippo\\src\\hippo_device.cc"), "windows path");
+static_assert(0xbb0e ==
+              hippo::internal::FileIdFromPath("src/../include/hippo_device.h"),
+              "header with templates");
+static_assert(0xbb00 !=
+              (hippo::internal::FileIdFromPath("test/src/test_core.cc") &
+               0xff00), "client files stay out of the hiPPo ids");
+static_assert(hippo::internal::kFileIdNotFound !=
+              hippo::internal::FileIdFromPath("test_core.cc"),
+              "client files get an id");
+
+// an error response of SoHal with |message|
+static uint64_t SohalError(TestDevice<> *device, const char *message) {
+  nl::json response = {
+    { "id", "1" }, { "jsonrpc", "2.0" },
+    { "error", { { "code", -32602 }, { "data", "sohal.py:1a:13" },
+                 { "message", message } } },
+  };
+  return device->GetRawResultOrError(&response);
+}
+
+uint64_t TestErrorCodes() {
+  TestDevice<> device("errorbench", 20641, 0);
+  char msg[256];
+
+  // an error made in a template of hippo_device.h
+  uint64_t err = device.poll_queue<int>(NULL, 0, NULL);
+  hippo::strerror(err, sizeof(msg), msg);
+  fprintf(stderr, "error from a header: %s\n", msg);
+  if (0xbb0e != (err >> 48) || NULL == strstr(msg, "hippo_device.h")) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return 0LL;
+}
+
+// the SoHal error messages are kept per thread, the last 8 in a ring
+uint64_t TestErrorHistory() {
+  TestDevice<> device("errorbench", 20641, 0);
+  const char *msgs[16];
+  char expected[32];
+  bool ok = true;
+
+  for (uint32_t i = 0; i < 10; i++) {
+    snprintf(expected, sizeof(expected), "sohal error %u", i);
+    ok &= (0LL != SohalError(&device, expected));
+  }
+  ok &= !strcmp("sohal error 9", hippo::strerror());
+  uint32_t num = hippo::strerror_history(msgs, 16);
+  ok &= (8 == num);
+  for (uint32_t i = 0; i < num; i++) {
+    // most recent first, the first two were overwritten
+    snprintf(expected, sizeof(expected), "sohal error %u", 9 - i);
+    ok &= !strcmp(expected, msgs[i]);
+  }
+  ok &= (2 == hippo::strerror_history(msgs, 2));
+
+  // the errors of another thread are not seen by this one, and the other
+  // way round
+  std::thread other([&]() {
+    ok &= !strcmp("", hippo::strerror());
+    ok &= (0 == hippo::strerror_history(msgs, 16));
+    ok &= (0LL != SohalError(&device, "other thread error"));
+    ok &= (1 == hippo::strerror_history(msgs, 16) &&
+           !strcmp("other thread error", msgs[0]));
+  });
+  other.join();
+  ok &= !strcmp("sohal error 9", hippo::strerror());
+  ok &= (8 == hippo::strerror_history(msgs, 16) &&
+         !strcmp("sohal error 9", msgs[0]));
+
+  fprintf(stderr, "error history: per thread ring %s\n",
+          ok ? "OK" : "failed");
+  return ok ? 0LL : MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+}
+
+uint64_t TestCore() {
+  uint64_t err = 0LL;
+
+  fprintf(stderr, "#################################\n");
+  fprintf(stderr, "  Now Testing Core (without SoHal)\n");
+  fprintf(stderr, "#################################\n");
+
+  if (err = TestScalarCodec()) {
+    return err;
+  }
+  if (err = TestErrorCodes()) {
+    return err;
+  }
+  if (err = TestErrorHistory()) {
+    return err;
+  }
+  return err;
+}
@@ -33,6 +33,10 @@ extern uint64_t TestSoHal(hippo::SoHal *sohal);
 extern uint64_t TestUVCCamera(hippo::UVCCamera *uvccamera);
 extern uint64_t TestDeskLamp(hippo::DeskLamp *desklamp);
 extern uint64_t TestSWDevice();
+extern uint64_t TestNotifications();
+extern uint64_t TestImaging();
+extern uint64_t TestCore();
+extern uint64_t TestArena();
 
 void print_error(uint64_t err) {
   char err_msg[256];
@@ -206,5 +210,21 @@ int main(int argc, char *argv[]) {
     print_error(err);
   }
 
+  if (err = TestNotifications()) {
+    print_error(err);
+  }
+
+  if (err = TestImaging()) {
+    print_error(err);
+  }
+
+  if (err = TestCore()) {
+    print_error(err);
+  }
+
+  if (err = TestArena()) {
+    print_error(err);
+  }
+
   return 0;
 }
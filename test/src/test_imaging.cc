@@ -0,0 +1,843 @@
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <chrono>   // NOLINT
+#include <vector>
+
+#include "include/pixel_convert.h"
+#include "include/keystone_warp.h"
+#include "include/point_cloud.h"
+#include "include/pyramid.h"
+#include "include/registration.h"
+#include "include/undistort.h"
+
+extern void print_error(uint64_t err);
+
+typedef struct Conversion {
+  hippo::PixelFormat src;
+  hippo::PixelFormat dst;
+  const char *name;
+} Conversion;
+
+const Conversion kConversions[] = {
+  { hippo::PixelFormat::PIXEL_YUY2, hippo::PixelFormat::PIXEL_RGB888,
+    "yuy2 -> rgb" },
+  { hippo::PixelFormat::PIXEL_YUY2, hippo::PixelFormat::PIXEL_BGRA8888,
+    "yuy2 -> bgra" },
+  { hippo::PixelFormat::PIXEL_UYVY, hippo::PixelFormat::PIXEL_RGB888,
+    "uyvy -> rgb" },
+  { hippo::PixelFormat::PIXEL_UYVY, hippo::PixelFormat::PIXEL_BGRA8888,
+    "uyvy -> bgra" },
+  { hippo::PixelFormat::PIXEL_NV12, hippo::PixelFormat::PIXEL_RGB888,
+    "nv12 -> rgb" },
+  { hippo::PixelFormat::PIXEL_NV12, hippo::PixelFormat::PIXEL_BGRA8888,
+    "nv12 -> bgra" },
+  { hippo::PixelFormat::PIXEL_GRAY16, hippo::PixelFormat::PIXEL_GRAY8,
+    "gray16 -> gray8" },
+  { hippo::PixelFormat::PIXEL_RGB888, hippo::PixelFormat::PIXEL_BGRA8888,
+    "rgb -> bgra" },
+};
+
+const char *kSimdNames[] = { "scalar", "sse2", "avx2" };
+
+// the bytes of an image, with the UV plane of NV12
+static size_t ImageSize(hippo::PixelFormat format, uint32_t width,
+                        uint32_t height, uint32_t stride) {
+  uint32_t rows = hippo::PixelFormat::PIXEL_NV12 == format ?
+      height + height / 2 : height;
+  return static_cast<size_t>(stride) * rows;
+}
+
+static uint64_t Convert(const Conversion &conv, hippo::SimdLevel simd,
+                        uint32_t num_threads, const uint8_t *src,
+                        uint32_t width, uint32_t height, uint32_t dst_stride,
+                        uint8_t *dst) {
+  hippo::ConvertOptions options = { 1000, 40000, num_threads, simd };
+  hippo::PixelConverter converter(options);
+  hippo::PixelBuffer src_buf = { const_cast<uint8_t*>(src), width, height, 0,
+                                 conv.src };
+  hippo::PixelBuffer dst_buf = { dst, width, height, dst_stride, conv.dst };
+  return converter.Convert(src_buf, dst_buf);
+}
+
+// every SIMD level must produce the same output as the scalar kernels, up to
+// the row tails, and must not touch the padding of the strided rows
+static uint64_t TestConversions() {
+  const uint32_t kWidths[] = { 2, 6, 16, 30, 34, 130 };
+  const uint32_t kHeight = 6;
+  const uint32_t kPadding = 13;
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+
+  fprintf(stderr, "cpu simd level: %s\n",
+          kSimdNames[static_cast<uint32_t>(best)]);
+  for (const Conversion &conv : kConversions) {
+    for (uint32_t width : kWidths) {
+      uint32_t src_stride = hippo::PixelConverter::RowBytes(conv.src, width);
+      uint32_t dst_stride =
+          hippo::PixelConverter::RowBytes(conv.dst, width) + kPadding;
+      std::vector<uint8_t> src(ImageSize(conv.src, width, kHeight,
+                                         src_stride));
+      for (auto &value : src) {
+        value = static_cast<uint8_t>(rand());
+      }
+      std::vector<uint8_t> expected(dst_stride * kHeight, 0xa5);
+      if (err = Convert(conv, hippo::SimdLevel::scalar, 1, src.data(),
+                        width, kHeight, dst_stride, expected.data())) {
+        print_error(err);
+        return err;
+      }
+      for (uint32_t level = 1; level <= static_cast<uint32_t>(best);
+           level++) {
+        std::vector<uint8_t> dst(dst_stride * kHeight, 0xa5);
+        if (err = Convert(conv, static_cast<hippo::SimdLevel>(level), 2,
+                          src.data(), width, kHeight, dst_stride,
+                          dst.data())) {
+          print_error(err);
+          return err;
+        }
+        if (dst != expected) {
+          fprintf(stderr, "%s (%s): wrong output for width %d\n",
+                  conv.name, kSimdNames[level], width);
+          err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+        }
+      }
+    }
+  }
+  return err;
+}
+
+// throughput of each conversion of a 4352x3264 (keystoned 4416x3312)
+// hirescamera frame
+static uint64_t BenchConversions() {
+  const uint32_t kWidth = 4352;
+  const uint32_t kHeight = 3264;
+  const uint32_t kIterations = 10;
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  std::vector<uint8_t> src(4 * kWidth * kHeight, 0x80);
+  std::vector<uint8_t> dst(4 * kWidth * kHeight);
+
+  for (const Conversion &conv : kConversions) {
+    for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+      for (uint32_t num_threads : { 1u, 0u }) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < kIterations; i++) {
+          if (err = Convert(conv, static_cast<hippo::SimdLevel>(level),
+                            num_threads, src.data(), kWidth, kHeight, 0,
+                            dst.data())) {
+            print_error(err);
+            return err;
+          }
+        }
+        double us = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count()) /
+            kIterations;
+        fprintf(stderr, "%-16s %-6s %s: %6.2f ms/frame, %7.1f Mpixels/s\n",
+                conv.name, kSimdNames[level],
+                num_threads ? "1 thread   " : "all threads", us / 1000.0,
+                us > 0.0 ? kWidth * kHeight / us : 0.0);
+      }
+    }
+  }
+
+  // the cost of splitting a frame across the threads, on a tiny frame
+  const uint32_t kSplits = 1000;
+  const Conversion &gray = kConversions[6];
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kSplits; i++) {
+    Convert(gray, hippo::SimdLevel::scalar, 4, src.data(), 64, 16, 0,
+            dst.data());
+  }
+  double us = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count()) / kSplits;
+  fprintf(stderr, "%-16s 64x16 in 4 threads: %6.2f us/frame\n", gray.name,
+          us);
+  return err;
+}
+
+// every SIMD level must produce the points of the scalar kernel in both
+// layouts, and each point must project back onto its pixel through the
+// distortion model
+static uint64_t TestPointCloud() {
+  const uint32_t kWidth = 640;
+  const uint32_t kHeight = 480;
+  const uint32_t kIterations = 100;
+  const hippo::CalibrationIntrinsics intrinsics = {
+    475.0f, 475.0f, 315.5f, 245.5f };
+  const hippo::CalibrationDistortion distortion = {
+    0.12f, -0.25f, 0.08f, 0.001f, -0.002f };
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  size_t num_pixels = kWidth * kHeight;
+  std::vector<uint16_t> depth(num_pixels);
+  std::vector<float> expected(3 * num_pixels);
+  std::vector<float> xyz(3 * num_pixels);
+  std::vector<float> planes(3 * num_pixels);
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    // with holes
+    depth[i] = static_cast<uint16_t>(i % 7 ? 300 + rand() % 2000 : 0);
+  }
+  hippo::PixelBuffer depth_buf = {
+    reinterpret_cast<uint8_t*>(depth.data()), kWidth, kHeight, 0,
+    hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+  for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+    hippo::PointCloudProjector projector(
+        2, static_cast<hippo::SimdLevel>(level));
+    if (err = projector.SetCalibration(intrinsics, distortion, false,
+                                       kWidth, kHeight)) {
+      print_error(err);
+      return err;
+    }
+    hippo::PixelBuffer points_buf = {
+      reinterpret_cast<uint8_t*>(level ? xyz.data() : expected.data()),
+      kWidth, kHeight, 0, hippo::PixelFormat::PIXEL_POINTS_MM32F };
+    hippo::PointPlanes planes_buf = {
+      planes.data(), planes.data() + num_pixels,
+      planes.data() + 2 * num_pixels, 0 };
+    if ((err = projector.Project(depth_buf, points_buf)) ||
+        (err = projector.Project(depth_buf, planes_buf))) {
+      print_error(err);
+      return err;
+    }
+    for (size_t i = 0; i < num_pixels; i++) {
+      if (planes[i] != expected[3 * i] ||
+          planes[num_pixels + i] != expected[3 * i + 1] ||
+          planes[2 * num_pixels + i] != expected[3 * i + 2] ||
+          (level && memcmp(&xyz[3 * i], &expected[3 * i],
+                           3 * sizeof(float)))) {
+        fprintf(stderr, "point cloud (%s): wrong point %zd\n",
+                kSimdNames[level], i);
+        return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+      }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; i++) {
+      projector.Project(depth_buf, points_buf);
+    }
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "point cloud %dx%d (%s): %lld us/frame\n",
+            kWidth, kHeight, kSimdNames[level], us / kIterations);
+  }
+  for (size_t i = 0; i < num_pixels; i += 97) {
+    if (0.0f == expected[3 * i + 2]) {
+      continue;
+    }
+    double x = expected[3 * i] / expected[3 * i + 2];
+    double y = expected[3 * i + 1] / expected[3 * i + 2];
+    double r2 = x * x + y * y;
+    double radial = 1.0 + r2 * (distortion.k1 + r2 * (distortion.k2 +
+                                                      r2 * distortion.k3));
+    double xd = x * radial + 2.0 * distortion.p1 * x * y +
+        distortion.p2 * (r2 + 2.0 * x * x);
+    double yd = y * radial + distortion.p1 * (r2 + 2.0 * y * y) +
+        2.0 * distortion.p2 * x * y;
+    double u = xd * intrinsics.fx + intrinsics.cx;
+    double v = yd * intrinsics.fy + intrinsics.cy;
+    if (fabs(u - static_cast<double>(i % kWidth)) > 0.01 ||
+        fabs(v - static_cast<double>(i / kWidth)) > 0.01) {
+      fprintf(stderr, "point cloud: point %zd projects to %f, %f\n",
+              i, u, v);
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+  return err;
+}
+
+// a depthcamera and a hirescamera 25mm apart, slightly rotated
+static void FakeMapping(hippo::Camera3DMapping *mapping) {
+  memset(mapping, 0, sizeof(*mapping));
+  mapping->from.calibration_resolution.width = 640;
+  mapping->from.calibration_resolution.height = 480;
+  mapping->from.focal_length.x = 475.0f;
+  mapping->from.focal_length.y = 475.0f;
+  mapping->from.lens_distortion.center.x = 318.0f;
+  mapping->from.lens_distortion.center.y = 242.0f;
+  mapping->from.lens_distortion.kappa[0] = 0.1f;
+  mapping->from.lens_distortion.kappa[1] = -0.2f;
+  mapping->to.calibration_resolution.width = 1920;
+  mapping->to.calibration_resolution.height = 1080;
+  mapping->to.focal_length.x = 1400.0f;
+  mapping->to.focal_length.y = 1400.0f;
+  mapping->to.lens_distortion.center.x = 955.0f;
+  mapping->to.lens_distortion.center.y = 545.0f;
+  mapping->to.lens_distortion.kappa[0] = -0.05f;
+  mapping->to.lens_distortion.p[0] = 0.001f;
+  const float angle = 0.02f;    // radians, around the y axis
+  mapping->matrix_transformation[0][0] = cosf(angle);
+  mapping->matrix_transformation[0][2] = -sinf(angle);
+  mapping->matrix_transformation[1][1] = 1.0f;
+  mapping->matrix_transformation[2][0] = sinf(angle);
+  mapping->matrix_transformation[2][2] = cosf(angle);
+  mapping->matrix_transformation[3][0] = 25.0f;
+  mapping->matrix_transformation[3][3] = 1.0f;
+}
+
+// every SIMD level must register the same pixels as the scalar kernel, and
+// each depth pixel must land where the camera models project it
+static uint64_t TestRegistration() {
+  const uint32_t kDepthWidth = 640, kDepthHeight = 480;
+  const uint32_t kColorWidth = 1280, kColorHeight = 720;
+  const uint32_t kIterations = 100;
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  hippo::Camera3DMapping mapping;
+  size_t num_depth = kDepthWidth * kDepthHeight;
+  size_t num_color = kColorWidth * kColorHeight;
+  std::vector<uint16_t> depth(num_depth);
+  // each color pixel holds its own index
+  std::vector<uint32_t> color(num_color);
+  std::vector<uint32_t> expected_color(num_depth), aligned(num_depth);
+  std::vector<uint16_t> expected_depth(num_color), registered(num_color);
+
+  FakeMapping(&mapping);
+  for (size_t i = 0; i < num_depth; i++) {
+    depth[i] = static_cast<uint16_t>(i % 11 ? 500 + rand() % 1000 : 0);
+  }
+  for (size_t i = 0; i < num_color; i++) {
+    color[i] = static_cast<uint32_t>(i) | 0x80000000;
+  }
+  hippo::PixelBuffer depth_buf = {
+    reinterpret_cast<uint8_t*>(depth.data()), kDepthWidth, kDepthHeight, 0,
+    hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+  hippo::PixelBuffer color_buf = {
+    reinterpret_cast<uint8_t*>(color.data()), kColorWidth, kColorHeight, 0,
+    hippo::PixelFormat::PIXEL_BGRA8888 };
+  for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+    hippo::DepthRegistration registration(
+        2, static_cast<hippo::SimdLevel>(level));
+    hippo::PixelBuffer aligned_buf = {
+      reinterpret_cast<uint8_t*>(level ? aligned.data() :
+                                 expected_color.data()),
+      kDepthWidth, kDepthHeight, 0, hippo::PixelFormat::PIXEL_BGRA8888 };
+    hippo::PixelBuffer registered_buf = {
+      reinterpret_cast<uint8_t*>(level ? registered.data() :
+                                 expected_depth.data()),
+      kColorWidth, kColorHeight, 0, hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+    if ((err = registration.SetMapping(mapping, kDepthWidth, kDepthHeight,
+                                       kColorWidth, kColorHeight)) ||
+        (err = registration.ColorToDepth(depth_buf, color_buf,
+                                         aligned_buf)) ||
+        (err = registration.DepthToColor(depth_buf, registered_buf))) {
+      print_error(err);
+      return err;
+    }
+    if (level && (aligned != expected_color ||
+                  registered != expected_depth)) {
+      fprintf(stderr, "registration (%s): wrong output\n",
+              kSimdNames[level]);
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; i++) {
+      registration.ColorToDepth(depth_buf, color_buf, aligned_buf);
+    }
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "registration %dx%d to %dx%d (%s): %lld us/frame\n",
+            kDepthWidth, kDepthHeight, kColorWidth, kColorHeight,
+            kSimdNames[level], us / kIterations);
+  }
+
+  hippo::LensModel depth_lens, color_lens;
+  hippo::LensModelFromCameraParameters(mapping.from, kDepthWidth,
+                                       kDepthHeight, &depth_lens);
+  hippo::LensModelFromCameraParameters(mapping.to, kColorWidth,
+                                       kColorHeight, &color_lens);
+  const float (*m)[4] = mapping.matrix_transformation;
+  for (size_t i = 0; i < num_depth; i += 89) {
+    double x, y, u, v;
+    hippo::UndistortPoint(depth_lens, static_cast<double>(i % kDepthWidth),
+                          static_cast<double>(i / kDepthWidth), &x, &y);
+    double z = depth[i];
+    double px = m[0][0] * x * z + m[1][0] * y * z + m[2][0] * z + m[3][0];
+    double py = m[0][1] * x * z + m[1][1] * y * z + m[2][1] * z + m[3][1];
+    double pz = m[0][2] * x * z + m[1][2] * y * z + m[2][2] * z + m[3][2];
+    hippo::DistortPoint(color_lens, px / pz, py / pz, &u, &v);
+    bool inside = z > 0.0 && u >= 0.0 && u < kColorWidth - 0.5 &&
+        v >= 0.0 && v < kColorHeight - 0.5;
+    if (!inside) {
+      continue;
+    }
+    uint32_t index = expected_color[i] & 0x7fffffff;
+    if (0 == expected_color[i] ||
+        fabs(u - static_cast<double>(index % kColorWidth)) > 0.51 ||
+        fabs(v - static_cast<double>(index / kColorWidth)) > 0.51) {
+      fprintf(stderr, "registration: pixel %zd lands on %f, %f\n", i, u, v);
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+  return err;
+}
+
+// a flat wall in front of the depthcamera must fill the color frame where
+// it's seen, even with more than 40 color pixels per depth pixel
+static uint64_t TestRegistrationCoverage() {
+  const uint32_t kDepthWidth = 640, kDepthHeight = 480;
+  const uint32_t kColorWidth = 4352, kColorHeight = 3264;
+  const uint32_t kIterations = 10;
+  const uint32_t kMargin = 8;
+  uint64_t err = 0LL;
+  hippo::Camera3DMapping mapping;
+  std::vector<uint16_t> depth(kDepthWidth * kDepthHeight, 1000);
+  std::vector<uint16_t> registered(kColorWidth * kColorHeight);
+
+  FakeMapping(&mapping);
+  hippo::PixelBuffer depth_buf = {
+    reinterpret_cast<uint8_t*>(depth.data()), kDepthWidth, kDepthHeight, 0,
+    hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+  hippo::PixelBuffer registered_buf = {
+    reinterpret_cast<uint8_t*>(registered.data()), kColorWidth,
+    kColorHeight, 0, hippo::PixelFormat::PIXEL_DEPTH_MM16 };
+  hippo::DepthRegistration registration;
+  if ((err = registration.SetMapping(mapping, kDepthWidth, kDepthHeight,
+                                     kColorWidth, kColorHeight)) ||
+      (err = registration.DepthToColor(depth_buf, registered_buf))) {
+    print_error(err);
+    return err;
+  }
+
+  // the color rectangle inside of the projections of the depth pixels a
+  // few pixels from the edges (which the distortions bend)
+  hippo::LensModel depth_lens, color_lens;
+  hippo::LensModelFromCameraParameters(mapping.from, kDepthWidth,
+                                       kDepthHeight, &depth_lens);
+  hippo::LensModelFromCameraParameters(mapping.to, kColorWidth,
+                                       kColorHeight, &color_lens);
+  const float (*m)[4] = mapping.matrix_transformation;
+  double left = 0.0, right = kColorWidth - 1.0;
+  double top = 0.0, bottom = kColorHeight - 1.0;
+  for (uint32_t i = 0; i < 2 * (kDepthWidth + kDepthHeight); i++) {
+    // the top, bottom, left and right edges
+    uint32_t edge = i < 2 * kDepthWidth ? i / kDepthWidth :
+        2 + (i - 2 * kDepthWidth) / kDepthHeight;
+    uint32_t t = edge < 2 ? i % kDepthWidth :
+        (i - 2 * kDepthWidth) % kDepthHeight;
+    double du = edge < 2 ? t : (2 == edge ? kMargin : kDepthWidth - kMargin);
+    double dv = edge >= 2 ? t : (0 == edge ? kMargin :
+                                 kDepthHeight - kMargin);
+    double x, y, u, v, z = 1000.0;
+    hippo::UndistortPoint(depth_lens, du, dv, &x, &y);
+    double px = m[0][0] * x * z + m[1][0] * y * z + m[2][0] * z + m[3][0];
+    double py = m[0][1] * x * z + m[1][1] * y * z + m[2][1] * z + m[3][1];
+    double pz = m[0][2] * x * z + m[1][2] * y * z + m[2][2] * z + m[3][2];
+    hippo::DistortPoint(color_lens, px / pz, py / pz, &u, &v);
+    if (0 == edge && v > top) {
+      top = v;
+    } else if (1 == edge && v < bottom) {
+      bottom = v;
+    } else if (2 == edge && u > left) {
+      left = u;
+    } else if (3 == edge && u < right) {
+      right = u;
+    }
+  }
+  size_t covered = 0;
+  for (size_t i = 0; i < registered.size(); i++) {
+    uint32_t x = static_cast<uint32_t>(i % kColorWidth);
+    uint32_t y = static_cast<uint32_t>(i / kColorWidth);
+    covered += registered[i] ? 1 : 0;
+    if (x >= left && x <= right && y >= top && y <= bottom &&
+        0 == registered[i]) {
+      fprintf(stderr, "registration: hole at %d, %d\n", x, y);
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kIterations; i++) {
+    registration.DepthToColor(depth_buf, registered_buf);
+  }
+  int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "registration %dx%d depth to %dx%d: %.1f%% covered, "
+          "%lld us/frame\n", kDepthWidth, kDepthHeight, kColorWidth,
+          kColorHeight, 100.0 * covered / registered.size(),
+          us / kIterations);
+  return err;
+}
+
+const hippo::PixelFormat kUndistortFormats[] = {
+  hippo::PixelFormat::PIXEL_GRAY8, hippo::PixelFormat::PIXEL_GRAY16,
+  hippo::PixelFormat::PIXEL_RGB888, hippo::PixelFormat::PIXEL_BGRA8888,
+  hippo::PixelFormat::PIXEL_DEPTH_MM16,
+};
+
+// without distortion the table is the identity, every SIMD level must
+// sample the same pixels as the scalar kernel, and a table loaded from the
+// cache must be the one that was built
+static uint64_t TestUndistort() {
+  const uint32_t kWidth = 1280, kHeight = 720;
+  const uint32_t kIterations = 20;
+  const char kSerial[] = "TEST0001";
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  hippo::Camera3DMapping mapping;
+  hippo::LensModel model, pinhole;
+  size_t size = kWidth * kHeight * 4;
+  std::vector<uint8_t> src(size), expected(size), dst(size);
+
+  FakeMapping(&mapping);
+  hippo::LensModelFromCameraParameters(mapping.to, kWidth, kHeight, &model);
+  pinhole = model;
+  memset(pinhole.k, 0, sizeof(pinhole.k));
+  memset(pinhole.p, 0, sizeof(pinhole.p));
+  for (size_t i = 0; i < size; i++) {
+    src[i] = static_cast<uint8_t>(rand());
+  }
+  for (const hippo::PixelFormat format : kUndistortFormats) {
+    size_t bytes = hippo::PixelConverter::RowBytes(format, kWidth) * kHeight;
+    hippo::PixelBuffer src_buf = { src.data(), kWidth, kHeight, 0, format };
+    hippo::PixelBuffer dst_buf = { dst.data(), kWidth, kHeight, 0, format };
+    hippo::PixelBuffer expected_buf = { expected.data(), kWidth, kHeight, 0,
+                                        format };
+    hippo::Undistorter identity;
+    if ((err = identity.SetModel(pinhole, kWidth, kHeight)) ||
+        (err = identity.Undistort(src_buf, dst_buf))) {
+      print_error(err);
+      return err;
+    }
+    if (memcmp(src.data(), dst.data(), bytes)) {
+      fprintf(stderr, "undistort %d: the pinhole model moves pixels\n",
+              static_cast<int>(format));
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+      hippo::Undistorter undistorter(2, static_cast<hippo::SimdLevel>(level));
+      if ((err = undistorter.SetModel(model, kWidth, kHeight)) ||
+          (err = undistorter.Undistort(src_buf,
+                                       level ? dst_buf : expected_buf))) {
+        print_error(err);
+        return err;
+      }
+      if (level && memcmp(expected.data(), dst.data(), bytes)) {
+        fprintf(stderr, "undistort %d (%s): wrong output\n",
+                static_cast<int>(format), kSimdNames[level]);
+        return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+      }
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < kIterations; i++) {
+        undistorter.Undistort(src_buf, dst_buf);
+      }
+      int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count();
+      fprintf(stderr, "undistort %d %dx%d (%s): %lld us/frame\n",
+              static_cast<int>(format), kWidth, kHeight, kSimdNames[level],
+              us / kIterations);
+    }
+  }
+
+  // the cache: the first table is built and saved, the second one loaded
+  const char *dir = getenv("TEMP");
+  char path[1024];
+  if (NULL == dir) {
+    dir = ".";
+  }
+  snprintf(path, sizeof(path), "%s/undistort_%s_%ux%u.lut", dir, kSerial,
+           kWidth, kHeight);
+  remove(path);
+  hippo::PixelBuffer src_buf = { src.data(), kWidth, kHeight, 0,
+                                 hippo::PixelFormat::PIXEL_BGRA8888 };
+  hippo::PixelBuffer dst_buf = { dst.data(), kWidth, kHeight, 0,
+                                 hippo::PixelFormat::PIXEL_BGRA8888 };
+  hippo::PixelBuffer expected_buf = { expected.data(), kWidth, kHeight, 0,
+                                      hippo::PixelFormat::PIXEL_BGRA8888 };
+  hippo::Undistorter built, loaded;
+  if ((err = built.SetModel(model, kWidth, kHeight, dir, kSerial)) ||
+      (err = loaded.SetModel(model, kWidth, kHeight, dir, kSerial)) ||
+      (err = built.Undistort(src_buf, expected_buf)) ||
+      (err = loaded.Undistort(src_buf, dst_buf))) {
+    print_error(err);
+    remove(path);
+    return err;
+  }
+  if (built.LoadedFromCache() || !loaded.LoadedFromCache() ||
+      expected != dst) {
+    fprintf(stderr, "undistort: the cached table doesn't match\n");
+    remove(path);
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+
+  // a source pixel out of the frame in the file (the last position, before
+  // the fractions) is a cache miss, and the table is built again
+  FILE *file = fopen(path, "r+b");
+  const uint32_t kBadPos = (kHeight << 16) | kWidth;
+  if (NULL == file ||
+      fseek(file, -static_cast<long>(kWidth * kHeight * sizeof(uint16_t) +
+                                     sizeof(uint32_t)), SEEK_END) ||
+      1 != fwrite(&kBadPos, sizeof(kBadPos), 1, file)) {
+    fprintf(stderr, "undistort: can't write to %s\n", path);
+    if (file) {
+      fclose(file);
+    }
+    remove(path);
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  fclose(file);
+  hippo::Undistorter rebuilt;
+  if ((err = rebuilt.SetModel(model, kWidth, kHeight, dir, kSerial)) ||
+      (err = rebuilt.Undistort(src_buf, dst_buf))) {
+    print_error(err);
+    remove(path);
+    return err;
+  }
+  remove(path);
+  if (rebuilt.LoadedFromCache() || expected != dst) {
+    fprintf(stderr, "undistort: loaded a corrupted table\n");
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+// a rectangle is a plain crop, the corners of a quadrilateral land on the
+// corners of the output, and every SIMD level must sample the same pixels as
+// the scalar kernel
+static uint64_t TestKeystone() {
+  const uint32_t kSrcWidth = 2176, kSrcHeight = 1632;
+  const uint32_t kDstWidth = 1920, kDstHeight = 1080;
+  const uint32_t kIterations = 20;
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  std::vector<uint32_t> src(kSrcWidth * kSrcHeight);
+  std::vector<uint32_t> expected(kDstWidth * kDstHeight);
+  std::vector<uint32_t> dst(kDstWidth * kDstHeight);
+
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint32_t>(rand()) * 65599u + static_cast<uint32_t>(i);
+  }
+  hippo::PixelBuffer src_buf = {
+    reinterpret_cast<uint8_t*>(src.data()), kSrcWidth, kSrcHeight, 0,
+    hippo::PixelFormat::PIXEL_BGRA8888 };
+  hippo::PixelBuffer dst_buf = {
+    reinterpret_cast<uint8_t*>(dst.data()), kDstWidth, kDstHeight, 0,
+    hippo::PixelFormat::PIXEL_BGRA8888 };
+  hippo::PixelBuffer expected_buf = {
+    reinterpret_cast<uint8_t*>(expected.data()), kDstWidth, kDstHeight, 0,
+    hippo::PixelFormat::PIXEL_BGRA8888 };
+
+  hippo::KeystoneWarp crop;
+  hippo::CameraQuadrilateral rect = {
+    { 100, 50 }, { 100 + kDstWidth - 1, 50 },
+    { 100, 50 + kDstHeight - 1 }, { 100 + kDstWidth - 1, 50 + kDstHeight - 1 },
+  };
+  if ((err = crop.SetQuadrilateral(rect, kSrcWidth, kSrcHeight, kDstWidth,
+                                   kDstHeight)) ||
+      (err = crop.Warp(src_buf, dst_buf))) {
+    print_error(err);
+    return err;
+  }
+  for (uint32_t v = 0; v < kDstHeight; v++) {
+    if (memcmp(&dst[v * kDstWidth], &src[(v + 50) * kSrcWidth + 100],
+               kDstWidth * 4)) {
+      fprintf(stderr, "keystone: the rectangle isn't a crop\n");
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+
+  hippo::KeystoneWarp trapezoid;
+  hippo::CameraQuadrilateral quad = {
+    { 200, 100 }, { 1900, 150 }, { 150, 1400 }, { 2000, 1500 },
+  };
+  if ((err = trapezoid.SetQuadrilateral(quad, kSrcWidth, kSrcHeight,
+                                        kDstWidth, kDstHeight)) ||
+      (err = trapezoid.Warp(src_buf, dst_buf))) {
+    print_error(err);
+    return err;
+  }
+  if (dst[0] != src[100 * kSrcWidth + 200] ||
+      dst[kDstWidth - 1] != src[150 * kSrcWidth + 1900] ||
+      dst[(kDstHeight - 1) * kDstWidth] != src[1400 * kSrcWidth + 150] ||
+      dst.back() != src[1500 * kSrcWidth + 2000]) {
+    fprintf(stderr, "keystone: the corners don't match\n");
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+
+  // a fit to mat keystone of the 2176 x 1632 mode
+  hippo::CameraKeystoneTableEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.resolution.width = kSrcWidth;
+  entry.resolution.height = kSrcHeight;
+  entry.enabled = true;
+  entry.value.top_left = { 180, 120 };
+  entry.value.top_right = { -220, 90 };
+  entry.value.bottom_left = { 90, -60 };
+  entry.value.bottom_right = { -40, -100 };
+  for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+    hippo::KeystoneWarp warp(2, static_cast<hippo::SimdLevel>(level));
+    if ((err = warp.SetKeystone(entry, 4352, 3264, kDstWidth, kDstHeight)) ||
+        (err = warp.Warp(src_buf, level ? dst_buf : expected_buf))) {
+      print_error(err);
+      return err;
+    }
+    if (level && dst != expected) {
+      fprintf(stderr, "keystone (%s): wrong output\n", kSimdNames[level]);
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; i++) {
+      warp.Warp(src_buf, dst_buf);
+    }
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "keystone %dx%d to %dx%d (%s): %lld us/frame\n",
+            kSrcWidth, kSrcHeight, kDstWidth, kDstHeight, kSimdNames[level],
+            us / kIterations);
+  }
+  return err;
+}
+
+const hippo::PixelFormat kPyramidFormats[] = {
+  hippo::PixelFormat::PIXEL_GRAY8, hippo::PixelFormat::PIXEL_GRAY16,
+  hippo::PixelFormat::PIXEL_RGB888, hippo::PixelFormat::PIXEL_BGRA8888,
+  hippo::PixelFormat::PIXEL_YUY2, hippo::PixelFormat::PIXEL_UYVY,
+};
+
+// every SIMD level must build the same levels as the scalar kernels, the
+// levels of a gray image are the 2x2 boxes of the previous ones, and a
+// MODE_4416x3312 frame goes down to the 552 x 414 of the last level
+static uint64_t TestPyramid() {
+  const uint32_t kWidth = 1110, kHeight = 835;
+  const uint32_t kFrameWidth = 4416, kFrameHeight = 3312;
+  const uint32_t kIterations = 10;
+  uint64_t err = 0LL;
+  hippo::SimdLevel best = hippo::PixelConverter::DetectSimdLevel();
+  std::vector<uint8_t> src(kWidth * kHeight * 4);
+
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint8_t>(rand());
+  }
+  for (const hippo::PixelFormat format : kPyramidFormats) {
+    hippo::PixelBuffer src_buf = { src.data(), kWidth, kHeight, 0, format };
+    hippo::FramePyramid expected(1, hippo::SimdLevel::scalar);
+    if (err = expected.Build(src_buf, hippo::FramePyramid::kMaxLevels)) {
+      print_error(err);
+      return err;
+    }
+    for (uint32_t level = 1; level <= static_cast<uint32_t>(best); level++) {
+      hippo::FramePyramid pyramid(2, static_cast<hippo::SimdLevel>(level));
+      if (err = pyramid.Build(src_buf, hippo::FramePyramid::kMaxLevels)) {
+        print_error(err);
+        return err;
+      }
+      for (uint32_t i = 1; i <= hippo::FramePyramid::kMaxLevels; i++) {
+        hippo::PixelBuffer a, b;
+        expected.GetLevel(i, &a);
+        pyramid.GetLevel(i, &b);
+        if (a.width != b.width || a.height != b.height ||
+            memcmp(a.data, b.data, a.stride * a.height)) {
+          fprintf(stderr, "pyramid %d level %d (%s): wrong output\n",
+                  static_cast<int>(format), i, kSimdNames[level]);
+          return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+        }
+      }
+    }
+    if (hippo::PixelFormat::PIXEL_GRAY8 != format) {
+      continue;
+    }
+    for (uint32_t i = 1; i <= hippo::FramePyramid::kMaxLevels; i++) {
+      hippo::PixelBuffer from, to;
+      expected.GetLevel(i - 1, &from);
+      expected.GetLevel(i, &to);
+      for (uint32_t y = 0; y < to.height; y++) {
+        for (uint32_t x = 0; x < to.width; x++) {
+          const uint8_t *p = from.data + 2 * y * from.stride + 2 * x;
+          int box = (p[0] + p[1] + p[from.stride] + p[from.stride + 1] +
+                     2) >> 2;
+          if (to.data[y * to.stride + x] != box) {
+            fprintf(stderr, "pyramid level %d: wrong box at %d, %d\n", i, x,
+                    y);
+            return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+          }
+        }
+      }
+    }
+  }
+
+  // a frame of one YUY2 stream, as grabbed from the hirescamera
+  size_t frame_bytes = sizeof(hippo::FrameHeader) +
+      sizeof(hippo::StreamHeader) + kFrameWidth * kFrameHeight * 2;
+  std::vector<uint8_t> raw(frame_bytes);
+  hippo::CameraFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.raw_data_ = raw.data();
+  frame.raw_length_ = frame_bytes;
+  frame.header = reinterpret_cast<hippo::FrameHeader*>(raw.data());
+  frame.header->stream.value = 0x01;
+  frame.streams[0].header = reinterpret_cast<hippo::StreamHeader*>(
+      raw.data() + sizeof(hippo::FrameHeader));
+  frame.streams[0].data = raw.data() + sizeof(hippo::FrameHeader) +
+      sizeof(hippo::StreamHeader);
+  frame.streams[0].header->width = kFrameWidth;
+  frame.streams[0].header->height = kFrameHeight;
+  frame.streams[0].header->format = hippo::PixelFormat::PIXEL_YUY2;
+  // a stream that isn't in the frame, even with pointers left over
+  frame.streams[1] = frame.streams[0];
+  {
+    hippo::FramePyramid pyramid;
+    if (!pyramid.Build(frame, 1, 1)) {
+      fprintf(stderr, "pyramid: built a stream that isn't in the frame\n");
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+  for (uint32_t level = 0; level <= static_cast<uint32_t>(best); level++) {
+    hippo::FramePyramid pyramid(0, static_cast<hippo::SimdLevel>(level));
+    hippo::PixelBuffer last;
+    if ((err = pyramid.Build(frame, 0, hippo::FramePyramid::kMaxLevels)) ||
+        (err = pyramid.GetLevel(hippo::FramePyramid::kMaxLevels, &last))) {
+      print_error(err);
+      return err;
+    }
+    if (last.width != kFrameWidth / 8 || last.height != kFrameHeight / 8) {
+      fprintf(stderr, "pyramid: the last level is %dx%d\n", last.width,
+              last.height);
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; i++) {
+      pyramid.Build(frame, 0, hippo::FramePyramid::kMaxLevels);
+    }
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "pyramid %dx%d yuy2, 3 levels (%s): %lld us/frame\n",
+            kFrameWidth, kFrameHeight, kSimdNames[level], us / kIterations);
+  }
+  return err;
+}
+
+uint64_t TestImaging() {
+  uint64_t err = 0LL;
+
+  fprintf(stderr, "#################################\n");
+  fprintf(stderr, "  Now Testing Image Processing\n");
+  fprintf(stderr, "#################################\n");
+
+  if (err = TestConversions()) {
+    return err;
+  }
+  if (err = TestPointCloud()) {
+    return err;
+  }
+  if (err = TestRegistration()) {
+    return err;
+  }
+  if (err = TestRegistrationCoverage()) {
+    return err;
+  }
+  if (err = TestUndistort()) {
+    return err;
+  }
+  if (err = TestKeystone()) {
+    return err;
+  }
+  if (err = TestPyramid()) {
+    return err;
+  }
+  return BenchConversions();
+}
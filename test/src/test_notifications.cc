@@ -0,0 +1,665 @@
+
+// Copyright 2019 HP Development Company, L.P.
+// SPDX-License-Identifier: MIT
+
+#if defined(_WIN32) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>   // NOLINT
+#include <condition_variable>   // NOLINT
+#include <mutex>     // NOLINT
+#include <thread>   // NOLINT
+#include <vector>
+
+#include "include/hippo_device.h"
+#include "include/json.hpp"
+#include "include/hirescamera.h"
+#include "include/notification_recorder.h"
+#include "include/system.h"
+#include "../include/test_device.h"
+
+namespace nl = nlohmann;
+
+extern void print_error(uint64_t err);
+
+//
+// benchmark of the notification delivery: the bench below plays the part of
+// the signal thread by calling SendSignal() of its test device in a tight
+// loop, and measures how long each notification takes to reach the device
+//
+// the depth of a device's notification queue: the reactor thread drops the
+// notifications of a full queue, so the benchmark keeps fewer in flight (one
+// less, as the slot of a notification is only released once its callback has
+// returned)
+const uint32_t kMaxSignalsInFlight = 255;
+
+class SignalBench {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  SignalBench(uint32_t index, uint32_t num_signals) :
+      num_signals_(num_signals), sent_(num_signals), received_(0),
+      next_(0), out_of_order_(0), max_latency_us_(0), total_latency_us_(0),
+      device_("signalbench", 20641, index,
+              [this](const char *method, void *params) { Received(method); }) {
+  }
+
+  // sends |num_signals_| notifications, returns the number of microseconds
+  // until the last one was delivered
+  int64_t Run() {
+    Clock::time_point start = Clock::now();
+    char method[32];
+    for (uint32_t i = 0; i < num_signals_; i++) {
+      snprintf(method, sizeof(method), "on_bench_%u", i);
+      while (i - received_ >= kMaxSignalsInFlight) {
+        std::this_thread::yield();
+      }
+      sent_[i] = Clock::now();
+      device_.SendSignal(method, NULL);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait_for(lock, std::chrono::seconds(10), [this] {
+      return received_ == num_signals_;
+    });
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start).count();
+  }
+
+  uint32_t received() { return received_; }
+  uint32_t out_of_order() { return out_of_order_; }
+  int64_t max_latency_us() { return max_latency_us_; }
+  int64_t avg_latency_us() {
+    return received_ ? total_latency_us_ / received_ : 0;
+  }
+  TestDevice<> *device() { return &device_; }
+
+ private:
+  void Received(const char *method) {
+    Clock::time_point now = Clock::now();
+    uint32_t i = strtoul(method + sizeof("on_bench_") - 1, NULL, 10);
+    if (i < next_) {
+      out_of_order_++;
+    }
+    next_ = i + 1;
+    int64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - sent_[i]).count();
+    total_latency_us_ += latency;
+    if (latency > max_latency_us_) {
+      max_latency_us_ = latency;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++received_ == num_signals_) {
+      condition_.notify_one();
+    }
+  }
+
+  uint32_t num_signals_;
+  std::vector<Clock::time_point> sent_;
+  std::atomic<uint32_t> received_;
+  uint32_t next_;
+  uint32_t out_of_order_;
+  int64_t max_latency_us_;
+  int64_t total_latency_us_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // the last member, so that it is gone (with the notifications still being
+  // delivered) before the counters
+  TestDevice<> device_;
+};
+
+//
+// a device with a slow callback receiving a burst of on_value notifications:
+// with the keep_latest policy it must end up with the last value
+//
+uint64_t TestConflation() {
+  const int kNumValues = 2000;
+  uint64_t err = 0LL;
+  std::atomic<int> last_value(-1);
+  TestDevice<> device("conflationbench", 20641, 0,
+                      [&last_value](const char *method, void *params) {
+    last_value = reinterpret_cast<nl::json*>(params)->at(0).get<int>();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+
+  if (err = device.notification_policy(
+          "on_value", hippo::NotificationPolicy::keep_latest)) {
+    return err;
+  }
+  for (int i = 0; i < kNumValues; i++) {
+    device.SendSignal("on_value", new nl::json({ i }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  hippo::NotificationStats stats;
+  if (err = device.notification_stats(&stats)) {
+    return err;
+  }
+  fprintf(stderr, "keep_latest: last value %d, delivered %lld, "
+          "conflated %lld, dropped %lld\n", last_value.load(),
+          stats.delivered, stats.conflated, stats.dropped);
+  if (last_value != kNumValues - 1 ||
+      stats.delivered + stats.conflated != kNumValues) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+//
+// a rate limited notification type doesn't hold back the others: a stream
+// of on_rotate notifications limited to 10 Hz, each one followed by an
+// on_tilt one (keep_all), every 100 us for half a second. The pending
+// on_rotate waits out of the queue, so all the on_tilt ones are delivered
+// without the queue filling up.
+//
+uint64_t TestRateLimit() {
+  typedef std::chrono::steady_clock Clock;
+  const uint32_t kNumPairs = 5000;
+  const std::chrono::microseconds kInterval(100);
+  uint64_t err = 0LL;
+  std::atomic<uint32_t> tilts(0);
+  std::atomic<uint32_t> rotations(0);
+  TestDevice<> device("ratebench", 20641, 0,
+                      [&tilts, &rotations](const char *method,
+                                           void *params) {
+    if (!strcmp("on_tilt", method)) {
+      tilts++;
+    } else {
+      rotations++;
+    }
+  });
+
+  if (err = device.notification_policy(
+          "on_rotate", hippo::NotificationPolicy::rate_limit, 10.0f)) {
+    return err;
+  }
+  Clock::time_point next = Clock::now();
+  for (uint32_t i = 0; i < kNumPairs; i++) {
+    while (Clock::now() < next) {
+      std::this_thread::yield();
+    }
+    next += kInterval;
+    device.SendSignal("on_rotate", new nl::json({ i }));
+    device.SendSignal("on_tilt", new nl::json({ i }));
+  }
+  // the last on_rotate is due 100 ms after the previous one at most
+  for (int i = 0; i < 50 && tilts < kNumPairs; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  hippo::NotificationStats stats;
+  if (err = device.notification_stats(&stats)) {
+    return err;
+  }
+  fprintf(stderr, "rate_limit: %u/%u on_tilt, %u on_rotate delivered, "
+          "conflated %lld, dropped %lld\n", tilts.load(), kNumPairs,
+          rotations.load(), stats.conflated, stats.dropped);
+  if (tilts != kNumPairs || 0 != stats.dropped || rotations < 2 ||
+      stats.delivered + stats.conflated != 2 * kNumPairs) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+//
+// writes a recording in the NotificationRecorder format: the header, then
+// each frame after |interval_us| microseconds
+//
+static void WriteVarint(uint64_t value, FILE *file) {
+  do {
+    fputc(static_cast<int>((value & 0x7f) | (value > 0x7f ? 0x80 : 0)), file);
+    value >>= 7;
+  } while (value);
+}
+
+static FILE *CreateRecording(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (NULL != file) {
+    const unsigned char header[] = { 'H', 'P', 'N', 'R', 1, 0, 0, 0 };
+    fwrite(header, 1, sizeof(header), file);
+  }
+  return file;
+}
+
+static void WriteFrame(uint64_t interval_us, const char *frame, int len,
+                       FILE *file) {
+  WriteVarint(interval_us, file);
+  WriteVarint(len + 1, file);
+  fwrite(frame, 1, len + 1, file);
+}
+
+//
+// button-press-to-callback latency under background load: a recording of
+// the bulk devices' notifications every 200us and of a press every 10ms is
+// replayed through the reactor, the bulk devices keep the worker pool busy
+// with slow callbacks, first with the input device as a normal device then
+// through the fast lane
+//
+class LaneBench {
+ public:
+  LaneBench(const char *name, uint32_t index, uint32_t callback_ms) :
+      callback_ms_(callback_ms), received_(0), max_latency_us_(0),
+      total_latency_us_(0),
+      device_(name, 20650, index,
+              [this](const char *method, void *params) { Received(); }) {
+  }
+
+  uint32_t received() { return received_; }
+  int64_t max_latency_us() { return max_latency_us_; }
+  int64_t avg_latency_us() {
+    return received_ ? total_latency_us_ / received_ : 0;
+  }
+  TestDevice<> *device() { return &device_; }
+
+ private:
+  void Received() {
+    // from the reactor receiving the frame to the callback
+    hippo::NotificationTimestamps timestamps;
+    if (!device_.notification_timestamps(&timestamps)) {
+      int64_t latency = timestamps.dispatched_us - timestamps.received_us;
+      total_latency_us_ += latency;
+      if (latency > max_latency_us_) {
+        max_latency_us_ = latency;
+      }
+    }
+    received_++;
+    if (callback_ms_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(callback_ms_));
+    }
+  }
+
+  uint32_t callback_ms_;
+  std::atomic<uint32_t> received_;
+  std::atomic<int64_t> max_latency_us_;
+  std::atomic<int64_t> total_latency_us_;
+  TestDevice<> device_;
+};
+
+uint64_t TestPriorityLanes() {
+  const char kPath[] = "replay_lanes.hpnr";
+  const uint32_t kNumBulkDevices = 6;
+  const uint32_t kNumPresses = 100;
+  const uint32_t kBulkIntervalUs = 200;
+  const uint32_t kPressIntervalUs = 10000;
+  uint64_t err = 0LL;
+  int64_t avg_latency_us[2] = { 0 };
+
+  FILE *file = CreateRecording(kPath);
+  if (NULL == file) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_OPEN);
+  }
+  uint32_t num_frames = kNumPresses * kPressIntervalUs / kBulkIntervalUs;
+  for (uint32_t i = 0; i < num_frames; i++) {
+    char frame[128];
+    int len = snprintf(frame, sizeof(frame),
+                       "{\"jsonrpc\":\"2.0\",\"method\":\"bulkbench@%u."
+                       "on_value\",\"params\":[%u]}", i % kNumBulkDevices, i);
+    WriteFrame(i ? kBulkIntervalUs : 0, frame, len, file);
+    if (0 == (i * kBulkIntervalUs) % kPressIntervalUs) {
+      len = snprintf(frame, sizeof(frame),
+                     "{\"jsonrpc\":\"2.0\",\"method\":\"lanebench."
+                     "on_button_press\",\"params\":[%u]}", i);
+      WriteFrame(0, frame, len, file);
+    }
+  }
+  fclose(file);
+
+  for (int lane = 0; lane < 2 && !err; lane++) {
+    hippo::NotificationReplayer replayer;
+    hippo::ReplayStats stats;
+    std::vector<LaneBench*> bulk;
+    LaneBench input("lanebench", 0, 0);
+
+    hippo::NotificationPriority priority = lane ?
+        hippo::NotificationPriority::high : hippo::NotificationPriority::normal;
+    if (err = input.device()->notification_priority(priority)) {
+      break;
+    }
+    for (uint32_t i = 0; i < kNumBulkDevices; i++) {
+      bulk.push_back(new LaneBench("bulkbench", i, 2));
+    }
+    if (!(err = replayer.Open(kPath, "localhost", 20650)) &&
+        !(err = input.device()->subscribe_raw(NULL, NULL))) {
+      for (uint32_t i = 0; i < kNumBulkDevices && !err; i++) {
+        err = bulk[i]->device()->subscribe_raw(NULL, NULL);
+      }
+      if (!err) {
+        err = replayer.Run(hippo::ReplaySpeed::original, &stats);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    }
+    input.device()->unsubscribe();
+    for (auto dev : bulk) {
+      dev->device()->unsubscribe();
+      delete dev;
+    }
+    replayer.Close();
+    fprintf(stderr, "%s lane: %d/%d presses, latency avg %lld us "
+            "max %lld us\n", lane ? "fast" : "normal", input.received(),
+            kNumPresses, input.avg_latency_us(), input.max_latency_us());
+    avg_latency_us[lane] = input.avg_latency_us();
+  }
+  remove(kPath);
+  if (!err && avg_latency_us[1] > avg_latency_us[0]) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return err;
+}
+
+//
+// replay of a synthetic hot-plug storm: the recording is written here in the
+// NotificationRecorder format and played back to a device subscribed to a
+// SoHal that is not there. At max speed the frames can come faster than the
+// callbacks, the notifications of the full queue are then dropped.
+//
+static const char *kReplayNotifications[] = {
+  "on_device_connected", "on_device_disconnected",
+};
+
+uint64_t TestReplay() {
+  const char kPath[] = "replay_storm.hpnr";
+  const uint32_t kNumFrames = 10000;
+  const uint32_t kFrameIntervalUs = 100;
+  uint64_t err = 0LL;
+  std::atomic<uint32_t> received(0);
+  TestDevice<> device("replaybench", 20649, 0,
+                      [&received](const char *method, void *params) {
+    received++;
+  });
+  hippo::NotificationReplayer replayer;
+  hippo::ReplayStats stats;
+  hippo::NotificationStats device_stats;
+
+  FILE *file = CreateRecording(kPath);
+  if (NULL == file) {
+    return MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_OPEN);
+  }
+  for (uint32_t i = 0; i < kNumFrames; i++) {
+    char frame[128];
+    int len = snprintf(frame, sizeof(frame),
+                       "{\"jsonrpc\":\"2.0\",\"method\":\"replaybench.%s\","
+                       "\"params\":[{\"index\":0}]}",
+                       (i % 2) ? "on_device_disconnected" :
+                       "on_device_connected");
+    WriteFrame(i ? kFrameIntervalUs : 0, frame, len, file);
+  }
+  fclose(file);
+
+  if (err = replayer.Open(kPath, "localhost", 20649)) {
+    return err;
+  }
+  if (err = device.subscribe_raw(NULL, NULL)) {
+    return err;
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    hippo::ReplaySpeed speed = pass ?
+        hippo::ReplaySpeed::original : hippo::ReplaySpeed::max;
+    uint64_t expected = (pass + 1) * kNumFrames;
+    if (err = replayer.Run(speed, &stats)) {
+      break;
+    }
+    for (int i = 0; i < 100; i++) {
+      if (err = device.notification_stats(&device_stats)) {
+        break;
+      }
+      if (device_stats.delivered + device_stats.dropped >= expected) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    fprintf(stderr, "replay (%s): %lld frames recorded over %lld us, "
+            "routed in %lld us (%.0f/s), %lld delivered, %lld dropped\n",
+            pass ? "original speed" : "max speed", stats.frames,
+            stats.recorded_us, stats.elapsed_us,
+            stats.elapsed_us ? 1e6 * stats.frames / stats.elapsed_us : 0.0,
+            device_stats.delivered, device_stats.dropped);
+    if (err || device_stats.delivered + device_stats.dropped != expected ||
+        received != device_stats.delivered ||
+        (pass && stats.elapsed_us < stats.recorded_us)) {
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+      break;
+    }
+  }
+  // another object of the device shares its subscription, with its own
+  // mask: each one gets the notifications it selects
+  std::atomic<uint32_t> connected_received(0);
+  TestDevice<> connected("replaybench", 20649, 0,
+                         [&connected_received](const char *method,
+                                               void *params) {
+    connected_received++;
+  });
+  uint32_t subscriptions = 0;
+  if (!err && !(err = connected.subscribe_raw(NULL, 1ULL << 0,
+                                              kReplayNotifications, 2,
+                                              &subscriptions))) {
+    uint32_t before = received;
+    if (!(err = replayer.Run(hippo::ReplaySpeed::original, &stats))) {
+      for (int i = 0; i < 100 && received < before + kNumFrames; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    fprintf(stderr, "replay (shared subscription): %d and %d delivered\n",
+            received - before, connected_received.load());
+    if (2 != subscriptions || connected_received != kNumFrames / 2 ||
+        received != before + kNumFrames) {
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    // the last object to unsubscribe ends the subscription
+    if (!err && !(err = device.unsubscribe(&subscriptions)) &&
+        1 != subscriptions) {
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    connected.unsubscribe();
+  }
+  device.unsubscribe();
+  replayer.Close();
+  remove(kPath);
+  return err;
+}
+
+//
+// allocations made while decoding a notification and calling the callback:
+// the test devices hand pre-parsed params straight to ProcessSignal().
+// hippo is a DLL, so replacing operator new here would only see the
+// allocations of the test: they are counted with the debug CRT's allocation
+// hook, which the DLL shares in the debug builds. All the builds check that
+// the arena the notifications are decoded in doesn't grow.
+//
+#if defined(_WIN32) && defined(_DEBUG)
+static std::atomic<uint32_t> gNumAllocs(0);
+static std::atomic<bool> gCountAllocs(false);
+
+static int CountAllocs(int type, void *data, size_t size, int block_type,
+                       long request, const unsigned char *file,  // NOLINT
+                       int line) {
+  if (gCountAllocs && (_HOOK_ALLOC == type || _HOOK_REALLOC == type)) {
+    gNumAllocs++;
+  }
+  return TRUE;
+}
+#endif
+
+template <typename P>
+static void decode_notification(const P &param, void *data) {
+  (*reinterpret_cast<uint32_t*>(data))++;
+}
+
+// delivers each of |events| |num_warm_up| times (the arena grows to the size
+// of the notification) then |num_events| times counting the allocations
+template <typename D, typename E>
+static uint64_t CountDecodeAllocations(TestDevice<D> *device, const E *events,
+                                       uint32_t num, uint32_t num_warm_up,
+                                       uint32_t num_events) {
+  uint64_t err = 0LL;
+  for (uint32_t e = 0; e < num; e++) {
+    for (uint32_t i = 0; i < num_warm_up; i++) {
+      device->Deliver(events[e].method, events[e].params);
+    }
+    size_t capacity = device->NotificationArena()->Capacity();
+#if defined(_WIN32) && defined(_DEBUG)
+    gNumAllocs = 0;
+    _CRT_ALLOC_HOOK previous = _CrtSetAllocHook(&CountAllocs);
+    gCountAllocs = true;
+#endif
+    for (uint32_t i = 0; i < num_events; i++) {
+      device->Deliver(events[e].method, events[e].params);
+    }
+#if defined(_WIN32) && defined(_DEBUG)
+    gCountAllocs = false;
+    _CrtSetAllocHook(previous);
+    fprintf(stderr, "decode %s: %.2f allocations per notification\n",
+            events[e].method, static_cast<double>(gNumAllocs) / num_events);
+    if (gNumAllocs) {
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+#else
+    fprintf(stderr, "decode %s: allocations not counted (debug builds "
+            "only)\n", events[e].method);
+#endif
+    if (capacity != device->NotificationArena()->Capacity()) {
+      fprintf(stderr, "decode %s: the arena grew from %u to %u bytes\n",
+              events[e].method, static_cast<uint32_t>(capacity),
+              static_cast<uint32_t>(device->NotificationArena()->Capacity()));
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+  }
+  return err;
+}
+
+uint64_t TestDecodeAllocations() {
+  const uint32_t kNumWarmUp = 16;
+  const uint32_t kNumEvents = 1000;
+  uint64_t err = 0LL;
+  uint32_t delivered = 0;
+  TestDevice<hippo::System> system;
+  TestDevice<hippo::HiResCamera> camera;
+
+  system.set_device_callback(
+      &decode_notification<hippo::SystemNotificationParam>, &delivered);
+  camera.set_device_callback(
+      &decode_notification<hippo::HiResCameraNotificationParam>, &delivered);
+
+  // the strings are longer than what std::string keeps inline
+  nl::json connected = nl::json::array({ {
+      { "name", "hirescamera" }, { "index", 0 },
+      { "vendor_id", 1008 }, { "product_id", 25109 } } });
+  nl::json displays = nl::json::array({ nl::json::array() });
+  for (int i = 0; i < 3; i++) {
+    char hardware_id[128];
+    snprintf(hardware_id, sizeof(hardware_id),
+             "\\\\?\\DISPLAY#HWP4635#5&1c2c5ae0&0&UID%d#"
+             "{e6f07b5f-ee97-4a90-b076-33f57bf4eaa7}", 4352 + i);
+    displays[0].push_back({
+      { "hardware_id", hardware_id },
+      { "primary_display", 0 == i },
+      { "coordinates", { { "x", 1920 * i }, { "y", 0 },
+                         { "width", 1920 }, { "height", 1080 } } } });
+  }
+  nl::json entries = nl::json::array({ {
+      { "type", "flash_fit_to_mat" }, { "entries", nl::json::array() } } });
+  for (int i = 0; i < 8; i++) {
+    nl::json corner = { { "x", i }, { "y", -i } };
+    entries[0]["entries"].push_back({
+      { "enabled", true },
+      { "value", { { "top_left", corner }, { "top_right", corner },
+                   { "bottom_left", corner }, { "bottom_right", corner } } },
+      { "resolution", { { "width", 4352 >> (i % 4) },
+                        { "height", 3264 >> (i % 4) },
+                        { "fps", 15 } } } });
+  }
+  struct Event {
+    const char *method;
+    nl::json *params;
+  };
+  const Event system_events[] = {
+    { "on_device_connected", &connected },
+    { "on_display_change", &displays },
+  };
+  const Event camera_events[] = {
+    { "on_keystone_table_entries", &entries },
+  };
+  uint64_t system_err = CountDecodeAllocations(
+      &system, system_events, 2, kNumWarmUp, kNumEvents);
+  uint64_t camera_err = CountDecodeAllocations(
+      &camera, camera_events, 1, kNumWarmUp, kNumEvents);
+  if (delivered != 3 * (kNumWarmUp + kNumEvents)) {
+    err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+  }
+  return system_err ? system_err : (camera_err ? camera_err : err);
+}
+
+uint64_t TestNotifications() {
+  const uint32_t kNumDevices = 8;
+  const uint32_t kNumSignals = 20000;
+  uint64_t err = 0LL;
+  std::vector<SignalBench*> devices;
+  std::vector<std::thread> threads;
+  int64_t elapsed_us[kNumDevices] = { 0 };
+
+  fprintf(stderr, "#################################\n");
+  fprintf(stderr, "  Now Testing Notifications\n");
+  fprintf(stderr, "#################################\n");
+
+  ADD_FILE_TO_MAP();   // will add this file to the file/error map
+
+  for (uint32_t i = 0; i < kNumDevices; i++) {
+    devices.push_back(new SignalBench(i, kNumSignals));
+  }
+  for (uint32_t i = 0; i < kNumDevices; i++) {
+    threads.push_back(std::thread([&devices, &elapsed_us, i] {
+      elapsed_us[i] = devices[i]->Run();
+    }));
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+  for (uint32_t i = 0; i < kNumDevices; i++) {
+    SignalBench *dev = devices[i];
+    fprintf(stderr, "device %d: %d/%d notifications in %lld us "
+            "(%.0f/s), latency avg %lld us max %lld us\n",
+            i, dev->received(), kNumSignals, elapsed_us[i],
+            elapsed_us[i] ? 1e6 * dev->received() / elapsed_us[i] : 0.0,
+            dev->avg_latency_us(), dev->max_latency_us());
+    if (dev->out_of_order()) {
+      fprintf(stderr, "device %d: %d notifications out of order\n",
+              i, dev->out_of_order());
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    if (dev->received() != kNumSignals) {
+      err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+    }
+    // the dispatcher's own measurement must agree with the benchmark's
+    hippo::NotificationLatency latency;
+    if (!dev->device()->notification_latency(&latency)) {
+      fprintf(stderr, "device %d: queue latency histogram (log2 us):", i);
+      for (uint32_t b = 0; b < hippo::LATENCY_HISTOGRAM_BUCKETS; b++) {
+        fprintf(stderr, " %lld", latency.queue.buckets[b]);
+      }
+      fprintf(stderr, "\n");
+      if (latency.total.count != dev->received()) {
+        err = MAKE_HIPPO_ERROR(hippo::HIPPO_DEVICE, hippo::HIPPO_ERROR);
+      }
+    }
+    delete dev;
+  }
+  if (err) {
+    return err;
+  }
+  if (err = TestConflation()) {
+    return err;
+  }
+  if (err = TestRateLimit()) {
+    return err;
+  }
+  if (err = TestPriorityLanes()) {
+    return err;
+  }
+  if (err = TestReplay()) {
+    return err;
+  }
+  return TestDecodeAllocations();
+}
@@ -376,6 +376,26 @@ uint64_t TestProjector(hippo::Projector *projector) {
     // function call
     projector->free_device_info(&info);
   }
+  // state cache: once read, brightness is served locally while subscribed
+  uint32_t brightness = 0;
+  hippo::StateCacheStats cache_stats;
+  if (err = projector->state_cache(hippo::StateCacheMode::cached)) {
+    print_error(err);
+  }
+  for (int i = 0; i < 10; i++) {
+    if (err = projector->brightness(&brightness)) {
+      print_error(err);
+    }
+  }
+  if (err = projector->state_cache_stats(&cache_stats)) {
+    print_error(err);
+  }
+  fprintf(stderr, "projector.brightness(): %d, cache hits %lld, "
+          "misses %lld\n", brightness, cache_stats.hits, cache_stats.misses);
+  if (cache_stats.hits < 9) {
+    fprintf(stderr, "ERROR - brightness should come from the cache!\n");
+  }
+  (void)projector->state_cache(hippo::StateCacheMode::disabled);
   // close
   if (err = projector->close(&open_count)) {
     return err;
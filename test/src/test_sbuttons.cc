@@ -101,6 +101,62 @@ uint64_t TestSButtons(hippo::SButtons *sbuttons) {
   } else {
     fprintf(stderr, "sbuttons.unsubscribe: count: %d\n", num_subscribe);
   }
+
+  // now the same in polling mode, the led_state change below will queue an
+  // on_led_state notification
+  if (err = sbuttons->subscribe(16, &num_subscribe)) {
+    return err;
+  }
+  fprintf(stderr, "sbuttons.subscribe(polling): count: %d\n", num_subscribe);
+  st_set = {hippo::ButtonLedColor::white, hippo::ButtonLedMode::off};
+  if (err = sbuttons->led_state(id, st_set, &st_get)) {
+    return err;
+  }
+  fprintf(stderr, "*******\n*\n* Here you have 5 seconds to test the polled "
+          "sbuttons.on_button_press notifications\n"
+          "* Please tap/hold the sbuttons\n*\n*******\n");
+  hippo::SButtonsNotificationParam params[16];
+  uint32_t num_params = 0;
+  for (int i = 0; i < 50; i++) {
+    if (err = sbuttons->poll(params, 16, &num_params)) {
+      return err;
+    }
+    for (uint32_t j = 0; j < num_params; j++) {
+      sbuttons_notification(params[j], reinterpret_cast<void*>(sbuttons));
+    }
+    Sleep(100);
+  }
+  if (err = sbuttons->unsubscribe(&num_subscribe)) {
+    print_error(err);
+  } else {
+    fprintf(stderr, "sbuttons.unsubscribe: count: %d\n", num_subscribe);
+  }
+
+  // and with a mask: the on_led_state notification of the led_state change
+  // below is discarded before being decoded
+  uint64_t mask =
+      hippo::NotificationMask(hippo::SButtonsNotification::on_button_press);
+  if (err = sbuttons->subscribe(&sbuttons_notification,
+                                reinterpret_cast<void*>(sbuttons), mask,
+                                &num_subscribe)) {
+    return err;
+  }
+  st_set = {hippo::ButtonLedColor::orange, hippo::ButtonLedMode::on};
+  if (err = sbuttons->led_state(id, st_set, &st_get)) {
+    return err;
+  }
+  fprintf(stderr, "*******\n*\n* Here you have 5 seconds to test the masked "
+          "sbuttons.on_button_press notifications\n"
+          "* Please tap/hold the sbuttons\n*\n*******\n");
+  Sleep(5000);
+  if (err = sbuttons->unsubscribe(&num_subscribe)) {
+    print_error(err);
+  }
+  hippo::NotificationStats stats;
+  if (!sbuttons->notification_stats(&stats)) {
+    fprintf(stderr, "sbuttons: %lld notifications filtered by the mask\n",
+            stats.filtered);
+  }
   return 0;
 }
 
@@ -4,6 +4,8 @@
 
 #include <cstdio>
 #include <cstring>
+#include <thread>   // NOLINT
+#include <vector>
 #include "include/system.h"
 
 const char *PowerState_str[] = {
@@ -150,6 +152,39 @@ void print_hardware_ids(hippo::HardwareIDs *hwIDs,
   }
 }
 
+// reads the session id from several threads at once with the read
+// coalescing enabled: all of them must get the same value back
+uint64_t TestCoalescedReads(hippo::System *system, uint32_t session_id) {
+  const uint32_t kNumThreads = 8;
+  uint64_t errs[kNumThreads] = { 0 };
+  uint32_t ids[kNumThreads] = { 0 };
+  std::vector<std::thread> threads;
+
+  system->coalesce_reads(true);
+  for (uint32_t i = 0; i < kNumThreads; i++) {
+    threads.push_back(std::thread([system, &errs, &ids, i] {
+      errs[i] = system->session_id(&ids[i]);
+    }));
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+  system->coalesce_reads(false);
+
+  for (uint32_t i = 0; i < kNumThreads; i++) {
+    if (errs[i]) {
+      return errs[i];
+    }
+    if (ids[i] != session_id) {
+      fprintf(stderr, "coalesced session_id %d != %d\n", ids[i], session_id);
+      return MAKE_HIPPO_ERROR(hippo::HIPPO_SYSTEM, hippo::HIPPO_ERROR);
+    }
+  }
+  fprintf(stderr, "%d coalesced session_id reads returned %d\n",
+          kNumThreads, session_id);
+  return 0LL;
+}
+
 uint64_t TestSystem(hippo::System *system) {
   uint64_t err;
   fprintf(stderr, "#################################\n");
@@ -181,6 +216,10 @@ uint64_t TestSystem(hippo::System *system) {
   }
   fprintf(stderr, "Current Session ID is: %d\n", sessionID);
 
+  if (err = TestCoalescedReads(system, sessionID)) {
+    return err;
+  }
+
   hippo::SessionState sessionState;
   if (err = system->is_locked(&sessionState)) {
     return err;